@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * 对数-线性延迟直方图（HDR 风格）
+ *
+ * 每个 2 的幂区间再均分为 2^sub_bucket_bits 个子桶，相对误差不超过
+ * 1/2^sub_bucket_bits，记录一次只需几条整数指令，可以放在交接热路径上。
+ * 每个线程各自记录，结束后再 merge 汇总。
+ */
+class latency_histogram {
+private:
+    static constexpr uint32_t sub_bucket_bits = 4;
+    static constexpr uint32_t sub_buckets = 1u << sub_bucket_bits;
+    static constexpr uint32_t magnitudes = 64 - sub_bucket_bits;
+
+    std::vector<uint64_t> counts_ = std::vector<uint64_t>(magnitudes * sub_buckets + sub_buckets, 0);
+    uint64_t total_ = 0;
+
+    static uint32_t index_of(uint64_t value) {
+        if (value < sub_buckets) {
+            return static_cast<uint32_t>(value);
+        }
+        const uint32_t magnitude = 63 - static_cast<uint32_t>(__builtin_clzll(value));
+        const uint32_t shift = magnitude - sub_bucket_bits;
+        const uint32_t sub = static_cast<uint32_t>(value >> shift) & (sub_buckets - 1);
+        return (shift + 1) * sub_buckets + sub;
+    }
+
+    // 桶的上界，作为该桶内数值的代表
+    static uint64_t value_of(uint32_t index) {
+        if (index < sub_buckets) {
+            return index;
+        }
+        const uint32_t shift = index / sub_buckets - 1;
+        const uint64_t sub = index % sub_buckets;
+        return ((sub_buckets | sub) << shift) + ((uint64_t(1) << shift) - 1);
+    }
+
+public:
+    void record(uint64_t value) {
+        counts_[index_of(value)]++;
+        total_++;
+    }
+
+    void merge(const latency_histogram& other) {
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+    }
+
+    uint64_t count() const {
+        return total_;
+    }
+
+    /**
+     * 获取分位数
+     *
+     * @param quantile 0 到 1 之间，例如 0.999
+     * @return 不小于该比例样本的最小桶上界，没有样本时为 0
+     */
+    uint64_t percentile(double quantile) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(total_));
+        if (rank >= total_) {
+            rank = total_ - 1;
+        }
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen > rank) {
+                return value_of(i);
+            }
+        }
+        return value_of(static_cast<uint32_t>(counts_.size() - 1));
+    }
+};
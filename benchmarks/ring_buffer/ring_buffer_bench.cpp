@@ -0,0 +1,295 @@
+#include "../../include/ring_buffer/ring_buffer.h"
+#include "../../include/ring_buffer/spsc_ring_buffer.h"
+#include "latency_histogram.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(SYNC_HAVE_BOOST_LOCKFREE)
+#include <boost/lockfree/queue.hpp>
+#endif
+
+// 单线程推入/取出往返，衡量每次交接的原子操作与屏障开销
+template <typename order>
+static void BM_PushGetRoundTrip(benchmark::State& state) {
+    ring_buffer<int, 1024, order> rb;
+    int value = 0;
+    for (auto _ : state) {
+        rb.push(value);
+        rb.get(value);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_PushGetRoundTrip, seq_cst_order);
+BENCHMARK_TEMPLATE(BM_PushGetRoundTrip, acq_rel_order);
+
+using mpmc_seq_cst = ring_buffer<int, 1024, seq_cst_order>;
+using mpmc_acq_rel = ring_buffer<int, 1024, acq_rel_order>;
+using spsc = spsc_ring_buffer<int, 1024>;
+
+// 多线程交接：偶数线程生产，奇数线程消费，各线程迭代次数相同保证收支平衡
+template <typename buffer_type>
+static void BM_ProducerConsumer(benchmark::State& state) {
+    static buffer_type rb;
+    const bool producer = (state.thread_index() % 2) == 0;
+    int value = 0;
+    for (auto _ : state) {
+        if (producer) {
+            while (!rb.push(value)) {
+                std::this_thread::yield();
+            }
+        } else {
+            while (!rb.get(value)) {
+                std::this_thread::yield();
+            }
+            benchmark::DoNotOptimize(value);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_ProducerConsumer, mpmc_seq_cst)->Threads(2)->Threads(8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ProducerConsumer, mpmc_acq_rel)->Threads(2)->Threads(8)->UseRealTime();
+// SPSC只能有一个生产者和一个消费者
+BENCHMARK_TEMPLATE(BM_ProducerConsumer, spsc)->Threads(2)->UseRealTime();
+
+// 单元格布局对比：与StressTest相同的小缓冲区，8~32个线程
+using stress_packed = ring_buffer<int, 16, acq_rel_order, packed_layout>;
+using stress_padded = ring_buffer<int, 16, acq_rel_order, padded_layout>;
+using stress_scrambled = ring_buffer<int, 16, acq_rel_order, scrambled_layout>;
+using wide_packed = ring_buffer<int, 1024, acq_rel_order, packed_layout>;
+using wide_padded = ring_buffer<int, 1024, acq_rel_order, padded_layout>;
+using wide_scrambled = ring_buffer<int, 1024, acq_rel_order, scrambled_layout>;
+BENCHMARK_TEMPLATE(BM_ProducerConsumer, stress_packed)->ThreadRange(8, 32)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ProducerConsumer, stress_padded)->ThreadRange(8, 32)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ProducerConsumer, stress_scrambled)->ThreadRange(8, 32)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ProducerConsumer, wide_packed)->ThreadRange(8, 32)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ProducerConsumer, wide_padded)->ThreadRange(8, 32)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ProducerConsumer, wide_scrambled)->ThreadRange(8, 32)->UseRealTime();
+
+// 批量交接：一次CAS占有一段单元格，对比逐个push/get
+template <typename buffer_type>
+static void BM_BatchProducerConsumer(benchmark::State& state) {
+    static buffer_type rb;
+    const bool producer = (state.thread_index() % 2) == 0;
+    const size_t batch = static_cast<size_t>(state.range(0));
+    int values[64] = {};
+    for (auto _ : state) {
+        size_t done = 0;
+        while (done < batch) {
+            size_t n = producer ? rb.push_n(values + done, values + batch)
+                                : rb.get_n(values + done, batch - done);
+            if (n == 0) {
+                std::this_thread::yield();
+            }
+            done += n;
+        }
+        benchmark::DoNotOptimize(values);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+}
+BENCHMARK_TEMPLATE(BM_BatchProducerConsumer, mpmc_acq_rel)->Arg(1)->Arg(8)->Arg(32)->Threads(2)->Threads(8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_BatchProducerConsumer, spsc)->Arg(1)->Arg(8)->Arg(32)->Threads(2)->UseRealTime();
+
+// ---------------------------------------------------------------------------
+// 场景化交接测试：P个生产者、C个消费者，不同元素大小，报告吞吐量与交接延迟分位数
+// ---------------------------------------------------------------------------
+
+// 指定字节数的元素，前8字节为生产时刻（纳秒），用于计算交接延迟
+template <size_t bytes>
+struct payload {
+    static_assert(bytes > sizeof(uint64_t), "payload must hold a timestamp");
+    uint64_t stamp_ns;
+    unsigned char pad[bytes - sizeof(uint64_t)];
+};
+
+// 只有时间戳的8字节元素：零长度数组不是标准 C++
+template <>
+struct payload<sizeof(uint64_t)> {
+    uint64_t stamp_ns;
+};
+
+static_assert(sizeof(payload<8>) == 8 && sizeof(payload<64>) == 64 && sizeof(payload<256>) == 256,
+              "payload sizes must match their template argument");
+
+static uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// 各实现统一为 try_push/try_pop 接口
+template <typename T>
+struct mpmc_ring {
+    using value_type = T;
+    static constexpr bool multi_producer = true;
+    static constexpr bool multi_consumer = true;
+    ring_buffer<T, 1024> queue;
+    bool try_push(const T& value) { return queue.push(value); }
+    bool try_pop(T& value) { return queue.get(value); }
+};
+
+template <typename T>
+struct spsc_ring {
+    using value_type = T;
+    static constexpr bool multi_producer = false;
+    static constexpr bool multi_consumer = false;
+    spsc_ring_buffer<T, 1024> queue;
+    bool try_push(const T& value) { return queue.push(value); }
+    bool try_pop(T& value) { return queue.get(value); }
+};
+
+// 对照组：互斥锁 + std::deque，容量同样限制为1024
+template <typename T>
+struct mutex_deque {
+    using value_type = T;
+    static constexpr bool multi_producer = true;
+    static constexpr bool multi_consumer = true;
+    std::mutex mutex;
+    std::deque<T> queue;
+    bool try_push(const T& value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queue.size() >= 1024) {
+            return false;
+        }
+        queue.push_back(value);
+        return true;
+    }
+    bool try_pop(T& value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queue.empty()) {
+            return false;
+        }
+        value = queue.front();
+        queue.pop_front();
+        return true;
+    }
+};
+
+#if defined(SYNC_HAVE_BOOST_LOCKFREE)
+// 对照组：boost::lockfree::queue，固定容量1024
+template <typename T>
+struct boost_lockfree {
+    using value_type = T;
+    static constexpr bool multi_producer = true;
+    static constexpr bool multi_consumer = true;
+    boost::lockfree::queue<T, boost::lockfree::capacity<1024>> queue;
+    bool try_push(const T& value) { return queue.bounded_push(value); }
+    bool try_pop(T& value) { return queue.pop(value); }
+};
+#endif
+
+// 每轮交接的元素总数
+constexpr int64_t handoff_items = 1 << 16;
+
+template <typename queue_type>
+static void BM_Handoff(benchmark::State& state) {
+    using element = typename queue_type::value_type;
+    const int producers = static_cast<int>(state.range(0));
+    const int consumers = static_cast<int>(state.range(1));
+    const int64_t per_producer = handoff_items / producers;
+    const int64_t total = per_producer * producers;
+
+    latency_histogram latency;
+    for (auto _ : state) {
+        // 大元素的内联缓冲区可能有数百KB，放在堆上
+        auto queue_ptr = std::make_unique<queue_type>();
+        queue_type& queue = *queue_ptr;
+        std::atomic<bool> go(false);
+        std::atomic<int64_t> consumed(0);
+        std::vector<latency_histogram> histograms(consumers);
+        std::vector<std::thread> threads;
+
+        for (int p = 0; p < producers; p++) {
+            threads.emplace_back([&]() {
+                element value;
+                std::memset(&value, 0, sizeof(value));
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                for (int64_t i = 0; i < per_producer; i++) {
+                    value.stamp_ns = now_ns();
+                    while (!queue.try_push(value)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (int c = 0; c < consumers; c++) {
+            threads.emplace_back([&, c]() {
+                element value;
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                while (consumed.load(std::memory_order_relaxed) < total) {
+                    if (queue.try_pop(value)) {
+                        histograms[c].record(now_ns() - value.stamp_ns);
+                        consumed.fetch_add(1, std::memory_order_relaxed);
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        // 线程创建不计入时间
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& t : threads) {
+            t.join();
+        }
+        state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        for (auto& h : histograms) {
+            latency.merge(h);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * total);
+    state.SetBytesProcessed(state.iterations() * total * static_cast<int64_t>(sizeof(element)));
+    state.counters["p50_ns"] = static_cast<double>(latency.percentile(0.50));
+    state.counters["p99_ns"] = static_cast<double>(latency.percentile(0.99));
+    state.counters["p999_ns"] = static_cast<double>(latency.percentile(0.999));
+}
+
+// SPSC / MPSC / SPMC / MPMC 及不同线程数
+static void handoff_scenarios(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"producers", "consumers"});
+    b->Args({1, 1});
+    b->Args({4, 1});
+    b->Args({8, 1});
+    b->Args({1, 4});
+    b->Args({1, 8});
+    b->Args({4, 4});
+    b->Args({8, 8});
+    b->Args({16, 16});
+    b->UseManualTime();
+}
+
+static void spsc_scenario(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"producers", "consumers"});
+    b->Args({1, 1});
+    b->UseManualTime();
+}
+
+#define HANDOFF_BENCHMARKS(bytes)                                                            \
+    BENCHMARK_TEMPLATE(BM_Handoff, mpmc_ring<payload<bytes>>)->Apply(handoff_scenarios);     \
+    BENCHMARK_TEMPLATE(BM_Handoff, spsc_ring<payload<bytes>>)->Apply(spsc_scenario);         \
+    BENCHMARK_TEMPLATE(BM_Handoff, mutex_deque<payload<bytes>>)->Apply(handoff_scenarios)
+
+HANDOFF_BENCHMARKS(8);
+HANDOFF_BENCHMARKS(64);
+HANDOFF_BENCHMARKS(256);
+
+#if defined(SYNC_HAVE_BOOST_LOCKFREE)
+BENCHMARK_TEMPLATE(BM_Handoff, boost_lockfree<payload<8>>)->Apply(handoff_scenarios);
+BENCHMARK_TEMPLATE(BM_Handoff, boost_lockfree<payload<64>>)->Apply(handoff_scenarios);
+BENCHMARK_TEMPLATE(BM_Handoff, boost_lockfree<payload<256>>)->Apply(handoff_scenarios);
+#endif
+
+BENCHMARK_MAIN();
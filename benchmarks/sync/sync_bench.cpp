@@ -0,0 +1,1026 @@
+#include "../../include/common/compression.h"
+#include "../../include/common/delta.h"
+#include "../../include/common/directory_scanner.h"
+#include "../../include/common/file_hasher.h"
+#include "../../include/common/file_reader.h"
+#include "../../include/common/manifest.h"
+#include "../../include/common/write_back.h"
+#include "../../include/connection/connection.h"
+#include "../../include/connection/transfer.h"
+#include "../../include/metrics/metrics.h"
+#include "../../include/metrics/trace.h"
+#include "../../include/thread_pool/thread_pool.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * 端到端同步基准
+ *
+ * 在临时目录中生成一个工作负载（源目录 src，对于编辑负载还有旧版本的目标目录 dst），
+ * 然后依次计时同步流水线的各个阶段：
+ *
+ *   scan     并行扫描两端的目录树
+ *   hash     分块哈希两端的文件
+ *   diff     为两端建立清单并比较
+ *   compress 压缩需要发送的数据（--compression 不为 none 时），只统计压缩率，传输仍发送原始数据
+ *   transfer 通过回环 TCP 连接拉取新文件，修改过的文件按增量计划只拉取 literal 分块并在目标端重建；
+ *            目标端的文件经 write_back_stage 写入，按 --durability 落盘，计时包含等待最后一组屏障
+ *   verify   重新哈希目标目录并与源端比较（--verify）
+ *
+ * 每个阶段报告文件/秒、MB/秒和每 GB 的 CPU 时间，最后报告进程的峰值 RSS。
+ * 链路整形用系统工具在回环接口上完成，例如
+ *   tc qdisc add dev lo root netem delay 20ms rate 1gbit
+ * 并用 --rtt-ms / --bandwidth-mbps 告诉拉取方链路参数（决定初始窗口）。
+ */
+
+namespace {
+
+struct bench_options {
+    std::string workload = "tiny";
+    std::string dir;  // 为空时在 /tmp 下新建
+    double scale = 1.0;
+    size_t threads = 0;
+    uint32_t chunk_size = 1u << 20;
+    std::string chunking;  // 为空时按负载选择
+    std::string compression = "none";
+    uint32_t edit_size = 64 * 1024;
+    double edit_fraction = 0.05;
+    double bandwidth_mbps = 0;
+    double rtt_ms = 0;
+    size_t inflight = 64;  // 同时在途的文件拉取数
+    std::string backend = "automatic";
+    durability_level durability = durability_level::batch;
+    bool verify = false;
+    bool keep = false;
+    std::string json;
+    std::string metrics;
+    std::string trace;
+};
+
+/**
+ * 工作负载：files 个大小为 file_size 的文件（小文件负载的大小在 file_size 附近浮动）
+ */
+struct workload_spec {
+    std::string name;
+    uint64_t files = 0;
+    uint64_t file_size = 0;
+    uint64_t files_per_dir = 0;  // 0 表示都放在根目录
+    bool edits = false;          // 目标端已有旧版本，源端随机修改一部分内容
+    chunking_mode chunking = chunking_mode::fixed;
+};
+
+struct stage_result {
+    std::string name;
+    double seconds = 0;
+    double cpu_seconds = 0;
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+};
+
+struct source_file {
+    std::string path;  // 相对路径
+    manifest_meta meta;
+    file_hash_result hash;
+};
+
+double cpu_seconds() {
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+uint64_t peak_rss_bytes() {
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+// 计时一个阶段：墙上时间和进程的 CPU 时间
+class stage_timer {
+public:
+    explicit stage_timer(const char* name)
+        : name_(name), start_(std::chrono::steady_clock::now()), cpu_start_(cpu_seconds()) {}
+
+    stage_result finish(uint64_t files, uint64_t bytes) const {
+        stage_result r;
+        r.name = name_;
+        r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        r.cpu_seconds = cpu_seconds() - cpu_start_;
+        r.files = files;
+        r.bytes = bytes;
+        return r;
+    }
+
+private:
+    const char* name_;
+    std::chrono::steady_clock::time_point start_;
+    double cpu_start_;
+};
+
+uint64_t next_random(uint64_t& state) {
+    // xorshift64*
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+// 每 4KB 前一半是随机数据，后一半是重复的文本，压缩率约为一半
+void fill_data(uint64_t& rng, uint8_t* out, size_t size) {
+    static const char text[] = "sync_bench synthetic payload ";
+    for (size_t i = 0; i < size; ++i) {
+        if ((i & 4095) < 2048) {
+            if ((i & 7) == 0) {
+                const uint64_t word = next_random(rng);
+                const size_t n = std::min<size_t>(8, size - i);
+                std::memcpy(out + i, &word, n);
+                i += n - 1;
+                continue;
+            }
+        } else {
+            out[i] = static_cast<uint8_t>(text[i % (sizeof(text) - 1)]);
+        }
+    }
+}
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+void make_dirs(const std::string& path) {
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+        const std::string prefix = pos == std::string::npos ? path : path.substr(0, pos);
+        if (::mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw_errno("mkdir " + prefix);
+        }
+        if (pos == std::string::npos) {
+            return;
+        }
+    }
+}
+
+void write_all(int fd, const uint8_t* data, size_t size, uint64_t offset, const std::string& path) {
+    while (size > 0) {
+        const ssize_t n = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno("write " + path);
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+}
+
+void read_all(int fd, uint8_t* out, size_t size, uint64_t offset, const std::string& path) {
+    while (size > 0) {
+        const ssize_t n = ::pread(fd, out, size, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno("read " + path);
+        }
+        if (n == 0) {
+            throw std::runtime_error("unexpected end of " + path);
+        }
+        out += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+}
+
+// 自动关闭的文件描述符
+class file_descriptor {
+public:
+    file_descriptor(const std::string& path, int flags) : path_(path), fd_(::open(path.c_str(), flags | O_CLOEXEC, 0644)) {
+        if (fd_ < 0) {
+            throw_errno("open " + path);
+        }
+    }
+
+    ~file_descriptor() {
+        ::close(fd_);
+    }
+
+    file_descriptor(const file_descriptor&) = delete;
+    file_descriptor& operator=(const file_descriptor&) = delete;
+
+    int get() const {
+        return fd_;
+    }
+
+    const std::string& path() const {
+        return path_;
+    }
+
+private:
+    std::string path_;
+    int fd_;
+};
+
+int remove_entry(const char* path, const struct stat*, int, struct FTW*) {
+    return ::remove(path);
+}
+
+void remove_tree(const std::string& path) {
+    ::nftw(path.c_str(), remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+}
+
+// 有界的任务窗口：超过 limit 时先等最早的一个，内存和在途任务数不随文件数增长
+class bounded_tasks {
+public:
+    explicit bounded_tasks(size_t limit) : limit_(limit) {}
+
+    void push(std::future<void> f) {
+        while (pending_.size() >= limit_) {
+            pop();
+        }
+        pending_.push_back(std::move(f));
+    }
+
+    void drain() {
+        while (!pending_.empty()) {
+            pop();
+        }
+    }
+
+private:
+    void pop() {
+        std::future<void> f = std::move(pending_.front());
+        pending_.pop_front();
+        f.get();
+    }
+
+    const size_t limit_;
+    std::deque<std::future<void>> pending_;
+};
+
+workload_spec make_workload(const bench_options& options) {
+    workload_spec spec;
+    spec.name = options.workload;
+    const double scale = options.scale;
+    if (options.workload == "tiny") {
+        // 100 万个 1KB 左右的小文件，每个目录 1000 个
+        spec.files = std::max<uint64_t>(1, static_cast<uint64_t>(std::llround(1000000 * scale)));
+        spec.file_size = 1024;
+        spec.files_per_dir = 1000;
+    } else if (options.workload == "large") {
+        // 几个 50GB 的大文件
+        spec.files = 3;
+        spec.file_size = std::max<uint64_t>(4096, static_cast<uint64_t>(std::llround(50.0 * (1ull << 30) * scale)));
+    } else if (options.workload == "edits") {
+        // 大文件中随机修改 5% 的内容，目标端已有旧版本，按增量传输
+        spec.files = 4;
+        spec.file_size = std::max<uint64_t>(1u << 20, static_cast<uint64_t>(std::llround(2.0 * (1ull << 30) * scale)));
+        spec.edits = true;
+        spec.chunking = chunking_mode::content_defined;
+    } else {
+        throw std::invalid_argument("unknown workload " + options.workload + " (tiny, large or edits)");
+    }
+    if (options.chunking == "fixed") {
+        spec.chunking = chunking_mode::fixed;
+    } else if (options.chunking == "cdc") {
+        spec.chunking = chunking_mode::content_defined;
+    } else if (!options.chunking.empty()) {
+        throw std::invalid_argument("unknown chunking " + options.chunking + " (fixed or cdc)");
+    }
+    return spec;
+}
+
+std::string file_name(const workload_spec& spec, uint64_t index) {
+    char name[64];
+    if (spec.files_per_dir == 0) {
+        std::snprintf(name, sizeof(name), "file%04llu.bin", static_cast<unsigned long long>(index));
+    } else {
+        std::snprintf(name, sizeof(name), "d%05llu/f%07llu", static_cast<unsigned long long>(index / spec.files_per_dir),
+                      static_cast<unsigned long long>(index));
+    }
+    return name;
+}
+
+// 生成一个文件；dst 不为空时写入同样的内容作为目标端的旧版本
+void generate_file(const workload_spec& spec, const bench_options& options, uint64_t index, const std::string& src,
+                   const std::string& dst) {
+    uint64_t rng = 0x9E3779B97F4A7C15ULL * (index + 1);
+    uint64_t size = spec.file_size;
+    if (spec.files_per_dir != 0) {
+        size = spec.file_size / 2 + next_random(rng) % spec.file_size + 1;
+    }
+    file_descriptor out(src, O_WRONLY | O_CREAT | O_TRUNC);
+    std::unique_ptr<file_descriptor> old;
+    if (!dst.empty()) {
+        old.reset(new file_descriptor(dst, O_WRONLY | O_CREAT | O_TRUNC));
+    }
+    std::vector<uint8_t> buffer(static_cast<size_t>(std::min<uint64_t>(size, 1u << 20)));
+    for (uint64_t offset = 0; offset < size; offset += buffer.size()) {
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(buffer.size(), size - offset));
+        fill_data(rng, buffer.data(), n);
+        write_all(out.get(), buffer.data(), n, offset, src);
+        if (old) {
+            write_all(old->get(), buffer.data(), n, offset, dst);
+        }
+    }
+    if (!spec.edits) {
+        return;
+    }
+    // 在源端随机位置覆盖 edit_size 大小的区域，直到改动的字节数达到比例
+    const uint32_t edit = static_cast<uint32_t>(std::min<uint64_t>(options.edit_size, size));
+    const uint64_t edits = static_cast<uint64_t>(std::ceil(options.edit_fraction * static_cast<double>(size) / edit));
+    buffer.resize(edit);
+    for (uint64_t k = 0; k < edits; ++k) {
+        const uint64_t offset = size == edit ? 0 : next_random(rng) % (size - edit);
+        fill_data(rng, buffer.data(), edit);
+        write_all(out.get(), buffer.data(), edit, offset, src);
+    }
+}
+
+void generate(thread_pool& pool, const workload_spec& spec, const bench_options& options, const std::string& src,
+              const std::string& dst) {
+    make_dirs(src);
+    make_dirs(dst);
+    if (spec.files_per_dir != 0) {
+        for (uint64_t d = 0; d * spec.files_per_dir < spec.files; ++d) {
+            const std::string name = file_name(spec, d * spec.files_per_dir);
+            const std::string sub = name.substr(0, name.find('/'));
+            make_dirs(src + "/" + sub);
+            if (spec.edits) {
+                make_dirs(dst + "/" + sub);
+            }
+        }
+    }
+    bounded_tasks pending(pool.size() * 4);
+    for (uint64_t i = 0; i < spec.files; ++i) {
+        const std::string name = file_name(spec, i);
+        const std::string old = spec.edits ? dst + "/" + name : std::string();
+        pending.push(pool.submit([&spec, &options, i, path = src + "/" + name, old] {
+            generate_file(spec, options, i, path, old);
+        }));
+    }
+    pending.drain();
+}
+
+// 扫描 root 下的普通文件
+std::vector<source_file> scan(thread_pool& pool, const std::string& root) {
+    std::vector<source_file> files;
+    directory_scanner scanner(pool, root);
+    scan_entry entry;
+    while (scanner.entries().get_wait(entry)) {
+        if (!S_ISREG(entry.mode)) {
+            continue;
+        }
+        source_file f;
+        f.path = std::move(entry.path);
+        f.meta.size = entry.id.size;
+        f.meta.mtime_ns = entry.id.mtime_ns;
+        f.meta.mode = entry.mode;
+        files.push_back(std::move(f));
+    }
+    scanner.wait();
+    std::sort(files.begin(), files.end(), [](const source_file& a, const source_file& b) { return a.path < b.path; });
+    return files;
+}
+
+// 每个文件一个任务，文件内部再由 file_hasher 拆成分块任务；给出 transfer_prefix 时
+// 分块的跟踪编号按传输时的文件名（transfer_prefix + 相对路径）计算，与发送和写回连成一条线
+uint64_t hash_all(thread_pool& pool, const file_hasher& hasher, const std::string& root,
+                  std::vector<source_file>& files, const std::string& transfer_prefix = std::string()) {
+    uint64_t bytes = 0;
+    bounded_tasks pending(1024);
+    for (source_file& f : files) {
+        bytes += f.meta.size;
+        const uint64_t trace_key =
+            trace_enabled() && !transfer_prefix.empty() ? trace_file_key(transfer_prefix + f.path) : 0;
+        pending.push(pool.submit_to(task_lane::hash, [&hasher, &f, path = root + "/" + f.path, trace_key] {
+            f.hash = hasher.hash_file(path, trace_key);
+        }));
+    }
+    pending.drain();
+    return bytes;
+}
+
+std::shared_ptr<std::vector<uint8_t>> build_manifest(const std::vector<source_file>& files) {
+    manifest_builder builder;
+    for (const source_file& f : files) {
+        builder.add(f.path, f.meta, f.hash.root);
+    }
+    return std::make_shared<std::vector<uint8_t>>(builder.finish());
+}
+
+// 一次文件拉取：数据经写回阶段写入 out，拉取完成后提交
+struct fetch_target {
+    std::shared_ptr<write_back_file> out;
+    std::future<uint64_t> done;
+};
+
+fetch_target start_fetch(transfer_client& client, write_back_stage& writer, const std::string& name,
+                         const std::string& path, uint64_t size) {
+    fetch_target target;
+    target.out = writer.open(path, size, 0644, trace_enabled() ? trace_file_key(name) : 0);
+    std::shared_ptr<write_back_file> out = target.out;
+    target.done = client.fetch(name, [out](uint64_t offset, const uint8_t* data, size_t size) {
+        out->write(offset, data, size);
+    });
+    return target;
+}
+
+struct transfer_totals {
+    uint64_t files = 0;
+    uint64_t deltas = 0;         // 增量传输的文件数
+    uint64_t bytes = 0;          // 写入目标端的字节数
+    uint64_t literal_bytes = 0;  // 增量传输中需要发送的字节数
+    uint64_t copied_bytes = 0;   // 增量传输中从旧版本复制的字节数
+    uint64_t removed = 0;
+    uint64_t metadata_only = 0;
+};
+
+/**
+ * 一个修改过的文件的增量传输：发送方把计划中的 literal 分块写成一个包（真实的发送方
+ * 会直接发出这些分块），拉取方拉取这个包，再用旧版本和包中的数据重建新文件；
+ * 重建的文件在写回阶段提交，提交的 future 放进 commits
+ */
+void transfer_delta(transfer_client& client, write_back_stage& writer, const std::string& scratch,
+                    const source_file& source, const source_file& basis, const std::string& src_path,
+                    const std::string& dst_path, std::vector<std::future<void>>& commits, transfer_totals& totals) {
+    const delta_plan plan = make_delta_plan(source.hash, basis.hash.chunks);
+    totals.literal_bytes += plan.literal_bytes();
+    totals.copied_bytes += plan.copied_bytes();
+
+    const uint64_t seq = totals.deltas++;
+    const std::string pack_name = "pack/" + std::to_string(seq);
+    {
+        file_descriptor in(src_path, O_RDONLY);
+        file_descriptor pack(scratch + "/" + pack_name, O_WRONLY | O_CREAT | O_TRUNC);
+        std::vector<uint8_t> buffer;
+        uint64_t pack_offset = 0;
+        for (const delta_op& op : plan.ops) {
+            if (!op.literal) {
+                continue;
+            }
+            buffer.resize(op.length);
+            read_all(in.get(), buffer.data(), op.length, op.target_offset, src_path);
+            write_all(pack.get(), buffer.data(), op.length, pack_offset, pack.path());
+            pack_offset += op.length;
+        }
+    }
+
+    // 拉取到的包是临时数据，直接写入，不经过写回阶段
+    const std::string recv_path = scratch + "/recv/" + std::to_string(seq);
+    {
+        auto received = std::make_shared<file_descriptor>(recv_path, O_WRONLY | O_CREAT | O_TRUNC);
+        client.fetch(pack_name, [received](uint64_t offset, const uint8_t* data, size_t size) {
+                  write_all(received->get(), data, size, offset, received->path());
+              }).get();
+    }
+
+    {
+        file_descriptor basis_file(dst_path, O_RDONLY);
+        file_descriptor literals(recv_path, O_RDONLY);
+        std::unique_ptr<write_back_file> out = writer.open(dst_path, plan.size);
+        uint64_t literal_offset = 0;
+        uint64_t out_offset = 0;
+        apply_delta(
+            plan,
+            [&](uint64_t offset, uint8_t* data, uint32_t length) {
+                read_all(basis_file.get(), data, length, offset, basis_file.path());
+            },
+            [&](uint8_t* data, uint32_t length) {
+                read_all(literals.get(), data, length, literal_offset, literals.path());
+                literal_offset += length;
+            },
+            [&](const uint8_t* data, uint32_t length) {
+                out->write(out_offset, data, length);
+                out_offset += length;
+            });
+        commits.push_back(out->commit());
+    }
+    ::unlink((scratch + "/" + pack_name).c_str());
+    ::unlink(recv_path.c_str());
+    totals.files++;
+    totals.bytes += plan.size;
+}
+
+// 需要发送的数据：新文件整个发送，修改过的文件只发送增量计划中的 literal 分块
+struct outgoing_file {
+    const source_file* file = nullptr;
+    const source_file* basis = nullptr;  // 目标端的旧版本，新文件为空
+};
+
+// 压缩需要发送的数据，统计压缩率；每个文件一个 compression_stage，退避状态按文件计
+compression_stats compress_outgoing(thread_pool& pool, const compression_options& copts, uint32_t chunk_size,
+                                    const std::string& src, const std::vector<outgoing_file>& outgoing) {
+    compression_stats total;
+    for (const outgoing_file& f : outgoing) {
+        std::vector<chunk_span> ranges;
+        if (f.basis != nullptr) {
+            for (const delta_op& op : make_delta_plan(f.file->hash, f.basis->hash.chunks).ops) {
+                if (op.literal) {
+                    ranges.push_back(chunk_span{op.target_offset, op.length});
+                }
+            }
+        } else {
+            ranges = fixed_size_chunks(f.file->meta.size, chunk_size);
+        }
+
+        compression_stage stage(pool, copts);
+        file_reader reader(src + "/" + f.file->path);
+        const uint64_t trace_key = trace_enabled() ? trace_file_key("src/" + f.file->path) : 0;
+        std::vector<std::future<compressed_chunk>> chunks;
+        for (const chunk_span& range : ranges) {
+            chunks.push_back(stage.compress_async(reader.read(range.offset, range.length),
+                                                  trace_chunk_id(trace_key, range.offset)));
+            if (chunks.size() >= pool.size() * 2) {
+                for (auto& c : chunks) {
+                    c.get();
+                }
+                chunks.clear();
+            }
+        }
+        for (auto& c : chunks) {
+            c.get();
+        }
+        const compression_stats s = stage.stats();
+        total.chunks += s.chunks;
+        total.compressed += s.compressed;
+        total.bytes_in += s.bytes_in;
+        total.bytes_out += s.bytes_out;
+    }
+    return total;
+}
+
+compression_codec parse_codec(const std::string& name) {
+    for (compression_codec codec : {compression_codec::none, compression_codec::lz4, compression_codec::zstd,
+                                    compression_codec::deflate}) {
+        if (name == codec_name(codec)) {
+            if (!codec_available(codec)) {
+                throw std::invalid_argument("compression " + name + " is not available in this build");
+            }
+            return codec;
+        }
+    }
+    throw std::invalid_argument("unknown compression " + name);
+}
+
+reactor_backend parse_backend(const std::string& name) {
+    if (name == "automatic") {
+        return reactor_backend::automatic;
+    }
+    if (name == "readiness") {
+        return reactor_backend::readiness;
+    }
+    if (name == "io_uring") {
+        return reactor_backend::io_uring;
+    }
+    throw std::invalid_argument("unknown backend " + name + " (automatic, readiness or io_uring)");
+}
+
+durability_level parse_durability(const std::string& name) {
+    if (name == "none") {
+        return durability_level::none;
+    }
+    if (name == "batch") {
+        return durability_level::batch;
+    }
+    if (name == "file") {
+        return durability_level::file;
+    }
+    throw std::invalid_argument("unknown durability " + name + " (none, batch or file)");
+}
+
+const char* durability_name(durability_level level) {
+    switch (level) {
+        case durability_level::none:
+            return "none";
+        case durability_level::batch:
+            return "batch";
+        case durability_level::file:
+            return "file";
+    }
+    return "unknown";
+}
+
+void print_usage() {
+    std::fprintf(stderr,
+                 "usage: sync_bench [options]\n"
+                 "  --workload=tiny|large|edits  1M tiny files, three 50 GB files, or 5%% edits in four 2 GB files\n"
+                 "  --scale=F                    multiply file counts (tiny) or sizes (large, edits) by F\n"
+                 "  --dir=PATH                   scratch directory (default: new directory under /tmp)\n"
+                 "  --threads=N                  thread-pool workers (default: all CPUs)\n"
+                 "  --chunk-size=BYTES           hash and transfer chunk size (default 1048576)\n"
+                 "  --chunking=fixed|cdc         chunking mode (default: cdc for edits, fixed otherwise)\n"
+                 "  --compression=CODEC          none, lz4, zstd or deflate\n"
+                 "  --edit-size=BYTES            size of each edited region (default 65536)\n"
+                 "  --edit-fraction=F            fraction of each file edited (default 0.05)\n"
+                 "  --bandwidth-mbps=N --rtt-ms=N  link parameters for the initial transfer window\n"
+                 "  --inflight=N                 concurrent file fetches (default 64)\n"
+                 "  --backend=automatic|readiness|io_uring\n"
+                 "  --durability=none|batch|file destination durability (default batch: group commit)\n"
+                 "  --verify                     rehash the destination and compare\n"
+                 "  --keep                       keep the scratch directory\n"
+                 "  --json=PATH                  also write the results as JSON\n"
+                 "  --metrics=PATH               write Prometheus metrics after the run\n"
+                 "  --trace=PATH                 write a Chrome trace of the pipeline\n");
+}
+
+bool parse_options(int argc, char** argv, bench_options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        const std::string key = arg.substr(0, eq);
+        const std::string value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+        if (key == "--workload") {
+            options.workload = value;
+        } else if (key == "--scale") {
+            options.scale = std::stod(value);
+        } else if (key == "--dir") {
+            options.dir = value;
+        } else if (key == "--threads") {
+            options.threads = std::stoul(value);
+        } else if (key == "--chunk-size") {
+            options.chunk_size = static_cast<uint32_t>(std::stoul(value));
+        } else if (key == "--chunking") {
+            options.chunking = value;
+        } else if (key == "--compression") {
+            options.compression = value;
+        } else if (key == "--edit-size") {
+            options.edit_size = static_cast<uint32_t>(std::stoul(value));
+        } else if (key == "--edit-fraction") {
+            options.edit_fraction = std::stod(value);
+        } else if (key == "--bandwidth-mbps") {
+            options.bandwidth_mbps = std::stod(value);
+        } else if (key == "--rtt-ms") {
+            options.rtt_ms = std::stod(value);
+        } else if (key == "--inflight") {
+            options.inflight = std::max<size_t>(1, std::stoul(value));
+        } else if (key == "--backend") {
+            options.backend = value;
+        } else if (key == "--durability") {
+            options.durability = parse_durability(value);
+        } else if (key == "--verify") {
+            options.verify = true;
+        } else if (key == "--keep") {
+            options.keep = true;
+        } else if (key == "--json") {
+            options.json = value;
+        } else if (key == "--metrics") {
+            options.metrics = value;
+        } else if (key == "--trace") {
+            options.trace = value;
+        } else {
+            return false;
+        }
+    }
+    return options.chunk_size > 0 && options.edit_size > 0 && options.scale > 0;
+}
+
+void print_stage(const stage_result& s) {
+    const double mb = static_cast<double>(s.bytes) / 1e6;
+    const double gb = static_cast<double>(s.bytes) / 1e9;
+    char cpu_per_gb[32] = "-";
+    if (s.bytes > 0) {
+        std::snprintf(cpu_per_gb, sizeof(cpu_per_gb), "%.2f", s.cpu_seconds / gb);
+    }
+    std::printf("%-10s %10.3f %12.0f %10.1f %10.2f %10s\n", s.name.c_str(), s.seconds,
+                s.seconds > 0 ? static_cast<double>(s.files) / s.seconds : 0.0, s.seconds > 0 ? mb / s.seconds : 0.0,
+                s.cpu_seconds, cpu_per_gb);
+}
+
+void write_json(const std::string& path, const bench_options& options, const workload_spec& spec,
+                const std::vector<stage_result>& stages, const transfer_totals& totals, uint64_t wire_bytes,
+                uint64_t peak_rss) {
+    FILE* out = std::fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        throw_errno("open " + path);
+    }
+    std::fprintf(out,
+                 "{\"workload\":\"%s\",\"files\":%llu,\"file_size\":%llu,\"threads\":%zu,\"chunk_size\":%u,"
+                 "\"chunking\":\"%s\",\"compression\":\"%s\",\"durability\":\"%s\",\"stages\":[",
+                 spec.name.c_str(), static_cast<unsigned long long>(spec.files),
+                 static_cast<unsigned long long>(spec.file_size), options.threads, options.chunk_size,
+                 spec.chunking == chunking_mode::fixed ? "fixed" : "cdc", options.compression.c_str(),
+                 durability_name(options.durability));
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const stage_result& s = stages[i];
+        std::fprintf(out, "%s{\"name\":\"%s\",\"seconds\":%.6f,\"cpu_seconds\":%.6f,\"files\":%llu,\"bytes\":%llu}",
+                     i == 0 ? "" : ",", s.name.c_str(), s.seconds, s.cpu_seconds,
+                     static_cast<unsigned long long>(s.files), static_cast<unsigned long long>(s.bytes));
+    }
+    std::fprintf(out, "],\"wire_bytes\":%llu,\"literal_bytes\":%llu,\"copied_bytes\":%llu,\"peak_rss\":%llu}\n",
+                 static_cast<unsigned long long>(wire_bytes), static_cast<unsigned long long>(totals.literal_bytes),
+                 static_cast<unsigned long long>(totals.copied_bytes), static_cast<unsigned long long>(peak_rss));
+    std::fclose(out);
+}
+
+int run(bench_options options) {
+    const workload_spec spec = make_workload(options);
+    const compression_codec codec = parse_codec(options.compression);
+
+    std::string scratch = options.dir;
+    bool created = false;
+    if (scratch.empty()) {
+        char tmpl[] = "/tmp/sync_bench.XXXXXX";
+        if (::mkdtemp(tmpl) == nullptr) {
+            throw_errno("mkdtemp");
+        }
+        scratch = tmpl;
+        created = true;
+    } else {
+        make_dirs(scratch);
+    }
+    const std::string src = scratch + "/src";
+    const std::string dst = scratch + "/dst";
+    struct stat st;
+    if (::stat(src.c_str(), &st) == 0 || ::stat(dst.c_str(), &st) == 0) {
+        throw std::invalid_argument(scratch + " already contains src or dst; use an empty directory");
+    }
+    make_dirs(scratch + "/pack");
+    make_dirs(scratch + "/recv");
+
+    thread_pool pool(options.threads);
+    options.threads = pool.size();
+
+    std::printf("workload %s: %llu files of %llu bytes%s, scratch %s\n", spec.name.c_str(),
+                static_cast<unsigned long long>(spec.files), static_cast<unsigned long long>(spec.file_size),
+                spec.edits ? " (edited)" : "", scratch.c_str());
+    std::printf("threads %zu, chunking %s, chunk size %u, compression %s, durability %s\n", options.threads,
+                spec.chunking == chunking_mode::fixed ? "fixed" : "cdc", options.chunk_size, codec_name(codec),
+                durability_name(options.durability));
+    std::fflush(stdout);
+
+    std::vector<stage_result> stages;
+    {
+        stage_timer timer("generate");
+        generate(pool, spec, options, src, dst);
+        stages.push_back(timer.finish(spec.files, 0));
+    }
+    if (!options.trace.empty()) {
+        trace_start();
+    }
+
+    // scan
+    std::vector<source_file> source;
+    std::vector<source_file> target;
+    {
+        stage_timer timer("scan");
+        source = scan(pool, src);
+        target = scan(pool, dst);
+        stages.push_back(timer.finish(source.size() + target.size(), 0));
+    }
+
+    // hash
+    file_hasher_options hopts;
+    hopts.chunking = spec.chunking;
+    hopts.chunk_size = options.chunk_size;
+    const file_hasher hasher(pool, hopts);
+    {
+        stage_timer timer("hash");
+        uint64_t bytes = hash_all(pool, hasher, src, source, "src/");
+        bytes += hash_all(pool, hasher, dst, target);
+        stages.push_back(timer.finish(source.size() + target.size(), bytes));
+    }
+
+    // diff
+    std::vector<manifest_change> changes;
+    {
+        stage_timer timer("diff");
+        const auto remote_bytes = build_manifest(source);
+        const auto local_bytes = build_manifest(target);
+        const manifest remote(file_view(remote_bytes->data(), remote_bytes->size(), remote_bytes));
+        const manifest local(file_view(local_bytes->data(), local_bytes->size(), local_bytes));
+        diff_manifests(local, remote, [&changes](const manifest_change& c) { changes.push_back(c); });
+        stages.push_back(timer.finish(source.size() + target.size(), remote_bytes->size() + local_bytes->size()));
+    }
+
+    std::unordered_map<std::string, size_t> source_index;
+    std::unordered_map<std::string, size_t> target_index;
+    for (size_t i = 0; i < source.size(); ++i) {
+        source_index.emplace(source[i].path, i);
+    }
+    for (size_t i = 0; i < target.size(); ++i) {
+        target_index.emplace(target[i].path, i);
+    }
+
+    // compress：只统计压缩率和耗时
+    compression_stats cstats;
+    if (codec != compression_codec::none) {
+        std::vector<outgoing_file> outgoing;
+        for (const manifest_change& c : changes) {
+            outgoing_file f;
+            if (c.type == manifest_change::kind::modified) {
+                f.basis = &target[target_index.at(c.path)];
+            } else if (c.type != manifest_change::kind::added) {
+                continue;
+            }
+            f.file = &source[source_index.at(c.path)];
+            outgoing.push_back(f);
+        }
+        compression_options copts;
+        copts.codec = codec;
+        stage_timer timer("compress");
+        cstats = compress_outgoing(pool, copts, options.chunk_size, src, outgoing);
+        stages.push_back(timer.finish(outgoing.size(), cstats.bytes_in));
+    }
+
+    // transfer
+    transfer_totals totals;
+    uint64_t wire_bytes = 0;
+    write_back_stats write_stats;
+    {
+        reactor_options ropts;
+        ropts.backend = parse_backend(options.backend);
+        ropts.max_frame_size = std::max<uint32_t>(ropts.max_frame_size, options.chunk_size);
+        reactor r(pool, ropts);
+        transfer_server server([&scratch](const std::string& name) { return shared_file::open(scratch + "/" + name); });
+        const uint16_t port = r.listen("127.0.0.1", 0, server.handler());
+
+        transfer_options topts;
+        topts.chunk_size = options.chunk_size;
+        if (options.bandwidth_mbps > 0 && options.rtt_ms > 0) {
+            topts.link_bandwidth = options.bandwidth_mbps * 1e6 / 8;
+            topts.link_rtt = std::chrono::microseconds(static_cast<int64_t>(options.rtt_ms * 1000));
+        }
+        transfer_client client(r, "127.0.0.1", port, topts);
+
+        write_back_options wopts;
+        wopts.durability = options.durability;
+        wopts.write_batch_bytes = std::max<size_t>(wopts.write_batch_bytes, options.chunk_size);
+        write_back_stage writer(pool, wopts);
+
+        stage_timer timer("transfer");
+        std::set<std::string> made_dirs;
+        std::deque<fetch_target> inflight;
+        std::vector<std::future<void>> commits;
+        auto finish_one = [&]() {
+            fetch_target& f = inflight.front();
+            totals.bytes += f.done.get();
+            totals.files++;
+            commits.push_back(f.out->commit());
+            inflight.pop_front();
+        };
+        for (const manifest_change& c : changes) {
+            const std::string dst_path = dst + "/" + c.path;
+            switch (c.type) {
+                case manifest_change::kind::added: {
+                    const size_t slash = c.path.rfind('/');
+                    if (slash != std::string::npos) {
+                        const std::string parent = dst + "/" + c.path.substr(0, slash);
+                        if (made_dirs.insert(parent).second) {
+                            make_dirs(parent);
+                        }
+                    }
+                    while (inflight.size() >= options.inflight) {
+                        finish_one();
+                    }
+                    inflight.push_back(start_fetch(client, writer, "src/" + c.path, dst_path,
+                                                   source[source_index.at(c.path)].meta.size));
+                    break;
+                }
+                case manifest_change::kind::modified:
+                    transfer_delta(client, writer, scratch, source[source_index.at(c.path)],
+                                   target[target_index.at(c.path)], src + "/" + c.path, dst_path, commits, totals);
+                    break;
+                case manifest_change::kind::removed:
+                    if (::unlink(dst_path.c_str()) != 0) {
+                        throw_errno("unlink " + dst_path);
+                    }
+                    totals.removed++;
+                    break;
+                case manifest_change::kind::metadata:
+                    totals.metadata_only++;
+                    break;
+            }
+        }
+        while (!inflight.empty()) {
+            finish_one();
+        }
+        for (auto& c : commits) {
+            c.get();
+        }
+        wire_bytes = client.stats().bytes_received;
+        stages.push_back(timer.finish(totals.files, totals.bytes));
+        write_stats = writer.stats();
+    }
+
+    // verify
+    uint64_t mismatches = 0;
+    if (options.verify) {
+        stage_timer timer("verify");
+        std::vector<source_file> copied = scan(pool, dst);
+        const uint64_t bytes = hash_all(pool, hasher, dst, copied);
+        if (copied.size() != source.size()) {
+            mismatches++;
+        }
+        for (size_t i = 0; i < copied.size() && i < source.size(); ++i) {
+            if (copied[i].path != source[i].path || copied[i].hash.root != source[i].hash.root) {
+                mismatches++;
+            }
+        }
+        stages.push_back(timer.finish(copied.size(), bytes));
+    }
+
+    if (!options.trace.empty()) {
+        trace_stop();
+        trace_write(options.trace);
+    }
+
+    std::printf("\n%-10s %10s %12s %10s %10s %10s\n", "stage", "seconds", "files/s", "MB/s", "cpu s", "cpu s/GB");
+    stage_result total;
+    total.name = "total";
+    for (const stage_result& s : stages) {
+        print_stage(s);
+        if (s.name != "generate" && s.name != "verify") {
+            total.seconds += s.seconds;
+            total.cpu_seconds += s.cpu_seconds;
+        }
+    }
+    total.files = source.size();
+    for (const source_file& f : source) {
+        total.bytes += f.meta.size;
+    }
+    print_stage(total);
+
+    const uint64_t peak_rss = peak_rss_bytes();
+    std::printf("\nchanges: %llu files written (%llu delta), %llu removed, %llu metadata only\n",
+                static_cast<unsigned long long>(totals.files), static_cast<unsigned long long>(totals.deltas),
+                static_cast<unsigned long long>(totals.removed), static_cast<unsigned long long>(totals.metadata_only));
+    std::printf("wire bytes %llu", static_cast<unsigned long long>(wire_bytes));
+    if (totals.deltas > 0) {
+        std::printf(" (delta literal %llu, copied from basis %llu)", static_cast<unsigned long long>(totals.literal_bytes),
+                    static_cast<unsigned long long>(totals.copied_bytes));
+    }
+    std::printf("\n");
+    std::printf("write-back %s: %llu files, %llu pwritev, %llu syncs in %llu barriers\n",
+                durability_name(options.durability), static_cast<unsigned long long>(write_stats.files),
+                static_cast<unsigned long long>(write_stats.writes), static_cast<unsigned long long>(write_stats.syncs),
+                static_cast<unsigned long long>(write_stats.barriers));
+    if (codec != compression_codec::none && cstats.bytes_in > 0) {
+        std::printf("compression %s: %llu -> %llu bytes (%.1f%%), %llu of %llu chunks compressed\n", codec_name(codec),
+                    static_cast<unsigned long long>(cstats.bytes_in), static_cast<unsigned long long>(cstats.bytes_out),
+                    100.0 * static_cast<double>(cstats.bytes_out) / static_cast<double>(cstats.bytes_in),
+                    static_cast<unsigned long long>(cstats.compressed), static_cast<unsigned long long>(cstats.chunks));
+    }
+    std::printf("peak RSS %.1f MiB\n", static_cast<double>(peak_rss) / (1 << 20));
+    if (options.verify) {
+        std::printf("verify: %s\n", mismatches == 0 ? "ok" : "MISMATCH");
+    }
+
+    if (!options.json.empty()) {
+        write_json(options.json, options, spec, stages, totals, wire_bytes, peak_rss);
+    }
+    if (!options.metrics.empty()) {
+        metrics_registry::global().write_prometheus(options.metrics);
+    }
+    if (!options.keep) {
+        if (created) {
+            remove_tree(scratch);
+        } else {
+            for (const char* sub : {"/src", "/dst", "/pack", "/recv"}) {
+                remove_tree(scratch + sub);
+            }
+        }
+    }
+    return mismatches == 0 ? 0 : 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    bench_options options;
+    try {
+        if (!parse_options(argc, argv, options)) {
+            print_usage();
+            return 2;
+        }
+        return run(options);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "sync_bench: %s\n", e.what());
+        return 1;
+    }
+}
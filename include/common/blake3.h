@@ -0,0 +1,102 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * BLAKE3 摘要长度（字节）
+ */
+constexpr size_t hash_digest_size = 32;
+
+using hash_digest = std::array<uint8_t, hash_digest_size>;
+
+/**
+ * 哈希内核使用的指令集
+ *
+ * 多个 1KB 分块或多个独立输入并行压缩时按 SIMD 宽度同时处理 4/8/16 路。
+ * 启动时按 CPU 支持情况选择最快的内核，也可以通过 set_hash_isa 强制指定（用于测试和基准）。
+ */
+enum class hash_isa {
+    portable,
+    sse2,
+    avx2,
+    avx512,
+    neon,
+};
+
+/**
+ * 当前使用的指令集
+ */
+hash_isa active_hash_isa();
+
+/**
+ * 当前 CPU 和编译配置是否支持该指令集
+ */
+bool hash_isa_supported(hash_isa isa);
+
+/**
+ * 强制使用指定指令集，不支持时抛出 std::invalid_argument
+ */
+void set_hash_isa(hash_isa isa);
+
+const char* hash_isa_name(hash_isa isa);
+
+/**
+ * 增量 BLAKE3 哈希
+ *
+ * 输出与标准 BLAKE3（默认模式、32 字节输出）一致。连续的完整分块批量交给
+ * SIMD 内核压缩，所以一次 update 的数据越大越快。
+ *
+ *     blake3_hasher hasher;
+ *     hasher.update(data, size);
+ *     hash_digest digest = hasher.finalize();
+ */
+class blake3_hasher {
+public:
+    blake3_hasher();
+
+    void update(const void* data, size_t size);
+
+    /**
+     * 计算当前已输入数据的摘要，不改变状态，之后仍可继续 update
+     */
+    hash_digest finalize() const;
+
+    void reset();
+
+    /**
+     * 一次性计算摘要
+     */
+    static hash_digest hash(const void* data, size_t size);
+
+private:
+    // 当前分块的链值和未压缩的最后一个块
+    uint32_t chunk_cv_[8];
+    uint64_t chunk_counter_;
+    uint8_t block_[64];
+    uint8_t block_len_;
+    uint8_t blocks_compressed_;
+
+    // 已完成子树的链值栈，深度不超过 54（2^54 个分块）
+    uint32_t cv_stack_[54][8];
+    uint8_t cv_stack_len_;
+
+    size_t chunk_length() const;
+    void chunk_update(const uint8_t* data, size_t size);
+    void chunk_output(uint32_t cv[8], uint8_t extra_flags) const;
+    void reset_chunk(uint64_t counter);
+    void push_chunk_cv(const uint32_t cv[8], uint64_t total_chunks);
+};
+
+/**
+ * 按 BLAKE3 父节点规则合并两个摘要
+ *
+ * 用于把分块摘要组合成树哈希；root 为 true 时是整棵树的根。
+ */
+hash_digest hash_parent(const hash_digest& left, const hash_digest& right, bool root);
+
+/**
+ * 摘要的十六进制表示
+ */
+std::string to_hex(const hash_digest& digest);
@@ -0,0 +1,182 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "../ring_buffer/ring_buffer.h"
+
+/**
+ * 缓冲区池配置
+ */
+struct buffer_pool_options {
+    // 每个缓冲区的字节数，按缓存行取整
+    size_t buffer_size = 64 * 1024;
+
+    // 缓冲区总数，构造时一次分配，之后不再增长
+    uint32_t buffers = 1024;
+
+    // 每个线程最多缓存的空闲缓冲区数；0 表示不使用线程缓存，每次都经过全局空闲列表
+    uint32_t magazine_size = 16;
+
+    // 缓冲区内存的大页和 NUMA 选项
+    ring_buffer_options memory;
+};
+
+/**
+ * 缓冲区池的用量
+ */
+struct buffer_pool_stats {
+    uint32_t capacity = 0;
+    size_t buffer_size = 0;
+    size_t reserved_bytes = 0;  // 构造时分配的内存，不随用量变化
+    uint32_t shared_free = 0;   // 全局空闲列表中的缓冲区数（近似值，不含各线程缓存的）
+    uint64_t exhausted = 0;     // 因为没有空闲缓冲区或超出配额而失败的申请次数
+};
+
+/**
+ * 一组缓冲区的用量上限，例如一个对端最多同时占用的缓冲区数
+ *
+ * 必须比用它申请的所有缓冲区活得久。
+ */
+class buffer_quota {
+public:
+    explicit buffer_quota(size_t limit) : limit_(limit) {}
+
+    buffer_quota(const buffer_quota&) = delete;
+    buffer_quota& operator=(const buffer_quota&) = delete;
+
+    size_t used() const {
+        return used_.load(std::memory_order_relaxed);
+    }
+
+    size_t limit() const {
+        return limit_;
+    }
+
+private:
+    friend class buffer_pool;
+    friend class pooled_buffer;
+
+    std::atomic<size_t> used_{0};
+    const size_t limit_;
+};
+
+namespace buffer_pool_detail {
+struct pool_core;
+}  // namespace buffer_pool_detail
+
+/**
+ * 从 buffer_pool 借出的一个定长缓冲区，只能移动，析构或 reset 时归还
+ *
+ * 只有几个指针大小，可以直接放进 ring_buffer 的单元格在线程之间传递，
+ * 在任意线程归还都可以。所属的 buffer_pool 必须比它活得久。
+ */
+class pooled_buffer {
+public:
+    pooled_buffer() = default;
+
+    pooled_buffer(pooled_buffer&& other) noexcept
+        : core_(other.core_), quota_(other.quota_), data_(other.data_), index_(other.index_) {
+        other.core_ = nullptr;
+        other.quota_ = nullptr;
+        other.data_ = nullptr;
+    }
+
+    pooled_buffer& operator=(pooled_buffer&& other) noexcept {
+        if (this != &other) {
+            reset();
+            core_ = other.core_;
+            quota_ = other.quota_;
+            data_ = other.data_;
+            index_ = other.index_;
+            other.core_ = nullptr;
+            other.quota_ = nullptr;
+            other.data_ = nullptr;
+        }
+        return *this;
+    }
+
+    pooled_buffer(const pooled_buffer&) = delete;
+    pooled_buffer& operator=(const pooled_buffer&) = delete;
+
+    ~pooled_buffer() {
+        reset();
+    }
+
+    explicit operator bool() const {
+        return core_ != nullptr;
+    }
+
+    uint8_t* data() const {
+        return data_;
+    }
+
+    /**
+     * 缓冲区在池中的编号
+     */
+    uint32_t index() const {
+        return index_;
+    }
+
+    /**
+     * 归还缓冲区；空句柄时什么也不做
+     */
+    void reset();
+
+private:
+    friend class buffer_pool;
+
+    buffer_pool_detail::pool_core* core_ = nullptr;
+    buffer_quota* quota_ = nullptr;
+    uint8_t* data_ = nullptr;
+    uint32_t index_ = 0;
+};
+
+/**
+ * 定长缓冲区池（slab）
+ *
+ * 所有缓冲区在构造时一次分配成一整块，空闲缓冲区的编号放在全局的 ring_buffer 中。
+ * 每个线程在前面有一个小的缓存（magazine）：申请和归还先在本线程缓存中完成，
+ * 缓存空了从全局列表批量取一半，满了批量还一半，都只需要一次 CAS。
+ * 因此 I/O 线程申请、工作线程归还这种跨线程的用法也不会在分配器中争抢，
+ * 总内存固定不变，不会产生碎片。
+ *
+ * 池中没有空闲缓冲区时申请失败（返回空句柄）而不是等待，由调用方退回其他方式。
+ * 注意其他线程缓存中的缓冲区对本线程不可见，最多 magazine_size × 线程数 个缓冲区
+ * 可能暂时闲置在各个线程中。
+ *
+ * 可以在多个线程中并发使用。
+ */
+class buffer_pool {
+public:
+    /**
+     * buffer_size 或 buffers 为 0 时抛出 std::invalid_argument，内存不足时抛出 std::bad_alloc
+     */
+    explicit buffer_pool(const buffer_pool_options& options = buffer_pool_options());
+
+    ~buffer_pool();
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool& operator=(const buffer_pool&) = delete;
+
+    /**
+     * 申请一个缓冲区，没有空闲缓冲区时返回空句柄
+     */
+    pooled_buffer try_acquire();
+
+    /**
+     * 申请一个计入 quota 的缓冲区，quota 已满或没有空闲缓冲区时返回空句柄
+     */
+    pooled_buffer try_acquire(buffer_quota& quota);
+
+    size_t buffer_size() const;
+
+    uint32_t capacity() const;
+
+    buffer_pool_stats stats() const;
+
+private:
+    // 线程缓存通过 weak_ptr 发现池已经销毁，线程退出时把缓存的缓冲区还给仍然存在的池
+    std::shared_ptr<buffer_pool_detail::pool_core> core_;
+};
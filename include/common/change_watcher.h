@@ -0,0 +1,146 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "../ring_buffer/blocking_ring_buffer.h"
+#include "../ring_buffer/ring_buffer.h"
+
+class change_backend;
+
+/**
+ * 变化类型
+ */
+enum class change_kind : uint8_t {
+    modified,  // 路径被创建、写入、改了属性或被移入
+    removed,   // 路径不再存在；是目录时其下所有路径都不再存在
+    rescan,    // 事件丢失（内核队列溢出等），需要完整扫描 path（监视的根目录）
+};
+
+/**
+ * 一条合并后的脏路径
+ */
+struct change_event {
+    std::string path;  // 绝对路径
+    change_kind kind = change_kind::modified;
+};
+
+/**
+ * Linux 上使用的事件来源
+ */
+enum class watch_backend {
+    automatic,  // 有权限时使用 fanotify，否则使用 inotify
+    inotify,    // 每个目录一个监视，不需要特权
+    fanotify,   // 整个文件系统一个标记，不受监视数量限制，需要 CAP_SYS_ADMIN
+};
+
+/**
+ * 变化检测配置
+ */
+struct change_watcher_options {
+    // 同一路径的事件在最后一次事件之后静默这么久才输出，连续写入的文件只输出一次
+    std::chrono::milliseconds debounce{50};
+
+    // 一直在变化的路径最多延迟这么久也会输出，避免永远等不到静默
+    std::chrono::milliseconds max_latency{1000};
+
+    // 脏路径队列的容量，必须是2的幂；队列满时路径留在合并表中，等消费者跟上再输出
+    uint32_t queue_capacity = 4096;
+
+    // 合并表最多保存的路径数量，超过时当作事件溢出处理（清空并要求完整扫描），限制内存占用
+    size_t max_pending = 1u << 16;
+
+    // 仅 Linux 使用
+    watch_backend backend = watch_backend::automatic;
+};
+
+/**
+ * 基于文件系统事件的增量变化检测
+ *
+ * 监视 root 下的整棵目录树：macOS 使用 FSEvents，Linux 使用 fanotify 或 inotify，
+ * Windows 使用 ReadDirectoryChangesW。后台线程收集事件，按路径合并并去抖
+ * （同一路径只保留最后一种变化），然后写入脏路径队列，由哈希工作线程通过 events()
+ * 取出处理，不需要遍历整棵树。
+ *
+ * 只有事件丢失时才需要完整扫描：内核事件队列溢出或合并表超过 max_pending 时，
+ * 丢弃合并表并输出一条 change_kind::rescan 事件，它总是先于之后的事件输出。
+ *
+ * 析构（或 stop）时尽量输出合并表中剩余的路径，然后关闭队列，消费者的 get_wait 会返回 false。
+ */
+class change_watcher {
+public:
+    using queue_type = blocking_ring_buffer<ring_buffer<change_event, dynamic_capacity>>;
+
+    /**
+     * 开始监视 root
+     *
+     * root 不存在或无法监视时抛出 std::system_error；
+     * 指定的后端在当前平台不可用时抛出 std::invalid_argument
+     */
+    explicit change_watcher(const std::string& root, const change_watcher_options& options = change_watcher_options());
+
+    ~change_watcher();
+
+    change_watcher(const change_watcher&) = delete;
+    change_watcher& operator=(const change_watcher&) = delete;
+
+    /**
+     * 脏路径队列
+     */
+    queue_type& events() {
+        return queue_;
+    }
+
+    /**
+     * 停止监视并关闭队列，可重复调用
+     */
+    void stop();
+
+    /**
+     * 规范化后的根目录
+     */
+    const std::string& root() const {
+        return root_;
+    }
+
+    /**
+     * 实际使用的事件来源，例如 "inotify"
+     */
+    const char* backend_name() const;
+
+    /**
+     * 发生过的事件溢出次数（每次都会输出一条 rescan 事件）
+     */
+    uint64_t overflows() const {
+        return overflows_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct pending_change {
+        change_kind kind;
+        std::chrono::steady_clock::time_point first_seen;
+        std::chrono::steady_clock::time_point last_seen;
+    };
+
+    void run();
+    void record(std::string path, change_kind kind, std::chrono::steady_clock::time_point now);
+    void flush(std::chrono::steady_clock::time_point now, bool force);
+
+    std::string root_;
+    change_watcher_options options_;
+    queue_type queue_;
+    std::unique_ptr<change_backend> backend_;
+
+    // 以下只由后台线程访问
+    std::unordered_map<std::string, pending_change> pending_;
+    bool rescan_pending_ = false;
+
+    std::atomic<uint64_t> overflows_{0};
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * 文件中的一个分块
+ */
+struct chunk_span {
+    uint64_t offset = 0;
+    uint32_t length = 0;
+};
+
+/**
+ * FastCDC 分块参数
+ */
+struct fastcdc_options {
+    uint32_t min_size = 16 * 1024;
+    uint32_t avg_size = 64 * 1024;
+    uint32_t max_size = 256 * 1024;
+};
+
+/**
+ * FastCDC 内容定义分块
+ *
+ * 使用 gear 滚动哈希寻找分块边界：边界只取决于边界附近 64 字节的内容，
+ * 在文件中插入或删除字节只会改变附近一两个分块，其余分块的摘要保持不变，
+ * 这正是增量传输需要的性质。采用论文中的归一化分块（平均大小之前使用更严格的掩码，
+ * 之后使用更宽松的掩码）使分块大小集中在平均值附近，并跳过最小长度内的字节。
+ *
+ * gear 表由固定种子生成，所有节点对同样的内容得到同样的边界。
+ */
+class fastcdc_chunker {
+public:
+    /**
+     * 参数不满足 64 <= min_size <= avg_size <= max_size 时抛出 std::invalid_argument
+     */
+    explicit fastcdc_chunker(const fastcdc_options& options = fastcdc_options());
+
+    /**
+     * 以 data 开头的下一个分块的长度
+     *
+     * size 不超过 min_size 时返回 size（剩余数据成为最后一个分块）。
+     * 同一位置开始、至少包含 max_size 字节时结果与后面还有多少数据无关。
+     */
+    size_t next_boundary(const uint8_t* data, size_t size) const;
+
+    /**
+     * 划分内存中的数据
+     */
+    std::vector<chunk_span> split(const void* data, size_t size) const;
+
+    /**
+     * 通过 file_reader 顺序映射文件并划分，读取失败时抛出 std::system_error
+     */
+    std::vector<chunk_span> split_file(const std::string& path) const;
+
+    const fastcdc_options& options() const {
+        return options_;
+    }
+
+private:
+    fastcdc_options options_;
+    uint64_t mask_small_;  // 平均大小之前使用，1 的位数更多，切分概率低
+    uint64_t mask_large_;  // 平均大小之后使用，1 的位数更少，切分概率高
+};
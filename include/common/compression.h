@@ -0,0 +1,184 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+#include "../thread_pool/thread_pool.h"
+#include "file_reader.h"
+
+/**
+ * 分块压缩算法
+ *
+ * 编号会写进传输的数据中，不能改变已有的值。
+ */
+enum class compression_codec : uint8_t {
+    none = 0,     // 原样保存
+    lz4 = 1,      // 速度优先，适合高带宽链路
+    zstd = 2,     // 压缩率和速度兼顾
+    deflate = 3,  // zlib 格式，没有 zstd/lz4 时的后备
+};
+
+/**
+ * 编译时是否链接了该算法的库；none 总是可用
+ */
+bool codec_available(compression_codec codec);
+
+const char* codec_name(compression_codec codec);
+
+/**
+ * 可用的算法中默认使用的一个：依次为 zstd、lz4、deflate，都没有时为 none
+ */
+compression_codec default_codec();
+
+/**
+ * 估计数据的字节熵（比特/字节，0 到 8）
+ *
+ * 超过 sample_size 时均匀地取几段共 sample_size 字节统计，不扫描整个分块。
+ * 已经压缩过的数据（图片、视频、压缩包）接近 8。
+ */
+double sample_entropy(const uint8_t* data, size_t size, size_t sample_size);
+
+/**
+ * 用 codec 压缩 [data, data + size)，结果写入 out
+ *
+ * level 为 0 时使用算法的默认级别。结果超过 max_output 字节时放弃并返回 false，
+ * 不可压缩的数据不会额外占用内存。codec 不可用时抛出 std::invalid_argument。
+ */
+bool compress_block(compression_codec codec, int level, const uint8_t* data, size_t size, size_t max_output,
+                    std::vector<uint8_t>& out);
+
+/**
+ * 解压到 out，原始大小必须正好是 original_size，否则（数据损坏）抛出 std::runtime_error
+ */
+void decompress_block(compression_codec codec, const uint8_t* data, size_t size, uint8_t* out, size_t original_size);
+
+/**
+ * 压缩阶段配置
+ */
+struct compression_options {
+    compression_codec codec = default_codec();
+
+    // 压缩级别，0 为算法默认（zstd 3、lz4 快速模式、deflate 6）。lz4 大于 1 时使用 HC，
+    // 负数为快速模式的加速倍数；zstd 负数为更快的级别
+    int level = 0;
+
+    // 小于这个大小的分块不压缩，帧头和调用的开销已经超过收益
+    size_t min_size = 512;
+
+    // 采样熵超过 max_entropy（比特/字节）的分块视为已经压缩过，直接跳过
+    double max_entropy = 7.5;
+    size_t sample_size = 4096;
+
+    // 压缩后至少要节省这个比例，否则原样保存
+    double min_saving = 0.05;
+
+    // 一个分块压缩失败（原样保存）后跳过之后的若干分块不再尝试，每次连续失败跳过数翻倍，
+    // 最多 max_backoff 个；压缩成功后清零。0 表示不跳过
+    uint32_t max_backoff = 32;
+
+    // 异步压缩和解压任务提交到的线程池通道，默认与哈希一样不挤占传输任务
+    task_lane lane = task_lane::hash;
+};
+
+/**
+ * 压缩阶段的统计，都是调用时的快照
+ */
+struct compression_stats {
+    uint64_t chunks = 0;           // 处理的分块数
+    uint64_t compressed = 0;       // 实际压缩保存的分块数
+    uint64_t skipped_small = 0;    // 太小而跳过
+    uint64_t skipped_entropy = 0;  // 采样熵太高而跳过
+    uint64_t skipped_backoff = 0;  // 前面的分块不可压缩而跳过
+    uint64_t incompressible = 0;   // 压缩后不够小而原样保存
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;        // 输出的字节数，原样保存的按原始大小计
+};
+
+/**
+ * 一个分块的压缩结果
+ */
+struct compressed_chunk {
+    compression_codec codec = compression_codec::none;  // none 表示原样保存
+    uint32_t original_size = 0;
+    std::vector<uint8_t> data;  // 压缩后的数据
+    file_view source;           // 原样保存时引用原始数据，不复制
+
+    const uint8_t* bytes() const {
+        return codec == compression_codec::none ? source.data() : data.data();
+    }
+
+    size_t size() const {
+        return codec == compression_codec::none ? source.size() : data.size();
+    }
+};
+
+/**
+ * 位于哈希和发送之间的分块压缩阶段
+ *
+ * 每个分块独立压缩，可以在线程池上并行：compress_async 返回的 future 按提交顺序
+ * 取结果就是有序的流。压缩前先做几项廉价的检查，不值得压缩的分块原样放行
+ * （引用原始数据，文件帧的零拷贝发送不受影响）：分块太小、采样熵太高，或者
+ * 前面的分块刚刚压缩失败（退避）。退避状态保存在阶段中，一个文件（或一条流）
+ * 使用一个 compression_stage，状态才反映“上一个分块”。
+ *
+ * 接收方用同样的方式并行解压，只需要分块的算法和原始大小。可以在多个线程中并发使用。
+ */
+class compression_stage {
+public:
+    /**
+     * codec 不可用、min_saving 不在 [0, 1) 内时抛出 std::invalid_argument
+     */
+    explicit compression_stage(thread_pool& pool, const compression_options& options = compression_options());
+
+    compression_stage(const compression_stage&) = delete;
+    compression_stage& operator=(const compression_stage&) = delete;
+
+    /**
+     * 在当前线程压缩一个分块；分块不能超过 4GB
+     *
+     * trace_id 是分块的跟踪编号（trace_chunk_id），与其他阶段的区间连起来；0 表示不连接
+     */
+    compressed_chunk compress(file_view chunk, uint64_t trace_id = 0);
+
+    /**
+     * 在线程池上压缩，chunk 持有的数据在任务完成前一直有效
+     */
+    std::future<compressed_chunk> compress_async(file_view chunk, uint64_t trace_id = 0);
+
+    /**
+     * 在当前线程解压；codec 为 none 时直接返回 data。数据损坏时抛出 std::runtime_error
+     */
+    file_view decompress(compression_codec codec, file_view data, uint32_t original_size,
+                         uint64_t trace_id = 0) const;
+
+    std::future<file_view> decompress_async(compression_codec codec, file_view data, uint32_t original_size,
+                                            uint64_t trace_id = 0) const;
+
+    const compression_options& options() const {
+        return options_;
+    }
+
+    compression_stats stats() const;
+
+private:
+    bool should_skip(file_view chunk);
+    void record(bool compressed);
+
+    thread_pool& pool_;
+    const compression_options options_;
+
+    // 退避：还要跳过的分块数和下一次失败时的跳过数
+    std::atomic<uint32_t> skip_remaining_{0};
+    std::atomic<uint32_t> backoff_{0};
+
+    std::atomic<uint64_t> chunks_{0};
+    std::atomic<uint64_t> compressed_{0};
+    std::atomic<uint64_t> skipped_small_{0};
+    std::atomic<uint64_t> skipped_entropy_{0};
+    std::atomic<uint64_t> skipped_backoff_{0};
+    std::atomic<uint64_t> incompressible_{0};
+    std::atomic<uint64_t> bytes_in_{0};
+    std::atomic<uint64_t> bytes_out_{0};
+};
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "file_hasher.h"
+
+/**
+ * 增量传输
+ *
+ * 一次文件更新的交互：
+ *
+ *   1. 接收方对已有的文件（基准）做内容定义分块哈希，把分块列表发给发送方
+ *      （encode_chunk_list）。
+ *   2. 发送方对新文件做同样的分块哈希，用 make_delta_plan 与接收方的列表比较，
+ *      把计划（encode_delta_plan）发给接收方，随后依次发送计划中 literal 分块的原始数据。
+ *   3. 接收方用 apply_delta 按计划重建新文件：已有的分块从基准文件复制，
+ *      其余从连接上读取。每个分块和最终的根哈希都会校验。
+ *
+ * 两端必须使用相同的分块参数，否则分块边界不同，几乎所有分块都会被当作缺失。
+ */
+
+/**
+ * 计划中的一个分块
+ */
+struct delta_op {
+    uint32_t length = 0;
+    hash_digest digest{};
+
+    // true 时数据由发送方随后发送；否则从基准文件的 basis_offset 处复制
+    bool literal = false;
+    uint64_t basis_offset = 0;
+
+    // 分块在新文件中的偏移，发送方据此读取 literal 数据；不参与编码，解码时按长度累加恢复
+    uint64_t target_offset = 0;
+};
+
+/**
+ * 增量传输计划
+ */
+struct delta_plan {
+    uint64_t size = 0;
+    hash_digest root{};
+    std::vector<delta_op> ops;
+
+    /**
+     * 需要通过连接发送的字节数
+     */
+    uint64_t literal_bytes() const;
+
+    /**
+     * 直接从基准文件复制的字节数
+     */
+    uint64_t copied_bytes() const;
+};
+
+/**
+ * 编码分块列表（只包含长度和摘要，偏移按长度累加）
+ */
+std::vector<uint8_t> encode_chunk_list(const std::vector<chunk_hash>& chunks);
+
+/**
+ * 解码分块列表，格式错误时抛出 std::runtime_error
+ */
+std::vector<chunk_hash> decode_chunk_list(const uint8_t* data, size_t size);
+
+/**
+ * 比较新文件与接收方的基准分块列表，生成传输计划
+ *
+ * 基准中存在相同摘要的分块标记为复制，其余标记为 literal。
+ */
+delta_plan make_delta_plan(const file_hash_result& target, const std::vector<chunk_hash>& basis);
+
+std::vector<uint8_t> encode_delta_plan(const delta_plan& plan);
+
+/**
+ * 解码传输计划，格式错误时抛出 std::runtime_error
+ */
+delta_plan decode_delta_plan(const uint8_t* data, size_t size);
+
+// 从基准文件的 offset 处读取 length 字节到 out
+using delta_read_basis = std::function<void(uint64_t offset, uint8_t* out, uint32_t length)>;
+
+// 从连接上读取下一个 literal 分块的 length 字节到 out
+using delta_read_literal = std::function<void(uint8_t* out, uint32_t length)>;
+
+// 按顺序写出新文件的数据
+using delta_write = std::function<void(const uint8_t* data, uint32_t length)>;
+
+/**
+ * 按计划重建新文件
+ *
+ * 任何分块的摘要或最终根哈希与计划不符（基准文件已变化、传输出错）时抛出 std::runtime_error，
+ * 调用方应丢弃已写出的数据。
+ */
+void apply_delta(const delta_plan& plan, const delta_read_basis& read_basis, const delta_read_literal& read_literal,
+                 const delta_write& write);
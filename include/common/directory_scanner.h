@@ -0,0 +1,151 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../ring_buffer/blocking_ring_buffer.h"
+#include "../ring_buffer/event_count.h"
+#include "../ring_buffer/ring_buffer.h"
+#include "../thread_pool/thread_pool.h"
+#include "hash_index.h"
+
+/**
+ * 扫描到的一个条目（文件、目录、符号链接等，不跟随符号链接）
+ */
+struct scan_entry {
+    std::string path;  // 相对于根目录，以 / 分隔
+    file_identity id;  // 直接用于 hash_index::lookup
+    uint32_t mode = 0;  // st_mode，包括文件类型
+};
+
+/**
+ * 读取目录和元数据的方式
+ */
+enum class scan_method {
+    automatic,  // macOS 上为 bulk，Linux 上内核支持时为 io_uring，否则为 statx；其他平台为 posix
+    posix,      // readdir + fstatat，每个条目一次系统调用
+    statx,      // Linux：getdents64 一次读取大量目录项，statx 逐个读取元数据
+    io_uring,   // Linux：getdents64，元数据由 io_uring 的 statx 批量提交，内核并行执行
+    bulk,       // macOS：getattrlistbulk 一次调用同时返回多个目录项和元数据
+};
+
+/**
+ * 扫描配置
+ */
+struct directory_scanner_options {
+    scan_method method = scan_method::automatic;
+
+    // 结果队列的容量，必须是2的幂；消费者跟不上时扫描任务在队列上等待
+    uint32_t queue_capacity = 4096;
+
+    // 一次批量读取元数据的条目数：io_uring 一次提交的 statx 数量，也是大目录拆分任务的粒度
+    size_t stat_batch = 256;
+
+    // 不进入其他文件系统上的目录（挂载点本身仍然输出）
+    bool one_file_system = false;
+
+    // 扫描任务提交到的线程池通道
+    task_lane lane = task_lane::hash;
+};
+
+/**
+ * 扫描的统计，都是调用时的快照
+ */
+struct scan_stats {
+    uint64_t directories = 0;  // 读取的目录数，包括根目录
+    uint64_t entries = 0;      // 输出的条目数
+    uint64_t errors = 0;       // 无法读取的目录或条目数（扫描期间被删除的不计）
+    uint64_t batches = 0;      // 元数据批次：io_uring 的提交次数或 getattrlistbulk 的调用次数
+};
+
+/**
+ * 并行目录扫描
+ *
+ * 每个目录是线程池上的一个任务：任务读取目录项，批量读取元数据，把结果写入
+ * entries() 队列，并为每个子目录提交新的任务，因此目录树的不同分支在多个工作线程上
+ * 同时扫描，NFS 等高延迟文件系统上的元数据请求可以重叠。一个目录的条目超过
+ * stat_batch 时按批拆成多个任务。
+ *
+ * 输出的顺序不确定；根目录本身不输出。全部目录扫描完毕后关闭队列，消费者的
+ * get_wait 返回 false。消费者（通常是查询 hash_index 的线程）不能是同一线程池中的任务，
+ * 否则在队列满时可能没有空闲的工作线程推进扫描。
+ *
+ * 析构时停止扫描：关闭队列并等待已经开始的任务结束。
+ */
+class directory_scanner {
+public:
+    using queue_type = blocking_ring_buffer<ring_buffer<scan_entry, dynamic_capacity>>;
+
+    /**
+     * 开始扫描 root
+     *
+     * root 无法打开时抛出 std::system_error；指定的 method 在当前平台不可用时抛出 std::invalid_argument
+     */
+    directory_scanner(thread_pool& pool, const std::string& root,
+                      const directory_scanner_options& options = directory_scanner_options());
+
+    ~directory_scanner();
+
+    directory_scanner(const directory_scanner&) = delete;
+    directory_scanner& operator=(const directory_scanner&) = delete;
+
+    /**
+     * 扫描结果队列
+     */
+    queue_type& entries() {
+        return queue_;
+    }
+
+    /**
+     * 等待扫描结束（队列已关闭，队列中可能还有未取出的条目）
+     */
+    void wait();
+
+    bool done() const;
+
+    /**
+     * 当前平台 method 是否可用；automatic 总是可用
+     */
+    static bool method_available(scan_method method);
+
+    /**
+     * 实际使用的方式，例如 "io_uring"
+     */
+    const char* method_name() const;
+
+    scan_stats stats() const;
+
+private:
+    struct directory_handle;
+
+    void submit(std::string path);
+    void submit_batch(std::shared_ptr<directory_handle> dir, std::vector<std::string> names);
+    void scan_directory(const std::string& path);
+    void stat_names(const directory_handle& dir, const std::vector<std::string>& names);
+#if defined(__APPLE__)
+    void scan_bulk(const directory_handle& dir);
+#endif
+    void emit(scan_entry entry);
+    void task_done();
+
+    thread_pool& pool_;
+    const std::string root_;
+    const directory_scanner_options options_;
+    scan_method method_;
+    uint64_t root_device_ = 0;
+    queue_type queue_;
+
+    std::atomic<bool> stopping_{false};
+    std::mutex mutex_;
+    event_count finished_;
+    size_t outstanding_ = 0;  // 已提交但尚未结束的任务数，受 mutex_ 保护
+
+    std::atomic<uint64_t> directories_{0};
+    std::atomic<uint64_t> entries_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<uint64_t> batches_{0};
+};
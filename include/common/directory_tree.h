@@ -0,0 +1,159 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../thread_pool/thread_pool.h"
+#include "blake3.h"
+#include "manifest.h"
+
+/**
+ * 目录摘要中的一个子项
+ */
+struct directory_child {
+    std::string name;
+    bool directory = false;
+    manifest_meta meta;  // 文件的元数据；目录只有 mode
+    hash_digest hash{};  // 文件为内容哈希，目录为子树哈希
+};
+
+/**
+ * 一个目录的摘要：目录自身的子树哈希和按名字排序的子项
+ */
+struct directory_listing {
+    std::string path;  // 相对于根的路径，根为空字符串
+    hash_digest hash{};
+    std::vector<directory_child> children;
+};
+
+std::vector<uint8_t> encode_directory_listing(const directory_listing& listing);
+
+/**
+ * 解码目录摘要，格式错误时抛出 std::runtime_error
+ */
+directory_listing decode_directory_listing(const uint8_t* data, size_t size);
+
+/**
+ * 按目录组织的 Merkle 树
+ *
+ * 叶子是文件：名字、mode、大小和内容哈希（哈希索引中的 file_hash_result::root）；
+ * 目录的哈希按名字顺序覆盖所有子项，只要子树中有任何文件变化，从它到根路径上的
+ * 每个目录哈希都会变化。修改时间不参与哈希：两端各自写入的文件时间本来就不同，
+ * 只改了时间的文件由清单比较（manifest_diff）处理。
+ *
+ * 文件变化事件到来时用 update/remove 修改叶子，只把到根的路径标记为脏；refresh
+ * 只重新计算脏的目录，文件很多的脏子树提交到线程池并行计算。
+ *
+ * 对象不是线程安全的，由一个线程（通常是扫描或事件处理线程）持有。
+ */
+class directory_tree {
+public:
+    /**
+     * @param parallel_threshold 文件数不少于这个值的脏子树在 refresh 时单独作为一个任务
+     */
+    explicit directory_tree(size_t parallel_threshold = 4096);
+
+    ~directory_tree();
+
+    directory_tree(const directory_tree&) = delete;
+    directory_tree& operator=(const directory_tree&) = delete;
+
+    /**
+     * 加入或更新 path 处的条目，缺少的上级目录自动创建
+     *
+     * meta.mode 为目录（S_ISDIR）时只确保目录存在；否则记为文件，替换同名的目录。
+     * path 为空或上级路径是文件时抛出 std::invalid_argument
+     */
+    void update(const std::string& path, const manifest_meta& meta, const hash_digest& content);
+
+    /**
+     * 删除 path 处的文件或整个目录；不存在时返回 false
+     */
+    bool remove(const std::string& path);
+
+    /**
+     * 加入清单中的全部条目
+     */
+    void load(const manifest& m);
+
+    /**
+     * 重新计算脏的目录，在当前线程中完成
+     */
+    void refresh();
+
+    /**
+     * 重新计算脏的目录，大的子树在 pool 的哈希通道上并行
+     */
+    void refresh(thread_pool& pool);
+
+    /**
+     * 是否有修改尚未 refresh
+     */
+    bool dirty() const;
+
+    /**
+     * 根目录的哈希；有修改尚未 refresh 时抛出 std::logic_error
+     */
+    hash_digest root_hash() const;
+
+    /**
+     * 目录 path 的摘要；path 不存在或不是目录时返回 false，有修改尚未 refresh 时抛出 std::logic_error
+     */
+    bool listing(const std::string& path, directory_listing& out) const;
+
+    /**
+     * 树中的文件数（不含目录）
+     */
+    size_t file_count() const;
+
+private:
+    struct node;
+
+    void compute(node& n, thread_pool* pool);
+    node* find(const std::string& path) const;
+
+    const size_t parallel_threshold_;
+    std::unique_ptr<node> root_;
+};
+
+/**
+ * 远程比较发现的一处差异
+ */
+struct directory_difference {
+    enum class kind {
+        added,     // 只在对端存在
+        removed,   // 只在本地存在
+        modified,  // 两端都有但不同；类型不同（文件与目录）也算
+    };
+
+    kind type = kind::added;
+    std::string path;
+    bool directory = false;  // added/removed 的是整个目录，需要调用方展开
+};
+
+/**
+ * 比较的统计
+ */
+struct directory_diff_stats {
+    uint64_t listings_fetched = 0;      // 向对端请求的目录摘要数
+    uint64_t subtrees_skipped = 0;      // 哈希相同而不再深入的子目录数
+};
+
+/**
+ * 获取对端目录 path 的摘要，对端没有这个目录时返回 false；通常是一次网络请求
+ */
+using directory_listing_fetcher = std::function<bool(const std::string& path, directory_listing& out)>;
+
+/**
+ * 从根开始逐层比较本地树和对端树
+ *
+ * 先比较根哈希，相同时只请求一次摘要；否则只进入哈希不同的子目录。没有变化的
+ * 部分不产生任何流量，流量与变化的目录数和深度成正比，而不是与目录树的文件总数。
+ * 本地树必须已经 refresh。
+ */
+directory_diff_stats diff_directory_trees(const directory_tree& local, const directory_listing_fetcher& fetch,
+                                          const std::function<void(const directory_difference&)>& on_difference);
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../thread_pool/thread_pool.h"
+#include "blake3.h"
+#include "chunker.h"
+#include "file_reader.h"
+
+/**
+ * 分块及其 BLAKE3 摘要
+ *
+ * 摘要只取决于分块内容，与分块在文件中的位置无关，
+ * 两端比较分块摘要列表即可找出需要传输的分块（增量同步）。
+ */
+struct chunk_hash {
+    uint64_t offset = 0;
+    uint32_t length = 0;
+    hash_digest digest{};
+};
+
+/**
+ * 文件哈希结果
+ */
+struct file_hash_result {
+    uint64_t size = 0;
+
+    // 由分块摘要组成的树哈希，见 combine_chunk_hashes
+    hash_digest root{};
+
+    std::vector<chunk_hash> chunks;
+};
+
+/**
+ * 按固定大小划分分块，最后一个分块可能较短；size 为 0 时没有分块
+ *
+ * chunk_size 为 0 时抛出 std::invalid_argument
+ */
+std::vector<chunk_span> fixed_size_chunks(uint64_t size, uint32_t chunk_size);
+
+/**
+ * 把分块摘要按 BLAKE3 的树形结构组合成根哈希
+ *
+ * 左子树取不超过分块数的最大2的幂，父节点使用 BLAKE3 的父节点压缩，根节点带 ROOT 标志。
+ * 只有一个分块时根哈希就是该分块的摘要；没有分块时为空输入的 BLAKE3 摘要。
+ * 注意结果不等于整个文件的标准 BLAKE3 摘要：叶子是分块的独立摘要，
+ * 这样分块摘要可以脱离位置单独比较。
+ */
+hash_digest combine_chunk_hashes(const std::vector<chunk_hash>& chunks);
+
+/**
+ * 分块方式
+ */
+enum class chunking_mode {
+    fixed,            // 固定大小，速度最快
+    content_defined,  // FastCDC，插入字节后大部分分块不变，用于增量传输
+};
+
+/**
+ * 文件哈希配置
+ */
+struct file_hasher_options {
+    chunking_mode chunking = chunking_mode::fixed;
+
+    // 固定分块大小；内容定义分块时也是每个哈希任务至少处理的字节数，
+    // 多个小分块合并成一个任务，避免每个分块一个任务的调度开销
+    uint32_t chunk_size = 1u << 20;
+
+    // 内容定义分块的参数
+    fastcdc_options cdc;
+
+    // 分块哈希任务提交到的线程池通道
+    task_lane lane = task_lane::hash;
+
+    // 读取文件的方式：大文件按窗口映射，小文件一次读入
+    file_reader_options reader;
+};
+
+/**
+ * 并行分块文件哈希
+ *
+ * 把文件拆成分块，连续的分块按 chunk_size 合并成任务提交到线程池并行读取和计算摘要，
+ * 再组合成树哈希，单个大文件也能用满所有核心。文件通过 file_reader 映射，
+ * 任务直接哈希页缓存中的页，不复制到临时缓冲区。分块内部的 1KB BLAKE3 分块
+ * 由 SIMD 内核多路并行压缩。可在线程池的工作线程内调用，等待期间该线程会执行其他任务。
+ */
+class file_hasher {
+public:
+    explicit file_hasher(thread_pool& pool, const file_hasher_options& options = file_hasher_options());
+
+    /**
+     * 哈希整个文件
+     *
+     * 打开或读取失败时抛出 std::system_error；哈希期间文件变短时抛出 std::runtime_error。
+     * trace_key 是分块跟踪编号使用的文件键（见 trace_chunk_id），为 0 时用 path 计算。
+     */
+    file_hash_result hash_file(const std::string& path, uint64_t trace_key = 0) const;
+
+    /**
+     * 按配置的方式划分文件。内容定义分块需要先顺序扫描一遍文件
+     */
+    std::vector<chunk_span> split_file(const std::string& path) const;
+
+    /**
+     * 按指定的分块哈希文件，分块必须按偏移排序且覆盖 [0, 文件大小)，否则抛出 std::invalid_argument
+     */
+    file_hash_result hash_file(const std::string& path, const std::vector<chunk_span>& spans,
+                               uint64_t trace_key = 0) const;
+
+    /**
+     * 哈希内存中的数据，按配置的方式分块
+     */
+    file_hash_result hash_buffer(const void* data, size_t size) const;
+
+    /**
+     * 按指定的分块哈希内存中的数据
+     */
+    file_hash_result hash_buffer(const void* data, size_t size, const std::vector<chunk_span>& spans) const;
+
+private:
+    thread_pool& pool_;
+    file_hasher_options options_;
+    fastcdc_chunker chunker_;
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * 文件中一段连续内容的只读视图
+ *
+ * 持有底层映射窗口或读缓冲区的引用，视图存在期间 data() 一直有效；
+ * 视图可以跨线程传递，随意复制。
+ */
+class file_view {
+public:
+    file_view() = default;
+
+    /**
+     * 引用 data 开始的 size 字节；owner 不为空时视图共同持有它
+     */
+    file_view(const uint8_t* data, size_t size, std::shared_ptr<const void> owner = nullptr)
+        : data_(data), size_(size), owner_(std::move(owner)) {}
+
+    const uint8_t* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::shared_ptr<const void> owner_;
+};
+
+/**
+ * 文件读取配置
+ */
+struct file_reader_options {
+    // 不超过这个大小的文件第一次读取时用一次 pread 整个读入，避免建立映射的开销
+    uint64_t mmap_threshold = 1u << 20;
+
+    // 映射窗口大小，向上取整到页大小；窗口按这个大小对齐
+    size_t window_size = 16u << 20;
+
+    // 按顺序读取：窗口使用 MADV_SEQUENTIAL，映射一个窗口时预读下一个窗口
+    bool sequential = true;
+};
+
+/**
+ * 大文件按滑动窗口 mmap 的只读访问层
+ *
+ * 哈希任务和发送路径直接使用映射的页，不再 read 进临时缓冲区。映射的窗口
+ * 按 window_size 对齐并缓存最近的几个，落在同一窗口内的读取共用一次映射；
+ * 跨越窗口边界的读取单独映射所需的范围。每个新窗口 madvise(MADV_WILLNEED)
+ * 触发预读，小文件仍然只用一次 pread。读取不经过 io_uring：映射的窗口每个分块没有
+ * 系统调用，小文件也只有一次 pread，要批量提交只能跨文件进行，需要另外的接口。
+ *
+ * 文件大小在打开时确定，超出的读取抛出 std::runtime_error。映射新窗口之前会
+ * 重新检查文件大小，但已映射的范围之后被截断时访问会收到 SIGBUS，
+ * 调用方需要保证读取期间文件不会变短（同步时由变化检测重新处理这样的文件）。
+ *
+ * 可以在多个线程中并发调用 read。
+ */
+class file_reader {
+public:
+    /**
+     * 以只读方式打开 path，失败时抛出 std::system_error
+     */
+    explicit file_reader(const std::string& path, const file_reader_options& options = file_reader_options());
+
+    /**
+     * 读取已经打开的 fd，不接管描述符；fd 必须在本对象销毁之前保持打开
+     */
+    explicit file_reader(int fd, const file_reader_options& options = file_reader_options());
+
+    ~file_reader();
+
+    file_reader(const file_reader&) = delete;
+    file_reader& operator=(const file_reader&) = delete;
+
+    /**
+     * 打开时的文件大小
+     */
+    uint64_t size() const {
+        return size_;
+    }
+
+    /**
+     * 是否通过 mmap 读取（文件大于 mmap_threshold）
+     */
+    bool mapped() const {
+        return mapped_;
+    }
+
+    int fd() const {
+        return fd_;
+    }
+
+    /**
+     * 读取 [offset, offset + length)
+     *
+     * 超出文件大小或文件已经变短时抛出 std::runtime_error，系统调用失败时抛出 std::system_error
+     */
+    file_view read(uint64_t offset, size_t length) const;
+
+private:
+    struct mapping;
+
+    void init();
+    std::shared_ptr<const mapping> window(uint64_t index) const;
+    std::shared_ptr<mapping> map_range(uint64_t offset, size_t length, bool advise) const;
+    void check_size(uint64_t end) const;
+
+    // 同时缓存的窗口数量，覆盖几个并行哈希任务各自读取的位置
+    static constexpr size_t cached_windows = 4;
+
+    int fd_ = -1;
+    bool owns_fd_ = false;
+    file_reader_options options_;
+    uint64_t size_ = 0;
+    bool mapped_ = false;
+
+    mutable std::mutex mutex_;
+    mutable std::vector<std::shared_ptr<const mapping>> windows_;  // 最近使用的在末尾
+    mutable std::shared_ptr<const std::vector<uint8_t>> contents_;  // 小文件的全部内容
+};
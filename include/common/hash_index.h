@@ -0,0 +1,151 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "file_hasher.h"
+
+struct stat;
+
+/**
+ * 判断文件是否变化所用的身份信息
+ */
+struct file_identity {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    int64_t mtime_ns = 0;
+    uint64_t size = 0;
+
+    static file_identity from_stat(const struct stat& st);
+};
+
+/**
+ * 持久化的文件哈希索引
+ *
+ * 以 (device, inode) 为键保存文件的分块摘要列表，mtime 和大小不变时直接复用，
+ * 不必重新读取和哈希文件。重命名不改变 inode，因此也能命中。
+ *
+ * 磁盘上是一个文件，分两部分：
+ *   - 基础段：按键排序的定长条目数组和分块区，整体 mmap，二分查找，打开时不需要解析；
+ *   - 追加日志：每次 put/remove 追加一条带校验和的记录，打开时重放到内存中的
+ *     开放寻址表。崩溃时最后一条记录可能不完整，打开时校验失败的尾部会被截掉。
+ * compact 把两部分合并成新的基础段，写入临时文件、fsync 后再原子地 rename 覆盖。
+ *
+ * 索引只是缓存：文件损坏（基础段校验失败）时丢弃内容重新开始，而不是报错。
+ * 可以在多个线程中并发使用。
+ */
+class hash_index {
+public:
+    /**
+     * 打开或创建索引文件，无法打开或创建时抛出 std::system_error
+     */
+    explicit hash_index(const std::string& path);
+
+    ~hash_index();
+
+    hash_index(const hash_index&) = delete;
+    hash_index& operator=(const hash_index&) = delete;
+
+    /**
+     * 查找文件的哈希
+     *
+     * @return 存在该文件的记录且 mtime 和大小都相同时返回 true
+     */
+    bool lookup(const file_identity& id, file_hash_result& result) const;
+
+    /**
+     * 记录文件的哈希，覆盖同一文件之前的记录
+     */
+    void put(const file_identity& id, const file_hash_result& result);
+
+    /**
+     * 删除文件的记录
+     */
+    void remove(uint64_t device, uint64_t inode);
+
+    /**
+     * 把已追加的记录刷到磁盘（fdatasync）
+     */
+    void flush();
+
+    /**
+     * 合并基础段和日志，写成新的索引文件
+     */
+    void compact();
+
+    /**
+     * 有效记录数量
+     */
+    size_t size() const;
+
+    /**
+     * 追加日志的字节数，可据此决定何时 compact
+     */
+    uint64_t log_bytes() const;
+
+private:
+    // 基础段中的定长条目，按 (device, inode) 排序
+    struct base_entry {
+        uint64_t device;
+        uint64_t inode;
+        int64_t mtime_ns;
+        uint64_t size;
+        hash_digest root;
+        uint64_t chunk_begin;
+        uint32_t chunk_count;
+        uint32_t reserved;
+    };
+
+    struct stored_chunk {
+        uint32_t length;
+        hash_digest digest;
+    };
+
+    // 日志中的条目，分块保存在 overlay_chunks_ 中
+    struct overlay_entry {
+        uint64_t device;
+        uint64_t inode;
+        int64_t mtime_ns;
+        uint64_t size;
+        hash_digest root;
+        uint64_t chunk_begin;
+        uint32_t chunk_count;
+        bool removed;
+    };
+
+    bool map_base();
+    void reset_file();
+    void replay_log();
+    void unmap();
+    void append_record(const std::vector<uint8_t>& record);
+    void apply_overlay(overlay_entry entry, const stored_chunk* chunks);
+    bool is_live(uint64_t device, uint64_t inode) const;
+
+    const base_entry* find_base(uint64_t device, uint64_t inode) const;
+    const overlay_entry* find_overlay(uint64_t device, uint64_t inode) const;
+    size_t overlay_slot(uint64_t device, uint64_t inode) const;
+    void grow_overlay();
+
+    std::string path_;
+    int fd_ = -1;
+
+    // 基础段的映射
+    void* map_ = nullptr;
+    size_t map_size_ = 0;
+    const base_entry* base_entries_ = nullptr;
+    uint64_t base_count_ = 0;
+    const stored_chunk* base_chunks_ = nullptr;
+    uint64_t base_end_ = 0;
+
+    // 日志重放得到的条目；overlay_table_ 为线性探测的开放寻址表，保存 overlay_entries_ 的下标加一
+    std::vector<overlay_entry> overlay_entries_;
+    std::vector<stored_chunk> overlay_chunks_;
+    std::vector<uint32_t> overlay_table_;
+    size_t live_count_ = 0;
+
+    uint64_t log_end_ = 0;
+
+    mutable std::shared_mutex mutex_;
+};
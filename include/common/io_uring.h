@@ -0,0 +1,213 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// 需要 6.0 及以后的内核头文件：多次触发的接收和提供缓冲区环
+#if defined(IORING_RECV_MULTISHOT)
+#define SYNC_HAVE_IO_URING 1
+#endif
+#endif
+
+#include <sys/uio.h>
+
+#if defined(SYNC_HAVE_IO_URING)
+
+/**
+ * io_uring 实例的最小封装
+ *
+ * 直接使用系统调用和内核头文件，不依赖 liburing。提交队列和完成队列都映射到用户态：
+ * get_sqe 取得一个空闲的提交项，填好后由 submit 一次系统调用批量提交，
+ * 同时可以等待完成；完成项通过 for_each_cqe 逐个取出。
+ *
+ * 同一实例只能由一个线程使用（通常是创建它的 I/O 线程）。
+ */
+class io_uring_queue {
+public:
+    /**
+     * @param entries 提交队列的大小，内核会向上取到2的幂
+     *
+     * 内核不支持或被禁用（io_uring_disabled）时抛出 std::system_error
+     */
+    explicit io_uring_queue(uint32_t entries);
+
+    ~io_uring_queue();
+
+    io_uring_queue(const io_uring_queue&) = delete;
+    io_uring_queue& operator=(const io_uring_queue&) = delete;
+
+    /**
+     * 当前内核是否可以使用 io_uring，并且支持 opcode 中的所有操作
+     */
+    static bool supported(const uint8_t* opcodes, size_t count);
+
+    /**
+     * 取得一个清零的提交项
+     *
+     * 提交队列已满时先提交已有的提交项再取；仍然取不到时返回 nullptr
+     */
+    io_uring_sqe* get_sqe();
+
+    /**
+     * 提交所有已填好的提交项，并等待至少 wait_nr 个完成项
+     *
+     * 被信号打断时返回；出错时抛出 std::system_error
+     *
+     * @return 内核接受的提交项数量
+     */
+    unsigned submit(unsigned wait_nr = 0);
+
+    /**
+     * 依次处理已经到达的完成项
+     *
+     * 每个完成项在回调之前归还给内核，回调中可以继续提交，也可以再次调用 for_each_cqe
+     *
+     * @return 处理的完成项数量
+     */
+    template <typename F>
+    unsigned for_each_cqe(F&& f) {
+        unsigned count = 0;
+        for (;;) {
+            const unsigned head = *cq_head_;
+            if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+                return count;
+            }
+            const io_uring_cqe cqe = cqes_[head & cq_mask_];
+            __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+            ++count;
+            f(cqe);
+        }
+    }
+
+    /**
+     * 提交队列中还能取得的提交项数量
+     */
+    unsigned sq_space() const {
+        return sq_entries_ - (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE));
+    }
+
+    /**
+     * 注册固定缓冲区，之后 READ_FIXED/WRITE_FIXED 用下标引用它们；失败时抛出 std::system_error
+     */
+    void register_buffers(const iovec* buffers, unsigned count);
+
+    /**
+     * 注册或注销一个提供缓冲区环（IORING_REGISTER_PBUF_RING）
+     *
+     * 环本身的内存由调用方分配（按页对齐），entries 必须是2的幂；失败时抛出 std::system_error
+     */
+    void register_buffer_ring(io_uring_buf_ring* ring, uint32_t entries, uint16_t group);
+    void unregister_buffer_ring(uint16_t group);
+
+    int fd() const {
+        return ring_fd_;
+    }
+
+private:
+    int ring_fd_ = -1;
+
+    void* sq_map_ = nullptr;
+    size_t sq_map_size_ = 0;
+    void* cq_map_ = nullptr;
+    size_t cq_map_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned cq_mask_ = 0;
+
+    // 本地的提交队列尾：到 submit 时才告诉内核
+    unsigned sqe_tail_ = 0;
+};
+
+/**
+ * 当前线程共用的 io_uring 实例，第一次调用时按 entries 创建；创建失败后该线程一直返回 nullptr，
+ * 调用方改用普通的系统调用
+ *
+ * 供在一次调用内提交并等待全部完成的批量操作使用（目录扫描的 statx、写回的 writev），
+ * 返回之前必须取走自己的所有完成项，调用之间不在实例上留下未完成的操作。
+ */
+io_uring_queue* thread_io_uring(uint32_t entries);
+
+/**
+ * 提供给内核选择的接收缓冲区（IOSQE_BUFFER_SELECT），多次触发的接收每次完成都带回一个缓冲区编号
+ *
+ * 优先使用与内核共享的缓冲区环（IORING_REGISTER_PBUF_RING），归还缓冲区只需写共享内存；
+ * 构造时用一个管道自检，环不可用时退回 IORING_OP_PROVIDE_BUFFERS，归还时提交提交项。
+ */
+class io_uring_provided_buffers {
+public:
+    /**
+     * 缓冲区 i 是 base 开始的第 i 个 buffer_size 字节，构造后全部交给内核
+     *
+     * 必须在 queue 上还没有其他操作时构造（自检会取走完成项）。
+     * 退回 PROVIDE_BUFFERS 时这些提交项的 user_data 为 tag，调用方应忽略它们的完成项。
+     * count 必须是2的幂且不超过 32768；失败时抛出 std::system_error
+     */
+    io_uring_provided_buffers(io_uring_queue& queue, uint16_t group, uint32_t count, uint8_t* base,
+                              uint32_t buffer_size, uint64_t tag);
+
+    /**
+     * 注销并释放环，必须在 queue 之前销毁
+     */
+    ~io_uring_provided_buffers();
+
+    io_uring_provided_buffers(const io_uring_provided_buffers&) = delete;
+    io_uring_provided_buffers& operator=(const io_uring_provided_buffers&) = delete;
+
+    /**
+     * 把编号为 id 的缓冲区还给内核（攒到 publish 时一起生效）
+     */
+    void recycle(uint16_t id);
+
+    /**
+     * 让 recycle 过的缓冲区对内核可见
+     */
+    void publish();
+
+    uint8_t* buffer(uint16_t id) const {
+        return base_ + static_cast<size_t>(id) * buffer_size_;
+    }
+
+    uint16_t group() const {
+        return group_;
+    }
+
+    /**
+     * 是否使用共享的缓冲区环
+     */
+    bool mapped() const {
+        return ring_ != nullptr;
+    }
+
+private:
+    bool map_ring(uint32_t count);
+    void unmap_ring();
+    bool self_test();
+
+    io_uring_queue& queue_;
+    const uint16_t group_;
+    const uint32_t mask_;
+    uint8_t* const base_;
+    const uint32_t buffer_size_;
+    const uint64_t tag_;
+
+    io_uring_buf_ring* ring_ = nullptr;
+    size_t ring_bytes_ = 0;
+    uint16_t tail_ = 0;
+
+    // PROVIDE_BUFFERS 模式下等待提交的编号
+    std::vector<uint16_t> pending_;
+};
+
+#endif
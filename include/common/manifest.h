@@ -0,0 +1,268 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "blake3.h"
+#include "file_reader.h"
+
+/**
+ * 清单中一个文件的元数据
+ */
+struct manifest_meta {
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    uint32_t mode = 0;  // st_mode，包括文件类型
+    uint32_t reserved = 0;
+
+    bool operator==(const manifest_meta& other) const {
+        return size == other.size && mtime_ns == other.mtime_ns && mode == other.mode;
+    }
+    bool operator!=(const manifest_meta& other) const {
+        return !(*this == other);
+    }
+};
+
+/**
+ * 构造清单时的一个条目
+ */
+struct manifest_entry {
+    std::string path;  // 相对路径，以 / 分隔
+    manifest_meta meta;
+    hash_digest hash{};  // 文件内容的根哈希（见 file_hash_result::root）
+};
+
+/**
+ * 清单的构造
+ *
+ * 条目必须按路径的字节序严格递增地加入（可以先用 sort_manifest_entries 排序），
+ * 否则抛出 std::invalid_argument。
+ */
+class manifest_builder {
+public:
+    /**
+     * @param restart_interval 每隔这么多条目保存一次完整路径，其余条目只保存与前一条不同的后缀；
+     *                         越小查找越快，越大文件越小
+     */
+    explicit manifest_builder(uint32_t restart_interval = 16);
+
+    void add(const manifest_entry& entry);
+
+    void add(const std::string& path, const manifest_meta& meta, const hash_digest& hash);
+
+    size_t size() const {
+        return count_;
+    }
+
+    /**
+     * 生成清单，之后 builder 恢复为空
+     */
+    std::vector<uint8_t> finish();
+
+    /**
+     * 生成清单并写入 path：先写临时文件并 fsync，再 rename 覆盖。失败时抛出 std::system_error
+     */
+    void write(const std::string& path);
+
+private:
+    const uint32_t restart_interval_;
+    size_t count_ = 0;
+    std::string last_path_;
+    std::vector<uint8_t> meta_;
+    std::vector<uint8_t> hashes_;
+    std::vector<uint64_t> restarts_;
+    std::vector<uint8_t> paths_;
+};
+
+/**
+ * 按路径的字节序排序条目，构造清单前使用
+ */
+void sort_manifest_entries(std::vector<manifest_entry>& entries);
+
+/**
+ * 二进制文件清单
+ *
+ * 格式（整数均为小端序）：
+ *   头部 64 字节：魔数、版本、条目数、重启间隔、各区的偏移、内容的校验和
+ *   元数据列：每个条目 24 字节（大小、修改时间、mode）
+ *   哈希列：每个条目 32 字节
+ *   重启点：每 restart_interval 个条目一个 u64，指向路径表中保存完整路径的位置
+ *   路径表：每个条目为 varint 共享前缀长度、varint 后缀长度、后缀
+ *
+ * 路径按字节序排序并做前缀压缩，几百万条目的目录树也只有几十 MB。元数据和哈希是定长列，
+ * 按下标直接访问；查找路径时先在重启点上二分，再在一个区间内顺序解码最多 restart_interval
+ * 个条目。清单可以直接 mmap 或引用收到的缓冲区，打开时只检查头部和校验和，不解析条目。
+ *
+ * 对象只读，可以在多个线程中并发使用；底层数据由 file_view 持有。
+ */
+class manifest {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    /**
+     * 引用 data 中的清单
+     *
+     * @param verify 为 true 时校验内容的校验和（顺序读一遍数据）；头部和各区的边界总是检查
+     * 格式错误或校验失败时抛出 std::runtime_error
+     */
+    explicit manifest(file_view data, bool verify = true);
+
+    /**
+     * 映射文件 path 中的清单；无法打开时抛出 std::system_error，格式错误时抛出 std::runtime_error
+     */
+    static manifest open(const std::string& path, bool verify = true);
+
+    size_t size() const {
+        return count_;
+    }
+
+    bool empty() const {
+        return count_ == 0;
+    }
+
+    /**
+     * 定长列按下标直接读取，index 必须小于 size()
+     */
+    manifest_meta meta(size_t index) const;
+
+    hash_digest hash(size_t index) const;
+
+    /**
+     * 第 index 个条目的路径；需要从最近的重启点解码，顺序访问请用 cursor
+     */
+    std::string path(size_t index) const;
+
+    manifest_entry entry(size_t index) const;
+
+    /**
+     * 第一个路径不小于 path 的条目的下标，没有时为 size()
+     */
+    size_t lower_bound(const std::string& path) const;
+
+    /**
+     * 路径为 path 的条目的下标，没有时为 npos
+     */
+    size_t find(const std::string& path) const;
+
+    /**
+     * 把 [begin, end) 的条目编码成一个独立的清单，用于分段发送；范围越界时抛出 std::out_of_range
+     */
+    std::vector<uint8_t> slice(size_t begin, size_t end, uint32_t restart_interval = 16) const;
+
+    /**
+     * 底层的数据，例如用来整个发送
+     */
+    const file_view& data() const {
+        return data_;
+    }
+
+    /**
+     * 顺序遍历条目的游标，增量地还原路径
+     */
+    class cursor {
+    public:
+        /**
+         * 从 index 开始；index 为 size() 时直接结束
+         */
+        explicit cursor(const manifest& m, size_t index = 0);
+
+        bool valid() const {
+            return index_ < m_->count_;
+        }
+
+        size_t index() const {
+            return index_;
+        }
+
+        const std::string& path() const {
+            return path_;
+        }
+
+        manifest_meta meta() const {
+            return m_->meta(index_);
+        }
+
+        hash_digest hash() const {
+            return m_->hash(index_);
+        }
+
+        void next();
+
+    private:
+        void decode();
+
+        const manifest* m_;
+        size_t index_;
+        uint64_t offset_ = 0;  // 下一条路径记录在路径表中的位置
+        std::string path_;
+    };
+
+private:
+    size_t restart_floor(const std::string& path) const;
+
+    file_view data_;
+    size_t count_ = 0;
+    uint32_t restart_interval_ = 0;
+    const uint8_t* meta_ = nullptr;
+    const uint8_t* hashes_ = nullptr;
+    const uint8_t* restarts_ = nullptr;
+    size_t restart_count_ = 0;
+    const uint8_t* paths_ = nullptr;
+    uint64_t paths_size_ = 0;
+};
+
+/**
+ * 两个清单之间的一处差异
+ */
+struct manifest_change {
+    enum class kind {
+        added,     // 只在对端（remote）存在
+        removed,   // 只在本地（local）存在
+        modified,  // 两边都有，大小或内容哈希不同
+        metadata,  // 内容相同，只有修改时间或 mode 不同
+    };
+
+    kind type = kind::added;
+    std::string path;
+    manifest_meta local_meta;  // added 时为空
+    hash_digest local_hash{};
+    manifest_meta remote_meta;  // removed 时为空
+    hash_digest remote_hash{};
+};
+
+/**
+ * 本地清单与对端清单的线性归并比较
+ *
+ * 对端清单可以分段到达：每段是按路径递增、互不重叠的一个清单（例如 manifest::slice 的结果），
+ * 收到一段就 add 一段，差异随之产生，不需要等整个清单传完。全部加入后调用 finish，
+ * 本地剩下的条目报告为 removed。两个清单各只顺序读一遍。
+ */
+class manifest_diff {
+public:
+    using callback = std::function<void(const manifest_change& change)>;
+
+    manifest_diff(const manifest& local, callback on_change);
+
+    /**
+     * 加入对端的下一段；段内不是递增或与前一段重叠时抛出 std::invalid_argument
+     */
+    void add(const manifest& remote);
+
+    void finish();
+
+private:
+    void emit_local();
+
+    callback on_change_;
+    manifest::cursor cursor_;
+    std::string last_remote_;
+    bool has_remote_ = false;
+    bool finished_ = false;
+};
+
+/**
+ * 一次比较整个清单，等同于 manifest_diff 只加入一段
+ */
+void diff_manifests(const manifest& local, const manifest& remote, const manifest_diff::callback& on_change);
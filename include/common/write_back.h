@@ -0,0 +1,226 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../ring_buffer/event_count.h"
+#include "../thread_pool/thread_pool.h"
+
+/**
+ * 写入的持久化级别
+ */
+enum class durability_level {
+    none,   // 不主动落盘：写完即 rename，由内核决定何时写回；崩溃时最近的文件可能为空或丢失
+    batch,  // 组提交：已提交的文件攒成一组，一次数据屏障、一批 rename、一次目录屏障，commit 在屏障之后完成
+    file,   // 每个文件 fsync 后 rename，再 fsync 所在目录，最安全也最慢
+};
+
+/**
+ * 写回配置，通常每个共享目录一份，按需要在安全和速度之间取舍
+ */
+struct write_back_options {
+    durability_level durability = durability_level::batch;
+
+    // 一个文件缓存的数据达到这么多字节时写出，提交时写出剩下的部分
+    size_t write_batch_bytes = 1u << 20;
+
+    // 一次 pwritev 最多合并的缓冲区数
+    size_t max_iov = 64;
+
+    // 首尾相接的小分块合并到同一个缓冲区，不超过这个大小
+    size_t coalesce_bytes = 64 * 1024;
+
+    // Linux 上内核支持时，一次写出中互不相连的几段用 io_uring 的 WRITEV 一次提交，
+    // 不再每段一次 pwritev；不支持时照常使用 pwritev
+    bool use_io_uring = true;
+
+    // 不小于这个大小的文件在打开时预分配空间（fallocate/F_PREALLOCATE），减少碎片和元数据更新
+    uint64_t preallocate_min_size = 1u << 20;
+
+    // batch 级别一组最多包含的文件数
+    size_t sync_batch_files = 1024;
+
+    // batch 级别在 Linux 上用 syncfs 作为屏障（每个文件系统一次调用），否则逐个 fsync 组内的文件和目录
+    bool use_syncfs = true;
+
+    // 组提交的屏障任务提交到的线程池通道
+    task_lane lane = task_lane::transfer;
+
+    // 临时文件名为目标路径加上这个后缀，rename 之前读取方看不到写了一半的文件
+    std::string temp_suffix = ".sync-tmp";
+};
+
+/**
+ * 写回的统计，都是调用时的快照
+ */
+struct write_back_stats {
+    uint64_t files = 0;        // 已 rename 到目标路径的文件数（包括之后目录落盘失败的）
+    uint64_t bytes = 0;        // 写出的字节数
+    uint64_t writes = 0;       // 写入操作数：pwritev 调用或 io_uring 的 WRITEV
+    uint64_t submissions = 0;  // 提交 WRITEV 的 io_uring_enter 次数
+    uint64_t syncs = 0;        // fsync/syncfs 调用次数
+    uint64_t barriers = 0;     // batch 级别的组数
+    uint64_t failures = 0;     // 没有到达目标路径（失败或放弃）的文件数
+};
+
+class write_back_stage;
+
+/**
+ * 正在写入的一个文件
+ *
+ * write 可以按任意顺序写入分块，数据先复制到文件自己的缓冲区，攒够一批后按偏移排序，
+ * 连续的范围用一次 pwritev 写出。commit 写出剩余数据，按持久化级别落盘并原子地
+ * rename 到目标路径。没有 commit 就析构时放弃写入，删除临时文件。
+ *
+ * 同一个文件的 write 可以在多个线程中调用（内部加锁），但 commit 之后不能再写。
+ */
+class write_back_file {
+public:
+    ~write_back_file();
+
+    write_back_file(const write_back_file&) = delete;
+    write_back_file& operator=(const write_back_file&) = delete;
+
+    /**
+     * 写入 [offset, offset + size)；写出失败时抛出 std::system_error，commit 之后调用抛出 std::logic_error
+     *
+     * 同一范围可以重复写入（例如重传的分块），重叠部分的内容应当相同，写出时哪一份在后不确定
+     */
+    void write(uint64_t offset, const uint8_t* data, size_t size);
+
+    /**
+     * 完成写入
+     *
+     * 写入的范围没有覆盖 [0, 打开时的大小) 时失败并删除临时文件。返回的 future 在文件达到
+     * 配置的持久化级别时就绪，失败时得到对应的异常。rename 之后目录落盘失败时文件
+     * 已经在目标路径上，future 仍然得到异常，表示没有达到持久化级别。
+     */
+    std::future<void> commit();
+
+    /**
+     * 放弃写入，删除临时文件；已经 commit 时什么也不做
+     */
+    void abort();
+
+    const std::string& path() const {
+        return path_;
+    }
+
+    uint64_t size() const {
+        return size_;
+    }
+
+private:
+    friend class write_back_stage;
+
+    struct pending_chunk {
+        uint64_t offset;
+        std::vector<uint8_t> data;
+    };
+
+    write_back_file(write_back_stage& stage, const std::string& path, uint64_t size, uint32_t mode,
+                    uint64_t trace_key);
+
+    void cover_locked(uint64_t offset, uint64_t size);
+    void flush_locked();
+    void discard_locked();
+
+    write_back_stage& stage_;
+    const std::string path_;
+    const std::string temp_path_;
+    const uint64_t size_;
+    const uint64_t trace_key_;
+
+    std::mutex mutex_;
+    int fd_ = -1;
+    std::vector<pending_chunk> pending_;
+    size_t pending_bytes_ = 0;
+    std::map<uint64_t, uint64_t> covered_;  // 已写入的范围，起点 -> 终点，互不相交也不相接
+    uint64_t written_ = 0;                  // covered_ 覆盖的字节数，重复写入的部分只计一次
+    bool finished_ = false;  // 已 commit 或 abort
+};
+
+/**
+ * 接收端的写回阶段
+ *
+ * 每个文件写入临时文件，分块在文件级别合并成大的 pwritev，大文件预分配空间；
+ * 提交时原子地 rename 到目标路径。持久化按级别处理：batch 级别下多个文件共用
+ * 屏障——第一个提交的文件立即启动一组屏障，屏障进行期间提交的文件进入下一组，
+ * 负载越高每组越大，大量小文件时每个文件摊到的 fsync 远少于一次，而单个文件的
+ * 延迟不超过两轮屏障。
+ *
+ * 屏障的顺序保证崩溃后目标路径要么是旧内容要么是完整的新内容：先让组内临时文件的
+ * 数据落盘，再 rename，最后让目录项落盘，之后 commit 的 future 才就绪。
+ *
+ * 可以在多个线程中并发使用。析构时等待所有已提交的文件完成，打开的文件必须先于它析构。
+ */
+class write_back_stage {
+public:
+    /**
+     * options 不合法（max_iov 或 sync_batch_files 为 0）时抛出 std::invalid_argument
+     */
+    explicit write_back_stage(thread_pool& pool, const write_back_options& options = write_back_options());
+
+    ~write_back_stage();
+
+    write_back_stage(const write_back_stage&) = delete;
+    write_back_stage& operator=(const write_back_stage&) = delete;
+
+    /**
+     * 开始写入 path，文件大小必须事先知道（用于预分配和提交时的检查）；所在目录必须存在
+     *
+     * 无法创建临时文件时抛出 std::system_error。trace_key 是 write 区间的跟踪编号使用的文件键
+     * （见 trace_chunk_id），与发送方使用同一个文件名的键时分块的各个阶段连成一条线；为 0 时用 path 计算
+     */
+    std::unique_ptr<write_back_file> open(const std::string& path, uint64_t size, uint32_t mode = 0644,
+                                          uint64_t trace_key = 0);
+
+    /**
+     * 等待已提交的文件全部完成
+     */
+    void flush();
+
+    write_back_stats stats() const;
+
+    const write_back_options& options() const {
+        return options_;
+    }
+
+private:
+    friend class write_back_file;
+
+    // batch 级别下等待屏障的文件
+    struct queued_commit {
+        std::string temp_path;
+        std::string path;
+        std::promise<void> done;
+    };
+
+    void enqueue(queued_commit commit);
+    void sync_loop();
+    void run_group(std::vector<queued_commit>& group);
+    void finish_inline(write_back_file& file, int fd);
+
+    thread_pool& pool_;
+    const write_back_options options_;
+    bool use_io_uring_ = false;  // 配置要求且内核支持 WRITEV
+
+    std::mutex mutex_;
+    std::vector<queued_commit> queued_;  // 受 mutex_ 保护
+    bool syncing_ = false;               // 已有屏障任务在运行，受 mutex_ 保护
+    event_count idle_;
+
+    std::atomic<uint64_t> files_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> writes_{0};
+    std::atomic<uint64_t> submissions_{0};
+    std::atomic<uint64_t> syncs_{0};
+    std::atomic<uint64_t> barriers_{0};
+    std::atomic<uint64_t> failures_{0};
+};
@@ -0,0 +1,392 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "../common/buffer_pool.h"
+#include "../common/file_reader.h"
+#include "../metrics/metrics.h"
+#include "../ring_buffer/blocking_ring_buffer.h"
+#include "../ring_buffer/ring_buffer.h"
+#include "../thread_pool/thread_pool.h"
+
+/**
+ * 帧头：4 字节负载长度、2 字节类型、2 字节标志，均为小端序
+ */
+constexpr size_t frame_header_size = 8;
+
+/**
+ * 只读打开的文件，最后一个引用释放时关闭描述符
+ */
+class shared_file {
+public:
+    /**
+     * 接管描述符 fd；无法取得文件大小时关闭 fd 并抛出 std::system_error
+     */
+    explicit shared_file(int fd);
+
+    ~shared_file();
+
+    shared_file(const shared_file&) = delete;
+    shared_file& operator=(const shared_file&) = delete;
+
+    /**
+     * 以只读方式打开 path，失败时抛出 std::system_error
+     */
+    static std::shared_ptr<const shared_file> open(const std::string& path);
+
+    int fd() const {
+        return fd_;
+    }
+
+    /**
+     * 映射读取这个文件，需要把负载读到用户空间时使用，多个连接共用映射窗口
+     */
+    const file_reader& reader() const {
+        return reader_;
+    }
+
+private:
+    const int fd_;
+    file_reader reader_;
+};
+
+/**
+ * 连接上收发的消息单位
+ */
+struct frame {
+    uint16_t type = 0;
+    uint16_t flags = 0;
+    std::vector<uint8_t> payload;
+
+    frame() = default;
+    frame(frame&&) = default;
+    frame& operator=(frame&&) = default;
+
+    // 池缓冲区不能共享：复制时把它的内容复制成 payload
+    frame(const frame& other)
+        : type(other.type),
+          flags(other.flags),
+          payload(other.buffer ? std::vector<uint8_t>(other.buffer.data(), other.buffer.data() + other.buffer_length)
+                               : other.payload),
+          file(other.file),
+          file_offset(other.file_offset),
+          file_length(other.file_length) {}
+
+    frame& operator=(const frame& other) {
+        if (this != &other) {
+            frame copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    // 设置 file 时负载是文件中 [file_offset, file_offset + file_length) 的内容，payload 不使用。
+    // I/O 线程直接从文件读出发送，接收方收到的仍是普通的 payload
+    std::shared_ptr<const shared_file> file;
+    uint64_t file_offset = 0;
+    uint32_t file_length = 0;
+
+    // 设置 buffer 时负载是池缓冲区的前 buffer_length 字节，payload 不使用。启用接收缓冲区池
+    // 时收到的帧也可能是这种形式；缓冲区计入连接的配额，保留帧时要同时持有连接
+    pooled_buffer buffer;
+    uint32_t buffer_length = 0;
+
+    size_t payload_size() const {
+        return file ? file_length : buffer ? buffer_length : payload.size();
+    }
+
+    // 内存负载的起始地址（payload 或 buffer），文件帧不适用
+    const uint8_t* payload_data() const {
+        return buffer ? buffer.data() : payload.data();
+    }
+};
+
+class connection;
+class io_loop;
+class readiness_loop;
+class uring_loop;
+using connection_ptr = std::shared_ptr<connection>;
+
+/**
+ * 连接的回调，都在线程池的 transfer 通道上执行
+ *
+ * 同一连接的 on_frame 按接收顺序逐个调用，不会并发；on_close 在该连接的所有帧
+ * 交付之后调用一次，正常关闭时 error 为空。
+ */
+struct connection_handler {
+    std::function<void(const connection_ptr& conn, frame&& f)> on_frame;
+    std::function<void(const connection_ptr& conn, const std::error_code& error)> on_close;
+};
+
+/**
+ * I/O 线程使用的系统接口
+ */
+enum class reactor_backend {
+    automatic,  // 支持时使用 io_uring，否则使用 readiness
+    readiness,  // 边沿触发的就绪通知：Linux 为 epoll，macOS 为 kqueue
+    io_uring,   // Linux io_uring：多次触发的接收、注册缓冲区和链接的文件发送
+};
+
+/**
+ * readiness 后端发送文件帧负载的方式；帧头总是经过普通的发送路径
+ *
+ * 负载需要压缩、加密等变换时由发送方读成普通帧，不会用到这里的方式。
+ */
+enum class file_transfer {
+    automatic,  // sendfile 直接从页缓存发往套接字，不可用时（仅 Linux）改用 splice；其他平台为 copy
+    splice,     // 经过每个连接一对管道的 splice，仅 Linux，其他平台按 automatic 处理
+    copy,       // 从 shared_file::reader 的映射中与内存帧一起 writev
+};
+
+/**
+ * 事件循环配置
+ */
+struct reactor_options {
+    // I/O 线程数量，连接按轮询分配到各个线程，之后一直由该线程处理
+    size_t io_threads = 2;
+
+    // 每个连接发送队列和接收队列能容纳的帧数，必须是2的幂。
+    // 发送队列满时 send 阻塞；接收队列满时 I/O 线程暂停读取该连接，由 TCP 流量控制反压对端
+    uint32_t send_queue_frames = 256;
+    uint32_t recv_queue_frames = 256;
+
+    // 允许的最大帧负载，超过时按协议错误关闭连接
+    uint32_t max_frame_size = 16u << 20;
+
+    // 每次 read 系统调用的缓冲区大小；io_uring 后端中为每个接收缓冲区的大小
+    size_t read_buffer_size = 64 * 1024;
+
+    reactor_backend backend = reactor_backend::automatic;
+
+    // io_uring 后端发送文件帧时使用的注册缓冲区：每个 I/O 线程 file_blocks 块，每块 file_block_size 字节
+    uint32_t file_block_size = 256 * 1024;
+    uint32_t file_blocks = 16;
+
+    // readiness 后端的文件帧发送方式；io_uring 后端总是使用上面的注册缓冲区
+    file_transfer file_mode = file_transfer::automatic;
+
+    // 接收缓冲区池：不超过 pool_buffer_size 的帧负载放进池缓冲区（frame::buffer），
+    // 不再每帧 malloc。0 表示不启用。池在所有连接之间共享，共 pool_buffers 个缓冲区，
+    // 每个连接最多同时占用 pool_buffers_per_connection 个，超出或用完时退回 payload
+    size_t pool_buffer_size = 0;
+    uint32_t pool_buffers = 1024;
+    uint32_t pool_buffers_per_connection = 64;
+};
+
+/**
+ * 一条 TCP 连接
+ *
+ * 由 reactor 创建，可以在任意线程中发送和关闭。发送的帧先进入连接的发送
+ * ring_buffer，由所属 I/O 线程批量写出；收到的完整帧进入接收 ring_buffer，
+ * 再交给线程池按顺序回调 on_frame。
+ */
+class connection : public std::enable_shared_from_this<connection> {
+public:
+    ~connection();
+
+    connection(const connection&) = delete;
+    connection& operator=(const connection&) = delete;
+
+    /**
+     * 发送一帧，发送队列满时等待空位
+     *
+     * @return 连接已关闭时返回 false
+     */
+    bool send(frame f);
+
+    /**
+     * 尝试发送一帧，不等待；只有成功时才会移走 f
+     *
+     * @return 发送队列满或连接已关闭时返回 false
+     */
+    bool try_send(frame& f);
+
+    /**
+     * 关闭连接：已经进入发送队列的帧仍会尽量写出，然后关闭套接字
+     */
+    void close();
+
+    bool closed() const {
+        return closed_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * 连接编号，在同一个 reactor 内唯一
+     */
+    uint64_t id() const {
+        return id_;
+    }
+
+    /**
+     * 接收队列当前的空闲帧数，可用于向对端通告接收窗口
+     */
+    size_t recv_free_slots() const {
+        return recv_queue_.capacity() - recv_queue_.size_approx();
+    }
+
+    uint64_t bytes_sent() const {
+        return bytes_sent_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t bytes_received() const {
+        return bytes_received_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * 这个连接收到的帧当前占用的池缓冲区数，不超过 reactor_options::pool_buffers_per_connection
+     */
+    size_t pooled_buffers() const {
+        return quota_.used();
+    }
+
+private:
+    friend class io_loop;
+    friend class readiness_loop;
+    friend class uring_loop;
+    friend class reactor;
+
+    using frame_queue = blocking_ring_buffer<ring_buffer<frame, dynamic_capacity>>;
+
+    // 已从发送队列取出、正在写出的帧
+    struct outgoing_frame {
+        uint8_t header[frame_header_size];
+        frame f;
+        file_view body;  // 文件帧的负载需要经过用户空间时，从 shared_file::reader 取得的映射
+
+        size_t size() const {
+            return frame_header_size + f.payload_size();
+        }
+    };
+
+    connection(uint64_t id, int fd, std::shared_ptr<io_loop> loop, std::shared_ptr<const connection_handler> handler,
+               thread_pool& pool, std::shared_ptr<buffer_pool> buffers, const reactor_options& options);
+
+    void request_write();
+    void schedule_delivery();
+    void deliver();
+
+    const uint64_t id_;
+    const int fd_;
+    const std::shared_ptr<io_loop> loop_;
+    const std::shared_ptr<const connection_handler> handler_;
+    thread_pool& pool_;
+
+    // 声明在队列之前：队列中的帧析构时把缓冲区还给池并减少配额
+    const std::shared_ptr<buffer_pool> buffers_;
+    buffer_quota quota_;
+
+    frame_queue send_queue_;
+    frame_queue recv_queue_;
+
+    std::atomic<bool> closed_{false};         // 不再接受新的帧
+    std::atomic<bool> write_requested_{false};  // 已通知 I/O 线程有帧要写
+    std::atomic<bool> delivering_{false};     // 已有交付任务在线程池中
+    std::atomic<bool> read_paused_{false};    // 接收队列满，I/O 线程暂停读取
+    std::atomic<bool> finished_{false};       // I/O 线程已关闭套接字，不会再有新帧
+    std::atomic<bool> close_notified_{false};
+    std::error_code close_error_;             // finished_ 之前写入
+
+    std::atomic<uint64_t> bytes_sent_{0};
+    std::atomic<uint64_t> bytes_received_{0};
+
+    // 以下只由所属 I/O 线程访问
+    std::vector<uint8_t> in_;
+    size_t in_begin_ = 0;
+    size_t in_end_ = 0;
+    std::deque<outgoing_frame> out_;
+    size_t out_offset_ = 0;  // out_ 中第一帧已写出的字节数（包括帧头）
+    bool closing_ = false;   // 收到 close 请求，写完后关闭
+    const uint32_t max_frame_size_;
+    const size_t read_buffer_size_;
+
+    // 字节数和队列深度的导出，声明在最后，最先注销
+    SYNC_METRICS_ONLY(metric_registration metrics_;)
+};
+
+/**
+ * 事件驱动的连接管理（reactor）
+ *
+ * 固定数量的 I/O 线程各自运行一个事件循环，所有套接字都是非阻塞的。readiness 后端
+ * 使用边沿触发的就绪通知（Linux 为 epoll，macOS 为 kqueue）：可读时一直读到 EAGAIN 并切分
+ * 出完整的帧，可写时把发送队列中的帧批量写出，文件帧的负载用 sendfile/splice 在内核中
+ * 直接从文件发往套接字。io_uring 后端改为提交异步操作：每个连接
+ * 挂一个多次触发的接收，数据直接落在与内核共享的接收缓冲区中；文件帧用链接的
+ * READ_FIXED 和 SEND 从注册缓冲区发出，一个循环中的所有操作一次系统调用批量提交。
+ *
+ * I/O 线程只做系统调用和切帧，不执行任何回调，回调都交给线程池，
+ * 因此几百个对端也只需要几个 I/O 线程。
+ */
+class reactor {
+public:
+    /**
+     * 启动 I/O 线程；io_threads 为 0 或队列大小不是2的幂时抛出 std::invalid_argument，
+     * 明确要求 io_uring 而当前系统不支持时抛出 std::system_error
+     */
+    explicit reactor(thread_pool& pool, const reactor_options& options = reactor_options());
+
+    /**
+     * 关闭所有连接和监听套接字并等待 I/O 线程退出
+     */
+    ~reactor();
+
+    reactor(const reactor&) = delete;
+    reactor& operator=(const reactor&) = delete;
+
+    /**
+     * 监听 host:port，新连接使用 handler
+     *
+     * @param port 为 0 时由系统分配
+     * @return 实际监听的端口；失败时抛出 std::system_error
+     */
+    uint16_t listen(const std::string& host, uint16_t port, const connection_handler& handler);
+
+    /**
+     * 连接到 host:port（连接建立阶段是阻塞的），失败时抛出 std::system_error
+     */
+    connection_ptr connect(const std::string& host, uint16_t port, const connection_handler& handler);
+
+    /**
+     * 接管一个已经建立的流式套接字，例如 socketpair 的一端；reactor 负责关闭它
+     */
+    connection_ptr adopt(int fd, const connection_handler& handler);
+
+    /**
+     * 停止：关闭所有连接，可重复调用
+     */
+    void stop();
+
+    size_t io_threads() const {
+        return loops_.size();
+    }
+
+    /**
+     * 实际使用的后端："epoll"、"kqueue" 或 "io_uring"
+     */
+    const char* backend_name() const;
+
+    /**
+     * 接收缓冲区池，没有启用时为空；也可以用来为发送的帧申请缓冲区
+     */
+    const std::shared_ptr<buffer_pool>& buffers() const {
+        return buffers_;
+    }
+
+private:
+    std::shared_ptr<io_loop> next_loop();
+
+    thread_pool& pool_;
+    reactor_options options_;
+    std::shared_ptr<buffer_pool> buffers_;
+    std::vector<std::shared_ptr<io_loop>> loops_;
+    std::atomic<size_t> next_loop_{0};
+    std::atomic<uint64_t> next_id_{1};
+    std::atomic<bool> stopped_{false};
+};
@@ -0,0 +1,212 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "connection.h"
+
+/**
+ * 条带化连接的控制帧类型，用户帧不能使用 striped_reserved_type 及以上的类型
+ *
+ * 整数为小端序：
+ *   hello : u64 组标识, u16 流序号, u16 流数量   发起方在每条流上发出的第一帧
+ *   run   : u64 起始序号, u32 帧数              这条流上之后的 N 个用户帧依次使用这些序号
+ *   ack   : u64 已按顺序交付的帧数              接收方 -> 发送方，推进发送窗口
+ */
+enum class striped_frame : uint16_t {
+    hello = 0xff00,
+    run,
+    ack,
+};
+
+constexpr uint16_t striped_reserved_type = 0xff00;
+
+/**
+ * 条带化连接配置
+ */
+struct striped_options {
+    // 发起方到同一对端建立的 TCP 连接数（流），1 到 65535；接受方按发起方的 hello 确定
+    uint32_t streams = 4;
+
+    // 所有流共用的发送队列能容纳的帧数，必须是2的幂；满时 send 阻塞
+    uint32_t send_queue_frames = 1024;
+
+    // 调度器每次交给一条流的最多帧数，每段前面有一个 run 帧
+    uint32_t run_frames = 16;
+
+    // 已经发出、对端还没有按顺序交付的最多帧数，也就是对端重排缓冲区的上限；不小于 run_frames
+    uint32_t reorder_window = 4096;
+};
+
+/**
+ * 一条流的统计，都是调用时的快照
+ */
+struct striped_stream_stats {
+    uint64_t frames_sent = 0;     // 调度到这条流上的用户帧
+    uint64_t bytes_sent = 0;      // 套接字上写出的字节数，包括帧头和控制帧
+    uint64_t bytes_received = 0;
+    uint64_t send_backlog = 0;    // 已交给这条流、还没有写出的字节数；持续偏高说明这条流是瓶颈
+    bool open = false;
+};
+
+/**
+ * 条带化连接的统计
+ */
+struct striped_stats {
+    std::vector<striped_stream_stats> streams;  // 按流序号排列，接受方还没有加入的流为空
+    uint64_t frames_sent = 0;
+    uint64_t frames_delivered = 0;  // 按顺序交给 on_frame 的帧数
+    uint64_t in_flight = 0;         // 已发出、对端还没有确认交付的帧数
+    uint64_t window_stalls = 0;     // 发送窗口用完、等待对端确认的次数
+    size_t reorder_peak = 0;        // 重排缓冲区中曾经同时等待的最多帧数
+};
+
+class striped_connection;
+using striped_ptr = std::shared_ptr<striped_connection>;
+
+/**
+ * 条带化连接的回调，在线程池上执行
+ *
+ * on_frame 按对端 send 的顺序逐个调用，不会并发；on_close 在所有流都关闭后调用一次，
+ * 正常关闭时 error 为空。
+ */
+struct striped_handler {
+    std::function<void(const striped_ptr& conn, frame&& f)> on_frame;
+    std::function<void(const striped_ptr& conn, const std::error_code& error)> on_close;
+};
+
+/**
+ * 到同一对端的一组并行 TCP 连接（流），对使用者表现为一条有序的连接
+ *
+ * 单条 TCP 流在高带宽时延积的链路上受拥塞窗口限制跑不满带宽，并行的几条流各自
+ * 有自己的拥塞窗口。所有 send 的帧先进入一个共享的 ring_buffer，调度器每次取出一段
+ * （最多 run_frames 帧）交给未写出字节最少的一条流，因此跑得快的流自然分到更多的帧；
+ * 每段前面的 run 帧告诉对端这些帧的序号，对端按序号重排后按发送顺序交付。
+ *
+ * 对端每交付一批帧就回一个 ack；已发出而未确认的帧不超过 reorder_window，
+ * 一条流变慢时其他流最多领先这么多帧，对端的重排缓冲区不会无限增长。
+ * 文件帧和池缓冲区帧原样经过各条流，零拷贝发送和接收不受影响。
+ *
+ * 任何一条流出错时关闭整组。可以在任意线程中发送和关闭。
+ */
+class striped_connection : public std::enable_shared_from_this<striped_connection> {
+public:
+    /**
+     * 建立 options.streams 条到 host:port 的连接，对端用 striped_listener 接受
+     *
+     * options 不合法时抛出 std::invalid_argument，连接失败时关闭已经建立的流并抛出 std::system_error
+     */
+    static striped_ptr connect(reactor& r, const std::string& host, uint16_t port, const striped_handler& handler,
+                               const striped_options& options = striped_options());
+
+    /**
+     * 关闭所有流
+     */
+    ~striped_connection();
+
+    striped_connection(const striped_connection&) = delete;
+    striped_connection& operator=(const striped_connection&) = delete;
+
+    /**
+     * 发送一帧，共享发送队列满时等待空位；帧类型不能是保留的控制帧类型（抛出 std::invalid_argument）
+     *
+     * @return 连接已关闭时返回 false
+     */
+    bool send(frame f);
+
+    /**
+     * 关闭：共享队列中的帧全部交给各条流之后关闭所有流，流上已经排队的帧仍会写出
+     */
+    void close();
+
+    bool closed() const {
+        return closed_.load(std::memory_order_acquire);
+    }
+
+    uint32_t streams() const {
+        return static_cast<uint32_t>(streams_.size());
+    }
+
+    striped_stats stats() const;
+
+private:
+    friend class striped_listener;
+
+    struct stream;
+
+    striped_connection(uint64_t group, uint32_t streams, std::shared_ptr<const striped_handler> handler,
+                       const striped_options& options);
+
+    static connection_handler stream_handler(const std::weak_ptr<striped_connection>& self, uint32_t index);
+
+    bool attach(uint32_t index, const connection_ptr& conn);
+    void on_stream_frame(uint32_t index, frame&& f);
+    void on_stream_close(uint32_t index, const std::error_code& error);
+    void accept(uint64_t seq, frame&& f, bool run_end);
+    void pump();
+    void drain();
+    bool transmit(stream& s, frame f);
+    std::shared_ptr<stream> pick_stream() const;
+    void send_ack(uint64_t delivered);
+    void fail(const std::error_code& error);
+    void close_streams();
+
+    const uint64_t group_;
+    const striped_options options_;
+    const std::shared_ptr<const striped_handler> handler_;
+
+    // 流的数量构造时确定，接受方的流在 hello 到达后才有连接
+    mutable std::mutex streams_mutex_;
+    std::vector<std::shared_ptr<stream>> streams_;
+    uint32_t finished_streams_ = 0;
+    mutable size_t next_pick_ = 0;
+    std::error_code close_error_;
+
+    // 发送：只有持有 pumping_ 的线程从共享队列取帧并分配序号
+    blocking_ring_buffer<ring_buffer<frame, dynamic_capacity>> send_queue_;
+    std::atomic<bool> pumping_{false};
+    std::atomic<uint64_t> next_seq_{0};
+    std::atomic<uint64_t> acked_{0};
+    std::atomic<uint64_t> window_stalls_{0};
+
+    // 接收：按序号重排，只有持有 delivering_ 的线程调用 on_frame
+    mutable std::mutex recv_mutex_;
+    struct pending_frame {
+        frame f;
+        bool run_end;  // 一段的最后一帧：交付后回 ack，发送方在段边界上等待窗口
+    };
+    std::map<uint64_t, pending_frame> reorder_;
+    uint64_t next_deliver_ = 0;
+    bool delivering_ = false;
+    std::atomic<uint64_t> delivered_{0};
+    size_t reorder_peak_ = 0;
+
+    std::atomic<bool> closed_{false};        // 不再接受新的帧
+    std::atomic<bool> closing_{false};       // 共享队列取空后关闭所有流
+    std::atomic<bool> streams_closed_{false};  // 已经关闭所有流，不再调度新的帧
+    std::atomic<bool> close_notified_{false};
+};
+
+/**
+ * 接受方：用 handler() 作为 reactor::listen 的回调，把同一组的流合成 striped_connection
+ *
+ * 连接的第一帧必须是 hello，否则关闭该连接。组在第一条流到达时创建，其余的流陆续加入，
+ * 之后收到的帧和 send 都只使用已经加入的流。
+ */
+class striped_listener {
+public:
+    explicit striped_listener(const striped_handler& handler, const striped_options& options = striped_options());
+
+    connection_handler handler() const;
+
+private:
+    struct state;
+    std::shared_ptr<state> state_;
+};
@@ -0,0 +1,148 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+#include "connection.h"
+
+/**
+ * 流水线化的文件传输协议
+ *
+ * 拉取方（transfer_client）在一条连接上同时打开多个文件（流），把各个流的分块请求
+ * 轮流放进一个共享的滑动窗口：窗口内的请求全部在途，不需要等前一个分块的响应，
+ * 窗口大小按带宽时延积（BDP）确定，高延迟链路上也能跑满带宽。
+ *
+ * 数据方（transfer_server）按收到的顺序响应请求，分块数据用文件帧发出（不经过用户空间），
+ * 帧的 flags 是请求所在的窗口槽位，拉取方据此找到对应的流和偏移。
+ *
+ * 流量控制基于信用：拉取方只在自己连接的接收队列还有空位时发出新请求，在途的请求数
+ * 不超过接收队列的空闲槽位（connection::recv_free_slots）。写盘慢时分块在接收队列中堆积，
+ * 空位减少，请求随之停止，不会在内存中无限缓冲。
+ *
+ * 消息都是普通的帧，帧类型见 transfer_frame；整数为小端序：
+ *   open    : u32 流编号, 文件名            拉取方 -> 数据方
+ *   opened  : u32 流编号, u64 文件大小      数据方 -> 拉取方
+ *   request : u32 流编号, u64 偏移, u32 长度，flags 为槽位
+ *   data    : 分块数据，flags 为槽位
+ *   error   : u32 流编号, 错误信息          数据方 -> 拉取方，流结束
+ *   close   : u32 流编号                    拉取方 -> 数据方，流结束
+ */
+enum class transfer_frame : uint16_t {
+    open = 0x0100,
+    opened,
+    request,
+    data,
+    error,
+    close,
+};
+
+/**
+ * 为 bandwidth 字节/秒、往返时间 rtt 的链路计算分块请求窗口：ceil(bandwidth × rtt / chunk_size)，
+ * 限制在 [1, max_window]
+ */
+uint32_t bdp_window(double bandwidth, std::chrono::microseconds rtt, uint32_t chunk_size, uint32_t max_window);
+
+/**
+ * 拉取方配置
+ */
+struct transfer_options {
+    // 每个请求的分块大小，不能超过连接的 max_frame_size
+    uint32_t chunk_size = 1u << 20;
+
+    // 窗口上限，最多 65536（槽位编号放在帧的 16 位 flags 中）
+    uint32_t max_window = 256;
+
+    // 链路带宽（字节/秒）和往返时间都给出时，初始窗口取它们的带宽时延积，否则取 initial_window
+    double link_bandwidth = 0;
+    std::chrono::microseconds link_rtt{0};
+    uint32_t initial_window = 16;
+
+    // 按测得的最小往返时间和交付速率持续调整窗口（取两倍 BDP 留出余量），不低于 min_window
+    bool adaptive_window = true;
+    uint32_t min_window = 4;
+};
+
+/**
+ * 拉取方的统计，都是调用时的快照
+ */
+struct transfer_stats {
+    uint32_t window = 0;                  // 当前窗口
+    uint32_t outstanding = 0;             // 在途的请求数
+    uint64_t requests = 0;                // 已发出的请求数
+    uint64_t bytes_received = 0;          // 收到的分块数据字节数
+    uint64_t credit_stalls = 0;           // 因接收队列没有空位而暂停发请求的次数
+    std::chrono::microseconds min_rtt{0};  // 测得的最小往返时间，还没有样本时为 0
+    double delivery_rate = 0;             // 最近测得的交付速率（字节/秒）
+};
+
+/**
+ * 数据方：用 handler() 作为 reactor::listen 或 adopt 的回调
+ *
+ * 可以同时服务多个连接，每个连接上可以有多个打开的流。
+ */
+class transfer_server {
+public:
+    // 按文件名打开文件；抛出的异常信息作为 error 消息发给拉取方
+    using open_file = std::function<std::shared_ptr<const shared_file>(const std::string& name)>;
+
+    explicit transfer_server(open_file open);
+
+    connection_handler handler() const;
+
+private:
+    struct state;
+    std::shared_ptr<state> state_;
+};
+
+/**
+ * 拉取方：连接到 transfer_server，在同一条连接上并发拉取多个文件
+ *
+ * 可以在任意线程调用 fetch；分块按偏移顺序交给 sink，在线程池上执行，
+ * 同一连接上的 sink 调用不会并发。销毁时关闭连接，未完成的拉取以异常结束。
+ */
+class transfer_client {
+public:
+    // 收到文件 [offset, offset + size) 的数据
+    using chunk_sink = std::function<void(uint64_t offset, const uint8_t* data, size_t size)>;
+
+    /**
+     * 连接到 host:port；options 不合法时抛出 std::invalid_argument，连接失败时抛出 std::system_error
+     */
+    transfer_client(reactor& r, const std::string& host, uint16_t port,
+                    const transfer_options& options = transfer_options());
+
+    /**
+     * 接管已经建立的流式套接字，例如 socketpair 的一端
+     */
+    transfer_client(reactor& r, int fd, const transfer_options& options = transfer_options());
+
+    ~transfer_client();
+
+    transfer_client(const transfer_client&) = delete;
+    transfer_client& operator=(const transfer_client&) = delete;
+
+    /**
+     * 拉取文件 name，数据依次交给 sink
+     *
+     * @return 完成时得到文件大小；数据方报错、sink 抛出异常或连接关闭时得到对应的异常
+     */
+    std::future<uint64_t> fetch(const std::string& name, chunk_sink sink);
+
+    transfer_stats stats() const;
+
+    const connection_ptr& conn() const {
+        return conn_;
+    }
+
+private:
+    struct state;
+
+    static connection_handler make_handler(const std::shared_ptr<state>& s);
+
+    std::shared_ptr<state> state_;
+    connection_ptr conn_;
+};
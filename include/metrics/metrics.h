@@ -0,0 +1,284 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * 热路径上的统计
+ *
+ * 计数器和直方图按线程分片：每个线程固定写自己的分片（独占一个缓存行），写入只有一次
+ * 无竞争的原子加，不需要锁；读数时才把所有分片加起来。编译时定义 SYNC_METRICS
+ * （CMake 选项 SYNC_ENABLE_METRICS）才会插桩，否则下面的宏展开为空，热路径上没有任何代码。
+ * 注册表和导出接口总是可用，未开启时只是没有数据。
+ */
+#if defined(SYNC_METRICS)
+#define SYNC_METRIC_ADD(counter, n) (counter).add(n)
+#define SYNC_METRIC_RECORD(histogram, value) (histogram).record(value)
+#define SYNC_METRICS_ONLY(...) __VA_ARGS__
+#else
+#define SYNC_METRIC_ADD(counter, n) ((void)0)
+#define SYNC_METRIC_RECORD(histogram, value) ((void)0)
+#define SYNC_METRICS_ONLY(...)
+#endif
+
+constexpr size_t metric_shards = 16;
+
+/**
+ * 为新线程分配一个分片编号，线程数超过分片数时轮流共用
+ */
+size_t next_metric_shard();
+
+inline size_t metric_shard() {
+    thread_local const size_t shard = next_metric_shard();
+    return shard;
+}
+
+/**
+ * 单调递增的计数器
+ */
+class metric_counter {
+public:
+    metric_counter() = default;
+    metric_counter(const metric_counter&) = delete;
+    metric_counter& operator=(const metric_counter&) = delete;
+
+    void add(uint64_t n = 1) {
+        shards_[metric_shard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    /**
+     * 所有分片之和；与并发的 add 之间没有同步，是一个近似的快照
+     */
+    uint64_t value() const;
+
+private:
+    struct alignas(64) shard {
+        std::atomic<uint64_t> value{0};
+    };
+
+    shard shards_[metric_shards];
+};
+
+/**
+ * HDR 风格的对数-线性直方图
+ *
+ * 每个 2 的幂区间再等分成 8 个桶，任意值的相对误差不超过 12.5%，覆盖整个 uint64 范围，
+ * 不需要预先知道数值的分布。桶按线程分片，记录一个值只有两次无竞争的原子加。
+ */
+class metric_histogram {
+public:
+    static constexpr unsigned sub_bucket_bits = 3;
+    static constexpr size_t sub_buckets = size_t(1) << sub_bucket_bits;
+    static constexpr size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_buckets;
+    static constexpr size_t histogram_shards = 8;
+
+    metric_histogram();
+    metric_histogram(const metric_histogram&) = delete;
+    metric_histogram& operator=(const metric_histogram&) = delete;
+
+    void record(uint64_t value) {
+        shard& s = shards_[metric_shard() % histogram_shards];
+        s.buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        s.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    static size_t bucket_of(uint64_t value) {
+        if (value < sub_buckets) {
+            return static_cast<size_t>(value);
+        }
+        const unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(value));
+        const size_t sub = static_cast<size_t>(value >> (msb - sub_bucket_bits)) & (sub_buckets - 1);
+        return (msb - sub_bucket_bits + 1) * sub_buckets + sub;
+    }
+
+    /**
+     * 桶中的最大值
+     */
+    static uint64_t bucket_upper(size_t index);
+
+    /**
+     * 合并所有分片后的快照
+     */
+    struct snapshot {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum = 0;
+
+        /**
+         * 分位数 q（0 到 1）所在桶的上界，没有数据时为 0
+         */
+        uint64_t quantile(double q) const;
+
+        /**
+         * 不大于 bound 的值的数量；按桶计，跨过 bound 的桶不计入，
+         * bound 取某个桶的上界（例如 2^k - 1）时结果是精确的
+         */
+        uint64_t count_at_most(uint64_t bound) const;
+    };
+
+    snapshot read() const;
+
+private:
+    struct alignas(64) shard {
+        std::atomic<uint64_t> buckets[bucket_count];
+        std::atomic<uint64_t> sum;
+    };
+
+    std::unique_ptr<shard[]> shards_;
+};
+
+using metric_labels = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * 导出时收集一组样本，同名的样本归到同一个指标族
+ */
+class metric_writer {
+public:
+    void counter(const std::string& name, const std::string& help, const metric_labels& labels, double value);
+
+    void gauge(const std::string& name, const std::string& help, const metric_labels& labels, double value);
+
+    /**
+     * 导出为 Prometheus 直方图，scale 把记录的单位换算成导出的单位（例如纳秒到秒为 1e-9）
+     */
+    void histogram(const std::string& name, const std::string& help, const metric_labels& labels,
+                   const metric_histogram::snapshot& snapshot, double scale);
+
+    /**
+     * Prometheus 文本格式（0.0.4）
+     */
+    std::string prometheus() const;
+
+private:
+    struct family {
+        std::string type;
+        std::string help;
+        std::vector<std::string> samples;  // 已经格式化的样本行
+    };
+
+    family& family_of(const std::string& name, const char* type, const std::string& help);
+
+    std::map<std::string, family> families_;
+};
+
+/**
+ * 导出时调用的收集函数，用于读取已有的状态（队列深度、连接的字节数），热路径上没有额外开销
+ */
+using metric_collector = std::function<void(metric_writer& writer)>;
+
+class metrics_registry;
+
+/**
+ * 收集函数的注册，析构时注销；注销之后收集函数不会再被调用
+ */
+class metric_registration {
+public:
+    metric_registration() = default;
+    ~metric_registration();
+
+    metric_registration(metric_registration&& other) noexcept;
+    metric_registration& operator=(metric_registration&& other) noexcept;
+
+    metric_registration(const metric_registration&) = delete;
+    metric_registration& operator=(const metric_registration&) = delete;
+
+    void reset();
+
+private:
+    friend class metrics_registry;
+
+    metric_registration(metrics_registry* registry, uint64_t id) : registry_(registry), id_(id) {}
+
+    metrics_registry* registry_ = nullptr;
+    uint64_t id_ = 0;
+};
+
+/**
+ * 指标注册表
+ *
+ * counter/histogram 按名字和标签返回同一个对象，对象与注册表同生命周期，调用方可以保存引用
+ * 在热路径上使用。导出时才读取各个分片并调用收集函数。可以在多个线程中并发使用。
+ */
+class metrics_registry {
+public:
+    metrics_registry() = default;
+    metrics_registry(const metrics_registry&) = delete;
+    metrics_registry& operator=(const metrics_registry&) = delete;
+
+    /**
+     * 进程内默认的注册表，库内部的指标都在这里
+     */
+    static metrics_registry& global();
+
+    metric_counter& counter(const std::string& name, const std::string& help, const metric_labels& labels = {});
+
+    /**
+     * @param scale 导出时把记录的值乘以 scale，例如记录纳秒、导出秒时为 1e-9
+     */
+    metric_histogram& histogram(const std::string& name, const std::string& help, const metric_labels& labels = {},
+                                double scale = 1.0);
+
+    /**
+     * 注册导出时调用的收集函数；收集函数不能注销自己或其他收集函数
+     */
+    metric_registration add_collector(metric_collector collector);
+
+    /**
+     * 全部指标的 Prometheus 文本格式
+     */
+    std::string prometheus() const;
+
+    /**
+     * 写入文件（供 node_exporter 的 textfile collector 读取）：先写临时文件再 rename，
+     * 读取方不会看到写了一半的内容。失败时抛出 std::system_error
+     */
+    void write_prometheus(const std::string& path) const;
+
+private:
+    friend class metric_registration;
+
+    struct counter_entry {
+        std::string name;
+        std::string help;
+        metric_labels labels;
+        std::unique_ptr<metric_counter> counter;
+    };
+
+    struct histogram_entry {
+        std::string name;
+        std::string help;
+        metric_labels labels;
+        double scale;
+        std::unique_ptr<metric_histogram> histogram;
+    };
+
+    void remove_collector(uint64_t id);
+
+    mutable std::mutex mutex_;
+    std::vector<counter_entry> counters_;
+    std::vector<histogram_entry> histograms_;
+
+    // 导出时持有 collectors_mutex_ 调用收集函数，注销会等待正在进行的导出结束，
+    // 之后收集函数引用的对象（例如连接）就可以安全析构
+    mutable std::mutex collectors_mutex_;
+    std::map<uint64_t, metric_collector> collectors_;
+    uint64_t next_collector_ = 1;
+};
+
+/**
+ * ring_buffer 的全局计数器，所有实例共用
+ */
+struct ring_buffer_metrics {
+    metric_counter push_full;    // push/push_n 因为缓冲区满而失败
+    metric_counter get_empty;    // get/get_n 因为缓冲区空而失败
+    metric_counter cas_retries;  // 争抢位置失败后重试的次数
+};
+
+extern ring_buffer_metrics ring_buffer_counters;
@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * 流水线上的区间跟踪，输出 Chrome trace 事件格式（chrome://tracing 和 Perfetto 都能打开）
+ *
+ * 跟踪在运行时通过 trace_start 开启，未开启时 trace_span 只读一次原子标志。每个区间
+ * 记录名字、类别、开始和结束时间以及一个编号；编号相同的区间（例如同一个分块的读取、
+ * 哈希、压缩、发送）在输出时用 flow 事件按时间顺序连起来，可以在时间线上跟着一个分块
+ * 走完整条流水线。事件写入每个线程自己的缓冲区，只在导出时合并。
+ *
+ * 分块的编号用 trace_chunk_id(文件键, 分块偏移) 计算，不依赖数据所在的地址，各个阶段
+ * 各自算出同一个值。文件键是 trace_file_key(文件名)，文件名取流水线各阶段都知道的名字
+ * （例如传输时使用的名字）；分块方式不同的阶段只在偏移相同的分块上相连。
+ *
+ * 编译时没有定义 SYNC_METRICS 时 SYNC_TRACE_SPAN 展开为空。
+ */
+#if defined(SYNC_METRICS)
+#define SYNC_TRACE_CONCAT_INNER(a, b) a##b
+#define SYNC_TRACE_CONCAT(a, b) SYNC_TRACE_CONCAT_INNER(a, b)
+#define SYNC_TRACE_SPAN(name, category, id) trace_span SYNC_TRACE_CONCAT(sync_trace_span_, __LINE__)(name, category, id)
+#else
+#define SYNC_TRACE_SPAN(name, category, id) ((void)sizeof(id))
+#endif
+
+namespace trace_detail {
+extern std::atomic<bool> enabled;
+}
+
+inline bool trace_enabled() {
+    return trace_detail::enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * 文件名的 64 位键（FNV-1a），不会是 0
+ */
+uint64_t trace_file_key(const std::string& name);
+
+/**
+ * 文件 file_key 中从 offset 开始的分块的跟踪编号；file_key 为 0 时返回 0，即不参与 flow 连接
+ */
+inline uint64_t trace_chunk_id(uint64_t file_key, uint64_t offset) {
+    if (file_key == 0) {
+        return 0;
+    }
+    // splitmix64 的混合函数，相邻的偏移和相近的键得到分散的编号
+    uint64_t x = file_key ^ (offset * 0x9e3779b97f4a7c15ull);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    // 查看器按 double 解析 JSON 中的数字，只保留 53 位才不会有两个编号被舍入成同一个
+    x >>= 11;
+    return x == 0 ? 1 : x;
+}
+
+/**
+ * 清空之前的事件并开始记录
+ *
+ * @param max_events_per_thread 每个线程最多保留的事件数，超出的事件丢弃并计数
+ */
+void trace_start(size_t max_events_per_thread = size_t(1) << 20);
+
+/**
+ * 停止记录；已记录的事件保留到下一次 trace_start
+ */
+void trace_stop();
+
+/**
+ * 把已记录的事件写成 Chrome trace JSON（{"traceEvents": [...]}）
+ */
+void trace_write(std::ostream& out);
+
+/**
+ * 写入文件，失败时抛出 std::system_error
+ */
+void trace_write(const std::string& path);
+
+/**
+ * 因为缓冲区满而丢弃的事件数
+ */
+uint64_t trace_dropped();
+
+/**
+ * 记录一个区间：构造时开始，析构时结束
+ *
+ * name 和 category 必须是字符串字面量（或生命周期覆盖整个跟踪的字符串），只保存指针。
+ * id 为 0 表示不参与 flow 连接。
+ */
+class trace_span {
+public:
+    trace_span(const char* name, const char* category, uint64_t id = 0)
+        : name_(name), category_(category), id_(id), begin_ns_(trace_enabled() ? now() : -1) {}
+
+    ~trace_span() {
+        if (begin_ns_ >= 0) {
+            record(name_, category_, id_, begin_ns_, now());
+        }
+    }
+
+    trace_span(const trace_span&) = delete;
+    trace_span& operator=(const trace_span&) = delete;
+
+private:
+    static int64_t now();
+    static void record(const char* name, const char* category, uint64_t id, int64_t begin_ns, int64_t end_ns);
+
+    const char* name_;
+    const char* category_;
+    const uint64_t id_;
+    const int64_t begin_ns_;  // 未开启跟踪时为 -1
+};
@@ -0,0 +1,258 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#include "event_count.h"
+
+/**
+ * 自旋等待时降低流水线与功耗压力的提示指令
+ */
+inline void spin_pause() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+/**
+ * 带阻塞等待的环形缓冲区
+ *
+ * 包装 ring_buffer 或 spsc_ring_buffer，增加 push_wait/get_wait 及带超时的版本。
+ * 等待采用"先自旋、再让出、后休眠"的自适应策略：自旋阶段成功则增加下次的
+ * 自旋预算，最终需要休眠则减少预算；休眠基于 event_count（Linux 上为 futex），
+ * 因此在队列有数据/有空位的快速路径上没有任何系统调用，队列空闲时线程不占用 CPU。
+ *
+ * 非阻塞的 push/get/push_n/get_n 仍然可用，并会在成功后唤醒对侧的等待者。
+ * close() 之后等待不再休眠：get_wait 会继续取完剩余元素，然后返回 false。
+ */
+template <typename buffer_type>
+class blocking_ring_buffer {
+public:
+    using value_type = typename buffer_type::value_type;
+
+private:
+    static constexpr uint32_t min_spin_ = 16;
+    static constexpr uint32_t max_spin_ = 4096;
+    static constexpr uint32_t yield_rounds_ = 4;
+
+    buffer_type buffer_;
+
+    // 缓冲区由空变为非空 / 由满变为非满的事件
+    event_count not_empty_;
+    event_count not_full_;
+
+    std::atomic<bool> closed_{false};
+
+    // 自适应自旋预算，所有等待者共享
+    std::atomic<uint32_t> spin_budget_{256};
+
+    // 只有写入成功时才会移走 value，失败时调用方仍持有原值，可以重试
+    bool try_push(value_type& value) {
+        return buffer_.push_n(std::make_move_iterator(&value), std::make_move_iterator(&value + 1)) == 1;
+    }
+
+    bool try_get(value_type& value) {
+        return buffer_.get_n(&value, 1) == 1;
+    }
+
+    // 先自旋再休眠地重复 op，直到成功、关闭或超时
+    template <typename Op>
+    bool wait_op(Op op, event_count& ec, const std::chrono::steady_clock::time_point* deadline) {
+        // 快速路径：不需要等待时不触碰自旋预算
+        if (op()) {
+            return true;
+        }
+
+        // 单核机器上自旋不可能等到对侧，直接进入让出阶段
+        static const bool single_core = std::thread::hardware_concurrency() <= 1;
+        const uint32_t budget = single_core ? 0 : spin_budget_.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < budget; ++i) {
+            spin_pause();
+            if (op()) {
+                // 自旋等到了，下次允许多自旋一些
+                if (budget < max_spin_) {
+                    spin_budget_.store(budget * 2, std::memory_order_relaxed);
+                }
+                return true;
+            }
+        }
+
+        // 自旋没有等到，下次少花一些CPU
+        if (budget > min_spin_) {
+            spin_budget_.store(budget / 2, std::memory_order_relaxed);
+        }
+
+        // 让出CPU几次：对侧线程可能就在本核上等待调度，这比一次休眠/唤醒便宜得多
+        for (uint32_t i = 0; i < yield_rounds_; ++i) {
+            std::this_thread::yield();
+            if (op()) {
+                return true;
+            }
+        }
+
+        for (;;) {
+            uint32_t key = ec.prepare_wait();
+            if (op()) {
+                ec.cancel_wait();
+                return true;
+            }
+            if (closed_.load(std::memory_order_acquire)) {
+                ec.cancel_wait();
+                return false;
+            }
+            if (deadline == nullptr) {
+                ec.wait(key);
+            } else if (!ec.wait_until(key, *deadline)) {
+                // 超时前最后再试一次
+                return op();
+            }
+        }
+    }
+
+public:
+
+    blocking_ring_buffer() = default;
+
+    /**
+     * 转发构造参数，例如 dynamic_capacity 缓冲区的容量与分配选项
+     */
+    template <typename... Args>
+    explicit blocking_ring_buffer(Args&&... args) : buffer_(std::forward<Args>(args)...) {}
+
+    ~blocking_ring_buffer() {}
+
+    bool push(value_type value) {
+        if (!try_push(value)) {
+            return false;
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    bool get(value_type& value) {
+        if (!try_get(value)) {
+            return false;
+        }
+        not_full_.notify_one();
+        return true;
+    }
+
+    template <typename ForwardIt>
+    size_t push_n(ForwardIt first, ForwardIt last) {
+        size_t count = buffer_.push_n(first, last);
+        if (count == 1) {
+            not_empty_.notify_one();
+        } else if (count > 1) {
+            not_empty_.notify_all();
+        }
+        return count;
+    }
+
+    template <typename OutputIt>
+    size_t get_n(OutputIt out, size_t max) {
+        size_t count = buffer_.get_n(out, max);
+        if (count == 1) {
+            not_full_.notify_one();
+        } else if (count > 1) {
+            not_full_.notify_all();
+        }
+        return count;
+    }
+
+    /**
+     * 写入元素，缓冲区满时等待空位
+     *
+     * @return 写入成功返回 true；缓冲区已关闭且仍然满时返回 false
+     */
+    bool push_wait(value_type value) {
+        if (!wait_op([&] { return try_push(value); }, not_full_, nullptr)) {
+            return false;
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /**
+     * 读取元素，缓冲区空时等待数据
+     *
+     * @return 读取成功返回 true；缓冲区已关闭且已取空时返回 false
+     */
+    bool get_wait(value_type& value) {
+        if (!wait_op([&] { return try_get(value); }, not_empty_, nullptr)) {
+            return false;
+        }
+        not_full_.notify_one();
+        return true;
+    }
+
+    /**
+     * 带超时的 push_wait
+     *
+     * @return 超时、或缓冲区已关闭且仍然满时返回 false
+     */
+    template <typename Rep, typename Period>
+    bool push_wait_for(value_type value, const std::chrono::duration<Rep, Period>& timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        if (!wait_op([&] { return try_push(value); }, not_full_, &deadline)) {
+            return false;
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /**
+     * 带超时的 get_wait
+     *
+     * @return 超时、或缓冲区已关闭且已取空时返回 false
+     */
+    template <typename Rep, typename Period>
+    bool get_wait_for(value_type& value, const std::chrono::duration<Rep, Period>& timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        if (!wait_op([&] { return try_get(value); }, not_empty_, &deadline)) {
+            return false;
+        }
+        not_full_.notify_one();
+        return true;
+    }
+
+    /**
+     * 关闭缓冲区，唤醒所有等待者
+     */
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    bool closed() const {
+        return closed_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * 获取缓冲区容量
+     *
+     * @return 缓冲区容量
+     */
+    constexpr size_t capacity() const {
+        return buffer_.capacity();
+    }
+
+    /**
+     * 近似的元素数量，只用于统计和流量控制等启发式判断
+     */
+    size_t size_approx() const {
+        return buffer_.size_approx();
+    }
+};
@@ -0,0 +1,159 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+/**
+ * 事件计数器（eventcount）
+ *
+ * 为无锁结构提供"条件不满足时休眠"的能力，而不给快速路径增加系统调用：
+ *
+ *     uint32_t key = ec.prepare_wait();
+ *     if (条件已满足) { ec.cancel_wait(); ... }
+ *     else ec.wait(key);
+ *
+ * 通知方在改变条件后调用 notify_one/notify_all，只有当确实存在等待者时才会
+ * 推进纪元并唤醒（Linux 上为 futex，其他平台退化为互斥锁+条件变量）。
+ * prepare_wait 中的等待者登记与 notify 中的 seq_cst 屏障构成 Dekker 式配对，
+ * 保证等待者要么看到条件变化，要么被唤醒，不会丢失通知。
+ */
+class event_count {
+private:
+    // 纪元，每次有等待者时的通知都会推进它；futex 直接等待在这个字上
+    alignas(64) std::atomic<uint32_t> epoch_{0};
+
+    // 已登记（prepare_wait 之后、wait/cancel_wait 之前）的等待者数量
+    std::atomic<uint32_t> waiters_{0};
+
+#if !defined(__linux__)
+    std::mutex mutex_;
+    std::condition_variable cv_;
+#endif
+
+    void wake(int count) {
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+        // 通知前先获取锁：等待者要么在检查纪元时已看到新值，要么已经进入休眠
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count == 1) {
+            cv_.notify_one();
+        } else {
+            cv_.notify_all();
+        }
+#endif
+    }
+
+    bool notify(int count) {
+        // 与 prepare_wait 中的登记配对：条件的修改必须在读取等待者数量之前全局可见
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        epoch_.fetch_add(1, std::memory_order_release);
+        wake(count);
+        return true;
+    }
+
+public:
+
+    event_count() = default;
+
+    event_count(const event_count&) = delete;
+    event_count& operator=(const event_count&) = delete;
+
+    /**
+     * 登记为等待者
+     *
+     * @return 当前纪元，传给 wait/wait_until；纪元变化说明期间有过通知
+     */
+    uint32_t prepare_wait() {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_seq_cst);
+    }
+
+    /**
+     * 登记之后发现条件已经满足，放弃等待
+     */
+    void cancel_wait() {
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * 休眠直到纪元不再等于 key
+     */
+    void wait(uint32_t key) {
+#if defined(__linux__)
+        while (epoch_.load(std::memory_order_acquire) == key) {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+        }
+#else
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&] { return epoch_.load(std::memory_order_acquire) != key; });
+#endif
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * 休眠直到纪元不再等于 key 或超过截止时间
+     *
+     * @return 被通知返回 true，超时返回 false
+     */
+    template <typename Clock, typename Duration>
+    bool wait_until(uint32_t key, const std::chrono::time_point<Clock, Duration>& deadline) {
+        bool notified = true;
+#if defined(__linux__)
+        while (epoch_.load(std::memory_order_acquire) == key) {
+            auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now());
+            if (remaining.count() <= 0) {
+                notified = false;
+                break;
+            }
+            struct timespec ts;
+            ts.tv_sec = static_cast<time_t>(remaining.count() / 1000000000);
+            ts.tv_nsec = static_cast<long>(remaining.count() % 1000000000);
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, key, &ts, nullptr, 0);
+        }
+#else
+        std::unique_lock<std::mutex> lock(mutex_);
+        notified = cv_.wait_until(lock, deadline, [&] { return epoch_.load(std::memory_order_acquire) != key; });
+#endif
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+        return notified;
+    }
+
+    /**
+     * 当前是否有已登记的等待者，只作为启发式判断
+     */
+    bool has_waiters() const {
+        return waiters_.load(std::memory_order_relaxed) != 0;
+    }
+
+    /**
+     * 唤醒一个等待者；没有等待者时只有一次屏障和一次读取
+     *
+     * @return 是否存在等待者（调用方可据此把通知转给其他等待点）
+     */
+    bool notify_one() {
+        return notify(1);
+    }
+
+    /**
+     * 唤醒所有等待者
+     *
+     * @return 是否存在等待者
+     */
+    bool notify_all() {
+        return notify(INT32_MAX);
+    }
+};
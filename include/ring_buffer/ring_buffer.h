@@ -1,135 +1,534 @@
 #pragma once
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
 
-template <typename store_type, uint32_t size>
+#include "ring_buffer_storage.h"
+
+/**
+ * 满/空/CAS 重试计数，只在定义 SYNC_RING_BUFFER_METRICS（CMake 选项
+ * SYNC_ENABLE_RING_BUFFER_METRICS）时编译，默认情况下争抢位置的路径上没有任何插桩，
+ * 头文件也不依赖 metrics 库。
+ */
+#if defined(SYNC_RING_BUFFER_METRICS)
+#include "../metrics/metrics.h"
+#define SYNC_RING_BUFFER_COUNT(counter) SYNC_METRIC_ADD(ring_buffer_counters.counter, 1)
+#else
+#define SYNC_RING_BUFFER_COUNT(counter) ((void)0)
+#endif
+
+/**
+ * 内存序策略
+ *
+ * seq_cst_order 保留最初的全序语义，每次交接都是一次完整屏障；
+ * acq_rel_order 为 Vyukov 有界 MPMC 队列的标准内存序：单元格序列号以
+ * acquire/release 配对发布数据，位置计数器上的 CAS 只负责争抢，使用 relaxed。
+ */
+struct seq_cst_order {
+    static constexpr std::memory_order position_load = std::memory_order_relaxed;
+    static constexpr std::memory_order position_cas = std::memory_order_seq_cst;
+    static constexpr std::memory_order position_reload = std::memory_order_seq_cst;
+    static constexpr std::memory_order sequence_load = std::memory_order_seq_cst;
+    static constexpr std::memory_order sequence_store = std::memory_order_seq_cst;
+};
+
+struct acq_rel_order {
+    static constexpr std::memory_order position_load = std::memory_order_relaxed;
+    static constexpr std::memory_order position_cas = std::memory_order_relaxed;
+    static constexpr std::memory_order position_reload = std::memory_order_relaxed;
+    static constexpr std::memory_order sequence_load = std::memory_order_acquire;
+    static constexpr std::memory_order sequence_store = std::memory_order_release;
+};
+
+/**
+ * 单元格布局策略
+ *
+ * packed_layout 单元格紧密排列（默认），内存占用最少，但相邻位置共享缓存行，
+ * MPMC 高负载下相邻的生产者/消费者会反复使同一缓存行失效；
+ * padded_layout 每个单元格按缓存行对齐，消除相邻单元格间的伪共享，代价是内存放大；
+ * scrambled_layout 单元格仍紧密排列，但把连续位置映射到不同的缓存行，
+ * 不增加内存，同一缓存行上的单元格彼此相隔 容量/每行单元格数 个位置。
+ */
+struct packed_layout {
+    static constexpr size_t cell_alignment = 1;
+    static constexpr bool scramble = false;
+};
+
+struct padded_layout {
+    static constexpr size_t cell_alignment = 64;
+    static constexpr bool scramble = false;
+};
+
+struct scrambled_layout {
+    static constexpr size_t cell_alignment = 1;
+    static constexpr bool scramble = true;
+};
+
+/**
+ * 有界多生产者多消费者环形缓冲区（Vyukov 算法）
+ *
+ * size 为编译期容量，单元格内联在对象中；size 为 dynamic_capacity 时容量在构造时
+ * 指定，单元格从堆（可选大页）中分配，适合按连接配置大小的大缓冲区。
+ */
+template <typename store_type, uint32_t size, typename order = acq_rel_order, typename layout = packed_layout>
 class ring_buffer {
 private:
-    static_assert((size >= 2) && ((size & (size - 1)) == 0),
-                  "Size must be a power of 2 and at least 2");
-    struct Cell {
+    static constexpr size_t cell_alignment_ =
+        std::max(layout::cell_alignment, std::max(alignof(std::atomic<uint32_t>), alignof(store_type)));
+
+    // 元素存放在未初始化的对齐存储中：入队时就地构造，出队时析构，
+    // 因此 store_type 不需要默认构造，也可以是只能移动的类型
+    struct alignas(cell_alignment_) Cell {
         std::atomic<uint32_t> sequence;
-        store_type data;
+        alignas(store_type) unsigned char storage[sizeof(store_type)];
+
+        store_type* data() {
+            return std::launder(reinterpret_cast<store_type*>(storage));
+        }
     };
-    Cell buffer_[size];
+    ring_storage<Cell, size> buffer_;
 
+    const uint32_t capacity_ = size;
     const uint32_t mask_ = size - 1;
 
-    // 入队位置，使用alignas避免伪共享
-    alignas(64) std::atomic<uint32_t> enqueue_pos_{0};
+    // scrambled_layout 的索引映射参数：每行单元格数为 2^line_shift_，共 2^lines_shift_ 行
+    const uint32_t line_shift_ = scramble_line_shift(capacity_);
+    const uint32_t lines_shift_ = log2(capacity_) - line_shift_;
+    const uint32_t line_mask_ = (1u << lines_shift_) - 1;
 
-    // 出队位置，使用alignas避免伪共享
-    alignas(64) std::atomic<uint32_t> dequeue_pos_{0};
+    static uint32_t log2(uint32_t value) {
+        uint32_t bits = 0;
+        while ((1u << (bits + 1)) <= value && bits < 31) {
+            ++bits;
+        }
+        return bits;
+    }
 
-public:
+    // 每个缓存行容纳的单元格数（取2的幂），至少保留两行，否则映射退化为恒等映射
+    static uint32_t scramble_line_shift(uint32_t capacity) {
+        if (!layout::scramble || sizeof(Cell) >= 64) {
+            return 0;
+        }
+        const uint32_t shift = log2(static_cast<uint32_t>(64 / sizeof(Cell)));
+        const uint32_t max_shift = log2(capacity) - 1;
+        return shift < max_shift ? shift : max_shift;
+    }
 
-    ring_buffer() {
-        for (uint32_t i = 0; i < size; ++i) {
-            buffer_[i].sequence.store(i, std::memory_order_relaxed);
+    Cell* cell_at(uint32_t pos) {
+        uint32_t index = pos & mask_;
+        if (layout::scramble) {
+            // 位置 q * 行数 + r 映射到第 r 行的第 q 个单元格，连续位置落在不同的缓存行
+            index = ((index & line_mask_) << line_shift_) | (index >> lines_shift_);
         }
+        return &buffer_.cells()[index];
     }
 
-    ~ring_buffer() {}
+    void init_sequences() {
+        for (uint32_t i = 0; i < capacity_; ++i) {
+            cell_at(i)->sequence.store(i, std::memory_order_relaxed);
+        }
+    }
 
-    bool push(store_type value) {
-        Cell* cell;
-        uint32_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    // 把消费者争抢到的 [pos + next, pos + end) 中的单元格析构并交还给生产者；
+    // 析构时处理剩下的单元格，出队过程中抛出异常时也不会有单元格停留在已占有状态
+    struct release_cells {
+        ring_buffer& owner;
+        uint32_t pos;
+        uint32_t next;
+        uint32_t end;
+
+        void release_one() {
+            Cell* cell = owner.cell_at(pos + next);
+            cell->data()->~store_type();
+            // 将单元格交还给下一轮的生产者
+            cell->sequence.store(pos + next + owner.capacity_, order::sequence_store);
+            ++next;
+        }
+
+        ~release_cells() {
+            while (next < end) {
+                release_one();
+            }
+        }
+    };
+
+    // 入队位置，使用alignas避免伪共享
+    alignas(64) std::atomic<uint32_t> enqueue_pos_{0};
+
+    // 出队位置，使用alignas避免伪共享
+    alignas(64) std::atomic<uint32_t> dequeue_pos_{0};
+
+    /**
+     * 在位置计数器上争抢最多 max 个连续的单元格
+     *
+     * offset 为 0 时争抢可写入的单元格（序列号等于位置），
+     * 为 1 时争抢可读取的单元格（序列号等于位置+1）。
+     *
+     * @return 争抢到的单元格数量，起始位置通过 pos 返回；缓冲区满/空时返回 0
+     */
+    uint32_t claim(std::atomic<uint32_t>& position, uint32_t offset, uint32_t max, uint32_t& pos) {
+        pos = position.load(order::position_load);
 
         for (;;) {
-            // 计算单元格索引并获取单元格
-            cell = &buffer_[pos & mask_];
-
-            // 获取单元格的序列号，使用seq_cst确保看到最新值
-            uint32_t seq = cell->sequence.load(std::memory_order_seq_cst);
-
-            // 计算序列号与位置的差值
-            // 使用有符号整数差值，处理序列号回绕
-            int32_t diff = static_cast<int32_t>(seq - pos);
-
-            // 如果序列号等于位置，说明单元格可写入
-            if (diff == 0) {
-                // 尝试原子地更新入队位置
-                // 这确保了在多生产者环境中，每个位置只能被一个生产者写入
-                if (enqueue_pos_.compare_exchange_strong(  // 使用strong版本减少伪失败
-                        pos, pos + 1,
-                        std::memory_order_seq_cst)) {  // 使用seq_cst确保全局内存顺序
-                    break;  // 成功获取写入权限
+            // 统计从pos开始连续就绪的单元格数量
+            uint32_t count = 0;
+            int32_t diff = 0;
+            while (count < max) {
+                // 获取单元格的序列号，与发布方的release配对
+                uint32_t seq = cell_at(pos + count)->sequence.load(order::sequence_load);
+
+                // 计算序列号与期望值的差值
+                // 使用有符号整数差值，处理序列号回绕
+                diff = static_cast<int32_t>(seq - (pos + count + offset));
+                if (diff != 0) {
+                    break;
                 }
+                ++count;
             }
-            // 如果序列号小于位置，说明缓冲区已满
+
+            // 至少有一个单元格就绪
+            if (count > 0) {
+                // 尝试原子地推进位置，一次CAS占有整段单元格
+                // 这确保了在多生产者/多消费者环境中，每个位置只能被一个线程占有
+                if (position.compare_exchange_strong(  // 使用strong版本减少伪失败
+                        pos, pos + count,
+                        order::position_cas)) {  // 数据的可见性由序列号保证，CAS只负责争抢位置
+                    return count;  // 成功获取访问权限
+                }
+                SYNC_RING_BUFFER_COUNT(cas_retries);
+            }
+            // 如果序列号小于期望值，说明缓冲区已满（生产者）或为空（消费者）
             else if (diff < 0) {
-                return false;
+                if (offset == 0) {
+                    SYNC_RING_BUFFER_COUNT(push_full);
+                } else {
+                    SYNC_RING_BUFFER_COUNT(get_empty);
+                }
+                return 0;
             }
-            // 如果序列号大于位置，说明有其他生产者已经更新了入队位置
+            // 如果序列号大于期望值，说明有其他线程已经推进了位置
             else {
-                pos = enqueue_pos_.load(std::memory_order_seq_cst);  // 使用seq_cst确保看到最新值
+                SYNC_RING_BUFFER_COUNT(cas_retries);
+                pos = position.load(order::position_reload);
             }
         }
+    }
 
-      
-   
-        // 写入数据
-        cell->data = std::move(value);
-
+public:
+    using value_type = store_type;
 
-        cell->sequence.store(pos + 1, std::memory_order_seq_cst);
+    ring_buffer() {
+        static_assert(size != dynamic_capacity, "A dynamic_capacity ring_buffer needs a capacity");
+        init_sequences();
+    }
 
-        return true;
+    /**
+     * 构造容量在运行时指定的缓冲区（size 必须为 dynamic_capacity）
+     *
+     * capacity 必须是不小于2的2的幂，否则抛出 std::invalid_argument。
+     */
+    explicit ring_buffer(uint32_t capacity, const ring_buffer_options& options = ring_buffer_options())
+        : buffer_(capacity, options), capacity_(capacity), mask_(capacity - 1) {
+        static_assert(size == dynamic_capacity, "Only a dynamic_capacity ring_buffer takes a capacity");
+        init_sequences();
     }
-    bool get(store_type& value) {
-        Cell* cell;
-        uint32_t pos = dequeue_pos_.load(std::memory_order_relaxed);
 
-        for (;;) {
-            // 计算单元格索引并获取单元格
-            cell = &buffer_[pos & mask_];
-
-            // 获取单元格的序列号，使用seq_cst确保看到最新值
-            uint32_t seq = cell->sequence.load(std::memory_order_seq_cst);
-
-            // 计算序列号与位置+1的差值
-            // 使用有符号整数差值，处理序列号回绕
-            int32_t diff = static_cast<int32_t>(seq - (pos + 1));
-
-            // 如果序列号等于位置+1，说明单元格可读取
-            if (diff == 0) {
-                // 尝试原子地更新出队位置
-                // 这确保了在多消费者环境中，每个值只能被一个消费者读取
-                if (dequeue_pos_.compare_exchange_strong(  // 使用strong版本减少伪失败
-                        pos, pos + 1,
-                        std::memory_order_seq_cst)) {  // 使用seq_cst确保全局内存顺序
-                    break;  // 成功获取读取权限
+    /**
+     * 析构仍留在缓冲区中的元素
+     *
+     * 调用时不能再有其他线程访问缓冲区。
+     */
+    ~ring_buffer() {
+        if (!std::is_trivially_destructible<store_type>::value) {
+            const uint32_t end = enqueue_pos_.load(std::memory_order_acquire);
+            for (uint32_t pos = dequeue_pos_.load(std::memory_order_acquire); pos != end; ++pos) {
+                Cell* cell = cell_at(pos);
+                if (cell->sequence.load(std::memory_order_acquire) == pos + 1) {
+                    cell->data()->~store_type();
                 }
             }
-            // 如果序列号小于位置+1，说明缓冲区为空
-            else if (diff < 0) {
+        }
+    }
+
+    bool push(store_type value) {
+        return emplace(std::move(value));
+    }
+
+    /**
+     * 直接在单元格中构造元素
+     *
+     * 占有的单元格必须发布，否则后续的消费者会一直停在这个位置上，因此占有之后不能
+     * 抛出异常：构造可能抛出异常时，先在单元格之外构造，占有之后再移动进去
+     * （要求 store_type 的移动构造不抛出异常），异常在占有之前抛出，缓冲区不受影响。
+     *
+     * @return 缓冲区已满时返回 false，此时元素不会进入缓冲区
+     */
+    template <typename... Args>
+    bool emplace(Args&&... args) {
+        if constexpr (!std::is_nothrow_constructible<store_type, Args&&...>::value) {
+            static_assert(std::is_nothrow_move_constructible<store_type>::value,
+                          "ring_buffer elements must be nothrow move constructible");
+            store_type value(std::forward<Args>(args)...);
+            return emplace(std::move(value));
+        } else {
+            uint32_t pos;
+            if (claim(enqueue_pos_, 0, 1, pos) == 0) {
                 return false;
             }
-            // 如果序列号大于位置+1，说明有其他消费者已经更新了出队位置
-            else {
-                pos = dequeue_pos_.load(std::memory_order_seq_cst);  // 使用seq_cst确保看到最新值
+            Cell* cell = cell_at(pos);
+
+            // 写入数据
+            ::new (static_cast<void*>(cell->storage)) store_type(std::forward<Args>(args)...);
+
+            // 发布数据，消费者以acquire读到该序列号后即可看到写入的内容
+            cell->sequence.store(pos + 1, order::sequence_store);
+
+            return true;
+        }
+    }
+
+    /**
+     * 取出一个元素
+     *
+     * 移动赋值抛出异常时该元素被丢弃，单元格照常交还给生产者后再把异常抛给调用方。
+     *
+     * @return 缓冲区为空时返回 false
+     */
+    bool get(store_type& value) {
+        uint32_t pos;
+        if (claim(dequeue_pos_, 1, 1, pos) == 0) {
+            return false;
+        }
+
+        // CAS成功后该单元格归当前消费者独占，在重新发布之前其他线程不会修改它
+        // 读取数据；析构元素并交还单元格由 release_cells 完成，赋值抛出异常时也不例外
+        release_cells release{*this, pos, 0, 1};
+        value = std::move(*cell_at(pos)->data());
+        return true;
+    }
+
+    /**
+     * 批量写入 [first, last) 中的元素
+     *
+     * 只用一次 CAS 争抢一段连续的单元格，然后逐个填充并发布。
+     * 可能只写入一部分（缓冲区剩余空间不足时），调用方应根据返回值
+     * 从第一个未写入的元素继续。
+     *
+     * 从 *first 构造可能抛出异常时（例如拷贝 std::string）退化为逐个 emplace：
+     * 整段占有之后中途抛出异常会留下永远不发布的单元格。此时异常之前的元素已经写入。
+     *
+     * @return 实际写入的元素数量，缓冲区已满时为 0
+     */
+    template <typename ForwardIt>
+    size_t push_n(ForwardIt first, ForwardIt last) {
+        using reference = typename std::iterator_traits<ForwardIt>::reference;
+        if constexpr (!std::is_nothrow_constructible<store_type, reference>::value) {
+            size_t count = 0;
+            for (; first != last && emplace(*first); ++first) {
+                ++count;
+            }
+            return count;
+        } else {
+            const auto wanted = std::distance(first, last);
+            if (wanted <= 0) {
+                return 0;
+            }
+            uint32_t pos;
+            const uint32_t max =
+                wanted < static_cast<decltype(wanted)>(capacity_) ? static_cast<uint32_t>(wanted) : capacity_;
+            const uint32_t count = claim(enqueue_pos_, 0, max, pos);
+
+            for (uint32_t i = 0; i < count; ++i, ++first) {
+                Cell* cell = cell_at((pos + i));
+                ::new (static_cast<void*>(cell->storage)) store_type(*first);
+                cell->sequence.store(pos + i + 1, order::sequence_store);
             }
+            return count;
+        }
+    }
+
+    /**
+     * 批量读取最多 max 个元素写入 out
+     *
+     * 只用一次 CAS 争抢一段连续的已发布单元格，然后逐个取出并交还给生产者。
+     * 写入 out 时抛出异常（例如 back_inserter 的 push_back 抛出 bad_alloc）时，
+     * 已争抢到但还没有取出的元素被丢弃，所有单元格照常交还后再抛出异常。
+     *
+     * @return 实际读取的元素数量，缓冲区为空时为 0
+     */
+    template <typename OutputIt>
+    size_t get_n(OutputIt out, size_t max) {
+        if (max == 0) {
+            return 0;
+        }
+        uint32_t pos;
+        const uint32_t count = claim(dequeue_pos_, 1, max < capacity_ ? static_cast<uint32_t>(max) : capacity_, pos);
+
+        release_cells release{*this, pos, 0, count};
+        for (; release.next < count; ++out) {
+            *out = std::move(*cell_at(pos + release.next)->data());
+            release.release_one();
         }
+        return count;
+    }
 
+    /**
+     * 生产者槽位句柄
+     *
+     * 由 try_reserve 返回，生产者直接在槽位中就地填充数据，然后 commit 发布。
+     * 句柄只能移动不能拷贝；未显式提交的句柄在析构时自动提交，
+     * 因为已占有的位置必须发布，否则后续的消费者会一直停在这个位置上。
+     */
+    class write_slot {
+    private:
+        friend class ring_buffer;
+        Cell* cell_ = nullptr;
+        uint32_t pos_ = 0;
 
+        write_slot(Cell* cell, uint32_t pos) : cell_(cell), pos_(pos) {}
 
-        // 再次检查序列号，确保没有其他线程修改了单元格状态
-        uint32_t seq_check = cell->sequence.load(std::memory_order_seq_cst);
-        if (seq_check != pos + 1) {
-            uint32_t expected = pos + 1;
-            dequeue_pos_.compare_exchange_strong(expected, pos, std::memory_order_seq_cst);
-            return false;
+    public:
+        write_slot() = default;
+        write_slot(write_slot&& other) noexcept : cell_(other.cell_), pos_(other.pos_) {
+            other.cell_ = nullptr;
         }
+        write_slot& operator=(write_slot&& other) noexcept {
+            if (this != &other) {
+                if (cell_) {
+                    commit();
+                }
+                cell_ = other.cell_;
+                pos_ = other.pos_;
+                other.cell_ = nullptr;
+            }
+            return *this;
+        }
+        write_slot(const write_slot&) = delete;
+        write_slot& operator=(const write_slot&) = delete;
 
-        // 读取数据
-        value = std::move(cell->data);
+        ~write_slot() {
+            if (cell_) {
+                commit();
+            }
+        }
 
+        explicit operator bool() const { return cell_ != nullptr; }
+        store_type& operator*() const { return *cell_->data(); }
+        store_type* operator->() const { return cell_->data(); }
+        store_type* data() const { return cell_->data(); }
 
-        cell->sequence.store(pos + size, std::memory_order_seq_cst);
+        /**
+         * 发布槽位中的数据，之后句柄失效
+         */
+        void commit() {
+            cell_->sequence.store(pos_ + 1, order::sequence_store);
+            cell_ = nullptr;
+        }
+    };
 
-        return true;
+    /**
+     * 消费者槽位句柄
+     *
+     * 由 try_peek 返回，消费者直接读取（或就地处理）槽位中的数据，然后 release
+     * 将槽位交还给生产者。未显式释放的句柄在析构时自动释放。
+     */
+    class read_slot {
+    private:
+        friend class ring_buffer;
+        Cell* cell_ = nullptr;
+        uint32_t next_ = 0;  // 释放时写入的序列号：位置+容量
+
+        read_slot(Cell* cell, uint32_t next) : cell_(cell), next_(next) {}
+
+    public:
+        read_slot() = default;
+        read_slot(read_slot&& other) noexcept : cell_(other.cell_), next_(other.next_) {
+            other.cell_ = nullptr;
+        }
+        read_slot& operator=(read_slot&& other) noexcept {
+            if (this != &other) {
+                if (cell_) {
+                    release();
+                }
+                cell_ = other.cell_;
+                next_ = other.next_;
+                other.cell_ = nullptr;
+            }
+            return *this;
+        }
+        read_slot(const read_slot&) = delete;
+        read_slot& operator=(const read_slot&) = delete;
+
+        ~read_slot() {
+            if (cell_) {
+                release();
+            }
+        }
+
+        explicit operator bool() const { return cell_ != nullptr; }
+        store_type& operator*() const { return *cell_->data(); }
+        store_type* operator->() const { return cell_->data(); }
+        store_type* data() const { return cell_->data(); }
+
+        /**
+         * 析构槽位中的元素并将槽位交还给下一轮的生产者，之后句柄失效
+         */
+        void release() {
+            cell_->data()->~store_type();
+            cell_->sequence.store(next_, order::sequence_store);
+            cell_ = nullptr;
+        }
+    };
+
+    /**
+     * 占有一个可写入的槽位，不拷贝/移动任何数据
+     *
+     * 槽位中的元素已就地默认初始化（平凡类型不会被清零），生产者直接填充即可。
+     * 与 emplace 一样，默认构造可能抛出异常时先在单元格之外构造，占有之后再移动进去。
+     *
+     * @return 槽位句柄，缓冲区已满时为空句柄
+     */
+    write_slot try_reserve() {
+        if constexpr (!std::is_nothrow_default_constructible<store_type>::value) {
+            static_assert(std::is_nothrow_move_constructible<store_type>::value,
+                          "ring_buffer elements must be nothrow move constructible");
+            store_type value;
+            uint32_t pos;
+            if (claim(enqueue_pos_, 0, 1, pos) == 0) {
+                return write_slot();
+            }
+            Cell* cell = cell_at(pos);
+            ::new (static_cast<void*>(cell->storage)) store_type(std::move(value));
+            return write_slot(cell, pos);
+        } else {
+            uint32_t pos;
+            if (claim(enqueue_pos_, 0, 1, pos) == 0) {
+                return write_slot();
+            }
+            Cell* cell = cell_at(pos);
+            ::new (static_cast<void*>(cell->storage)) store_type;
+            return write_slot(cell, pos);
+        }
+    }
+
+    /**
+     * 占有一个已发布的槽位，不拷贝/移动任何数据
+     *
+     * @return 槽位句柄，缓冲区为空时为空句柄
+     */
+    read_slot try_peek() {
+        uint32_t pos;
+        if (claim(dequeue_pos_, 1, 1, pos) == 0) {
+            return read_slot();
+        }
+        return read_slot(cell_at(pos), pos + capacity_);
     }
 
     /**
@@ -138,7 +537,31 @@ public:
      * @return 缓冲区容量
      */
     constexpr size_t capacity() const {
-        return size;
+        return capacity_;
+    }
+
+    /**
+     * 近似的元素数量（包括已被占有、尚未提交的单元格），只用于统计和流量控制等启发式判断
+     */
+    size_t size_approx() const {
+        const uint32_t dequeue = dequeue_pos_.load(std::memory_order_relaxed);
+        const uint32_t enqueue = enqueue_pos_.load(std::memory_order_relaxed);
+        const uint32_t used = enqueue - dequeue;
+        return used > capacity_ ? 0 : used;
+    }
+
+    /**
+     * 存储是否确实使用了大页
+     */
+    bool huge_pages() const {
+        return buffer_.huge_pages();
+    }
+
+    /**
+     * 存储是否已设置 NUMA 节点偏好
+     */
+    bool numa_bound() const {
+        return buffer_.numa_bound();
     }
 
 
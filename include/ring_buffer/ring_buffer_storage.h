@@ -0,0 +1,242 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+#if defined(__APPLE__)
+#include <mach/vm_statistics.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * 容量在运行时指定的环形缓冲区使用的容量模板参数
+ *
+ *     ring_buffer<chunk_desc, dynamic_capacity> rb(config.buffer_entries);
+ */
+constexpr uint32_t dynamic_capacity = 0;
+
+/**
+ * 运行时容量缓冲区的分配选项
+ */
+struct ring_buffer_options {
+    // 尝试使用大页（Linux MAP_HUGETLB / 透明大页，macOS superpage）减少TLB缺失，
+    // 失败时退化为普通页，不影响功能
+    bool huge_pages = false;
+
+    // 优先从该 NUMA 节点分配内存（Linux mbind），通常是消费该缓冲区的工作线程所在的节点；
+    // -1 表示不指定，由内核按首次访问决定；其他平台忽略
+    int numa_node = -1;
+};
+
+namespace ring_buffer_detail {
+
+constexpr size_t cache_line_size = 64;
+constexpr size_t huge_page_size = 2 * 1024 * 1024;
+constexpr size_t small_page_size = 4096;
+
+/**
+ * 一段为缓冲区分配的内存，记录释放时需要的信息
+ */
+struct memory_region {
+    void* base = nullptr;
+    size_t bytes = 0;
+    size_t alignment = cache_line_size;
+    bool mapped = false;      // 来自 mmap，需要 munmap 释放
+    bool huge_pages = false;  // 确实使用了大页（或已建议内核使用透明大页）
+    bool numa_bound = false;  // 已设置 NUMA 节点偏好
+};
+
+inline bool is_valid_capacity(uint32_t capacity) {
+    return capacity >= 2 && (capacity & (capacity - 1)) == 0;
+}
+
+/**
+ * 将映射区域设置为优先从指定 NUMA 节点分配物理页
+ *
+ * 使用 MPOL_PREFERRED：节点内存不足时仍可从其他节点分配，不会因此失败。
+ * 直接调用系统调用，不依赖 libnuma。
+ */
+inline bool bind_to_node(void* base, size_t bytes, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    constexpr int mpol_preferred = 1;
+    constexpr int max_nodes = 1024;
+    if (node < 0 || node >= max_nodes) {
+        return false;
+    }
+    unsigned long mask[max_nodes / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    return syscall(SYS_mbind, base, bytes, mpol_preferred, mask, max_nodes + 1, 0) == 0;
+#else
+    (void)base;
+    (void)bytes;
+    (void)node;
+    return false;
+#endif
+}
+
+/**
+ * 分配至少 bytes 字节、按 alignment 对齐的内存
+ *
+ * 请求大页时按 2MB 取整后映射；指定 NUMA 节点时按页取整后映射并设置节点偏好
+ * （必须在首次访问之前设置）；否则使用对齐的 operator new。
+ * 分配失败时抛出 std::bad_alloc。
+ */
+inline memory_region allocate(size_t bytes, size_t alignment, const ring_buffer_options& options) {
+    memory_region region;
+    region.alignment = alignment < cache_line_size ? cache_line_size : alignment;
+
+#if defined(__linux__) || defined(__APPLE__)
+    const bool want_huge = options.huge_pages && region.alignment <= huge_page_size;
+#if defined(__linux__)
+    const bool want_node = options.numa_node >= 0 && region.alignment <= small_page_size;
+#else
+    const bool want_node = false;
+#endif
+    if (want_huge || want_node) {
+        const size_t page = want_huge ? huge_page_size : small_page_size;
+        const size_t rounded = (bytes + page - 1) & ~(page - 1);
+        void* base = MAP_FAILED;
+#if defined(__linux__)
+        // 优先使用预留的大页，没有预留时退化为普通映射并建议内核使用透明大页
+        if (want_huge) {
+            base = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (base != MAP_FAILED) {
+                region.huge_pages = true;
+            }
+        }
+        if (base == MAP_FAILED) {
+            base = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (want_huge && base != MAP_FAILED && madvise(base, rounded, MADV_HUGEPAGE) == 0) {
+                region.huge_pages = true;
+            }
+        }
+        if (want_node && base != MAP_FAILED) {
+            region.numa_bound = bind_to_node(base, rounded, options.numa_node);
+        }
+#else
+        // macOS 通过文件描述符参数请求 2MB superpage
+        base = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+        if (base != MAP_FAILED) {
+            region.huge_pages = true;
+        } else {
+            base = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        }
+#endif
+        if (base == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        region.base = base;
+        region.bytes = rounded;
+        region.mapped = true;
+        return region;
+    }
+#else
+    (void)options;
+#endif
+
+    region.base = ::operator new(bytes, std::align_val_t(region.alignment));
+    region.bytes = bytes;
+    return region;
+}
+
+inline void deallocate(memory_region& region) {
+    if (region.base == nullptr) {
+        return;
+    }
+#if defined(__linux__) || defined(__APPLE__)
+    if (region.mapped) {
+        munmap(region.base, region.bytes);
+        region.base = nullptr;
+        return;
+    }
+#endif
+    ::operator delete(region.base, std::align_val_t(region.alignment));
+    region.base = nullptr;
+}
+
+}  // namespace ring_buffer_detail
+
+/**
+ * 环形缓冲区单元格的存储
+ *
+ * 容量为编译期常量时单元格内联在对象中；容量为 dynamic_capacity 时在构造时
+ * 从堆（或大页映射）中分配按缓存行对齐的存储，容量仍必须是2的幂。
+ */
+template <typename cell_type, uint32_t size>
+class ring_storage {
+private:
+    static_assert((size >= 2) && ((size & (size - 1)) == 0),
+                  "Size must be a power of 2 and at least 2");
+    cell_type cells_[size];
+
+public:
+    ring_storage() = default;
+
+    cell_type* cells() { return cells_; }
+    const cell_type* cells() const { return cells_; }
+
+    constexpr uint32_t capacity() const { return size; }
+
+    constexpr bool huge_pages() const { return false; }
+
+    constexpr bool numa_bound() const { return false; }
+};
+
+template <typename cell_type>
+class ring_storage<cell_type, dynamic_capacity> {
+private:
+    ring_buffer_detail::memory_region region_;
+    cell_type* cells_ = nullptr;
+    uint32_t capacity_ = 0;
+
+public:
+    /**
+     * 分配 capacity 个单元格
+     *
+     * capacity 不是不小于2的2的幂时抛出 std::invalid_argument，
+     * 内存不足时抛出 std::bad_alloc。
+     */
+    ring_storage(uint32_t capacity, const ring_buffer_options& options) {
+        if (!ring_buffer_detail::is_valid_capacity(capacity)) {
+            throw std::invalid_argument("ring buffer capacity must be a power of 2 and at least 2");
+        }
+        region_ = ring_buffer_detail::allocate(sizeof(cell_type) * capacity, alignof(cell_type), options);
+        cells_ = static_cast<cell_type*>(region_.base);
+        capacity_ = capacity;
+        for (uint32_t i = 0; i < capacity_; ++i) {
+            ::new (static_cast<void*>(&cells_[i])) cell_type;
+        }
+    }
+
+    ~ring_storage() {
+        for (uint32_t i = 0; i < capacity_; ++i) {
+            cells_[i].~cell_type();
+        }
+        ring_buffer_detail::deallocate(region_);
+    }
+
+    ring_storage(const ring_storage&) = delete;
+    ring_storage& operator=(const ring_storage&) = delete;
+
+    cell_type* cells() { return cells_; }
+    const cell_type* cells() const { return cells_; }
+
+    uint32_t capacity() const { return capacity_; }
+
+    /**
+     * 是否确实获得了大页（或已建议内核使用透明大页）
+     */
+    bool huge_pages() const { return region_.huge_pages; }
+
+    /**
+     * 是否已为存储设置 NUMA 节点偏好
+     */
+    bool numa_bound() const { return region_.numa_bound; }
+};
@@ -0,0 +1,417 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "ring_buffer.h"
+
+/**
+ * 单生产者单消费者环形缓冲区
+ *
+ * 接口与 ring_buffer 一致，但只允许一个线程 push、一个线程 get。
+ * 不需要 CAS 和每个单元格的序列号：生产者独占 tail_，消费者独占 head_，
+ * 双方各自缓存对方的索引，只有在缓存值显示满/空时才重新读取对方的原子变量，
+ * 因此稳态下每次交接只有一次 release 写入，没有跨核的读缓存行。
+ *
+ * 与 ring_buffer 一样，size 为 dynamic_capacity 时容量在构造时指定。
+ */
+template <typename store_type, uint32_t size>
+class spsc_ring_buffer {
+private:
+    // 只读的容量信息，双方共享
+    const uint32_t capacity_ = size;
+    const uint32_t mask_ = size - 1;
+
+    // 生产者侧：写入位置及其缓存的消费者位置，位于同一缓存行
+    alignas(64) std::atomic<uint32_t> tail_{0};
+    uint32_t cached_head_ = 0;
+
+    // 消费者侧：读取位置及其缓存的生产者位置，位于同一缓存行
+    alignas(64) std::atomic<uint32_t> head_{0};
+    uint32_t cached_tail_ = 0;
+
+    // 元素存放在未初始化的对齐存储中：入队时就地构造，出队时析构
+    struct Slot {
+        alignas(store_type) unsigned char storage[sizeof(store_type)];
+    };
+    alignas(64) ring_storage<Slot, size> buffer_;
+
+    store_type* element(uint32_t pos) {
+        return std::launder(reinterpret_cast<store_type*>(buffer_.cells()[pos & mask_].storage));
+    }
+
+    void* raw(uint32_t pos) {
+        return static_cast<void*>(buffer_.cells()[pos & mask_].storage);
+    }
+
+public:
+    using value_type = store_type;
+
+    spsc_ring_buffer() {
+        static_assert(size != dynamic_capacity, "A dynamic_capacity spsc_ring_buffer needs a capacity");
+    }
+
+    /**
+     * 构造容量在运行时指定的缓冲区（size 必须为 dynamic_capacity）
+     *
+     * capacity 必须是不小于2的2的幂，否则抛出 std::invalid_argument。
+     */
+    explicit spsc_ring_buffer(uint32_t capacity, const ring_buffer_options& options = ring_buffer_options())
+        : capacity_(capacity), mask_(capacity - 1), buffer_(capacity, options) {
+        static_assert(size == dynamic_capacity, "Only a dynamic_capacity spsc_ring_buffer takes a capacity");
+    }
+
+    /**
+     * 析构仍留在缓冲区中的元素
+     *
+     * 调用时不能再有其他线程访问缓冲区。
+     */
+    ~spsc_ring_buffer() {
+        if (!std::is_trivially_destructible<store_type>::value) {
+            const uint32_t tail = tail_.load(std::memory_order_acquire);
+            for (uint32_t head = head_.load(std::memory_order_acquire); head != tail; ++head) {
+                element(head)->~store_type();
+            }
+        }
+    }
+
+    bool push(store_type value) {
+        return emplace(std::move(value));
+    }
+
+    /**
+     * 直接在缓冲区中构造元素
+     *
+     * 构造在发布之前进行，构造抛出异常时 tail_ 不变，缓冲区不受影响。
+     *
+     * @return 缓冲区已满时返回 false，此时不会构造任何对象
+     */
+    template <typename... Args>
+    bool emplace(Args&&... args) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+
+        // 缓存显示已满时才去读取消费者的最新位置
+        if (tail - cached_head_ == capacity_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == capacity_) {
+                SYNC_RING_BUFFER_COUNT(push_full);
+                return false;
+            }
+        }
+
+        // 写入数据
+        ::new (raw(tail)) store_type(std::forward<Args>(args)...);
+
+        // 发布数据
+        tail_.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * 取出一个元素；移动赋值抛出异常时元素留在缓冲区中，下一次 get 重新读取它
+     *
+     * @return 缓冲区为空时返回 false
+     */
+    bool get(store_type& value) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+
+        // 缓存显示为空时才去读取生产者的最新位置
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                SYNC_RING_BUFFER_COUNT(get_empty);
+                return false;
+            }
+        }
+
+        // 读取数据
+        value = std::move(*element(head));
+        element(head)->~store_type();
+
+        // 将单元格交还给生产者
+        head_.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * 批量写入 [first, last) 中的元素，语义与 ring_buffer::push_n 相同
+     *
+     * 中途构造抛出异常时，发布已经构造好的元素后重新抛出，不会泄漏已构造的对象。
+     *
+     * @return 实际写入的元素数量，缓冲区已满时为 0
+     */
+    template <typename ForwardIt>
+    size_t push_n(ForwardIt first, ForwardIt last) {
+        const auto wanted = std::distance(first, last);
+        if (wanted <= 0) {
+            return 0;
+        }
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+
+        uint32_t free_cells = capacity_ - (tail - cached_head_);
+        if (free_cells < static_cast<uint64_t>(wanted)) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            free_cells = capacity_ - (tail - cached_head_);
+        }
+        const uint32_t count = free_cells < static_cast<uint64_t>(wanted) ? free_cells : static_cast<uint32_t>(wanted);
+        if (count == 0) {
+            SYNC_RING_BUFFER_COUNT(push_full);
+        }
+
+        uint32_t i = 0;
+        try {
+            for (; i < count; ++i, ++first) {
+                ::new (raw(tail + i)) store_type(*first);
+            }
+        } catch (...) {
+            tail_.store(tail + i, std::memory_order_release);
+            throw;
+        }
+
+        // 整批一次发布
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * 批量读取最多 max 个元素写入 out，语义与 ring_buffer::get_n 相同
+     *
+     * 写入 out 时抛出异常时，交还已经取出的元素后再抛出；出错的元素和之后的元素
+     * 留在缓冲区中，下一次读取时重新取出。
+     *
+     * @return 实际读取的元素数量，缓冲区为空时为 0
+     */
+    template <typename OutputIt>
+    size_t get_n(OutputIt out, size_t max) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+
+        uint32_t ready = cached_tail_ - head;
+        if (ready < max) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            ready = cached_tail_ - head;
+        }
+        const uint32_t count = ready < max ? ready : static_cast<uint32_t>(max);
+        if (count == 0 && max > 0) {
+            SYNC_RING_BUFFER_COUNT(get_empty);
+        }
+
+        uint32_t i = 0;
+        try {
+            for (; i < count; ++i, ++out) {
+                *out = std::move(*element(head + i));
+                element(head + i)->~store_type();
+            }
+        } catch (...) {
+            head_.store(head + i, std::memory_order_release);
+            throw;
+        }
+
+        // 整批一次交还给生产者
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * 生产者槽位句柄，语义与 ring_buffer::write_slot 相同
+     *
+     * 同一时刻生产者只能持有一个未提交的槽位。
+     */
+    class write_slot {
+    private:
+        friend class spsc_ring_buffer;
+        spsc_ring_buffer* owner_ = nullptr;
+        uint32_t pos_ = 0;
+
+        write_slot(spsc_ring_buffer* owner, uint32_t pos) : owner_(owner), pos_(pos) {}
+
+    public:
+        write_slot() = default;
+        write_slot(write_slot&& other) noexcept : owner_(other.owner_), pos_(other.pos_) {
+            other.owner_ = nullptr;
+        }
+        write_slot& operator=(write_slot&& other) noexcept {
+            if (this != &other) {
+                if (owner_) {
+                    commit();
+                }
+                owner_ = other.owner_;
+                pos_ = other.pos_;
+                other.owner_ = nullptr;
+            }
+            return *this;
+        }
+        write_slot(const write_slot&) = delete;
+        write_slot& operator=(const write_slot&) = delete;
+
+        ~write_slot() {
+            if (owner_) {
+                commit();
+            }
+        }
+
+        explicit operator bool() const { return owner_ != nullptr; }
+        store_type& operator*() const { return *data(); }
+        store_type* operator->() const { return data(); }
+        store_type* data() const { return owner_->element(pos_); }
+
+        /**
+         * 发布槽位中的数据，之后句柄失效
+         */
+        void commit() {
+            owner_->tail_.store(pos_ + 1, std::memory_order_release);
+            owner_ = nullptr;
+        }
+    };
+
+    /**
+     * 消费者槽位句柄，语义与 ring_buffer::read_slot 相同
+     *
+     * 同一时刻消费者只能持有一个未释放的槽位。
+     */
+    class read_slot {
+    private:
+        friend class spsc_ring_buffer;
+        spsc_ring_buffer* owner_ = nullptr;
+        uint32_t pos_ = 0;
+
+        read_slot(spsc_ring_buffer* owner, uint32_t pos) : owner_(owner), pos_(pos) {}
+
+    public:
+        read_slot() = default;
+        read_slot(read_slot&& other) noexcept : owner_(other.owner_), pos_(other.pos_) {
+            other.owner_ = nullptr;
+        }
+        read_slot& operator=(read_slot&& other) noexcept {
+            if (this != &other) {
+                if (owner_) {
+                    release();
+                }
+                owner_ = other.owner_;
+                pos_ = other.pos_;
+                other.owner_ = nullptr;
+            }
+            return *this;
+        }
+        read_slot(const read_slot&) = delete;
+        read_slot& operator=(const read_slot&) = delete;
+
+        ~read_slot() {
+            if (owner_) {
+                release();
+            }
+        }
+
+        explicit operator bool() const { return owner_ != nullptr; }
+        store_type& operator*() const { return *data(); }
+        store_type* operator->() const { return data(); }
+        store_type* data() const { return owner_->element(pos_); }
+
+        /**
+         * 析构槽位中的元素并将槽位交还给生产者，之后句柄失效
+         */
+        void release() {
+            data()->~store_type();
+            owner_->head_.store(pos_ + 1, std::memory_order_release);
+            owner_ = nullptr;
+        }
+    };
+
+    /**
+     * 获取一个可写入的槽位，不拷贝/移动任何数据
+     *
+     * 槽位中的元素已就地默认初始化（平凡类型不会被清零），生产者直接填充即可。
+     *
+     * @return 槽位句柄，缓冲区已满时为空句柄
+     */
+    write_slot try_reserve() {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == capacity_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == capacity_) {
+                return write_slot();
+            }
+        }
+        ::new (raw(tail)) store_type;
+        return write_slot(this, tail);
+    }
+
+    /**
+     * 获取一个已发布的槽位，不拷贝/移动任何数据
+     *
+     * @return 槽位句柄，缓冲区为空时为空句柄
+     */
+    read_slot try_peek() {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return read_slot();
+            }
+        }
+        return read_slot(this, head);
+    }
+
+    /**
+     * 获取缓冲区容量
+     *
+     * @return 缓冲区容量
+     */
+    constexpr size_t capacity() const {
+        return capacity_;
+    }
+
+    /**
+     * 近似的元素数量，只用于统计和流量控制等启发式判断
+     */
+    size_t size_approx() const {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        const uint32_t used = tail - head;
+        return used > capacity_ ? 0 : used;
+    }
+
+    /**
+     * 存储是否确实使用了大页
+     */
+    bool huge_pages() const {
+        return buffer_.huge_pages();
+    }
+
+    /**
+     * 存储是否已设置 NUMA 节点偏好
+     */
+    bool numa_bound() const {
+        return buffer_.numa_bound();
+    }
+};
+
+/**
+ * 缓冲区选择标签
+ *
+ * 调用方（例如连接模块的收发缓冲区）按生产者/消费者数量选择实现，
+ * 两种实现的 push/get/capacity 接口完全一致，可以互相替换。
+ */
+struct mpmc_tag {};
+struct spsc_tag {};
+
+template <typename store_type, uint32_t size, typename tag>
+struct select_ring_buffer;
+
+template <typename store_type, uint32_t size>
+struct select_ring_buffer<store_type, size, mpmc_tag> {
+    using type = ring_buffer<store_type, size>;
+};
+
+template <typename store_type, uint32_t size>
+struct select_ring_buffer<store_type, size, spsc_tag> {
+    using type = spsc_ring_buffer<store_type, size>;
+};
+
+template <typename store_type, uint32_t size, typename tag>
+using select_ring_buffer_t = typename select_ring_buffer<store_type, size, tag>::type;
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * 一个 NUMA 节点及其上本进程可用的 CPU
+ */
+struct numa_node_info {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+/**
+ * CPU 与 NUMA 拓扑
+ *
+ * Linux 上读取 /sys/devices/system/node，并与进程的 CPU 亲和掩码取交集
+ * （容器和 taskset 限制下只包含实际可用的 CPU）；其他平台或读取失败时
+ * 视为包含所有 CPU 的单个节点。
+ */
+class cpu_topology {
+public:
+    std::vector<numa_node_info> nodes;
+
+    /**
+     * 探测当前机器的拓扑
+     */
+    static cpu_topology detect();
+
+    /**
+     * 构造包含 0..cpus-1 的单节点拓扑
+     */
+    static cpu_topology single_node(size_t cpus);
+
+    /**
+     * 解析内核 cpulist 格式，例如 "0-3,8,10-11"，格式错误的部分被忽略
+     */
+    static std::vector<int> parse_cpu_list(const std::string& text);
+
+    /**
+     * 所有节点的 CPU 总数
+     */
+    size_t cpu_count() const;
+
+    /**
+     * CPU 所在节点在 nodes 中的下标，未知时返回 -1
+     */
+    int node_index_of_cpu(int cpu) const;
+
+    /**
+     * 节点编号在 nodes 中的下标，未知时返回 -1
+     */
+    int node_index_of_id(int id) const;
+};
+
+/**
+ * 数据所在的 NUMA 节点编号
+ *
+ * 用于把处理某块缓冲区的任务路由到该缓冲区所在的节点。
+ * 页面尚未分配物理内存、平台不支持或查询失败时返回 -1。
+ */
+int numa_node_of(const void* address);
+
+/**
+ * 当前线程正在运行的 CPU，不支持时返回 -1
+ */
+int current_cpu();
+
+/**
+ * 将当前线程限制在给定的 CPU 集合上运行
+ *
+ * Linux 使用 pthread_setaffinity_np；macOS 不支持硬绑定，用亲和标签 affinity_tag
+ * （相同标签的线程倾向于共享L2缓存）作为提示；其他平台不做任何事。
+ *
+ * @return 是否设置成功
+ */
+bool set_current_thread_affinity(const std::vector<int>& cpus, int affinity_tag);
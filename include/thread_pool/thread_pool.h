@@ -0,0 +1,278 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../metrics/metrics.h"
+#include "../ring_buffer/blocking_ring_buffer.h"
+#include "../ring_buffer/event_count.h"
+#include "../ring_buffer/ring_buffer.h"
+#include "cpu_topology.h"
+#include "work_steal_deque.h"
+
+/**
+ * 任务通道
+ *
+ * 每个通道有独立的注入队列和每个工作线程上独立的双端队列。
+ * transfer 用于延迟敏感的文件传输任务，hash 用于CPU密集的哈希计算任务，
+ * 初次扫描时的大量哈希任务不会把小文件的传输任务堵在后面。
+ */
+enum class task_lane : uint8_t {
+    transfer = 0,
+    hash = 1,
+};
+
+constexpr size_t task_lane_count = 2;
+
+/**
+ * 线程池配置
+ */
+struct thread_pool_options {
+    // 工作线程数量（包括专用哈希线程），0 表示使用进程可用的 CPU 数量
+    size_t threads = 0;
+
+    // 每个通道注入队列的容量，必须是2的幂
+    uint32_t queue_capacity = 4096;
+
+    // 加权公平出队的权重，按 task_lane 的顺序；两个通道都有任务时
+    // 通用工作线程大约按此比例交替执行，权重必须大于0
+    std::array<uint32_t, task_lane_count> lane_weights = {{4, 1}};
+
+    // 专门执行 hash 通道任务的工作线程数量。大于0时 hash 通道只由这些线程执行，
+    // 其余线程只执行 transfer 通道，因此传输任务永远不会排在大文件哈希之后；
+    // 必须至少留一个通用工作线程（按 NUMA 节点划分时每个节点都要留一个）
+    size_t dedicated_hash_workers = 0;
+
+    // 按 NUMA 节点划分工作线程：每个节点有自己的注入队列并分配在该节点的内存上，
+    // 工作线程只在本节点的 CPU 上运行，优先执行本节点的任务，本节点没有任务时才跨节点窃取
+    bool numa_aware = false;
+
+    // 将每个工作线程固定到单个 CPU 上（在所属节点的 CPU 中轮流分配）；
+    // macOS 不支持硬绑定，只设置亲和标签作为提示
+    bool pin_threads = false;
+
+    // 使用的拓扑，nodes 为空时自动探测；可用于手动划分或测试
+    cpu_topology topology;
+};
+
+/**
+ * 工作窃取线程池
+ *
+ * 用于分发文件传输任务和哈希计算任务。每个工作线程为每个通道各有一个 Chase-Lev
+ * 双端队列，工作线程内部提交的任务（例如把一个大文件拆成多个分块哈希任务）压入
+ * 自己对应通道的队列，不经过任何共享结构；外部线程提交的任务进入该通道的全局
+ * ring_buffer 注入队列，注入队列满时提交方阻塞等待（背压）。
+ *
+ * 工作线程按平滑加权轮询决定先服务哪个通道，在每个通道内按
+ * "本地队列 -> 注入队列"的顺序寻找任务，都找不到时再依次到各通道随机选择受害者
+ * 窃取，仍然找不到时在所属工作组的 event_count 上休眠，不占用 CPU。
+ * 按 NUMA 节点划分时，每个节点的工作线程先服务本节点，再窃取同节点的线程，
+ * 最后才去没有空闲线程的其他节点取任务；某个节点的线程全忙时新任务会唤醒其他节点的空闲线程。
+ * macOS 上哈希专用线程使用 QOS_CLASS_UTILITY，其余线程使用 QOS_CLASS_USER_INITIATED。
+ * 析构时会执行完所有已提交的任务再退出。
+ */
+class thread_pool {
+public:
+    /**
+     * @param threads 工作线程数量，0 表示使用进程可用的 CPU 数量
+     * @param queue_capacity 每个通道注入队列的容量，必须是2的幂
+     */
+    explicit thread_pool(size_t threads = 0, uint32_t queue_capacity = 4096);
+
+    /**
+     * 配置不合法（权重为0、专用哈希线程占满所有线程等）时抛出 std::invalid_argument
+     */
+    explicit thread_pool(const thread_pool_options& options);
+
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    /**
+     * 向 transfer 通道提交任务
+     *
+     * 任务抛出的异常通过返回的 future 传递给调用方。
+     * 线程池正在关闭时抛出 std::runtime_error。
+     *
+     * @return 任务结果的 future
+     */
+    template <typename F, typename... Args>
+    auto submit(F&& f, Args&&... args) -> std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+        return submit_to(task_lane::transfer, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    /**
+     * 向指定通道提交任务
+     *
+     * 工作线程提交时进入本节点，外部线程提交时进入当前 CPU 所在的节点。
+     *
+     * @param lane 任务通道
+     * @return 任务结果的 future
+     */
+    template <typename F, typename... Args>
+    auto submit_to(task_lane lane, F&& f, Args&&... args)
+        -> std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+        return submit_on_node(-1, lane, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    /**
+     * 向指定 NUMA 节点的工作线程提交任务
+     *
+     * 通常传入任务要处理的缓冲区所在的节点（见 numa_node_of），让任务在数据所在的
+     * 插槽上执行。节点未知（-1 或不在拓扑中）时等同于 submit_to。
+     *
+     * @param node NUMA 节点编号
+     * @param lane 任务通道
+     * @return 任务结果的 future
+     */
+    template <typename F, typename... Args>
+    auto submit_on_node(int node, task_lane lane, F&& f, Args&&... args)
+        -> std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+        using result_type = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+        std::packaged_task<result_type()> job(
+            [fn = std::forward<F>(f), tup = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                return std::apply(std::move(fn), std::move(tup));
+            });
+        std::future<result_type> result = job.get_future();
+        enqueue(node, lane, new task_impl<std::packaged_task<result_type()>>(std::move(job)));
+        return result;
+    }
+
+    /**
+     * 等待 future 就绪
+     *
+     * 外部线程直接阻塞等待。工作线程在等待期间继续执行其他任务（通常就是它在等的子任务），
+     * 这样任务可以把工作拆成子任务再等待结果，不会因为所有工作线程都在等待而死锁。
+     */
+    template <typename T>
+    void wait(const std::future<T>& result) {
+        if (!in_worker()) {
+            result.wait();
+            return;
+        }
+        while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!run_pending_task()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /**
+     * 在当前工作线程上执行一个待执行的任务
+     *
+     * @return 外部线程调用或没有可执行的任务时返回 false
+     */
+    bool run_pending_task();
+
+    /**
+     * 获取工作线程数量
+     *
+     * @return 工作线程数量
+     */
+    size_t size() const {
+        return workers_.size();
+    }
+
+    /**
+     * 工作线程划分成的节点数量，未开启 numa_aware 时为 1
+     */
+    size_t node_count() const {
+        return nodes_.size();
+    }
+
+    /**
+     * 当前线程是否是本线程池的工作线程
+     */
+    bool in_worker() const;
+
+    /**
+     * 当前工作线程所属的 NUMA 节点编号
+     *
+     * @return 外部线程或未开启 numa_aware 时返回 -1
+     */
+    int current_node() const;
+
+private:
+    struct task {
+        virtual ~task() {}
+        virtual void run() = 0;
+
+        // 进入队列的时间和通道，用于统计排队时间和执行时间
+        SYNC_METRICS_ONLY(int64_t enqueued_ns = 0; task_lane lane = task_lane::transfer;)
+    };
+
+    template <typename Fn>
+    struct task_impl : task {
+        Fn fn;
+        explicit task_impl(Fn&& f) : fn(std::move(f)) {}
+        void run() override { fn(); }
+    };
+
+    using injection_queue = blocking_ring_buffer<ring_buffer<task*, dynamic_capacity>>;
+
+    struct lane_state {
+        injection_queue queue;
+        uint32_t weight;
+        size_t group;  // 本节点负责执行该通道的工作组
+
+        lane_state(uint32_t capacity, const ring_buffer_options& options, uint32_t w)
+            : queue(capacity, options), weight(w), group(0) {}
+    };
+
+    struct node_state {
+        int id = -1;  // NUMA 节点编号，未按节点划分时为 -1
+        std::vector<int> cpus;
+        std::array<std::unique_ptr<lane_state>, task_lane_count> lanes;
+    };
+
+    // 服务同一组通道的工作线程共用一个休眠点，新任务只唤醒能执行它的线程
+    struct worker_group {
+        uint32_t lane_mask = 0;
+        event_count idle;
+    };
+
+    struct worker {
+        work_steal_deque<task*> deques[task_lane_count];
+        std::thread thread;
+        uint64_t rng_state = 0;
+        size_t group = 0;
+        size_t node = 0;
+        std::vector<int> affinity;  // 为空时不设置亲和性
+
+        // 平滑加权轮询的当前值
+        int64_t current_weight[task_lane_count] = {};
+    };
+
+    void start(const thread_pool_options& options);
+    size_t home_node() const;
+    void enqueue(int node_id, task_lane lane, task* t);
+    void notify_lane(size_t node, size_t lane);
+    bool node_has_idle(size_t node, size_t lane) const;
+    void worker_loop(size_t index);
+    bool find_task(size_t index, task*& t);
+    bool steal_task(size_t index, size_t lane, bool same_node, task*& t);
+    void drain_remaining();
+    static void run_task(task* t);
+
+    std::vector<std::unique_ptr<worker>> workers_;
+    std::vector<std::unique_ptr<worker_group>> groups_;
+    std::vector<std::unique_ptr<node_state>> nodes_;
+    cpu_topology topology_;
+    bool numa_aware_ = false;
+
+    std::atomic<bool> stopping_{false};
+
+    // 各通道注入队列深度的导出，声明在最后，最先注销
+    SYNC_METRICS_ONLY(metric_registration metrics_;)
+};
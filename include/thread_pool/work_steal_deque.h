@@ -0,0 +1,151 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Chase-Lev 工作窃取双端队列
+ *
+ * 每个工作线程拥有一个：所有者在底部 push/pop（LIFO，缓存局部性好），
+ * 其他线程从顶部 steal（FIFO，偷走最早、通常也是最大的任务）。
+ * 内存序采用 Lê 等人在弱内存模型下证明正确的版本。
+ * 数组满时所有者将其扩容一倍，旧数组保留到析构时释放，
+ * 因为并发的窃取者可能仍在读取旧数组。
+ *
+ * T 必须是可平凡拷贝的类型（通常为任务指针）。
+ */
+template <typename T>
+class work_steal_deque {
+private:
+    static_assert(std::is_trivially_copyable<T>::value, "work_steal_deque elements must be trivially copyable");
+
+    struct array {
+        const int64_t capacity;
+        const int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        explicit array(int64_t cap) : capacity(cap), mask(cap - 1), slots(new std::atomic<T>[static_cast<size_t>(cap)]) {}
+
+        T get(int64_t i) const {
+            return slots[i & mask].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, T value) {
+            slots[i & mask].store(value, std::memory_order_relaxed);
+        }
+    };
+
+    // 窃取者竞争的顶部，使用alignas避免与所有者的底部伪共享
+    alignas(64) std::atomic<int64_t> top_{0};
+
+    // 只有所有者写入的底部
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<array*> array_;
+
+    // 所有者独占：当前数组及扩容后被替换的旧数组
+    std::vector<std::unique_ptr<array>> arrays_;
+
+    array* grow(array* old, int64_t bottom, int64_t top) {
+        auto bigger = std::make_unique<array>(old->capacity * 2);
+        for (int64_t i = top; i < bottom; ++i) {
+            bigger->put(i, old->get(i));
+        }
+        array* result = bigger.get();
+        arrays_.push_back(std::move(bigger));
+        array_.store(result, std::memory_order_release);
+        return result;
+    }
+
+public:
+
+    /**
+     * @param capacity 初始容量，必须是2的幂
+     */
+    explicit work_steal_deque(int64_t capacity = 256) {
+        arrays_.push_back(std::make_unique<array>(capacity));
+        array_.store(arrays_.back().get(), std::memory_order_relaxed);
+    }
+
+    work_steal_deque(const work_steal_deque&) = delete;
+    work_steal_deque& operator=(const work_steal_deque&) = delete;
+
+    /**
+     * 所有者压入底部，空间不足时扩容，总是成功
+     */
+    void push(T value) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        array* a = array_.load(std::memory_order_relaxed);
+        if (bottom - top > a->capacity - 1) {
+            a = grow(a, bottom, top);
+        }
+        a->put(bottom, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * 所有者从底部弹出
+     *
+     * @return 队列为空（或最后一个元素被窃取者抢走）时返回 false
+     */
+    bool pop(T& value) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        array* a = array_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            // 队列为空，恢复底部
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        value = a->get(bottom);
+        if (top == bottom) {
+            // 只剩最后一个元素，与窃取者在顶部竞争
+            bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    /**
+     * 其他线程从顶部窃取
+     *
+     * @return 队列为空或与其他窃取者/所有者竞争失败时返回 false
+     */
+    bool steal(T& value) {
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_acquire);
+
+        if (top >= bottom) {
+            return false;
+        }
+
+        array* a = array_.load(std::memory_order_acquire);
+        T candidate = a->get(top);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return false;
+        }
+        value = candidate;
+        return true;
+    }
+
+    /**
+     * 近似的元素数量，只用于统计和启发式判断
+     */
+    size_t size_approx() const {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+};
@@ -0,0 +1,361 @@
+#include "common/blake3.h"
+
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include "blake3_impl.h"
+
+namespace blake3_detail {
+
+namespace {
+
+inline uint32_t rotr32(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+inline void g(uint32_t* v, int a, int b, int c, int d, uint32_t x, uint32_t y) {
+    v[a] = v[a] + v[b] + x;
+    v[d] = rotr32(v[d] ^ v[a], 16);
+    v[c] = v[c] + v[d];
+    v[b] = rotr32(v[b] ^ v[c], 12);
+    v[a] = v[a] + v[b] + y;
+    v[d] = rotr32(v[d] ^ v[a], 8);
+    v[c] = v[c] + v[d];
+    v[b] = rotr32(v[b] ^ v[c], 7);
+}
+
+}  // namespace
+
+void compress_in_place(uint32_t cv[8], const uint8_t block[block_len], uint8_t block_length, uint64_t counter,
+                       uint8_t flags) {
+    uint32_t m[16];
+    for (int i = 0; i < 16; ++i) {
+        m[i] = load32(block + 4 * i);
+    }
+    uint32_t v[16] = {
+        cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+        iv[0], iv[1], iv[2], iv[3],
+        static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), block_length, flags,
+    };
+    for (int r = 0; r < 7; ++r) {
+        const uint8_t* s = msg_schedule[r];
+        g(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+        g(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+        g(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+        g(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+        g(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+        g(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+        g(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+        g(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+    }
+    for (int i = 0; i < 8; ++i) {
+        cv[i] = v[i] ^ v[i + 8];
+    }
+}
+
+void hash_many_portable(const uint8_t* const* inputs, size_t num_inputs, size_t blocks, const uint32_t key[8],
+                        uint64_t counter, bool increment_counter, uint8_t flags, uint8_t flags_start,
+                        uint8_t flags_end, uint8_t* out) {
+    for (size_t i = 0; i < num_inputs; ++i) {
+        uint32_t cv[8];
+        std::memcpy(cv, key, sizeof(cv));
+        uint8_t block_flags = flags | flags_start;
+        for (size_t b = 0; b < blocks; ++b) {
+            if (b + 1 == blocks) {
+                block_flags |= flags_end;
+            }
+            compress_in_place(cv, inputs[i] + b * block_len, static_cast<uint8_t>(block_len), counter, block_flags);
+            block_flags = flags;
+        }
+        for (int w = 0; w < 8; ++w) {
+            store32(out + i * 32 + 4 * w, cv[w]);
+        }
+        if (increment_counter) {
+            counter++;
+        }
+    }
+}
+
+namespace {
+
+hash_many_fn kernel_for(hash_isa isa) {
+    switch (isa) {
+#if defined(SYNC_HASH_HAVE_SSE2)
+        case hash_isa::sse2:
+            return hash_many_sse2;
+#endif
+#if defined(SYNC_HASH_HAVE_AVX2)
+        case hash_isa::avx2:
+            return hash_many_avx2;
+#endif
+#if defined(SYNC_HASH_HAVE_AVX512)
+        case hash_isa::avx512:
+            return hash_many_avx512;
+#endif
+#if defined(SYNC_HASH_HAVE_NEON)
+        case hash_isa::neon:
+            return hash_many_neon;
+#endif
+        default:
+            return hash_many_portable;
+    }
+}
+
+hash_isa detect_isa() {
+#if defined(SYNC_HASH_HAVE_AVX512)
+    if (hash_isa_supported(hash_isa::avx512)) {
+        return hash_isa::avx512;
+    }
+#endif
+#if defined(SYNC_HASH_HAVE_AVX2)
+    if (hash_isa_supported(hash_isa::avx2)) {
+        return hash_isa::avx2;
+    }
+#endif
+#if defined(SYNC_HASH_HAVE_SSE2)
+    return hash_isa::sse2;
+#elif defined(SYNC_HASH_HAVE_NEON)
+    return hash_isa::neon;
+#else
+    return hash_isa::portable;
+#endif
+}
+
+std::atomic<hash_isa>& selected_isa() {
+    static std::atomic<hash_isa> isa(detect_isa());
+    return isa;
+}
+
+}  // namespace
+
+hash_many_fn active_hash_many() {
+    return kernel_for(selected_isa().load(std::memory_order_relaxed));
+}
+
+}  // namespace blake3_detail
+
+using namespace blake3_detail;
+
+hash_isa active_hash_isa() {
+    return selected_isa().load(std::memory_order_relaxed);
+}
+
+bool hash_isa_supported(hash_isa isa) {
+    switch (isa) {
+        case hash_isa::portable:
+            return true;
+        case hash_isa::sse2:
+#if defined(SYNC_HASH_HAVE_SSE2)
+            return true;
+#else
+            return false;
+#endif
+        case hash_isa::avx2:
+#if defined(SYNC_HASH_HAVE_AVX2)
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+        case hash_isa::avx512:
+#if defined(SYNC_HASH_HAVE_AVX512)
+            return __builtin_cpu_supports("avx512f");
+#else
+            return false;
+#endif
+        case hash_isa::neon:
+#if defined(SYNC_HASH_HAVE_NEON)
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+void set_hash_isa(hash_isa isa) {
+    if (!hash_isa_supported(isa)) {
+        throw std::invalid_argument(std::string("hash isa not supported: ") + hash_isa_name(isa));
+    }
+    selected_isa().store(isa, std::memory_order_relaxed);
+}
+
+const char* hash_isa_name(hash_isa isa) {
+    switch (isa) {
+        case hash_isa::portable:
+            return "portable";
+        case hash_isa::sse2:
+            return "sse2";
+        case hash_isa::avx2:
+            return "avx2";
+        case hash_isa::avx512:
+            return "avx512";
+        case hash_isa::neon:
+            return "neon";
+    }
+    return "unknown";
+}
+
+blake3_hasher::blake3_hasher() {
+    reset();
+}
+
+void blake3_hasher::reset() {
+    reset_chunk(0);
+    cv_stack_len_ = 0;
+}
+
+void blake3_hasher::reset_chunk(uint64_t counter) {
+    std::memcpy(chunk_cv_, iv, sizeof(chunk_cv_));
+    chunk_counter_ = counter;
+    block_len_ = 0;
+    blocks_compressed_ = 0;
+}
+
+size_t blake3_hasher::chunk_length() const {
+    return static_cast<size_t>(blocks_compressed_) * block_len + block_len_;
+}
+
+void blake3_hasher::chunk_update(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        // 块满且还有后续数据时才压缩，分块的最后一个块要留到 chunk_output 带上 CHUNK_END
+        if (block_len_ == block_len) {
+            compress_in_place(chunk_cv_, block_, static_cast<uint8_t>(block_len), chunk_counter_,
+                              blocks_compressed_ == 0 ? chunk_start : 0);
+            blocks_compressed_++;
+            block_len_ = 0;
+        }
+        const size_t take = block_len - block_len_ < size ? block_len - block_len_ : size;
+        std::memcpy(block_ + block_len_, data, take);
+        block_len_ = static_cast<uint8_t>(block_len_ + take);
+        data += take;
+        size -= take;
+    }
+}
+
+void blake3_hasher::chunk_output(uint32_t cv[8], uint8_t extra_flags) const {
+    uint8_t block[block_len] = {};
+    std::memcpy(block, block_, block_len_);
+    std::memcpy(cv, chunk_cv_, sizeof(chunk_cv_));
+    const uint8_t flags = (blocks_compressed_ == 0 ? chunk_start : 0) | chunk_end | extra_flags;
+    compress_in_place(cv, block, block_len_, chunk_counter_, flags);
+}
+
+void blake3_hasher::push_chunk_cv(const uint32_t cv[8], uint64_t total_chunks) {
+    // 分块总数末尾有几个 0，就有几棵完整子树可以和新链值合并
+    uint32_t merged[8];
+    std::memcpy(merged, cv, sizeof(merged));
+    while ((total_chunks & 1) == 0) {
+        uint8_t block[block_len];
+        cv_stack_len_--;
+        for (int i = 0; i < 8; ++i) {
+            store32(block + 4 * i, cv_stack_[cv_stack_len_][i]);
+            store32(block + 32 + 4 * i, merged[i]);
+        }
+        std::memcpy(merged, iv, sizeof(merged));
+        compress_in_place(merged, block, static_cast<uint8_t>(block_len), 0, parent);
+        total_chunks >>= 1;
+    }
+    std::memcpy(cv_stack_[cv_stack_len_], merged, sizeof(merged));
+    cv_stack_len_++;
+}
+
+void blake3_hasher::update(const void* data, size_t size) {
+    const uint8_t* input = static_cast<const uint8_t*>(data);
+    constexpr size_t batch = 64;
+
+    while (size > 0) {
+        // 当前分块已满且还有数据，说明它不是最后一个分块，可以作为非根节点结束
+        if (chunk_length() == chunk_len) {
+            uint32_t cv[8];
+            chunk_output(cv, 0);
+            push_chunk_cv(cv, chunk_counter_ + 1);
+            reset_chunk(chunk_counter_ + 1);
+        }
+
+        // 位于分块边界且后面至少还有一个字节：把中间的完整分块批量交给 SIMD 内核
+        if (chunk_length() == 0 && size > chunk_len) {
+            size_t count = (size - 1) / chunk_len;
+            if (count > batch) {
+                count = batch;
+            }
+            const uint8_t* inputs[batch];
+            uint8_t out[batch * 32];
+            for (size_t i = 0; i < count; ++i) {
+                inputs[i] = input + i * chunk_len;
+            }
+            active_hash_many()(inputs, count, chunk_len / block_len, iv, chunk_counter_, true, 0, chunk_start,
+                               chunk_end, out);
+            for (size_t i = 0; i < count; ++i) {
+                uint32_t cv[8];
+                for (int w = 0; w < 8; ++w) {
+                    cv[w] = load32(out + i * 32 + 4 * w);
+                }
+                push_chunk_cv(cv, chunk_counter_ + i + 1);
+            }
+            chunk_counter_ += count;
+            input += count * chunk_len;
+            size -= count * chunk_len;
+            continue;
+        }
+
+        size_t take = chunk_len - chunk_length();
+        if (take > size) {
+            take = size;
+        }
+        chunk_update(input, take);
+        input += take;
+        size -= take;
+    }
+}
+
+hash_digest blake3_hasher::finalize() const {
+    uint32_t cv[8];
+    chunk_output(cv, cv_stack_len_ == 0 ? root : 0);
+    for (int i = static_cast<int>(cv_stack_len_) - 1; i >= 0; --i) {
+        uint8_t block[block_len];
+        for (int w = 0; w < 8; ++w) {
+            store32(block + 4 * w, cv_stack_[i][w]);
+            store32(block + 32 + 4 * w, cv[w]);
+        }
+        std::memcpy(cv, iv, sizeof(cv));
+        compress_in_place(cv, block, static_cast<uint8_t>(block_len), 0, parent | (i == 0 ? root : 0));
+    }
+
+    hash_digest digest;
+    for (int w = 0; w < 8; ++w) {
+        store32(digest.data() + 4 * w, cv[w]);
+    }
+    return digest;
+}
+
+hash_digest blake3_hasher::hash(const void* data, size_t size) {
+    blake3_hasher hasher;
+    hasher.update(data, size);
+    return hasher.finalize();
+}
+
+hash_digest hash_parent(const hash_digest& left, const hash_digest& right, bool is_root) {
+    uint8_t block[block_len];
+    std::memcpy(block, left.data(), hash_digest_size);
+    std::memcpy(block + hash_digest_size, right.data(), hash_digest_size);
+    uint32_t cv[8];
+    std::memcpy(cv, iv, sizeof(cv));
+    compress_in_place(cv, block, static_cast<uint8_t>(block_len), 0, parent | (is_root ? root : 0));
+
+    hash_digest digest;
+    for (int w = 0; w < 8; ++w) {
+        store32(digest.data() + 4 * w, cv[w]);
+    }
+    return digest;
+}
+
+std::string to_hex(const hash_digest& digest) {
+    static const char digits[] = "0123456789abcdef";
+    std::string text(digest.size() * 2, '0');
+    for (size_t i = 0; i < digest.size(); ++i) {
+        text[2 * i] = digits[digest[i] >> 4];
+        text[2 * i + 1] = digits[digest[i] & 0xF];
+    }
+    return text;
+}
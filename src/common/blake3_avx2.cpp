@@ -0,0 +1,15 @@
+// 使用 32 字节向量同时压缩 8 路输入，由 CMake 为本文件单独开启对应的指令集
+#include "blake3_simd_kernel.h"
+
+namespace blake3_detail {
+
+typedef uint32_t vec8u32 __attribute__((vector_size(32)));
+
+void hash_many_avx2(const uint8_t* const* inputs, size_t num_inputs, size_t blocks, const uint32_t key[8],
+                    uint64_t counter, bool increment_counter, uint8_t flags, uint8_t flags_start,
+                    uint8_t flags_end, uint8_t* out) {
+    hash_many_vector<vec8u32, 8>(inputs, num_inputs, blocks, key, counter, increment_counter, flags,
+                                 flags_start, flags_end, out);
+}
+
+}  // namespace blake3_detail
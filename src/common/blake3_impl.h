@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// BLAKE3 内部常量和各指令集内核的声明，只在 src/common 内部使用
+
+namespace blake3_detail {
+
+constexpr size_t block_len = 64;
+constexpr size_t chunk_len = 1024;
+
+enum : uint8_t {
+    chunk_start = 1 << 0,
+    chunk_end = 1 << 1,
+    parent = 1 << 2,
+    root = 1 << 3,
+};
+
+constexpr uint32_t iv[8] = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                            0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+
+// 每一轮使用的消息字下标
+constexpr uint8_t msg_schedule[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+// 使用 static 保证内部链接：各指令集源文件以不同的编译选项包含本文件，
+// 不能让链接器把某个文件编译出的 AVX-512 版本共享给其他文件
+static inline uint32_t load32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static inline void store32(uint8_t* p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+    p[2] = static_cast<uint8_t>(value >> 16);
+    p[3] = static_cast<uint8_t>(value >> 24);
+}
+
+/**
+ * 对 num_inputs 个输入各压缩 blocks 个 64 字节块，输出各自的 32 字节链值
+ *
+ * 与 BLAKE3 参考实现的 hash_many 语义相同：increment_counter 为 true 时
+ * 第 i 个输入使用计数器 counter + i（分块），否则都使用 counter（父节点）。
+ */
+using hash_many_fn = void (*)(const uint8_t* const* inputs, size_t num_inputs, size_t blocks, const uint32_t key[8],
+                              uint64_t counter, bool increment_counter, uint8_t flags, uint8_t flags_start,
+                              uint8_t flags_end, uint8_t* out);
+
+void compress_in_place(uint32_t cv[8], const uint8_t block[block_len], uint8_t block_length, uint64_t counter,
+                       uint8_t flags);
+
+void hash_many_portable(const uint8_t* const* inputs, size_t num_inputs, size_t blocks, const uint32_t key[8],
+                        uint64_t counter, bool increment_counter, uint8_t flags, uint8_t flags_start,
+                        uint8_t flags_end, uint8_t* out);
+
+#if defined(SYNC_HASH_HAVE_SSE2)
+void hash_many_sse2(const uint8_t* const* inputs, size_t num_inputs, size_t blocks, const uint32_t key[8],
+                    uint64_t counter, bool increment_counter, uint8_t flags, uint8_t flags_start,
+                    uint8_t flags_end, uint8_t* out);
+#endif
+#if defined(SYNC_HASH_HAVE_AVX2)
+void hash_many_avx2(const uint8_t* const* inputs, size_t num_inputs, size_t blocks, const uint32_t key[8],
+                    uint64_t counter, bool increment_counter, uint8_t flags, uint8_t flags_start,
+                    uint8_t flags_end, uint8_t* out);
+#endif
+#if defined(SYNC_HASH_HAVE_AVX512)
+void hash_many_avx512(const uint8_t* const* inputs, size_t num_inputs, size_t blocks, const uint32_t key[8],
+                      uint64_t counter, bool increment_counter, uint8_t flags, uint8_t flags_start,
+                      uint8_t flags_end, uint8_t* out);
+#endif
+#if defined(SYNC_HASH_HAVE_NEON)
+void hash_many_neon(const uint8_t* const* inputs, size_t num_inputs, size_t blocks, const uint32_t key[8],
+                    uint64_t counter, bool increment_counter, uint8_t flags, uint8_t flags_start,
+                    uint8_t flags_end, uint8_t* out);
+#endif
+
+/**
+ * 当前选中的内核及其并行宽度
+ */
+hash_many_fn active_hash_many();
+
+}  // namespace blake3_detail
@@ -0,0 +1,112 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "blake3_impl.h"
+
+// 通用的多路并行压缩内核，基于编译器向量扩展：每个向量的第 i 路对应第 i 个输入。
+// 由各指令集的源文件以不同的编译选项（-mavx2 等）包含并实例化。
+// 放在匿名命名空间中，保证不同指令集编译出的代码不会在链接时被互相替换。
+
+namespace {
+
+template <typename V>
+inline V rotr(V x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+template <typename V>
+inline void g(V* v, int a, int b, int c, int d, V x, V y) {
+    v[a] = v[a] + v[b] + x;
+    v[d] = rotr(v[d] ^ v[a], 16);
+    v[c] = v[c] + v[d];
+    v[b] = rotr(v[b] ^ v[c], 12);
+    v[a] = v[a] + v[b] + y;
+    v[d] = rotr(v[d] ^ v[a], 8);
+    v[c] = v[c] + v[d];
+    v[b] = rotr(v[b] ^ v[c], 7);
+}
+
+template <typename V, size_t N>
+inline void hash_lanes(const uint8_t* const* inputs, size_t blocks, const uint32_t key[8], uint64_t counter,
+                       bool increment_counter, uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t* out) {
+    using namespace blake3_detail;
+
+    V h[8];
+    for (int i = 0; i < 8; ++i) {
+        h[i] = V{} + key[i];
+    }
+    V counter_low = V{};
+    V counter_high = V{};
+    for (size_t lane = 0; lane < N; ++lane) {
+        const uint64_t c = counter + (increment_counter ? lane : 0);
+        counter_low[lane] = static_cast<uint32_t>(c);
+        counter_high[lane] = static_cast<uint32_t>(c >> 32);
+    }
+
+    uint8_t block_flags = flags | flags_start;
+    for (size_t b = 0; b < blocks; ++b) {
+        if (b + 1 == blocks) {
+            block_flags |= flags_end;
+        }
+
+        // 转置：第 w 个消息字向量由各输入同一位置的字组成
+        V m[16];
+        for (int w = 0; w < 16; ++w) {
+            for (size_t lane = 0; lane < N; ++lane) {
+                m[w][lane] = load32(inputs[lane] + b * block_len + 4 * w);
+            }
+        }
+
+        V v[16] = {
+            h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+            V{} + iv[0], V{} + iv[1], V{} + iv[2], V{} + iv[3],
+            counter_low, counter_high, V{} + static_cast<uint32_t>(block_len), V{} + static_cast<uint32_t>(block_flags),
+        };
+        for (int r = 0; r < 7; ++r) {
+            const uint8_t* s = msg_schedule[r];
+            g(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+            g(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+            g(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+            g(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+            g(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+            g(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+            g(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+            g(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+        }
+        for (int i = 0; i < 8; ++i) {
+            h[i] = v[i] ^ v[i + 8];
+        }
+        block_flags = flags;
+    }
+
+    for (size_t lane = 0; lane < N; ++lane) {
+        for (int i = 0; i < 8; ++i) {
+            store32(out + lane * 32 + 4 * i, h[i][lane]);
+        }
+    }
+}
+
+/**
+ * 每次处理 N 个输入，剩余不足 N 个时交给可移植实现
+ */
+template <typename V, size_t N>
+inline void hash_many_vector(const uint8_t* const* inputs, size_t num_inputs, size_t blocks, const uint32_t key[8],
+                             uint64_t counter, bool increment_counter, uint8_t flags, uint8_t flags_start,
+                             uint8_t flags_end, uint8_t* out) {
+    while (num_inputs >= N) {
+        hash_lanes<V, N>(inputs, blocks, key, counter, increment_counter, flags, flags_start, flags_end, out);
+        if (increment_counter) {
+            counter += N;
+        }
+        inputs += N;
+        num_inputs -= N;
+        out += N * 32;
+    }
+    if (num_inputs > 0) {
+        blake3_detail::hash_many_portable(inputs, num_inputs, blocks, key, counter, increment_counter, flags,
+                                          flags_start, flags_end, out);
+    }
+}
+
+}  // namespace
@@ -0,0 +1,209 @@
+#include "common/buffer_pool.h"
+
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace buffer_pool_detail {
+
+uint32_t ring_capacity(uint32_t buffers) {
+    uint32_t capacity = 2;
+    while (capacity < buffers) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+/**
+ * 池的全部状态；buffer_pool 和线程退出时的归还共同持有
+ */
+struct pool_core {
+    explicit pool_core(const buffer_pool_options& options)
+        : buffer_size(options.buffer_size),
+          stride((options.buffer_size + ring_buffer_detail::cache_line_size - 1) &
+                 ~(ring_buffer_detail::cache_line_size - 1)),
+          capacity(options.buffers),
+          magazine_size(options.magazine_size),
+          free(ring_capacity(options.buffers)) {
+        region = ring_buffer_detail::allocate(stride * capacity, ring_buffer_detail::cache_line_size, options.memory);
+        std::vector<uint32_t> all(capacity);
+        for (uint32_t i = 0; i < capacity; ++i) {
+            all[i] = i;
+        }
+        free.push_n(all.begin(), all.end());
+    }
+
+    ~pool_core() {
+        ring_buffer_detail::deallocate(region);
+    }
+
+    pool_core(const pool_core&) = delete;
+    pool_core& operator=(const pool_core&) = delete;
+
+    uint8_t* buffer(uint32_t index) const {
+        return static_cast<uint8_t*>(region.base) + size_t(index) * stride;
+    }
+
+    bool take(uint32_t& index);
+    void give(uint32_t index);
+
+    const size_t buffer_size;
+    const size_t stride;
+    const uint32_t capacity;
+    const uint32_t magazine_size;
+    ring_buffer_detail::memory_region region;
+    ring_buffer<uint32_t, dynamic_capacity> free;  // 容量不小于缓冲区总数，归还永远不会失败
+    std::atomic<uint64_t> exhausted{0};
+    std::weak_ptr<pool_core> self;
+};
+
+namespace {
+
+/**
+ * 一个线程对一个池的缓存
+ */
+struct magazine {
+    pool_core* core;
+    std::weak_ptr<pool_core> owner;
+    std::vector<uint32_t> indices;
+};
+
+/**
+ * 本线程的所有缓存；线程退出时还给仍然存在的池
+ */
+struct thread_cache {
+    std::vector<magazine> magazines;
+
+    ~thread_cache() {
+        for (auto& m : magazines) {
+            if (std::shared_ptr<pool_core> core = m.owner.lock()) {
+                core->free.push_n(m.indices.begin(), m.indices.end());
+            }
+        }
+    }
+
+    magazine& find(pool_core* core) {
+        for (size_t i = 0; i < magazines.size();) {
+            magazine& m = magazines[i];
+            if (m.owner.expired()) {
+                // 池已经销毁；地址可能被新的池重用，先清掉旧的缓存
+                magazines.erase(magazines.begin() + static_cast<std::ptrdiff_t>(i));
+                continue;
+            }
+            if (m.core == core) {
+                return m;
+            }
+            ++i;
+        }
+        magazines.push_back(magazine{core, core->self, {}});
+        magazines.back().indices.reserve(core->magazine_size);
+        return magazines.back();
+    }
+};
+
+thread_local thread_cache local_cache;
+
+}  // namespace
+
+bool pool_core::take(uint32_t& index) {
+    if (magazine_size == 0) {
+        return free.get(index);
+    }
+    magazine& m = local_cache.find(this);
+    if (m.indices.empty()) {
+        // 一次从全局列表取半个缓存，剩下的空间留给之后的归还
+        free.get_n(std::back_inserter(m.indices), magazine_size / 2 + 1);
+        if (m.indices.empty()) {
+            return false;
+        }
+    }
+    index = m.indices.back();
+    m.indices.pop_back();
+    return true;
+}
+
+void pool_core::give(uint32_t index) {
+    if (magazine_size == 0) {
+        free.push_n(&index, &index + 1);
+        return;
+    }
+    magazine& m = local_cache.find(this);
+    if (m.indices.size() >= magazine_size) {
+        // 缓存满：把最早放入的一半还给全局列表
+        const size_t half = m.indices.size() / 2;
+        free.push_n(m.indices.begin(), m.indices.begin() + static_cast<std::ptrdiff_t>(half));
+        m.indices.erase(m.indices.begin(), m.indices.begin() + static_cast<std::ptrdiff_t>(half));
+    }
+    m.indices.push_back(index);
+}
+
+}  // namespace buffer_pool_detail
+
+void pooled_buffer::reset() {
+    if (core_ == nullptr) {
+        return;
+    }
+    core_->give(index_);
+    if (quota_ != nullptr) {
+        quota_->used_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    core_ = nullptr;
+    quota_ = nullptr;
+    data_ = nullptr;
+}
+
+buffer_pool::buffer_pool(const buffer_pool_options& options) {
+    if (options.buffer_size == 0 || options.buffers == 0 || options.buffers > (1u << 31)) {
+        throw std::invalid_argument("buffer pool needs a positive buffer size and count");
+    }
+    core_ = std::make_shared<buffer_pool_detail::pool_core>(options);
+    core_->self = core_;
+}
+
+buffer_pool::~buffer_pool() {}
+
+pooled_buffer buffer_pool::try_acquire() {
+    pooled_buffer result;
+    uint32_t index;
+    if (!core_->take(index)) {
+        core_->exhausted.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+    result.core_ = core_.get();
+    result.data_ = core_->buffer(index);
+    result.index_ = index;
+    return result;
+}
+
+pooled_buffer buffer_pool::try_acquire(buffer_quota& quota) {
+    if (quota.used_.fetch_add(1, std::memory_order_relaxed) >= quota.limit_) {
+        quota.used_.fetch_sub(1, std::memory_order_relaxed);
+        core_->exhausted.fetch_add(1, std::memory_order_relaxed);
+        return pooled_buffer();
+    }
+    pooled_buffer result = try_acquire();
+    if (!result) {
+        quota.used_.fetch_sub(1, std::memory_order_relaxed);
+        return result;
+    }
+    result.quota_ = &quota;
+    return result;
+}
+
+size_t buffer_pool::buffer_size() const {
+    return core_->buffer_size;
+}
+
+uint32_t buffer_pool::capacity() const {
+    return core_->capacity;
+}
+
+buffer_pool_stats buffer_pool::stats() const {
+    buffer_pool_stats stats;
+    stats.capacity = core_->capacity;
+    stats.buffer_size = core_->buffer_size;
+    stats.reserved_bytes = core_->region.bytes;
+    stats.shared_free = static_cast<uint32_t>(core_->free.size_approx());
+    stats.exhausted = core_->exhausted.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,38 @@
+#pragma once
+// 变化检测的平台后端，只在 common 库内部使用
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "common/change_watcher.h"
+
+/**
+ * 平台事件来源
+ *
+ * poll 在后台线程中调用，等待最多 timeout，把期间收到的原始事件逐条交给 on_change；
+ * 事件丢失时以 change_kind::rescan 报告。wake 可以在任意线程调用，让正在等待的 poll 尽快返回。
+ */
+class change_backend {
+public:
+    using change_callback = std::function<void(std::string path, change_kind kind)>;
+
+    virtual ~change_backend() {}
+
+    virtual void poll(std::chrono::milliseconds timeout, const change_callback& on_change) = 0;
+
+    virtual void wake() = 0;
+
+    virtual const char* name() const = 0;
+};
+
+/**
+ * 为当前平台创建后端，root 为规范化后的绝对路径
+ */
+std::unique_ptr<change_backend> make_change_backend(const std::string& root, const change_watcher_options& options);
+
+/**
+ * 规范化路径（解析符号链接，得到绝对路径），失败时抛出 std::system_error
+ */
+std::string canonical_watch_root(const std::string& root);
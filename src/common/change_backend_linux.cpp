@@ -0,0 +1,391 @@
+// Linux 变化检测后端：fanotify（整个文件系统一个标记）和 inotify（每个目录一个监视）
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __has_include(<sys/fanotify.h>)
+#include <sys/fanotify.h>
+#endif
+
+#include "change_backend.h"
+
+namespace {
+
+std::string join_path(const std::string& dir, const char* name) {
+    return dir == "/" ? dir + name : dir + "/" + name;
+}
+
+bool within(const std::string& path, const std::string& root) {
+    if (path.compare(0, root.size(), root) != 0) {
+        return false;
+    }
+    return path.size() == root.size() || path[root.size()] == '/' || root == "/";
+}
+
+/**
+ * 遍历目录树，对每个目录调用 on_dir（返回 false 时不再进入该目录），对其他条目调用 on_file
+ *
+ * 不跟随符号链接；遍历过程中消失的条目直接跳过。
+ */
+template <typename OnDir, typename OnFile>
+void walk_tree(const std::string& path, OnDir&& on_dir, OnFile&& on_file) {
+    if (!on_dir(path)) {
+        return;
+    }
+    DIR* dir = ::opendir(path.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+    std::vector<std::string> subdirs;
+    while (dirent* entry = ::readdir(dir)) {
+        if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        std::string child = join_path(path, entry->d_name);
+        bool is_dir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            is_dir = ::lstat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (is_dir) {
+            subdirs.push_back(std::move(child));
+        } else {
+            on_file(child);
+        }
+    }
+    ::closedir(dir);
+    for (const auto& subdir : subdirs) {
+        walk_tree(subdir, on_dir, on_file);
+    }
+}
+
+/**
+ * 两个后端共用的等待逻辑：事件描述符加一个用于唤醒的 eventfd
+ */
+class fd_backend : public change_backend {
+protected:
+    int fd_ = -1;
+    int wake_fd_ = -1;
+    std::string root_;
+    std::vector<uint8_t> buffer_ = std::vector<uint8_t>(64 * 1024);
+
+    explicit fd_backend(const std::string& root) : root_(root) {
+        wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "eventfd");
+        }
+    }
+
+    // 读取并处理一批事件，返回 false 表示暂时没有更多事件
+    virtual bool drain(const change_callback& on_change) = 0;
+
+public:
+    ~fd_backend() override {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        ::close(wake_fd_);
+    }
+
+    void poll(std::chrono::milliseconds timeout, const change_callback& on_change) override {
+        pollfd fds[2] = {{fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+        const int ready = ::poll(fds, 2, static_cast<int>(timeout.count()));
+        if (ready <= 0) {
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t value;
+            (void)::read(wake_fd_, &value, sizeof(value));
+        }
+        if (fds[0].revents & POLLIN) {
+            while (drain(on_change)) {
+            }
+        }
+    }
+
+    void wake() override {
+        const uint64_t one = 1;
+        (void)::write(wake_fd_, &one, sizeof(one));
+    }
+};
+
+class inotify_backend : public fd_backend {
+private:
+    static constexpr uint32_t watch_mask = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE |
+                                           IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+    // 监视描述符 -> 目录路径
+    std::unordered_map<int, std::string> watches_;
+
+    // 监视数量达到 max_user_watches 后无法再完整覆盖，只报告一次溢出
+    bool watch_limit_reported_ = false;
+
+    /**
+     * 监视目录树；on_change 不为空时把树下已有的文件报告为 modified
+     * （新建或移入的目录在添加监视之前就可能已经有内容）
+     */
+    void add_tree(const std::string& path, const change_callback* on_change) {
+        walk_tree(
+            path,
+            [&](const std::string& dir) {
+                const int wd = ::inotify_add_watch(fd_, dir.c_str(), watch_mask);
+                if (wd < 0) {
+                    if ((errno == ENOSPC || errno == ENOMEM) && on_change != nullptr && !watch_limit_reported_) {
+                        watch_limit_reported_ = true;
+                        (*on_change)(root_, change_kind::rescan);
+                    }
+                    return false;
+                }
+                // 同一目录再次添加时返回原来的描述符，这里顺便更新移动后的路径
+                watches_[wd] = dir;
+                if (on_change != nullptr && dir != path) {
+                    (*on_change)(dir, change_kind::modified);
+                }
+                return true;
+            },
+            [&](const std::string& file) {
+                if (on_change != nullptr) {
+                    (*on_change)(file, change_kind::modified);
+                }
+            });
+    }
+
+    // 目录被移出（或在树内移动）时移除其下的监视，移入时由 add_tree 重新添加
+    void remove_tree(const std::string& path) {
+        for (auto it = watches_.begin(); it != watches_.end();) {
+            if (within(it->second, path)) {
+                ::inotify_rm_watch(fd_, it->first);
+                it = watches_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void handle(const inotify_event& event, const change_callback& on_change) {
+        if (event.mask & IN_Q_OVERFLOW) {
+            on_change(root_, change_kind::rescan);
+            return;
+        }
+        auto it = watches_.find(event.wd);
+        if (it == watches_.end()) {
+            return;
+        }
+        if (event.mask & IN_IGNORED) {
+            watches_.erase(it);
+            return;
+        }
+        if (event.len == 0) {
+            // 目录自身的属性变化
+            on_change(it->second, change_kind::modified);
+            return;
+        }
+
+        std::string path = join_path(it->second, event.name);
+        const bool is_dir = (event.mask & IN_ISDIR) != 0;
+        if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+            if (is_dir && (event.mask & IN_MOVED_FROM)) {
+                remove_tree(path);
+            }
+            on_change(std::move(path), change_kind::removed);
+        } else if (is_dir && (event.mask & (IN_CREATE | IN_MOVED_TO))) {
+            add_tree(path, &on_change);
+            on_change(std::move(path), change_kind::modified);
+        } else {
+            on_change(std::move(path), change_kind::modified);
+        }
+    }
+
+    bool drain(const change_callback& on_change) override {
+        const ssize_t n = ::read(fd_, buffer_.data(), buffer_.size());
+        if (n <= 0) {
+            return false;
+        }
+        // 内核按 inotify_event 的对齐写入，buffer_ 来自堆分配，可以直接按结构访问
+        for (ssize_t offset = 0; offset < n;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer_.data() + offset);
+            handle(*event, on_change);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        }
+        return true;
+    }
+
+public:
+    explicit inotify_backend(const std::string& root) : fd_backend(root) {
+        fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "inotify_init1");
+        }
+        if (::inotify_add_watch(fd_, root_.c_str(), watch_mask) < 0) {
+            throw std::system_error(errno, std::generic_category(), "inotify_add_watch " + root_);
+        }
+        add_tree(root_, nullptr);
+    }
+
+    const char* name() const override {
+        return "inotify";
+    }
+};
+
+#if defined(FAN_REPORT_DFID_NAME)
+
+class fanotify_backend : public fd_backend {
+private:
+    // 用于 open_by_handle_at 的根目录描述符
+    int mount_fd_ = -1;
+
+    // 把目录句柄解析成路径；目录已经被删除时返回 false
+    bool resolve(file_handle* handle, std::string& path) {
+        const int dir_fd = ::open_by_handle_at(mount_fd_, handle, O_PATH | O_CLOEXEC);
+        if (dir_fd < 0) {
+            return false;
+        }
+        char link[64];
+        std::snprintf(link, sizeof(link), "/proc/self/fd/%d", dir_fd);
+        char target[4096];
+        const ssize_t length = ::readlink(link, target, sizeof(target));
+        ::close(dir_fd);
+        if (length <= 0 || length == static_cast<ssize_t>(sizeof(target))) {
+            return false;
+        }
+        path.assign(target, static_cast<size_t>(length));
+        return true;
+    }
+
+    void handle(const fanotify_event_metadata& meta, const uint8_t* info, const change_callback& on_change) {
+        if (meta.mask & FAN_Q_OVERFLOW) {
+            on_change(root_, change_kind::rescan);
+            return;
+        }
+        const uint8_t* end = info + (meta.event_len - meta.metadata_len);
+        while (info + sizeof(fanotify_event_info_header) <= end) {
+            fanotify_event_info_header header;
+            std::memcpy(&header, info, sizeof(header));
+            if (header.len == 0) {
+                break;
+            }
+            if (header.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                // 记录中依次是 fsid、file_handle 和以 0 结尾的文件名，先复制出来保证对齐
+                std::vector<uint8_t> record(info, info + header.len);
+                auto* fid = reinterpret_cast<fanotify_event_info_fid*>(record.data());
+                auto* handle = reinterpret_cast<file_handle*>(fid->handle);
+                const char* name = reinterpret_cast<const char*>(handle->f_handle + handle->handle_bytes);
+
+                std::string path;
+                if (resolve(handle, path)) {
+                    if (std::strcmp(name, ".") != 0) {
+                        path = join_path(path, name);
+                    }
+                    if (within(path, root_)) {
+                        report(meta.mask, std::move(path), on_change);
+                    }
+                }
+            }
+            info += header.len;
+        }
+    }
+
+    void report(uint64_t mask, std::string path, const change_callback& on_change) {
+        if (mask & (FAN_DELETE | FAN_MOVED_FROM)) {
+            on_change(std::move(path), change_kind::removed);
+            return;
+        }
+        if ((mask & FAN_ONDIR) && (mask & FAN_MOVED_TO)) {
+            // 移入的目录不会为其中已有的文件产生事件
+            walk_tree(
+                path,
+                [&](const std::string& dir) {
+                    on_change(dir, change_kind::modified);
+                    return true;
+                },
+                [&](const std::string& file) { on_change(file, change_kind::modified); });
+            return;
+        }
+        on_change(std::move(path), change_kind::modified);
+    }
+
+    bool drain(const change_callback& on_change) override {
+        const ssize_t n = ::read(fd_, buffer_.data(), buffer_.size());
+        if (n <= 0) {
+            return false;
+        }
+        size_t offset = 0;
+        while (offset + sizeof(fanotify_event_metadata) <= static_cast<size_t>(n)) {
+            fanotify_event_metadata meta;
+            std::memcpy(&meta, buffer_.data() + offset, sizeof(meta));
+            if (meta.event_len < meta.metadata_len || offset + meta.event_len > static_cast<size_t>(n)) {
+                break;
+            }
+            if (meta.fd >= 0) {
+                ::close(meta.fd);
+            }
+            handle(meta, buffer_.data() + offset + meta.metadata_len, on_change);
+            offset += meta.event_len;
+        }
+        return true;
+    }
+
+public:
+    explicit fanotify_backend(const std::string& root) : fd_backend(root) {
+        fd_ = ::fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "fanotify_init");
+        }
+        const uint64_t mask = FAN_MODIFY | FAN_CLOSE_WRITE | FAN_ATTRIB | FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM |
+                              FAN_MOVED_TO | FAN_ONDIR;
+        if (::fanotify_mark(fd_, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask, AT_FDCWD, root_.c_str()) != 0) {
+            throw std::system_error(errno, std::generic_category(), "fanotify_mark " + root_);
+        }
+        mount_fd_ = ::open(root_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (mount_fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + root_);
+        }
+    }
+
+    ~fanotify_backend() override {
+        if (mount_fd_ >= 0) {
+            ::close(mount_fd_);
+        }
+    }
+
+    const char* name() const override {
+        return "fanotify";
+    }
+};
+
+#endif
+
+}  // namespace
+
+std::unique_ptr<change_backend> make_change_backend(const std::string& root, const change_watcher_options& options) {
+#if defined(FAN_REPORT_DFID_NAME)
+    if (options.backend == watch_backend::fanotify) {
+        return std::make_unique<fanotify_backend>(root);
+    }
+    if (options.backend == watch_backend::automatic) {
+        try {
+            return std::make_unique<fanotify_backend>(root);
+        } catch (const std::system_error&) {
+            // 没有 CAP_SYS_ADMIN 或内核太旧，退回 inotify
+        }
+    }
+#else
+    if (options.backend == watch_backend::fanotify) {
+        throw std::invalid_argument("fanotify with FAN_REPORT_DFID_NAME is not available");
+    }
+#endif
+    return std::make_unique<inotify_backend>(root);
+}
@@ -0,0 +1,122 @@
+// macOS 变化检测后端：FSEvents（文件级事件）
+
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <CoreServices/CoreServices.h>
+#include <dispatch/dispatch.h>
+#include <sys/stat.h>
+
+#include "change_backend.h"
+
+namespace {
+
+/**
+ * FSEvents 在自己的调度队列上回调，回调中只把事件放进待取列表，由 poll 在后台线程中取走
+ */
+class fsevents_backend : public change_backend {
+private:
+    struct raw_change {
+        std::string path;
+        change_kind kind;
+    };
+
+    std::string root_;
+    dispatch_queue_t queue_ = nullptr;
+    FSEventStreamRef stream_ = nullptr;
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::vector<raw_change> changes_;
+    bool woken_ = false;
+
+    static void callback(ConstFSEventStreamRef, void* info, size_t count, void* paths,
+                         const FSEventStreamEventFlags* flags, const FSEventStreamEventId*) {
+        auto* self = static_cast<fsevents_backend*>(info);
+        char** names = static_cast<char**>(paths);
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        for (size_t i = 0; i < count; ++i) {
+            const FSEventStreamEventFlags flag = flags[i];
+            if (flag & (kFSEventStreamEventFlagMustScanSubDirs | kFSEventStreamEventFlagUserDropped |
+                        kFSEventStreamEventFlagKernelDropped | kFSEventStreamEventFlagRootChanged)) {
+                self->changes_.push_back(raw_change{self->root_, change_kind::rescan});
+                continue;
+            }
+            // 一条事件可能合并了创建、删除和重命名，以文件当前是否存在为准
+            struct stat st;
+            const bool exists = ::lstat(names[i], &st) == 0;
+            self->changes_.push_back(raw_change{names[i], exists ? change_kind::modified : change_kind::removed});
+        }
+        self->ready_.notify_one();
+    }
+
+public:
+    explicit fsevents_backend(const std::string& root) : root_(root) {
+        CFStringRef path = CFStringCreateWithCString(nullptr, root_.c_str(), kCFStringEncodingUTF8);
+        CFArrayRef paths = CFArrayCreate(nullptr, reinterpret_cast<const void**>(&path), 1, &kCFTypeArrayCallBacks);
+        FSEventStreamContext context = {0, this, nullptr, nullptr, nullptr};
+        // 去抖由 change_watcher 完成，这里只保留很小的合并延迟
+        stream_ = FSEventStreamCreate(nullptr, &fsevents_backend::callback, &context, paths,
+                                      kFSEventStreamEventIdSinceNow, 0.01,
+                                      kFSEventStreamCreateFlagFileEvents | kFSEventStreamCreateFlagNoDefer |
+                                          kFSEventStreamCreateFlagWatchRoot);
+        CFRelease(paths);
+        CFRelease(path);
+        if (stream_ == nullptr) {
+            throw std::system_error(EINVAL, std::generic_category(), "FSEventStreamCreate " + root_);
+        }
+        queue_ = dispatch_queue_create("sync.change_watcher", DISPATCH_QUEUE_SERIAL);
+        FSEventStreamSetDispatchQueue(stream_, queue_);
+        if (!FSEventStreamStart(stream_)) {
+            FSEventStreamInvalidate(stream_);
+            FSEventStreamRelease(stream_);
+            dispatch_release(queue_);
+            throw std::system_error(EIO, std::generic_category(), "FSEventStreamStart " + root_);
+        }
+    }
+
+    ~fsevents_backend() override {
+        FSEventStreamStop(stream_);
+        FSEventStreamInvalidate(stream_);
+        FSEventStreamRelease(stream_);
+        // 等调度队列上已经排队的回调执行完，之后不会再访问 this
+        dispatch_sync(queue_, ^{});
+        dispatch_release(queue_);
+    }
+
+    void poll(std::chrono::milliseconds timeout, const change_callback& on_change) override {
+        std::vector<raw_change> changes;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait_for(lock, timeout, [this] { return woken_ || !changes_.empty(); });
+            woken_ = false;
+            changes.swap(changes_);
+        }
+        for (auto& change : changes) {
+            on_change(std::move(change.path), change.kind);
+        }
+    }
+
+    void wake() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        woken_ = true;
+        ready_.notify_one();
+    }
+
+    const char* name() const override {
+        return "fsevents";
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<change_backend> make_change_backend(const std::string& root, const change_watcher_options& options) {
+    if (options.backend != watch_backend::automatic) {
+        throw std::invalid_argument("inotify and fanotify are only available on Linux");
+    }
+    return std::make_unique<fsevents_backend>(root);
+}
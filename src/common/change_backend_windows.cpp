@@ -0,0 +1,129 @@
+// Windows 变化检测后端：ReadDirectoryChangesW（监视整棵子树）
+
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include <windows.h>
+
+#include "change_backend.h"
+
+namespace {
+
+std::string to_utf8(const wchar_t* text, int length) {
+    const int bytes = WideCharToMultiByte(CP_UTF8, 0, text, length, nullptr, 0, nullptr, nullptr);
+    std::string result(static_cast<size_t>(bytes), '\0');
+    WideCharToMultiByte(CP_UTF8, 0, text, length, &result[0], bytes, nullptr, nullptr);
+    return result;
+}
+
+class win32_backend : public change_backend {
+private:
+    static constexpr DWORD notify_filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                                           FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE |
+                                           FILE_NOTIFY_CHANGE_LAST_WRITE;
+
+    std::string root_;
+    HANDLE directory_ = INVALID_HANDLE_VALUE;
+    HANDLE io_event_ = nullptr;
+    HANDLE wake_event_ = nullptr;
+    OVERLAPPED overlapped_ = {};
+    bool pending_read_ = false;
+
+    // FILE_NOTIFY_INFORMATION 要求 DWORD 对齐
+    std::vector<DWORD> buffer_ = std::vector<DWORD>(64 * 1024 / sizeof(DWORD));
+
+    void issue_read() {
+        ResetEvent(io_event_);
+        overlapped_ = {};
+        overlapped_.hEvent = io_event_;
+        pending_read_ = ReadDirectoryChangesW(directory_, buffer_.data(), static_cast<DWORD>(buffer_.size() * sizeof(DWORD)),
+                                              TRUE, notify_filter, nullptr, &overlapped_, nullptr) != 0;
+    }
+
+    void parse(DWORD bytes, const change_callback& on_change) {
+        const auto* base = reinterpret_cast<const uint8_t*>(buffer_.data());
+        for (DWORD offset = 0;;) {
+            const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(base + offset);
+            std::string name = to_utf8(info->FileName, static_cast<int>(info->FileNameLength / sizeof(wchar_t)));
+            std::string path = root_ + "\\" + name;
+            const bool removed = info->Action == FILE_ACTION_REMOVED || info->Action == FILE_ACTION_RENAMED_OLD_NAME;
+            on_change(std::move(path), removed ? change_kind::removed : change_kind::modified);
+            if (info->NextEntryOffset == 0 || offset + info->NextEntryOffset >= bytes) {
+                break;
+            }
+            offset += info->NextEntryOffset;
+        }
+    }
+
+public:
+    explicit win32_backend(const std::string& root) : root_(root) {
+        directory_ = CreateFileA(root_.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                 nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (directory_ == INVALID_HANDLE_VALUE) {
+            throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "watch " + root_);
+        }
+        io_event_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        wake_event_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        issue_read();
+        if (!pending_read_) {
+            const DWORD error = GetLastError();
+            CloseHandle(directory_);
+            CloseHandle(io_event_);
+            CloseHandle(wake_event_);
+            throw std::system_error(static_cast<int>(error), std::system_category(), "ReadDirectoryChangesW " + root_);
+        }
+    }
+
+    ~win32_backend() override {
+        CancelIoEx(directory_, &overlapped_);
+        DWORD bytes;
+        GetOverlappedResult(directory_, &overlapped_, &bytes, TRUE);
+        CloseHandle(directory_);
+        CloseHandle(io_event_);
+        CloseHandle(wake_event_);
+    }
+
+    void poll(std::chrono::milliseconds timeout, const change_callback& on_change) override {
+        if (!pending_read_) {
+            issue_read();
+            if (!pending_read_) {
+                on_change(root_, change_kind::rescan);
+                Sleep(static_cast<DWORD>(timeout.count()));
+                return;
+            }
+        }
+        HANDLE handles[2] = {io_event_, wake_event_};
+        const DWORD result = WaitForMultipleObjects(2, handles, FALSE, static_cast<DWORD>(timeout.count()));
+        if (result != WAIT_OBJECT_0) {
+            return;
+        }
+        DWORD bytes = 0;
+        const BOOL ok = GetOverlappedResult(directory_, &overlapped_, &bytes, FALSE);
+        pending_read_ = false;
+        // 缓冲区装不下这段时间的全部变化时系统返回 0 字节（或 ERROR_NOTIFY_ENUM_DIR），事件已丢失
+        if (!ok || bytes == 0) {
+            on_change(root_, change_kind::rescan);
+        } else {
+            parse(bytes, on_change);
+        }
+        issue_read();
+    }
+
+    void wake() override {
+        SetEvent(wake_event_);
+    }
+
+    const char* name() const override {
+        return "ReadDirectoryChangesW";
+    }
+};
+
+}  // namespace
+
+std::unique_ptr<change_backend> make_change_backend(const std::string& root, const change_watcher_options& options) {
+    if (options.backend != watch_backend::automatic) {
+        throw std::invalid_argument("inotify and fanotify are only available on Linux");
+    }
+    return std::make_unique<win32_backend>(root);
+}
@@ -0,0 +1,128 @@
+#include "common/change_watcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "change_backend.h"
+
+std::string canonical_watch_root(const std::string& root) {
+#if defined(_WIN32)
+    char full[MAX_PATH];
+    const DWORD length = GetFullPathNameA(root.c_str(), MAX_PATH, full, nullptr);
+    if (length == 0 || length >= MAX_PATH) {
+        throw std::system_error(static_cast<int>(GetLastError()), std::system_category(), "watch " + root);
+    }
+    const DWORD attributes = GetFileAttributesA(full);
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        throw std::system_error(ENOTDIR, std::generic_category(), "watch " + root);
+    }
+    std::string result(full, length);
+#else
+    char* resolved = ::realpath(root.c_str(), nullptr);
+    if (resolved == nullptr) {
+        throw std::system_error(errno, std::generic_category(), "watch " + root);
+    }
+    std::string result(resolved);
+    std::free(resolved);
+    struct stat st;
+    if (::stat(result.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        throw std::system_error(ENOTDIR, std::generic_category(), "watch " + root);
+    }
+#endif
+    // 根目录本身不带结尾的分隔符，拼接子路径时统一加一个
+    while (result.size() > 1 && (result.back() == '/' || result.back() == '\\')) {
+        result.pop_back();
+    }
+    return result;
+}
+
+change_watcher::change_watcher(const std::string& root, const change_watcher_options& options)
+    : root_(canonical_watch_root(root)), options_(options), queue_(options.queue_capacity) {
+    backend_ = make_change_backend(root_, options_);
+    thread_ = std::thread([this] { run(); });
+}
+
+change_watcher::~change_watcher() {
+    stop();
+}
+
+void change_watcher::stop() {
+    if (stopping_.exchange(true)) {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        return;
+    }
+    backend_->wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    queue_.close();
+}
+
+const char* change_watcher::backend_name() const {
+    return backend_->name();
+}
+
+void change_watcher::run() {
+    const auto on_change = [this](std::string path, change_kind kind) {
+        record(std::move(path), kind, std::chrono::steady_clock::now());
+    };
+    // 没有待输出的路径时只需要偶尔醒来检查是否停止
+    const std::chrono::milliseconds idle_timeout(500);
+    const std::chrono::milliseconds busy_timeout =
+        std::max(std::chrono::milliseconds(1), std::min(options_.debounce, options_.max_latency) / 2);
+
+    while (!stopping_.load(std::memory_order_acquire)) {
+        const bool busy = rescan_pending_ || !pending_.empty();
+        backend_->poll(busy ? busy_timeout : idle_timeout, on_change);
+        flush(std::chrono::steady_clock::now(), false);
+    }
+    flush(std::chrono::steady_clock::now(), true);
+}
+
+void change_watcher::record(std::string path, change_kind kind, std::chrono::steady_clock::time_point now) {
+    if (kind == change_kind::rescan || pending_.size() >= options_.max_pending) {
+        // 之前合并的路径都包含在完整扫描里
+        pending_.clear();
+        rescan_pending_ = true;
+        overflows_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    auto inserted = pending_.emplace(std::move(path), pending_change{kind, now, now});
+    if (!inserted.second) {
+        // 同一路径只保留最后一种变化，去抖计时从这次事件重新开始
+        inserted.first->second.kind = kind;
+        inserted.first->second.last_seen = now;
+    }
+}
+
+void change_watcher::flush(std::chrono::steady_clock::time_point now, bool force) {
+    if (rescan_pending_) {
+        if (!queue_.push(change_event{root_, change_kind::rescan})) {
+            return;
+        }
+        rescan_pending_ = false;
+    }
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        const pending_change& change = it->second;
+        if (!force && now - change.last_seen < options_.debounce && now - change.first_seen < options_.max_latency) {
+            ++it;
+            continue;
+        }
+        // 队列满时留在合并表里，期间的新事件继续合并到同一条目
+        if (!queue_.push(change_event{it->first, change.kind})) {
+            return;
+        }
+        it = pending_.erase(it);
+    }
+}
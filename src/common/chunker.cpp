@@ -0,0 +1,138 @@
+#include "common/chunker.h"
+#include "common/file_reader.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// 由固定种子通过 splitmix64 生成的 gear 表，两端必须完全一致
+struct gear_table {
+    uint64_t values[256];
+
+    constexpr gear_table() : values() {
+        uint64_t state = 0x5F3759DF1BADB002ULL;
+        for (int i = 0; i < 256; ++i) {
+            state += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            values[i] = z ^ (z >> 31);
+        }
+    }
+};
+
+constexpr gear_table gear;
+
+// gear 哈希的第 k 位只受最近 k+1 个字节影响，掩码取高位，让判断覆盖完整的 64 字节窗口
+uint64_t high_bits_mask(int bits) {
+    if (bits <= 0) {
+        return 0;
+    }
+    if (bits >= 64) {
+        return ~0ULL;
+    }
+    return ((1ULL << bits) - 1) << (64 - bits);
+}
+
+int floor_log2(uint32_t value) {
+    int bits = 0;
+    while (value > 1) {
+        value >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+}  // namespace
+
+fastcdc_chunker::fastcdc_chunker(const fastcdc_options& options) : options_(options) {
+    if (options_.min_size < 64 || options_.min_size > options_.avg_size || options_.avg_size > options_.max_size) {
+        throw std::invalid_argument("fastcdc sizes must satisfy 64 <= min <= avg <= max");
+    }
+    // 归一化等级 2：平均大小前后的掩码各相差两位
+    const int bits = floor_log2(options_.avg_size);
+    mask_small_ = high_bits_mask(bits + 2);
+    mask_large_ = high_bits_mask(bits - 2);
+}
+
+size_t fastcdc_chunker::next_boundary(const uint8_t* data, size_t size) const {
+    if (size <= options_.min_size) {
+        return size;
+    }
+    const size_t limit = size < options_.max_size ? size : options_.max_size;
+    const size_t normal = limit < options_.avg_size ? limit : options_.avg_size;
+
+    uint64_t hash = 0;
+    size_t i = options_.min_size;
+    // 每次处理两个字节，减少循环判断；边界位置与逐字节处理完全相同
+    for (; i + 1 < normal; i += 2) {
+        hash = (hash << 1) + gear.values[data[i]];
+        if ((hash & mask_small_) == 0) {
+            return i + 1;
+        }
+        hash = (hash << 1) + gear.values[data[i + 1]];
+        if ((hash & mask_small_) == 0) {
+            return i + 2;
+        }
+    }
+    for (; i < normal; ++i) {
+        hash = (hash << 1) + gear.values[data[i]];
+        if ((hash & mask_small_) == 0) {
+            return i + 1;
+        }
+    }
+    for (; i + 1 < limit; i += 2) {
+        hash = (hash << 1) + gear.values[data[i]];
+        if ((hash & mask_large_) == 0) {
+            return i + 1;
+        }
+        hash = (hash << 1) + gear.values[data[i + 1]];
+        if ((hash & mask_large_) == 0) {
+            return i + 2;
+        }
+    }
+    for (; i < limit; ++i) {
+        hash = (hash << 1) + gear.values[data[i]];
+        if ((hash & mask_large_) == 0) {
+            return i + 1;
+        }
+    }
+    return limit;
+}
+
+std::vector<chunk_span> fastcdc_chunker::split(const void* data, size_t size) const {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    std::vector<chunk_span> spans;
+    spans.reserve(size / options_.avg_size + 1);
+    size_t offset = 0;
+    while (offset < size) {
+        const size_t length = next_boundary(bytes + offset, size - offset);
+        spans.push_back(chunk_span{offset, static_cast<uint32_t>(length)});
+        offset += length;
+    }
+    return spans;
+}
+
+std::vector<chunk_span> fastcdc_chunker::split_file(const std::string& path) const {
+    const file_reader reader(path);
+
+    // 每次取一段至少容纳若干个最大分块的视图；视图内剩余不足一个最大分块且没到文件末尾时，
+    // 从下一个分块的起点重新取，保证边界与一次性读入整个文件时相同
+    const size_t view_size = std::max<size_t>(size_t(options_.max_size) * 4, 4u << 20);
+    std::vector<chunk_span> spans;
+    uint64_t offset = 0;
+    while (offset < reader.size()) {
+        const size_t length = static_cast<size_t>(std::min<uint64_t>(view_size, reader.size() - offset));
+        const bool last = offset + length == reader.size();
+        const file_view view = reader.read(offset, length);
+        size_t begin = 0;
+        while (begin < length && (last || length - begin >= options_.max_size)) {
+            const size_t chunk = next_boundary(view.data() + begin, length - begin);
+            spans.push_back(chunk_span{offset + begin, static_cast<uint32_t>(chunk)});
+            begin += chunk;
+        }
+        offset += begin;
+    }
+    return spans;
+}
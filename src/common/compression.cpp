@@ -0,0 +1,413 @@
+#include "common/compression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "metrics/trace.h"
+
+#if defined(SYNC_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(SYNC_HAVE_LZ4)
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#if defined(SYNC_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace {
+
+// 采样分成几段，避免只看到文件头之类不具代表性的部分
+constexpr size_t entropy_slices = 4;
+
+std::runtime_error corrupt(compression_codec codec) {
+    return std::runtime_error(std::string("corrupt ") + codec_name(codec) + " chunk");
+}
+
+#if defined(SYNC_HAVE_ZSTD)
+// 压缩和解压上下文每个线程一个，重复使用其中的工作内存
+struct zstd_contexts {
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    ZSTD_DCtx* dctx = ZSTD_createDCtx();
+    ~zstd_contexts() {
+        ZSTD_freeCCtx(cctx);
+        ZSTD_freeDCtx(dctx);
+    }
+};
+
+zstd_contexts& zstd_local() {
+    thread_local zstd_contexts contexts;
+    if (contexts.cctx == nullptr || contexts.dctx == nullptr) {
+        throw std::bad_alloc();
+    }
+    return contexts;
+}
+#endif
+
+#if defined(SYNC_HAVE_ZLIB)
+// deflate 的流状态每个线程一个，每个分块 deflateReset 后重用
+struct zlib_streams {
+    z_stream deflater{};
+    z_stream inflater{};
+    int level = std::numeric_limits<int>::min();
+    bool inflater_ready = false;
+
+    ~zlib_streams() {
+        if (level != std::numeric_limits<int>::min()) {
+            deflateEnd(&deflater);
+        }
+        if (inflater_ready) {
+            inflateEnd(&inflater);
+        }
+    }
+
+    z_stream& deflate_stream(int wanted) {
+        if (level != wanted) {
+            if (level != std::numeric_limits<int>::min()) {
+                deflateEnd(&deflater);
+                level = std::numeric_limits<int>::min();
+            }
+            deflater = z_stream{};
+            if (deflateInit(&deflater, wanted) != Z_OK) {
+                throw std::bad_alloc();
+            }
+            level = wanted;
+        } else {
+            deflateReset(&deflater);
+        }
+        return deflater;
+    }
+
+    z_stream& inflate_stream() {
+        if (!inflater_ready) {
+            inflater = z_stream{};
+            if (inflateInit(&inflater) != Z_OK) {
+                throw std::bad_alloc();
+            }
+            inflater_ready = true;
+        } else {
+            inflateReset(&inflater);
+        }
+        return inflater;
+    }
+};
+
+zlib_streams& zlib_local() {
+    thread_local zlib_streams streams;
+    return streams;
+}
+#endif
+
+}  // namespace
+
+bool codec_available(compression_codec codec) {
+    switch (codec) {
+    case compression_codec::none:
+        return true;
+    case compression_codec::lz4:
+#if defined(SYNC_HAVE_LZ4)
+        return true;
+#else
+        return false;
+#endif
+    case compression_codec::zstd:
+#if defined(SYNC_HAVE_ZSTD)
+        return true;
+#else
+        return false;
+#endif
+    case compression_codec::deflate:
+#if defined(SYNC_HAVE_ZLIB)
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char* codec_name(compression_codec codec) {
+    switch (codec) {
+    case compression_codec::none:
+        return "none";
+    case compression_codec::lz4:
+        return "lz4";
+    case compression_codec::zstd:
+        return "zstd";
+    case compression_codec::deflate:
+        return "deflate";
+    }
+    return "unknown";
+}
+
+compression_codec default_codec() {
+    for (compression_codec codec : {compression_codec::zstd, compression_codec::lz4, compression_codec::deflate}) {
+        if (codec_available(codec)) {
+            return codec;
+        }
+    }
+    return compression_codec::none;
+}
+
+double sample_entropy(const uint8_t* data, size_t size, size_t sample_size) {
+    if (size == 0) {
+        return 0;
+    }
+    std::array<uint32_t, 256> counts{};
+    size_t sampled = 0;
+    if (size <= sample_size || sample_size < entropy_slices) {
+        for (size_t i = 0; i < size; ++i) {
+            ++counts[data[i]];
+        }
+        sampled = size;
+    } else {
+        const size_t slice = sample_size / entropy_slices;
+        const size_t stride = (size - slice) / (entropy_slices - 1);
+        for (size_t s = 0; s < entropy_slices; ++s) {
+            const uint8_t* p = data + s * stride;
+            for (size_t i = 0; i < slice; ++i) {
+                ++counts[p[i]];
+            }
+        }
+        sampled = slice * entropy_slices;
+    }
+    double entropy = 0;
+    const double total = static_cast<double>(sampled);
+    for (uint32_t count : counts) {
+        if (count != 0) {
+            const double p = count / total;
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy;
+}
+
+bool compress_block(compression_codec codec, int level, const uint8_t* data, size_t size, size_t max_output,
+                    std::vector<uint8_t>& out) {
+    if (!codec_available(codec) || codec == compression_codec::none) {
+        throw std::invalid_argument(std::string("compression codec not available: ") + codec_name(codec));
+    }
+    if (size > std::numeric_limits<int>::max() || max_output == 0) {
+        return false;
+    }
+    out.resize(max_output);
+    switch (codec) {
+#if defined(SYNC_HAVE_ZSTD)
+    case compression_codec::zstd: {
+        const size_t n = ZSTD_compressCCtx(zstd_local().cctx, out.data(), out.size(), data, size,
+                                           level == 0 ? ZSTD_CLEVEL_DEFAULT : level);
+        if (ZSTD_isError(n)) {
+            return false;
+        }
+        out.resize(n);
+        return true;
+    }
+#endif
+#if defined(SYNC_HAVE_LZ4)
+    case compression_codec::lz4: {
+        const int capacity = static_cast<int>(std::min<size_t>(out.size(), std::numeric_limits<int>::max()));
+        const char* src = reinterpret_cast<const char*>(data);
+        char* dst = reinterpret_cast<char*>(out.data());
+        const int n = level > 1 ? LZ4_compress_HC(src, dst, static_cast<int>(size), capacity, level)
+                                : LZ4_compress_fast(src, dst, static_cast<int>(size), capacity, level < 0 ? -level : 1);
+        if (n <= 0) {
+            return false;
+        }
+        out.resize(static_cast<size_t>(n));
+        return true;
+    }
+#endif
+#if defined(SYNC_HAVE_ZLIB)
+    case compression_codec::deflate: {
+        z_stream& zs = zlib_local().deflate_stream(level == 0 ? Z_DEFAULT_COMPRESSION : level);
+        zs.next_in = const_cast<Bytef*>(data);
+        zs.avail_in = static_cast<uInt>(size);
+        zs.next_out = out.data();
+        zs.avail_out = static_cast<uInt>(std::min<size_t>(out.size(), std::numeric_limits<uInt>::max()));
+        // 输出空间用完时返回 Z_OK 或 Z_BUF_ERROR，说明不够小，放弃
+        if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+            return false;
+        }
+        out.resize(zs.total_out);
+        return true;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+void decompress_block(compression_codec codec, const uint8_t* data, size_t size, uint8_t* out, size_t original_size) {
+    if (!codec_available(codec)) {
+        throw std::invalid_argument(std::string("compression codec not available: ") + codec_name(codec));
+    }
+    switch (codec) {
+    case compression_codec::none:
+        if (size != original_size) {
+            throw corrupt(codec);
+        }
+        std::copy(data, data + size, out);
+        return;
+#if defined(SYNC_HAVE_ZSTD)
+    case compression_codec::zstd: {
+        const size_t n = ZSTD_decompressDCtx(zstd_local().dctx, out, original_size, data, size);
+        if (ZSTD_isError(n) || n != original_size) {
+            throw corrupt(codec);
+        }
+        return;
+    }
+#endif
+#if defined(SYNC_HAVE_LZ4)
+    case compression_codec::lz4: {
+        if (size > std::numeric_limits<int>::max() || original_size > std::numeric_limits<int>::max()) {
+            throw corrupt(codec);
+        }
+        const int n = LZ4_decompress_safe(reinterpret_cast<const char*>(data), reinterpret_cast<char*>(out),
+                                          static_cast<int>(size), static_cast<int>(original_size));
+        if (n < 0 || static_cast<size_t>(n) != original_size) {
+            throw corrupt(codec);
+        }
+        return;
+    }
+#endif
+#if defined(SYNC_HAVE_ZLIB)
+    case compression_codec::deflate: {
+        z_stream& zs = zlib_local().inflate_stream();
+        zs.next_in = const_cast<Bytef*>(data);
+        zs.avail_in = static_cast<uInt>(size);
+        zs.next_out = out;
+        zs.avail_out = static_cast<uInt>(original_size);
+        if (size > std::numeric_limits<uInt>::max() || original_size > std::numeric_limits<uInt>::max() ||
+            inflate(&zs, Z_FINISH) != Z_STREAM_END || zs.total_out != original_size) {
+            throw corrupt(codec);
+        }
+        return;
+    }
+#endif
+    default:
+        throw corrupt(codec);
+    }
+}
+
+compression_stage::compression_stage(thread_pool& pool, const compression_options& options)
+    : pool_(pool), options_(options) {
+    if (!codec_available(options.codec)) {
+        throw std::invalid_argument(std::string("compression codec not available: ") + codec_name(options.codec));
+    }
+    if (!(options.min_saving >= 0 && options.min_saving < 1)) {
+        throw std::invalid_argument("min_saving must be in [0, 1)");
+    }
+}
+
+bool compression_stage::should_skip(file_view chunk) {
+    if (options_.codec == compression_codec::none) {
+        return true;
+    }
+    if (chunk.size() < options_.min_size) {
+        skipped_small_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    // 退避期间不做任何检查，连熵都不算
+    uint32_t remaining = skip_remaining_.load(std::memory_order_relaxed);
+    while (remaining > 0) {
+        if (skip_remaining_.compare_exchange_weak(remaining, remaining - 1, std::memory_order_relaxed)) {
+            skipped_backoff_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    if (options_.max_entropy < 8 &&
+        sample_entropy(chunk.data(), chunk.size(), options_.sample_size) > options_.max_entropy) {
+        skipped_entropy_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void compression_stage::record(bool compressed) {
+    if (compressed) {
+        backoff_.store(0, std::memory_order_relaxed);
+        return;
+    }
+    if (options_.max_backoff == 0) {
+        return;
+    }
+    // 连续失败时跳过的分块数翻倍：1、2、4……直到 max_backoff
+    const uint32_t previous = backoff_.load(std::memory_order_relaxed);
+    const uint32_t next = previous == 0 ? 1 : std::min(previous * 2, options_.max_backoff);
+    backoff_.store(next, std::memory_order_relaxed);
+    skip_remaining_.store(next, std::memory_order_relaxed);
+}
+
+compressed_chunk compression_stage::compress(file_view chunk, uint64_t trace_id) {
+    if (chunk.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::invalid_argument("compression chunks must be smaller than 4GB");
+    }
+    SYNC_TRACE_SPAN("compress", "chunk", trace_id);
+    compressed_chunk result;
+    result.original_size = static_cast<uint32_t>(chunk.size());
+    chunks_.fetch_add(1, std::memory_order_relaxed);
+    bytes_in_.fetch_add(chunk.size(), std::memory_order_relaxed);
+
+    if (!should_skip(chunk)) {
+        const size_t limit = static_cast<size_t>(static_cast<double>(chunk.size()) * (1 - options_.min_saving));
+        const bool ok = compress_block(options_.codec, options_.level, chunk.data(), chunk.size(), limit, result.data);
+        record(ok);
+        if (ok) {
+            result.codec = options_.codec;
+            compressed_.fetch_add(1, std::memory_order_relaxed);
+            bytes_out_.fetch_add(result.data.size(), std::memory_order_relaxed);
+            return result;
+        }
+        incompressible_.fetch_add(1, std::memory_order_relaxed);
+        result.data.clear();
+        result.data.shrink_to_fit();
+    }
+    result.source = std::move(chunk);
+    bytes_out_.fetch_add(result.original_size, std::memory_order_relaxed);
+    return result;
+}
+
+std::future<compressed_chunk> compression_stage::compress_async(file_view chunk, uint64_t trace_id) {
+    return pool_.submit_to(options_.lane, [this, chunk, trace_id] { return compress(chunk, trace_id); });
+}
+
+file_view compression_stage::decompress(compression_codec codec, file_view data, uint32_t original_size,
+                                        uint64_t trace_id) const {
+    if (codec == compression_codec::none) {
+        if (data.size() != original_size) {
+            throw corrupt(codec);
+        }
+        return data;
+    }
+    SYNC_TRACE_SPAN("decompress", "chunk", trace_id);
+    auto buffer = std::make_shared<std::vector<uint8_t>>(original_size);
+    decompress_block(codec, data.data(), data.size(), buffer->data(), original_size);
+    const uint8_t* bytes = buffer->data();
+    return file_view(bytes, original_size, std::move(buffer));
+}
+
+std::future<file_view> compression_stage::decompress_async(compression_codec codec, file_view data,
+                                                           uint32_t original_size, uint64_t trace_id) const {
+    return pool_.submit_to(options_.lane, [this, codec, data, original_size, trace_id] {
+        return decompress(codec, data, original_size, trace_id);
+    });
+}
+
+compression_stats compression_stage::stats() const {
+    compression_stats stats;
+    stats.chunks = chunks_.load(std::memory_order_relaxed);
+    stats.compressed = compressed_.load(std::memory_order_relaxed);
+    stats.skipped_small = skipped_small_.load(std::memory_order_relaxed);
+    stats.skipped_entropy = skipped_entropy_.load(std::memory_order_relaxed);
+    stats.skipped_backoff = skipped_backoff_.load(std::memory_order_relaxed);
+    stats.incompressible = incompressible_.load(std::memory_order_relaxed);
+    stats.bytes_in = bytes_in_.load(std::memory_order_relaxed);
+    stats.bytes_out = bytes_out_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,268 @@
+#include "common/delta.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+constexpr uint32_t chunk_list_magic = 0x314C4353;  // "SCL1"
+constexpr uint32_t delta_plan_magic = 0x31504453;  // "SDP1"
+
+// 线上格式统一使用小端
+class writer {
+public:
+    void u8(uint8_t value) { bytes_.push_back(value); }
+
+    void u32(uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            bytes_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void u64(uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            bytes_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void digest(const hash_digest& value) { bytes_.insert(bytes_.end(), value.begin(), value.end()); }
+
+    void reserve(size_t size) { bytes_.reserve(size); }
+
+    std::vector<uint8_t> take() { return std::move(bytes_); }
+
+private:
+    std::vector<uint8_t> bytes_;
+};
+
+class reader {
+public:
+    reader(const uint8_t* data, size_t size, const char* what) : data_(data), size_(size), what_(what) {}
+
+    uint8_t u8() {
+        need(1);
+        return data_[pos_++];
+    }
+
+    uint32_t u32() {
+        need(4);
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(data_[pos_++]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t u64() {
+        need(8);
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i) {
+            value |= static_cast<uint64_t>(data_[pos_++]) << (8 * i);
+        }
+        return value;
+    }
+
+    hash_digest digest() {
+        need(hash_digest_size);
+        hash_digest value;
+        std::memcpy(value.data(), data_ + pos_, hash_digest_size);
+        pos_ += hash_digest_size;
+        return value;
+    }
+
+    size_t remaining() const { return size_ - pos_; }
+
+    void fail(const char* reason) const { throw std::runtime_error(std::string("malformed ") + what_ + ": " + reason); }
+
+private:
+    void need(size_t bytes) const {
+        if (size_ - pos_ < bytes) {
+            fail("truncated");
+        }
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    const char* what_;
+};
+
+struct digest_hasher {
+    size_t operator()(const hash_digest& digest) const {
+        // 摘要本身是均匀分布的，取前 8 字节即可
+        size_t value;
+        std::memcpy(&value, digest.data(), sizeof(value));
+        return value;
+    }
+};
+
+}  // namespace
+
+uint64_t delta_plan::literal_bytes() const {
+    uint64_t total = 0;
+    for (const auto& op : ops) {
+        total += op.literal ? op.length : 0;
+    }
+    return total;
+}
+
+uint64_t delta_plan::copied_bytes() const {
+    return size - literal_bytes();
+}
+
+std::vector<uint8_t> encode_chunk_list(const std::vector<chunk_hash>& chunks) {
+    writer out;
+    out.reserve(8 + chunks.size() * (4 + hash_digest_size));
+    out.u32(chunk_list_magic);
+    out.u32(static_cast<uint32_t>(chunks.size()));
+    for (const auto& chunk : chunks) {
+        out.u32(chunk.length);
+        out.digest(chunk.digest);
+    }
+    return out.take();
+}
+
+std::vector<chunk_hash> decode_chunk_list(const uint8_t* data, size_t size) {
+    reader in(data, size, "chunk list");
+    if (in.u32() != chunk_list_magic) {
+        in.fail("bad magic");
+    }
+    const uint32_t count = in.u32();
+    if (in.remaining() != static_cast<uint64_t>(count) * (4 + hash_digest_size)) {
+        in.fail("size does not match chunk count");
+    }
+    std::vector<chunk_hash> chunks(count);
+    uint64_t offset = 0;
+    for (auto& chunk : chunks) {
+        chunk.offset = offset;
+        chunk.length = in.u32();
+        chunk.digest = in.digest();
+        if (chunk.length == 0) {
+            in.fail("empty chunk");
+        }
+        offset += chunk.length;
+    }
+    return chunks;
+}
+
+delta_plan make_delta_plan(const file_hash_result& target, const std::vector<chunk_hash>& basis) {
+    std::unordered_map<hash_digest, uint64_t, digest_hasher> available;
+    available.reserve(basis.size());
+    for (const auto& chunk : basis) {
+        available.emplace(chunk.digest, chunk.offset);
+    }
+
+    delta_plan plan;
+    plan.size = target.size;
+    plan.root = target.root;
+    plan.ops.reserve(target.chunks.size());
+    for (const auto& chunk : target.chunks) {
+        delta_op op;
+        op.length = chunk.length;
+        op.digest = chunk.digest;
+        op.target_offset = chunk.offset;
+        auto it = available.find(chunk.digest);
+        if (it != available.end()) {
+            op.basis_offset = it->second;
+        } else {
+            op.literal = true;
+        }
+        plan.ops.push_back(op);
+    }
+    return plan;
+}
+
+std::vector<uint8_t> encode_delta_plan(const delta_plan& plan) {
+    writer out;
+    out.reserve(48 + plan.ops.size() * (13 + hash_digest_size));
+    out.u32(delta_plan_magic);
+    out.u64(plan.size);
+    out.digest(plan.root);
+    out.u32(static_cast<uint32_t>(plan.ops.size()));
+    for (const auto& op : plan.ops) {
+        out.u8(op.literal ? 1 : 0);
+        out.u32(op.length);
+        out.digest(op.digest);
+        if (!op.literal) {
+            out.u64(op.basis_offset);
+        }
+    }
+    return out.take();
+}
+
+delta_plan decode_delta_plan(const uint8_t* data, size_t size) {
+    reader in(data, size, "delta plan");
+    if (in.u32() != delta_plan_magic) {
+        in.fail("bad magic");
+    }
+    delta_plan plan;
+    plan.size = in.u64();
+    plan.root = in.digest();
+    const uint32_t count = in.u32();
+    // 每个操作至少 37 字节，先检查再分配，避免恶意的数量导致巨大分配
+    if (in.remaining() / (5 + hash_digest_size) < count) {
+        in.fail("size does not match op count");
+    }
+    plan.ops.resize(count);
+    uint64_t offset = 0;
+    for (auto& op : plan.ops) {
+        const uint8_t kind = in.u8();
+        if (kind > 1) {
+            in.fail("unknown op kind");
+        }
+        op.literal = kind == 1;
+        op.length = in.u32();
+        op.digest = in.digest();
+        if (!op.literal) {
+            op.basis_offset = in.u64();
+        }
+        if (op.length == 0) {
+            in.fail("empty chunk");
+        }
+        op.target_offset = offset;
+        offset += op.length;
+    }
+    if (in.remaining() != 0) {
+        in.fail("trailing bytes");
+    }
+    if (offset != plan.size) {
+        in.fail("chunk lengths do not add up to file size");
+    }
+    return plan;
+}
+
+void apply_delta(const delta_plan& plan, const delta_read_basis& read_basis, const delta_read_literal& read_literal,
+                 const delta_write& write) {
+    std::vector<uint8_t> buffer;
+    std::vector<chunk_hash> written;
+    written.reserve(plan.ops.size());
+
+    for (const auto& op : plan.ops) {
+        if (buffer.size() < op.length) {
+            buffer.resize(op.length);
+        }
+        if (op.literal) {
+            read_literal(buffer.data(), op.length);
+        } else {
+            read_basis(op.basis_offset, buffer.data(), op.length);
+        }
+        const hash_digest digest = blake3_hasher::hash(buffer.data(), op.length);
+        if (digest != op.digest) {
+            throw std::runtime_error(op.literal ? "delta literal chunk does not match its digest"
+                                                : "basis chunk changed since its chunk list was sent");
+        }
+        write(buffer.data(), op.length);
+
+        chunk_hash chunk;
+        chunk.offset = op.target_offset;
+        chunk.length = op.length;
+        chunk.digest = digest;
+        written.push_back(chunk);
+    }
+
+    if (combine_chunk_hashes(written) != plan.root) {
+        throw std::runtime_error("reconstructed file does not match the target root hash");
+    }
+}
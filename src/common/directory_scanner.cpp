@@ -0,0 +1,571 @@
+#include "common/directory_scanner.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#if defined(STATX_BASIC_STATS)
+#define SYNC_HAVE_STATX 1
+#endif
+#endif
+
+#if defined(__APPLE__)
+#include <sys/attr.h>
+#include <sys/vnode.h>
+#endif
+
+#include "common/io_uring.h"
+
+namespace {
+
+const size_t dirent_buffer_size = 64 * 1024;
+
+std::string strip_trailing_slashes(std::string path) {
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+    return path;
+}
+
+std::string join_path(const std::string& dir, const std::string& name) {
+    return dir.empty() ? name : dir + "/" + name;
+}
+
+scan_method resolve_method(scan_method method) {
+    if (method != scan_method::automatic) {
+        if (!directory_scanner::method_available(method)) {
+            throw std::invalid_argument("scan method is not available on this platform");
+        }
+        return method;
+    }
+#if defined(__APPLE__)
+    return scan_method::bulk;
+#else
+    if (directory_scanner::method_available(scan_method::io_uring)) {
+        return scan_method::io_uring;
+    }
+    if (directory_scanner::method_available(scan_method::statx)) {
+        return scan_method::statx;
+    }
+    return scan_method::posix;
+#endif
+}
+
+/**
+ * readdir 读取目录中的全部名字（不含 . 和 ..）
+ */
+std::vector<std::string> read_names_posix(int fd) {
+    const int copy = ::dup(fd);  // closedir 会关闭描述符
+    if (copy < 0) {
+        throw std::system_error(errno, std::generic_category(), "dup");
+    }
+    DIR* dir = ::fdopendir(copy);
+    if (dir == nullptr) {
+        const int error = errno;
+        ::close(copy);
+        throw std::system_error(error, std::generic_category(), "fdopendir");
+    }
+    std::vector<std::string> names;
+    errno = 0;
+    while (const struct dirent* entry = ::readdir(dir)) {
+        if (std::strcmp(entry->d_name, ".") != 0 && std::strcmp(entry->d_name, "..") != 0) {
+            names.emplace_back(entry->d_name);
+        }
+        errno = 0;
+    }
+    const int error = errno;
+    ::closedir(dir);
+    if (error != 0) {
+        throw std::system_error(error, std::generic_category(), "readdir");
+    }
+    return names;
+}
+
+#if defined(__linux__)
+
+/**
+ * 直接用 getdents64 读取目录项，每次系统调用填满 64KB 的缓冲区
+ */
+std::vector<std::string> read_names_getdents(int fd) {
+    // linux_dirent64：u64 d_ino、s64 d_off、u16 d_reclen、u8 d_type，之后是以 0 结尾的名字
+    constexpr size_t reclen_offset = 16;
+    constexpr size_t name_offset = 19;
+
+    thread_local std::vector<char> buffer(dirent_buffer_size);
+    std::vector<std::string> names;
+    for (;;) {
+        const long n = ::syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "getdents64");
+        }
+        if (n == 0) {
+            break;
+        }
+        for (long offset = 0; offset < n;) {
+            const char* record = buffer.data() + offset;
+            uint16_t reclen;
+            std::memcpy(&reclen, record + reclen_offset, sizeof(reclen));
+            const char* name = record + name_offset;
+            if (std::strcmp(name, ".") != 0 && std::strcmp(name, "..") != 0) {
+                names.emplace_back(name);
+            }
+            offset += reclen;
+        }
+    }
+    return names;
+}
+
+#endif
+
+#if defined(SYNC_HAVE_STATX)
+
+constexpr unsigned statx_mask = STATX_TYPE | STATX_MODE | STATX_INO | STATX_MTIME | STATX_SIZE;
+constexpr int statx_flags = AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT;
+
+scan_entry entry_from_statx(std::string path, const struct statx& stx) {
+    scan_entry entry;
+    entry.path = std::move(path);
+    entry.id.device = static_cast<uint64_t>(makedev(stx.stx_dev_major, stx.stx_dev_minor));
+    entry.id.inode = stx.stx_ino;
+    entry.id.mtime_ns = static_cast<int64_t>(stx.stx_mtime.tv_sec) * 1000000000 + stx.stx_mtime.tv_nsec;
+    entry.id.size = stx.stx_size;
+    entry.mode = stx.stx_mode;
+    return entry;
+}
+
+#endif
+
+}  // namespace
+
+struct directory_scanner::directory_handle {
+    int fd;
+    std::string path;
+
+    directory_handle(int fd, std::string path) : fd(fd), path(std::move(path)) {}
+
+    ~directory_handle() {
+        ::close(fd);
+    }
+
+    directory_handle(const directory_handle&) = delete;
+    directory_handle& operator=(const directory_handle&) = delete;
+};
+
+directory_scanner::directory_scanner(thread_pool& pool, const std::string& root,
+                                     const directory_scanner_options& options)
+    : pool_(pool),
+      root_(strip_trailing_slashes(root)),
+      options_(options),
+      method_(resolve_method(options.method)),
+      queue_(options.queue_capacity) {
+    if (options_.stat_batch == 0) {
+        throw std::invalid_argument("stat_batch must be positive");
+    }
+    struct stat st;
+    if (::stat(root_.c_str(), &st) != 0) {
+        throw std::system_error(errno, std::generic_category(), "scan " + root_);
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        throw std::system_error(ENOTDIR, std::generic_category(), "scan " + root_);
+    }
+    root_device_ = static_cast<uint64_t>(st.st_dev);
+    submit(std::string());
+}
+
+directory_scanner::~directory_scanner() {
+    // 关闭队列让等待空位的任务返回，再等所有任务结束，它们都引用本对象
+    stopping_.store(true, std::memory_order_relaxed);
+    queue_.close();
+    wait();
+}
+
+bool directory_scanner::method_available(scan_method method) {
+    switch (method) {
+    case scan_method::automatic:
+    case scan_method::posix:
+        return true;
+    case scan_method::statx:
+#if defined(SYNC_HAVE_STATX)
+        return true;
+#else
+        return false;
+#endif
+    case scan_method::io_uring: {
+#if defined(SYNC_HAVE_IO_URING) && defined(SYNC_HAVE_STATX)
+        static const bool available = [] {
+            const uint8_t opcodes[] = {IORING_OP_STATX};
+            return io_uring_queue::supported(opcodes, 1);
+        }();
+        return available;
+#else
+        return false;
+#endif
+    }
+    case scan_method::bulk:
+#if defined(__APPLE__)
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+const char* directory_scanner::method_name() const {
+    switch (method_) {
+    case scan_method::posix:
+        return "posix";
+    case scan_method::statx:
+        return "statx";
+    case scan_method::io_uring:
+        return "io_uring";
+    case scan_method::bulk:
+        return "getattrlistbulk";
+    default:
+        return "automatic";
+    }
+}
+
+void directory_scanner::wait() {
+    for (;;) {
+        const uint32_t key = finished_.prepare_wait();
+        {
+            // 在锁内看到计数为零时，最后一个任务已经完成通知并释放了锁，不会再访问本对象
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (outstanding_ == 0) {
+                finished_.cancel_wait();
+                return;
+            }
+        }
+        finished_.wait(key);
+    }
+}
+
+bool directory_scanner::done() const {
+    return queue_.closed();
+}
+
+scan_stats directory_scanner::stats() const {
+    scan_stats s;
+    s.directories = directories_.load(std::memory_order_relaxed);
+    s.entries = entries_.load(std::memory_order_relaxed);
+    s.errors = errors_.load(std::memory_order_relaxed);
+    s.batches = batches_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void directory_scanner::submit(std::string path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outstanding_++;
+    }
+    pool_.submit_to(options_.lane, [this, path = std::move(path)] {
+        if (!stopping_.load(std::memory_order_relaxed)) {
+            try {
+                scan_directory(path);
+            } catch (const std::exception&) {
+                errors_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        task_done();
+    });
+}
+
+void directory_scanner::submit_batch(std::shared_ptr<directory_handle> dir, std::vector<std::string> names) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outstanding_++;
+    }
+    pool_.submit_to(options_.lane, [this, dir = std::move(dir), names = std::move(names)] {
+        if (!stopping_.load(std::memory_order_relaxed)) {
+            try {
+                stat_names(*dir, names);
+            } catch (const std::exception&) {
+                errors_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        task_done();
+    });
+}
+
+void directory_scanner::task_done() {
+    // 最后一个任务关闭队列；通知在锁内完成，之后等待者才可能销毁本对象
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--outstanding_ == 0) {
+        queue_.close();
+        finished_.notify_all();
+    }
+}
+
+void directory_scanner::scan_directory(const std::string& path) {
+    const std::string full = path.empty() ? root_ : (root_ == "/" ? root_ + path : root_ + "/" + path);
+    // 子目录不跟随符号链接：目录项和打开之间被换成链接时不会扫描到树外
+    const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (path.empty() ? 0 : O_NOFOLLOW);
+    const int fd = ::open(full.c_str(), flags);
+    if (fd < 0) {
+        // 扫描期间被删除或替换的目录不算错误
+        if (errno != ENOENT && errno != ENOTDIR && errno != ELOOP) {
+            errors_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    directories_.fetch_add(1, std::memory_order_relaxed);
+    auto dir = std::make_shared<directory_handle>(fd, path);
+
+#if defined(__APPLE__)
+    if (method_ == scan_method::bulk) {
+        scan_bulk(*dir);
+        return;
+    }
+#endif
+
+    std::vector<std::string> names;
+#if defined(__linux__)
+    names = method_ == scan_method::posix ? read_names_posix(fd) : read_names_getdents(fd);
+#else
+    names = read_names_posix(fd);
+#endif
+
+    // 大目录按批拆成多个任务，第一批在当前任务中处理
+    const size_t batch = options_.stat_batch;
+    for (size_t begin = batch; begin < names.size(); begin += batch) {
+        const size_t end = std::min(names.size(), begin + batch);
+        submit_batch(dir, std::vector<std::string>(std::make_move_iterator(names.begin() + begin),
+                                                   std::make_move_iterator(names.begin() + end)));
+    }
+    if (names.size() > batch) {
+        names.resize(batch);
+    }
+    stat_names(*dir, names);
+}
+
+void directory_scanner::stat_names(const directory_handle& dir, const std::vector<std::string>& names) {
+    auto failed = [this](int error) {
+        if (error != ENOENT) {
+            errors_.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+#if defined(SYNC_HAVE_IO_URING) && defined(SYNC_HAVE_STATX)
+    if (method_ == scan_method::io_uring) {
+        // 每个工作线程一个 io_uring 实例，创建失败后该线程改用 statx
+        io_uring_queue* ring = thread_io_uring(static_cast<uint32_t>(options_.stat_batch));
+        if (ring != nullptr) {
+            // 一次提交一批 statx，内核在自己的工作线程中并行执行，慢的文件系统上延迟可以重叠
+            std::vector<struct statx> results(names.size());
+            size_t begin = 0;
+            while (begin < names.size() && !stopping_.load(std::memory_order_relaxed)) {
+                size_t end = begin;
+                while (end < names.size() && ring->sq_space() > 0) {
+                    io_uring_sqe* sqe = ring->get_sqe();
+                    sqe->opcode = IORING_OP_STATX;
+                    sqe->fd = dir.fd;
+                    sqe->addr = reinterpret_cast<uint64_t>(names[end].c_str());
+                    sqe->len = statx_mask;
+                    sqe->off = reinterpret_cast<uint64_t>(&results[end]);
+                    sqe->statx_flags = statx_flags;
+                    sqe->user_data = end;
+                    ++end;
+                }
+                const size_t count = end - begin;
+                batches_.fetch_add(1, std::memory_order_relaxed);
+                size_t completed = 0;
+                ring->submit(static_cast<unsigned>(count));
+                for (;;) {
+                    completed += ring->for_each_cqe([&](const io_uring_cqe& cqe) {
+                        const size_t index = static_cast<size_t>(cqe.user_data);
+                        if (cqe.res < 0) {
+                            failed(-cqe.res);
+                        } else {
+                            emit(entry_from_statx(join_path(dir.path, names[index]), results[index]));
+                        }
+                    });
+                    if (completed >= count) {
+                        break;
+                    }
+                    ring->submit(1);
+                }
+                begin = end;
+            }
+            return;
+        }
+    }
+#endif
+
+    for (const std::string& name : names) {
+        if (stopping_.load(std::memory_order_relaxed)) {
+            return;
+        }
+#if defined(SYNC_HAVE_STATX)
+        if (method_ != scan_method::posix) {
+            struct statx stx;
+            if (::statx(dir.fd, name.c_str(), statx_flags, statx_mask, &stx) != 0) {
+                failed(errno);
+                continue;
+            }
+            emit(entry_from_statx(join_path(dir.path, name), stx));
+            continue;
+        }
+#endif
+        struct stat st;
+        if (::fstatat(dir.fd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            failed(errno);
+            continue;
+        }
+        scan_entry entry;
+        entry.path = join_path(dir.path, name);
+        entry.id = file_identity::from_stat(st);
+        entry.mode = static_cast<uint32_t>(st.st_mode);
+        emit(std::move(entry));
+    }
+}
+
+#if defined(__APPLE__)
+
+void directory_scanner::scan_bulk(const directory_handle& dir) {
+    struct attrlist attrs;
+    std::memset(&attrs, 0, sizeof(attrs));
+    attrs.bitmapcount = ATTR_BIT_MAP_COUNT;
+    attrs.commonattr = ATTR_CMN_RETURNED_ATTRS | ATTR_CMN_ERROR | ATTR_CMN_NAME | ATTR_CMN_DEVID | ATTR_CMN_OBJTYPE |
+                       ATTR_CMN_MODTIME | ATTR_CMN_ACCESSMASK | ATTR_CMN_FILEID;
+    attrs.fileattr = ATTR_FILE_DATALENGTH;
+
+    thread_local std::vector<char> buffer(dirent_buffer_size);
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        const int count = ::getattrlistbulk(dir.fd, &attrs, buffer.data(), buffer.size(), 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "getattrlistbulk");
+        }
+        if (count == 0) {
+            break;
+        }
+        batches_.fetch_add(1, std::memory_order_relaxed);
+
+        // 每个条目以 u32 长度开始，随后按位的顺序排列实际返回的属性；字段不一定对齐，逐个 memcpy
+        const char* record = buffer.data();
+        for (int i = 0; i < count; ++i) {
+            uint32_t length;
+            std::memcpy(&length, record, sizeof(length));
+            const char* field = record + sizeof(length);
+            attribute_set_t returned;
+            std::memcpy(&returned, field, sizeof(returned));
+            field += sizeof(returned);
+
+            uint32_t error = 0;
+            if (returned.commonattr & ATTR_CMN_ERROR) {
+                std::memcpy(&error, field, sizeof(error));
+                field += sizeof(error);
+            }
+            std::string name;
+            if (returned.commonattr & ATTR_CMN_NAME) {
+                attrreference_t ref;
+                std::memcpy(&ref, field, sizeof(ref));
+                const char* data = field + ref.attr_dataoffset;
+                name.assign(data, ::strnlen(data, ref.attr_length));
+                field += sizeof(ref);
+            }
+            dev_t device = 0;
+            if (returned.commonattr & ATTR_CMN_DEVID) {
+                std::memcpy(&device, field, sizeof(device));
+                field += sizeof(device);
+            }
+            fsobj_type_t type = VNON;
+            if (returned.commonattr & ATTR_CMN_OBJTYPE) {
+                std::memcpy(&type, field, sizeof(type));
+                field += sizeof(type);
+            }
+            struct timespec mtime = {0, 0};
+            if (returned.commonattr & ATTR_CMN_MODTIME) {
+                std::memcpy(&mtime, field, sizeof(mtime));
+                field += sizeof(mtime);
+            }
+            uint32_t access = 0;
+            if (returned.commonattr & ATTR_CMN_ACCESSMASK) {
+                std::memcpy(&access, field, sizeof(access));
+                field += sizeof(access);
+            }
+            uint64_t inode = 0;
+            if (returned.commonattr & ATTR_CMN_FILEID) {
+                std::memcpy(&inode, field, sizeof(inode));
+                field += sizeof(inode);
+            }
+            off_t size = 0;
+            if (returned.fileattr & ATTR_FILE_DATALENGTH) {
+                std::memcpy(&size, field, sizeof(size));
+                field += sizeof(size);
+            }
+            record += length;
+
+            if (error != 0 || name.empty()) {
+                if (error != ENOENT) {
+                    errors_.fetch_add(1, std::memory_order_relaxed);
+                }
+                continue;
+            }
+            uint32_t format = 0;
+            switch (type) {
+            case VREG:
+                format = S_IFREG;
+                break;
+            case VDIR:
+                format = S_IFDIR;
+                break;
+            case VLNK:
+                format = S_IFLNK;
+                break;
+            case VFIFO:
+                format = S_IFIFO;
+                break;
+            case VSOCK:
+                format = S_IFSOCK;
+                break;
+            case VCHR:
+                format = S_IFCHR;
+                break;
+            case VBLK:
+                format = S_IFBLK;
+                break;
+            default:
+                break;
+            }
+
+            scan_entry entry;
+            entry.path = join_path(dir.path, name);
+            entry.id.device = static_cast<uint64_t>(device);
+            entry.id.inode = inode;
+            entry.id.mtime_ns = static_cast<int64_t>(mtime.tv_sec) * 1000000000 + mtime.tv_nsec;
+            entry.id.size = static_cast<uint64_t>(size);
+            entry.mode = format | (access & 07777);
+            emit(std::move(entry));
+        }
+    }
+}
+
+#endif
+
+void directory_scanner::emit(scan_entry entry) {
+    // 先提交子目录再输出，让扫描尽早展开到更多工作线程
+    if (S_ISDIR(entry.mode) && !(options_.one_file_system && entry.id.device != root_device_)) {
+        submit(entry.path);
+    }
+    entries_.fetch_add(1, std::memory_order_relaxed);
+    queue_.push_wait(std::move(entry));
+}
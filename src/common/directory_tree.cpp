@@ -0,0 +1,470 @@
+#include "common/directory_tree.h"
+
+#include <cstring>
+#include <deque>
+#include <future>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+namespace {
+
+constexpr uint32_t listing_magic = 0x314C4453;  // "SDL1"
+
+enum : uint8_t {
+    child_file = 1,
+    child_directory = 2,
+};
+
+// 线上格式统一使用小端
+class writer {
+public:
+    void u8(uint8_t value) { bytes_.push_back(value); }
+
+    void u32(uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            bytes_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void u64(uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            bytes_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void digest(const hash_digest& value) { bytes_.insert(bytes_.end(), value.begin(), value.end()); }
+
+    void string(const std::string& value) {
+        u32(static_cast<uint32_t>(value.size()));
+        bytes_.insert(bytes_.end(), value.begin(), value.end());
+    }
+
+    std::vector<uint8_t> take() { return std::move(bytes_); }
+
+private:
+    std::vector<uint8_t> bytes_;
+};
+
+class reader {
+public:
+    reader(const uint8_t* data, size_t size, const char* what) : data_(data), size_(size), what_(what) {}
+
+    uint8_t u8() {
+        need(1);
+        return data_[pos_++];
+    }
+
+    uint32_t u32() {
+        need(4);
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(data_[pos_++]) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t u64() {
+        need(8);
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i) {
+            value |= static_cast<uint64_t>(data_[pos_++]) << (8 * i);
+        }
+        return value;
+    }
+
+    hash_digest digest() {
+        need(hash_digest_size);
+        hash_digest value;
+        std::memcpy(value.data(), data_ + pos_, hash_digest_size);
+        pos_ += hash_digest_size;
+        return value;
+    }
+
+    std::string string() {
+        const uint32_t size = u32();
+        need(size);
+        std::string value(reinterpret_cast<const char*>(data_ + pos_), size);
+        pos_ += size;
+        return value;
+    }
+
+    size_t remaining() const { return size_ - pos_; }
+
+    void fail(const char* reason) const { throw std::runtime_error(std::string("malformed ") + what_ + ": " + reason); }
+
+private:
+    void need(size_t bytes) const {
+        if (size_ - pos_ < bytes) {
+            fail("truncated");
+        }
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    const char* what_;
+};
+
+// 按 / 拆分路径，忽略空的部分
+std::vector<std::string> split_path(const std::string& path) {
+    std::vector<std::string> parts;
+    size_t begin = 0;
+    while (begin <= path.size()) {
+        size_t end = path.find('/', begin);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        if (end > begin) {
+            parts.push_back(path.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+    return parts;
+}
+
+std::string join_path(const std::string& dir, const std::string& name) {
+    return dir.empty() ? name : dir + "/" + name;
+}
+
+void hash_u32(blake3_hasher& hasher, uint32_t value) {
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; ++i) {
+        bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+    hasher.update(bytes, sizeof(bytes));
+}
+
+void hash_u64(blake3_hasher& hasher, uint64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+    hasher.update(bytes, sizeof(bytes));
+}
+
+// 两端的子项是否相同：目录比较子树哈希，文件比较 mode、大小和内容
+bool same_child(const directory_child& a, const directory_child& b) {
+    if (a.directory != b.directory || a.hash != b.hash) {
+        return false;
+    }
+    return a.directory || (a.meta.mode == b.meta.mode && a.meta.size == b.meta.size);
+}
+
+}  // namespace
+
+std::vector<uint8_t> encode_directory_listing(const directory_listing& listing) {
+    writer w;
+    w.u32(listing_magic);
+    w.string(listing.path);
+    w.digest(listing.hash);
+    w.u32(static_cast<uint32_t>(listing.children.size()));
+    for (const auto& child : listing.children) {
+        w.u8(child.directory ? child_directory : child_file);
+        w.string(child.name);
+        w.u32(child.meta.mode);
+        w.u64(child.meta.size);
+        w.u64(static_cast<uint64_t>(child.meta.mtime_ns));
+        w.digest(child.hash);
+    }
+    return w.take();
+}
+
+directory_listing decode_directory_listing(const uint8_t* data, size_t size) {
+    reader r(data, size, "directory listing");
+    if (r.u32() != listing_magic) {
+        r.fail("bad magic");
+    }
+    directory_listing listing;
+    listing.path = r.string();
+    listing.hash = r.digest();
+    const uint32_t count = r.u32();
+    // 每个子项至少 57 字节，先检查数量再分配
+    if (count > r.remaining() / 57) {
+        r.fail("child count exceeds size");
+    }
+    listing.children.resize(count);
+    for (auto& child : listing.children) {
+        const uint8_t type = r.u8();
+        if (type != child_file && type != child_directory) {
+            r.fail("bad child type");
+        }
+        child.directory = type == child_directory;
+        child.name = r.string();
+        child.meta.mode = r.u32();
+        child.meta.size = r.u64();
+        child.meta.mtime_ns = static_cast<int64_t>(r.u64());
+        child.hash = r.digest();
+    }
+    if (r.remaining() != 0) {
+        r.fail("trailing bytes");
+    }
+    return listing;
+}
+
+struct directory_tree::node {
+    bool directory = true;
+    manifest_meta meta;
+    hash_digest hash{};  // 文件为内容哈希，目录为子树哈希
+    bool dirty = true;
+    size_t files = 0;    // 子树中的文件数
+    std::map<std::string, std::unique_ptr<node>> children;  // 按名字的字节序排列
+};
+
+directory_tree::directory_tree(size_t parallel_threshold)
+    : parallel_threshold_(parallel_threshold), root_(std::make_unique<node>()) {}
+
+directory_tree::~directory_tree() = default;
+
+void directory_tree::update(const std::string& path, const manifest_meta& meta, const hash_digest& content) {
+    const std::vector<std::string> parts = split_path(path);
+    if (parts.empty()) {
+        throw std::invalid_argument("directory_tree: empty path");
+    }
+    const bool directory = S_ISDIR(meta.mode);
+
+    // 先找到上级目录，路径上遇到文件时不做任何修改
+    std::vector<node*> chain{root_.get()};
+    for (size_t i = 0; i + 1 < parts.size(); ++i) {
+        auto it = chain.back()->children.find(parts[i]);
+        if (it == chain.back()->children.end()) {
+            break;
+        }
+        if (!it->second->directory) {
+            throw std::invalid_argument("directory_tree: parent is a file: " + path);
+        }
+        chain.push_back(it->second.get());
+    }
+    for (size_t i = chain.size() - 1; i + 1 < parts.size(); ++i) {
+        auto child = std::make_unique<node>();
+        node* raw = child.get();
+        chain.back()->children.emplace(parts[i], std::move(child));
+        chain.push_back(raw);
+    }
+
+    node& parent = *chain.back();
+    std::unique_ptr<node>& slot = parent.children[parts.back()];
+    ptrdiff_t delta = 0;
+    if (slot && directory && slot->directory) {
+        slot->meta = meta;
+        slot->dirty = true;
+    } else {
+        if (slot) {
+            delta -= static_cast<ptrdiff_t>(slot->files);
+        }
+        slot = std::make_unique<node>();
+        slot->directory = directory;
+        slot->meta = meta;
+        if (!directory) {
+            slot->hash = content;
+            slot->dirty = false;
+            slot->files = 1;
+            delta += 1;
+        }
+    }
+    for (node* n : chain) {
+        n->dirty = true;
+        n->files = static_cast<size_t>(static_cast<ptrdiff_t>(n->files) + delta);
+    }
+}
+
+bool directory_tree::remove(const std::string& path) {
+    const std::vector<std::string> parts = split_path(path);
+    if (parts.empty()) {
+        return false;
+    }
+    std::vector<node*> chain{root_.get()};
+    for (size_t i = 0; i + 1 < parts.size(); ++i) {
+        auto it = chain.back()->children.find(parts[i]);
+        if (it == chain.back()->children.end() || !it->second->directory) {
+            return false;
+        }
+        chain.push_back(it->second.get());
+    }
+    auto it = chain.back()->children.find(parts.back());
+    if (it == chain.back()->children.end()) {
+        return false;
+    }
+    const size_t files = it->second->files;
+    chain.back()->children.erase(it);
+    for (node* n : chain) {
+        n->dirty = true;
+        n->files -= files;
+    }
+    return true;
+}
+
+void directory_tree::load(const manifest& m) {
+    for (manifest::cursor it(m); it.valid(); it.next()) {
+        update(it.path(), it.meta(), it.hash());
+    }
+}
+
+void directory_tree::refresh() {
+    compute(*root_, nullptr);
+}
+
+void directory_tree::refresh(thread_pool& pool) {
+    compute(*root_, &pool);
+}
+
+void directory_tree::compute(node& n, thread_pool* pool) {
+    if (!n.dirty) {
+        return;
+    }
+
+    // 大的脏子树交给线程池，其余在当前线程递归；等待时 pool.wait 会执行别的任务
+    std::vector<std::future<void>> pending;
+    for (auto& entry : n.children) {
+        node& child = *entry.second;
+        if (!child.dirty) {
+            continue;
+        }
+        if (pool != nullptr && child.files >= parallel_threshold_) {
+            pending.push_back(pool->submit_to(task_lane::hash, [this, &child, pool] { compute(child, pool); }));
+        } else {
+            compute(child, pool);
+        }
+    }
+    for (auto& task : pending) {
+        pool->wait(task);
+        task.get();
+    }
+
+    blake3_hasher hasher;
+    hash_u32(hasher, listing_magic);
+    hash_u64(hasher, n.children.size());
+    for (const auto& entry : n.children) {
+        const node& child = *entry.second;
+        const uint8_t type = child.directory ? child_directory : child_file;
+        hasher.update(&type, 1);
+        hash_u32(hasher, static_cast<uint32_t>(entry.first.size()));
+        hasher.update(entry.first.data(), entry.first.size());
+        if (!child.directory) {
+            hash_u32(hasher, child.meta.mode);
+            hash_u64(hasher, child.meta.size);
+        }
+        hasher.update(child.hash.data(), child.hash.size());
+    }
+    n.hash = hasher.finalize();
+    n.dirty = false;
+}
+
+bool directory_tree::dirty() const {
+    return root_->dirty;
+}
+
+hash_digest directory_tree::root_hash() const {
+    if (root_->dirty) {
+        throw std::logic_error("directory_tree: refresh before reading hashes");
+    }
+    return root_->hash;
+}
+
+directory_tree::node* directory_tree::find(const std::string& path) const {
+    node* n = root_.get();
+    for (const std::string& part : split_path(path)) {
+        if (!n->directory) {
+            return nullptr;
+        }
+        auto it = n->children.find(part);
+        if (it == n->children.end()) {
+            return nullptr;
+        }
+        n = it->second.get();
+    }
+    return n;
+}
+
+bool directory_tree::listing(const std::string& path, directory_listing& out) const {
+    if (root_->dirty) {
+        throw std::logic_error("directory_tree: refresh before reading hashes");
+    }
+    const node* n = find(path);
+    if (n == nullptr || !n->directory) {
+        return false;
+    }
+    out.path = path;
+    out.hash = n->hash;
+    out.children.clear();
+    out.children.reserve(n->children.size());
+    for (const auto& entry : n->children) {
+        directory_child child;
+        child.name = entry.first;
+        child.directory = entry.second->directory;
+        child.meta = entry.second->meta;
+        child.hash = entry.second->hash;
+        out.children.push_back(std::move(child));
+    }
+    return true;
+}
+
+size_t directory_tree::file_count() const {
+    return root_->files;
+}
+
+directory_diff_stats diff_directory_trees(const directory_tree& local, const directory_listing_fetcher& fetch,
+                                          const std::function<void(const directory_difference&)>& on_difference) {
+    directory_diff_stats stats;
+    auto report = [&](directory_difference::kind type, const std::string& path, bool directory) {
+        directory_difference difference;
+        difference.type = type;
+        difference.path = path;
+        difference.directory = directory;
+        on_difference(difference);
+    };
+
+    // 队列中的目录两端都存在且哈希不同（根除外，根先比较哈希）
+    std::deque<std::string> queue{std::string()};
+    directory_listing mine;
+    directory_listing theirs;
+    while (!queue.empty()) {
+        const std::string dir = std::move(queue.front());
+        queue.pop_front();
+        local.listing(dir, mine);
+        stats.listings_fetched++;
+        if (!fetch(dir, theirs)) {
+            if (dir.empty()) {
+                throw std::runtime_error("remote has no root directory listing");
+            }
+            report(directory_difference::kind::removed, dir, true);
+            continue;
+        }
+        if (theirs.hash == mine.hash) {
+            continue;
+        }
+
+        // 两边的子项都按名字排序，归并比较
+        size_t i = 0;
+        size_t j = 0;
+        while (i < mine.children.size() || j < theirs.children.size()) {
+            const int order = i == mine.children.size()     ? 1
+                              : j == theirs.children.size() ? -1
+                                                            : mine.children[i].name.compare(theirs.children[j].name);
+            if (order < 0) {
+                report(directory_difference::kind::removed, join_path(dir, mine.children[i].name),
+                       mine.children[i].directory);
+                ++i;
+            } else if (order > 0) {
+                report(directory_difference::kind::added, join_path(dir, theirs.children[j].name),
+                       theirs.children[j].directory);
+                ++j;
+            } else {
+                const directory_child& a = mine.children[i];
+                const directory_child& b = theirs.children[j];
+                if (same_child(a, b)) {
+                    if (a.directory) {
+                        stats.subtrees_skipped++;
+                    }
+                } else if (a.directory && b.directory) {
+                    queue.push_back(join_path(dir, a.name));
+                } else {
+                    report(directory_difference::kind::modified, join_path(dir, a.name), false);
+                }
+                ++i;
+                ++j;
+            }
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,198 @@
+#include "common/file_hasher.h"
+
+#include <cerrno>
+#include <exception>
+#include <future>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "metrics/trace.h"
+
+namespace {
+
+// 自动关闭的文件描述符
+class file_descriptor {
+public:
+    explicit file_descriptor(int fd) : fd_(fd) {}
+    ~file_descriptor() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+    file_descriptor(const file_descriptor&) = delete;
+    file_descriptor& operator=(const file_descriptor&) = delete;
+
+    int get() const { return fd_; }
+
+private:
+    int fd_;
+};
+
+hash_digest combine_range(const std::vector<chunk_hash>& chunks, size_t begin, size_t end, bool is_root) {
+    const size_t count = end - begin;
+    if (count == 1) {
+        return chunks[begin].digest;
+    }
+    size_t left = 1;
+    while (left * 2 < count) {
+        left *= 2;
+    }
+    return hash_parent(combine_range(chunks, begin, begin + left, false),
+                       combine_range(chunks, begin + left, end, false), is_root);
+}
+
+/**
+ * 并行计算各分块的摘要
+ *
+ * 连续的分块合并成不小于 batch_bytes 的批次，每个批次一个任务：
+ * read(offset, length) 返回该范围数据的 file_view（文件时是映射窗口或一次读入的内容），
+ * 然后逐个分块计算摘要。读取和每个分块的哈希都记录为区间，编号为 trace_chunk_id(trace_key, 偏移)，
+ * 读取的编号取批次中第一个分块。
+ */
+template <typename read_range>
+file_hash_result hash_spans(thread_pool& pool, task_lane lane, uint64_t size, const std::vector<chunk_span>& spans,
+                            uint32_t batch_bytes, uint64_t trace_key, read_range&& read) {
+    file_hash_result result;
+    result.size = size;
+    result.chunks.resize(spans.size());
+
+    uint64_t expected = 0;
+    for (const auto& span : spans) {
+        if (span.offset != expected || span.length == 0) {
+            throw std::invalid_argument("chunk spans must be contiguous, non-empty and start at 0");
+        }
+        expected += span.length;
+    }
+    if (expected != size) {
+        throw std::invalid_argument("chunk spans must cover the whole input");
+    }
+
+    // 所有已提交的任务都结束后再抛出第一个错误，任务引用的结果数组和回调此时才能安全销毁
+    std::exception_ptr error;
+    std::vector<std::future<void>> pending;
+    for (size_t first = 0; first < spans.size() && !error;) {
+        size_t last = first;
+        uint64_t bytes = 0;
+        while (last < spans.size() && (last == first || bytes + spans[last].length <= batch_bytes)) {
+            bytes += spans[last].length;
+            last++;
+        }
+        try {
+            pending.push_back(pool.submit_to(lane, [&result, &spans, &read, trace_key, first, last, bytes] {
+                const uint64_t base = spans[first].offset;
+                file_view view;
+                {
+                    SYNC_TRACE_SPAN("read", "chunk", trace_chunk_id(trace_key, base));
+                    view = read(base, static_cast<size_t>(bytes));
+                }
+                const uint8_t* data = view.data();
+                for (size_t i = first; i < last; ++i) {
+                    SYNC_TRACE_SPAN("hash", "chunk", trace_chunk_id(trace_key, spans[i].offset));
+                    chunk_hash& out = result.chunks[i];
+                    out.offset = spans[i].offset;
+                    out.length = spans[i].length;
+                    out.digest = blake3_hasher::hash(data + (spans[i].offset - base), spans[i].length);
+                }
+            }));
+        } catch (...) {
+            error = std::current_exception();
+        }
+        first = last;
+    }
+    for (auto& task : pending) {
+        pool.wait(task);
+        try {
+            task.get();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    result.root = combine_chunk_hashes(result.chunks);
+    return result;
+}
+
+}  // namespace
+
+std::vector<chunk_span> fixed_size_chunks(uint64_t size, uint32_t chunk_size) {
+    if (chunk_size == 0) {
+        throw std::invalid_argument("chunk size must be positive");
+    }
+    std::vector<chunk_span> spans;
+    spans.reserve(static_cast<size_t>((size + chunk_size - 1) / chunk_size));
+    for (uint64_t offset = 0; offset < size; offset += chunk_size) {
+        chunk_span span;
+        span.offset = offset;
+        span.length = static_cast<uint32_t>(size - offset < chunk_size ? size - offset : chunk_size);
+        spans.push_back(span);
+    }
+    return spans;
+}
+
+hash_digest combine_chunk_hashes(const std::vector<chunk_hash>& chunks) {
+    if (chunks.empty()) {
+        return blake3_hasher::hash(nullptr, 0);
+    }
+    return combine_range(chunks, 0, chunks.size(), true);
+}
+
+file_hasher::file_hasher(thread_pool& pool, const file_hasher_options& options)
+    : pool_(pool), options_(options), chunker_(options.cdc) {
+    if (options_.chunk_size == 0) {
+        throw std::invalid_argument("chunk size must be positive");
+    }
+}
+
+file_hash_result file_hasher::hash_buffer(const void* data, size_t size) const {
+    if (options_.chunking == chunking_mode::content_defined) {
+        return hash_buffer(data, size, chunker_.split(data, size));
+    }
+    return hash_buffer(data, size, fixed_size_chunks(size, options_.chunk_size));
+}
+
+file_hash_result file_hasher::hash_buffer(const void* data, size_t size, const std::vector<chunk_span>& spans) const {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    return hash_spans(pool_, options_.lane, size, spans, options_.chunk_size, 0,
+                      [bytes](uint64_t offset, size_t length) { return file_view(bytes + offset, length); });
+}
+
+std::vector<chunk_span> file_hasher::split_file(const std::string& path) const {
+    if (options_.chunking == chunking_mode::content_defined) {
+        return chunker_.split_file(path);
+    }
+    file_descriptor fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd.get() < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd.get(), &st) != 0) {
+        throw std::system_error(errno, std::generic_category(), "fstat " + path);
+    }
+    return fixed_size_chunks(static_cast<uint64_t>(st.st_size), options_.chunk_size);
+}
+
+file_hash_result file_hasher::hash_file(const std::string& path, uint64_t trace_key) const {
+    return hash_file(path, split_file(path), trace_key);
+}
+
+file_hash_result file_hasher::hash_file(const std::string& path, const std::vector<chunk_span>& spans,
+                                        uint64_t trace_key) const {
+    if (trace_key == 0 && trace_enabled()) {
+        trace_key = trace_file_key(path);
+    }
+    const file_reader reader(path, options_.reader);
+    // 分块必须覆盖打开时的整个文件：只覆盖前缀（例如文件变长之前得到的旧分块）时
+    // 得到的并不是整个文件的根哈希
+    // 各个任务直接哈希映射的页，落在同一窗口内的任务共用一次映射
+    return hash_spans(pool_, options_.lane, reader.size(), spans, options_.chunk_size, trace_key,
+                      [&reader](uint64_t offset, size_t length) { return reader.read(offset, length); });
+}
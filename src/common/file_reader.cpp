@@ -0,0 +1,192 @@
+#include "common/file_reader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+size_t page_size() {
+    static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+uint64_t fd_size(int fd) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        throw std::system_error(errno, std::generic_category(), "fstat");
+    }
+    return static_cast<uint64_t>(st.st_size);
+}
+
+}  // namespace
+
+/**
+ * 一段映射，最后一个视图释放时解除映射
+ */
+struct file_reader::mapping {
+    uint64_t index = 0;     // 窗口编号；单独映射的范围不进入缓存，不使用
+    uint64_t offset = 0;    // base 对应的文件偏移，页对齐
+    size_t length = 0;
+    void* base = nullptr;
+
+    mapping() = default;
+    mapping(const mapping&) = delete;
+    mapping& operator=(const mapping&) = delete;
+
+    ~mapping() {
+        if (base != nullptr) {
+            ::munmap(base, length);
+        }
+    }
+
+    const uint8_t* at(uint64_t file_offset) const {
+        return static_cast<const uint8_t*>(base) + (file_offset - offset);
+    }
+};
+
+file_reader::file_reader(const std::string& path, const file_reader_options& options) : options_(options) {
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    owns_fd_ = true;
+    try {
+        init();
+    } catch (...) {
+        ::close(fd_);
+        throw;
+    }
+}
+
+file_reader::file_reader(int fd, const file_reader_options& options) : fd_(fd), options_(options) {
+    init();
+}
+
+file_reader::~file_reader() {
+    // 视图可能比读取器活得久，映射由视图持有，这里只关闭描述符
+    if (owns_fd_) {
+        ::close(fd_);
+    }
+}
+
+void file_reader::init() {
+    const size_t page = page_size();
+    options_.window_size = std::max(page, (options_.window_size + page - 1) / page * page);
+    size_ = fd_size(fd_);
+    mapped_ = size_ > options_.mmap_threshold;
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (options_.sequential) {
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+}
+
+void file_reader::check_size(uint64_t end) const {
+    if (fd_size(fd_) < end) {
+        throw std::runtime_error("file shrank while reading");
+    }
+}
+
+file_view file_reader::read(uint64_t offset, size_t length) const {
+    if (offset > size_ || length > size_ - offset) {
+        throw std::runtime_error("read past end of file");
+    }
+    if (length == 0) {
+        return file_view();
+    }
+
+    if (!mapped_) {
+        std::shared_ptr<const std::vector<uint8_t>> contents;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!contents_) {
+                // 第一次读取时整个读入，之后的读取都引用这份内容
+                auto buffer = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(size_));
+                size_t done = 0;
+                while (done < buffer->size()) {
+                    const ssize_t n = ::pread(fd_, buffer->data() + done, buffer->size() - done,
+                                              static_cast<off_t>(done));
+                    if (n < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        throw std::system_error(errno, std::generic_category(), "pread");
+                    }
+                    if (n == 0) {
+                        throw std::runtime_error("file shrank while reading");
+                    }
+                    done += static_cast<size_t>(n);
+                }
+                contents_ = std::move(buffer);
+            }
+            contents = contents_;
+        }
+        return file_view(contents->data() + offset, length, contents);
+    }
+
+    const uint64_t index = offset / options_.window_size;
+    if (offset + length <= (index + 1) * options_.window_size) {
+        std::shared_ptr<const mapping> w = window(index);
+        return file_view(w->at(offset), length, w);
+    }
+    // 跨越窗口边界：单独映射，不放进窗口缓存
+    std::shared_ptr<const mapping> range = map_range(offset, length, false);
+    return file_view(range->at(offset), length, range);
+}
+
+std::shared_ptr<const file_reader::mapping> file_reader::window(uint64_t index) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < windows_.size(); ++i) {
+        if (windows_[i]->index == index) {
+            std::shared_ptr<const mapping> found = windows_[i];
+            // 移到末尾，最久未使用的窗口在开头
+            windows_.erase(windows_.begin() + static_cast<std::ptrdiff_t>(i));
+            windows_.push_back(found);
+            return found;
+        }
+    }
+
+    const uint64_t offset = index * options_.window_size;
+    const size_t length = static_cast<size_t>(std::min<uint64_t>(options_.window_size, size_ - offset));
+    std::shared_ptr<mapping> created = map_range(offset, length, true);
+    created->index = index;
+#if defined(POSIX_FADV_WILLNEED)
+    // 顺序读取时下一个窗口很快会用到，提前让内核读入页缓存
+    if (options_.sequential && offset + length < size_) {
+        ::posix_fadvise(fd_, static_cast<off_t>(offset + length),
+                        static_cast<off_t>(std::min<uint64_t>(options_.window_size, size_ - offset - length)),
+                        POSIX_FADV_WILLNEED);
+    }
+#endif
+    if (windows_.size() >= cached_windows) {
+        windows_.erase(windows_.begin());
+    }
+    windows_.push_back(created);
+    return created;
+}
+
+std::shared_ptr<file_reader::mapping> file_reader::map_range(uint64_t offset, size_t length, bool advise) const {
+    // 映射之前确认文件没有变短：映射超出文件末尾的页在访问时才会失败（SIGBUS）
+    check_size(offset + length);
+    const uint64_t aligned = offset / page_size() * page_size();
+    auto result = std::make_shared<mapping>();
+    result->offset = aligned;
+    result->length = static_cast<size_t>(offset - aligned) + length;
+    void* base = ::mmap(nullptr, result->length, PROT_READ, MAP_SHARED, fd_, static_cast<off_t>(aligned));
+    if (base == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+    result->base = base;
+    if (advise) {
+        ::madvise(base, result->length, options_.sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+        ::madvise(base, result->length, MADV_WILLNEED);
+    }
+    return result;
+}
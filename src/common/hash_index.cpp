@@ -0,0 +1,597 @@
+#include "common/hash_index.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t index_magic = 0x58494853;   // "SHIX"
+constexpr uint32_t index_version = 1;
+constexpr uint32_t record_magic = 0x43455253;  // "SREC"
+constexpr size_t header_size = 64;
+constexpr size_t checksum_size = 8;
+
+enum : uint8_t {
+    record_put = 1,
+    record_remove = 2,
+};
+
+struct file_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t entry_count;
+    uint64_t chunk_count;
+    uint64_t base_end;
+    uint8_t checksum[checksum_size];
+    uint8_t reserved[24];
+};
+static_assert(sizeof(file_header) == header_size, "index header must be 64 bytes");
+
+void checksum_of(const uint8_t* data, size_t size, uint8_t out[checksum_size]) {
+    const hash_digest digest = blake3_hasher::hash(data, size);
+    std::memcpy(out, digest.data(), checksum_size);
+}
+
+void write_all(int fd, const void* data, size_t size, uint64_t offset) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, bytes, size, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "pwrite hash index");
+        }
+        bytes += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+}
+
+bool read_all(int fd, void* data, size_t size, uint64_t offset) {
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        ssize_t n = ::pread(fd, bytes, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+template <typename T>
+void append_pod(std::vector<uint8_t>& out, const T& value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T read_pod(const uint8_t*& cursor) {
+    T value;
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return value;
+}
+
+uint64_t align8(uint64_t value) {
+    return (value + 7) & ~uint64_t(7);
+}
+
+bool key_less(uint64_t device_a, uint64_t inode_a, uint64_t device_b, uint64_t inode_b) {
+    return device_a != device_b ? device_a < device_b : inode_a < inode_b;
+}
+
+void fsync_directory_of(const std::string& path) {
+    const size_t slash = path.find_last_of('/');
+    const std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+}  // namespace
+
+file_identity file_identity::from_stat(const struct stat& st) {
+    file_identity id;
+    id.device = static_cast<uint64_t>(st.st_dev);
+    id.inode = static_cast<uint64_t>(st.st_ino);
+#if defined(__APPLE__)
+    id.mtime_ns = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    id.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    id.size = static_cast<uint64_t>(st.st_size);
+    return id;
+}
+
+hash_index::hash_index(const std::string& path) : path_(path) {
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + path_);
+    }
+    if (!map_base()) {
+        reset_file();
+    }
+    replay_log();
+}
+
+hash_index::~hash_index() {
+    unmap();
+    if (fd_ >= 0) {
+        ::fdatasync(fd_);
+        ::close(fd_);
+    }
+}
+
+void hash_index::unmap() {
+    if (map_ != nullptr) {
+        ::munmap(map_, map_size_);
+    }
+    map_ = nullptr;
+    map_size_ = 0;
+    base_entries_ = nullptr;
+    base_chunks_ = nullptr;
+    base_count_ = 0;
+    base_end_ = 0;
+}
+
+bool hash_index::map_base() {
+    static_assert(sizeof(base_entry) == 80, "base entry layout is part of the file format");
+    static_assert(sizeof(stored_chunk) == 36, "stored chunk layout is part of the file format");
+
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        throw std::system_error(errno, std::generic_category(), "fstat " + path_);
+    }
+    const uint64_t file_size = static_cast<uint64_t>(st.st_size);
+    file_header header;
+    if (file_size < header_size || !read_all(fd_, &header, sizeof(header), 0)) {
+        return false;
+    }
+    if (header.magic != index_magic || header.version != index_version || header.base_end > file_size ||
+        header.entry_count > file_size / sizeof(base_entry) || header.chunk_count > file_size / sizeof(stored_chunk)) {
+        return false;
+    }
+    const uint64_t chunks_offset = header_size + header.entry_count * sizeof(base_entry);
+    const uint64_t expected_end = align8(chunks_offset + header.chunk_count * sizeof(stored_chunk));
+    if (header.base_end != expected_end) {
+        return false;
+    }
+
+    void* map = ::mmap(nullptr, static_cast<size_t>(header.base_end), PROT_READ, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap " + path_);
+    }
+    // 校验和覆盖头部（校验和字段置零）和整个基础段
+    const uint8_t* bytes = static_cast<const uint8_t*>(map);
+    file_header zeroed = header;
+    std::memset(zeroed.checksum, 0, checksum_size);
+    blake3_hasher hasher;
+    hasher.update(&zeroed, sizeof(zeroed));
+    hasher.update(bytes + header_size, static_cast<size_t>(header.base_end - header_size));
+    const hash_digest digest = hasher.finalize();
+    if (std::memcmp(digest.data(), header.checksum, checksum_size) != 0) {
+        ::munmap(map, static_cast<size_t>(header.base_end));
+        return false;
+    }
+
+    // 基础段是只读的，按顺序查找时预读即可
+    ::madvise(map, static_cast<size_t>(header.base_end), MADV_WILLNEED);
+    map_ = map;
+    map_size_ = static_cast<size_t>(header.base_end);
+    base_entries_ = reinterpret_cast<const base_entry*>(bytes + header_size);
+    base_count_ = header.entry_count;
+    base_chunks_ = reinterpret_cast<const stored_chunk*>(bytes + chunks_offset);
+    base_end_ = header.base_end;
+    live_count_ = static_cast<size_t>(base_count_);
+    return true;
+}
+
+void hash_index::reset_file() {
+    // 写一个空的基础段。索引只是缓存，内容损坏时直接丢弃
+    file_header header = {};
+    header.magic = index_magic;
+    header.version = index_version;
+    header.base_end = header_size;
+    blake3_hasher hasher;
+    hasher.update(&header, sizeof(header));
+    const hash_digest digest = hasher.finalize();
+    std::memcpy(header.checksum, digest.data(), checksum_size);
+
+    if (::ftruncate(fd_, 0) != 0) {
+        throw std::system_error(errno, std::generic_category(), "ftruncate " + path_);
+    }
+    write_all(fd_, &header, sizeof(header), 0);
+    ::fdatasync(fd_);
+    if (!map_base()) {
+        throw std::runtime_error("failed to initialise hash index " + path_);
+    }
+}
+
+void hash_index::replay_log() {
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        throw std::system_error(errno, std::generic_category(), "fstat " + path_);
+    }
+    const uint64_t file_size = static_cast<uint64_t>(st.st_size);
+    uint64_t offset = base_end_;
+    std::vector<uint8_t> body;
+    std::vector<stored_chunk> chunks;
+
+    while (offset + 8 <= file_size) {
+        uint32_t prefix[2];
+        if (!read_all(fd_, prefix, sizeof(prefix), offset) || prefix[0] != record_magic) {
+            break;
+        }
+        const uint64_t body_len = prefix[1];
+        if (body_len < 17 || offset + 8 + body_len + checksum_size > file_size) {
+            break;
+        }
+        body.resize(static_cast<size_t>(body_len + checksum_size));
+        if (!read_all(fd_, body.data(), body.size(), offset + 8)) {
+            break;
+        }
+        uint8_t checksum[checksum_size];
+        checksum_of(body.data(), static_cast<size_t>(body_len), checksum);
+        if (std::memcmp(checksum, body.data() + body_len, checksum_size) != 0) {
+            break;
+        }
+
+        const uint8_t* cursor = body.data();
+        overlay_entry entry = {};
+        const uint8_t kind = read_pod<uint8_t>(cursor);
+        entry.device = read_pod<uint64_t>(cursor);
+        entry.inode = read_pod<uint64_t>(cursor);
+        if (kind == record_remove) {
+            entry.removed = true;
+            apply_overlay(entry, nullptr);
+        } else if (kind == record_put && body_len >= 17 + 8 + 8 + hash_digest_size + 4) {
+            entry.mtime_ns = read_pod<int64_t>(cursor);
+            entry.size = read_pod<uint64_t>(cursor);
+            std::memcpy(entry.root.data(), cursor, hash_digest_size);
+            cursor += hash_digest_size;
+            entry.chunk_count = read_pod<uint32_t>(cursor);
+            if (body_len != 17 + 8 + 8 + hash_digest_size + 4 + uint64_t(entry.chunk_count) * sizeof(stored_chunk)) {
+                break;
+            }
+            // 记录体中的分块没有对齐，先拷贝出来
+            chunks.resize(entry.chunk_count);
+            std::memcpy(chunks.data(), cursor, chunks.size() * sizeof(stored_chunk));
+            apply_overlay(entry, chunks.data());
+        } else {
+            break;
+        }
+        offset += 8 + body_len + checksum_size;
+    }
+
+    // 截掉崩溃时写了一半的尾部
+    if (offset < file_size && ::ftruncate(fd_, static_cast<off_t>(offset)) != 0) {
+        throw std::system_error(errno, std::generic_category(), "ftruncate " + path_);
+    }
+    log_end_ = offset;
+}
+
+size_t hash_index::overlay_slot(uint64_t device, uint64_t inode) const {
+    // 64 位混合后取低位，线性探测
+    uint64_t h = device * 0x9E3779B97F4A7C15ULL ^ inode;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    const size_t mask = overlay_table_.size() - 1;
+    size_t slot = static_cast<size_t>(h) & mask;
+    while (overlay_table_[slot] != 0) {
+        const overlay_entry& entry = overlay_entries_[overlay_table_[slot] - 1];
+        if (entry.device == device && entry.inode == inode) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void hash_index::grow_overlay() {
+    std::vector<uint32_t> old;
+    old.swap(overlay_table_);
+    overlay_table_.assign(old.empty() ? 1024 : old.size() * 2, 0);
+    for (uint32_t index : old) {
+        if (index != 0) {
+            const overlay_entry& entry = overlay_entries_[index - 1];
+            overlay_table_[overlay_slot(entry.device, entry.inode)] = index;
+        }
+    }
+}
+
+const hash_index::overlay_entry* hash_index::find_overlay(uint64_t device, uint64_t inode) const {
+    if (overlay_table_.empty()) {
+        return nullptr;
+    }
+    const uint32_t index = overlay_table_[overlay_slot(device, inode)];
+    return index == 0 ? nullptr : &overlay_entries_[index - 1];
+}
+
+const hash_index::base_entry* hash_index::find_base(uint64_t device, uint64_t inode) const {
+    const base_entry* end = base_entries_ + base_count_;
+    const base_entry* it = std::lower_bound(base_entries_, end, 0, [&](const base_entry& e, int) {
+        return key_less(e.device, e.inode, device, inode);
+    });
+    if (it != end && it->device == device && it->inode == inode) {
+        return it;
+    }
+    return nullptr;
+}
+
+bool hash_index::is_live(uint64_t device, uint64_t inode) const {
+    if (const overlay_entry* entry = find_overlay(device, inode)) {
+        return !entry->removed;
+    }
+    return find_base(device, inode) != nullptr;
+}
+
+void hash_index::apply_overlay(overlay_entry entry, const stored_chunk* chunks) {
+    const bool was_live = is_live(entry.device, entry.inode);
+    if (!entry.removed) {
+        entry.chunk_begin = overlay_chunks_.size();
+        overlay_chunks_.insert(overlay_chunks_.end(), chunks, chunks + entry.chunk_count);
+    }
+
+    // 负载因子不超过 1/2
+    if ((overlay_entries_.size() + 1) * 2 > overlay_table_.size()) {
+        grow_overlay();
+    }
+    const size_t slot = overlay_slot(entry.device, entry.inode);
+    if (overlay_table_[slot] != 0) {
+        // 同一文件的新记录覆盖旧记录；旧记录的分块留在数组中，compact 时回收
+        overlay_entries_[overlay_table_[slot] - 1] = entry;
+    } else {
+        overlay_entries_.push_back(entry);
+        overlay_table_[slot] = static_cast<uint32_t>(overlay_entries_.size());
+    }
+
+    const bool now_live = !entry.removed;
+    live_count_ = live_count_ + (now_live ? 1 : 0) - (was_live ? 1 : 0);
+}
+
+bool hash_index::lookup(const file_identity& id, file_hash_result& result) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    int64_t mtime_ns;
+    uint64_t size;
+    const hash_digest* root;
+    const stored_chunk* chunks;
+    uint32_t chunk_count;
+    if (const overlay_entry* entry = find_overlay(id.device, id.inode)) {
+        if (entry->removed) {
+            return false;
+        }
+        mtime_ns = entry->mtime_ns;
+        size = entry->size;
+        root = &entry->root;
+        chunks = overlay_chunks_.data() + entry->chunk_begin;
+        chunk_count = entry->chunk_count;
+    } else if (const base_entry* entry = find_base(id.device, id.inode)) {
+        mtime_ns = entry->mtime_ns;
+        size = entry->size;
+        root = &entry->root;
+        chunks = base_chunks_ + entry->chunk_begin;
+        chunk_count = entry->chunk_count;
+    } else {
+        return false;
+    }
+    if (mtime_ns != id.mtime_ns || size != id.size) {
+        return false;
+    }
+
+    result.size = size;
+    result.root = *root;
+    result.chunks.resize(chunk_count);
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < chunk_count; ++i) {
+        result.chunks[i].offset = offset;
+        result.chunks[i].length = chunks[i].length;
+        result.chunks[i].digest = chunks[i].digest;
+        offset += chunks[i].length;
+    }
+    return true;
+}
+
+void hash_index::append_record(const std::vector<uint8_t>& body) {
+    std::vector<uint8_t> record;
+    record.reserve(8 + body.size() + checksum_size);
+    append_pod(record, record_magic);
+    append_pod(record, static_cast<uint32_t>(body.size()));
+    record.insert(record.end(), body.begin(), body.end());
+    uint8_t checksum[checksum_size];
+    checksum_of(body.data(), body.size(), checksum);
+    record.insert(record.end(), checksum, checksum + checksum_size);
+
+    write_all(fd_, record.data(), record.size(), log_end_);
+    log_end_ += record.size();
+}
+
+void hash_index::put(const file_identity& id, const file_hash_result& result) {
+    std::vector<stored_chunk> chunks(result.chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        chunks[i].length = result.chunks[i].length;
+        chunks[i].digest = result.chunks[i].digest;
+    }
+
+    std::vector<uint8_t> body;
+    body.reserve(64 + chunks.size() * sizeof(stored_chunk));
+    append_pod(body, record_put);
+    append_pod(body, id.device);
+    append_pod(body, id.inode);
+    append_pod(body, id.mtime_ns);
+    append_pod(body, id.size);
+    body.insert(body.end(), result.root.begin(), result.root.end());
+    append_pod(body, static_cast<uint32_t>(chunks.size()));
+    const uint8_t* chunk_bytes = reinterpret_cast<const uint8_t*>(chunks.data());
+    body.insert(body.end(), chunk_bytes, chunk_bytes + chunks.size() * sizeof(stored_chunk));
+
+    overlay_entry entry = {};
+    entry.device = id.device;
+    entry.inode = id.inode;
+    entry.mtime_ns = id.mtime_ns;
+    entry.size = id.size;
+    entry.root = result.root;
+    entry.chunk_count = static_cast<uint32_t>(chunks.size());
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    append_record(body);
+    apply_overlay(entry, chunks.data());
+}
+
+void hash_index::remove(uint64_t device, uint64_t inode) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (!is_live(device, inode)) {
+        return;
+    }
+    std::vector<uint8_t> body;
+    append_pod(body, record_remove);
+    append_pod(body, device);
+    append_pod(body, inode);
+    append_record(body);
+
+    overlay_entry entry = {};
+    entry.device = device;
+    entry.inode = inode;
+    entry.removed = true;
+    apply_overlay(entry, nullptr);
+}
+
+void hash_index::flush() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (::fdatasync(fd_) != 0) {
+        throw std::system_error(errno, std::generic_category(), "fdatasync " + path_);
+    }
+}
+
+void hash_index::compact() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    // 合并：基础段中未被日志覆盖的条目 + 日志中仍然有效的条目，按键排序
+    struct source {
+        uint64_t device;
+        uint64_t inode;
+        const base_entry* base;
+        const overlay_entry* overlay;
+    };
+    std::vector<source> sources;
+    sources.reserve(static_cast<size_t>(base_count_) + overlay_entries_.size());
+    for (uint64_t i = 0; i < base_count_; ++i) {
+        const base_entry& entry = base_entries_[i];
+        if (find_overlay(entry.device, entry.inode) == nullptr) {
+            sources.push_back(source{entry.device, entry.inode, &entry, nullptr});
+        }
+    }
+    for (const auto& entry : overlay_entries_) {
+        if (!entry.removed) {
+            sources.push_back(source{entry.device, entry.inode, nullptr, &entry});
+        }
+    }
+    std::sort(sources.begin(), sources.end(),
+              [](const source& a, const source& b) { return key_less(a.device, a.inode, b.device, b.inode); });
+
+    std::vector<base_entry> entries(sources.size());
+    std::vector<stored_chunk> chunks;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        base_entry& out = entries[i];
+        const stored_chunk* from;
+        if (sources[i].base != nullptr) {
+            out = *sources[i].base;
+            from = base_chunks_ + out.chunk_begin;
+        } else {
+            const overlay_entry& entry = *sources[i].overlay;
+            out = base_entry{};
+            out.device = entry.device;
+            out.inode = entry.inode;
+            out.mtime_ns = entry.mtime_ns;
+            out.size = entry.size;
+            out.root = entry.root;
+            out.chunk_count = entry.chunk_count;
+            from = overlay_chunks_.data() + entry.chunk_begin;
+        }
+        out.chunk_begin = chunks.size();
+        chunks.insert(chunks.end(), from, from + out.chunk_count);
+    }
+
+    file_header header = {};
+    header.magic = index_magic;
+    header.version = index_version;
+    header.entry_count = entries.size();
+    header.chunk_count = chunks.size();
+    const uint64_t chunks_offset = header_size + entries.size() * sizeof(base_entry);
+    const uint64_t chunks_end = chunks_offset + chunks.size() * sizeof(stored_chunk);
+    header.base_end = align8(chunks_end);
+    const uint8_t padding[8] = {};
+
+    blake3_hasher hasher;
+    hasher.update(&header, sizeof(header));
+    hasher.update(entries.data(), entries.size() * sizeof(base_entry));
+    hasher.update(chunks.data(), chunks.size() * sizeof(stored_chunk));
+    hasher.update(padding, static_cast<size_t>(header.base_end - chunks_end));
+    const hash_digest digest = hasher.finalize();
+    std::memcpy(header.checksum, digest.data(), checksum_size);
+
+    // 写临时文件并 fsync 后再 rename：崩溃时要么是旧文件，要么是完整的新文件
+    const std::string temp = path_ + ".tmp";
+    const int fd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + temp);
+    }
+    try {
+        write_all(fd, &header, sizeof(header), 0);
+        write_all(fd, entries.data(), entries.size() * sizeof(base_entry), header_size);
+        write_all(fd, chunks.data(), chunks.size() * sizeof(stored_chunk), chunks_offset);
+        write_all(fd, padding, static_cast<size_t>(header.base_end - chunks_end), chunks_end);
+        if (::fsync(fd) != 0) {
+            throw std::system_error(errno, std::generic_category(), "fsync " + temp);
+        }
+        if (::rename(temp.c_str(), path_.c_str()) != 0) {
+            throw std::system_error(errno, std::generic_category(), "rename " + temp);
+        }
+    } catch (...) {
+        ::close(fd);
+        ::unlink(temp.c_str());
+        throw;
+    }
+    fsync_directory_of(path_);
+
+    // 切换到新文件
+    unmap();
+    ::close(fd_);
+    fd_ = fd;
+    overlay_entries_.clear();
+    overlay_chunks_.clear();
+    overlay_table_.clear();
+    if (!map_base()) {
+        throw std::runtime_error("compacted hash index failed verification: " + path_);
+    }
+    log_end_ = base_end_;
+}
+
+size_t hash_index::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return live_count_;
+}
+
+uint64_t hash_index::log_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return log_end_ - base_end_;
+}
@@ -0,0 +1,334 @@
+#include "common/io_uring.h"
+
+#if defined(SYNC_HAVE_IO_URING)
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+int sys_setup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int sys_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template <typename T>
+T* at_offset(void* base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+}
+
+}  // namespace
+
+io_uring_queue::io_uring_queue(uint32_t entries) {
+    io_uring_params params = {};
+    // 多次触发的接收会为一个提交项产生很多完成项，完成队列开得比提交队列大
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    params.cq_entries = entries * 4;
+    ring_fd_ = sys_setup(entries, &params);
+    if (ring_fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+    }
+
+    sq_map_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_map_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_map_size_ = cq_map_size_ = std::max(sq_map_size_, cq_map_size_);
+    }
+    sq_map_ = ::mmap(nullptr, sq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                     IORING_OFF_SQ_RING);
+    if (sq_map_ == MAP_FAILED) {
+        const int error = errno;
+        ::close(ring_fd_);
+        throw std::system_error(error, std::generic_category(), "mmap io_uring sq");
+    }
+    if (single_mmap) {
+        cq_map_ = sq_map_;
+    } else {
+        cq_map_ = ::mmap(nullptr, cq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                         IORING_OFF_CQ_RING);
+        if (cq_map_ == MAP_FAILED) {
+            const int error = errno;
+            ::munmap(sq_map_, sq_map_size_);
+            ::close(ring_fd_);
+            throw std::system_error(error, std::generic_category(), "mmap io_uring cq");
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                        IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        const int error = errno;
+        if (!single_mmap) {
+            ::munmap(cq_map_, cq_map_size_);
+        }
+        ::munmap(sq_map_, sq_map_size_);
+        ::close(ring_fd_);
+        throw std::system_error(error, std::generic_category(), "mmap io_uring sqes");
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sq_head_ = at_offset<unsigned>(sq_map_, params.sq_off.head);
+    sq_tail_ = at_offset<unsigned>(sq_map_, params.sq_off.tail);
+    sq_array_ = at_offset<unsigned>(sq_map_, params.sq_off.array);
+    sq_mask_ = *at_offset<unsigned>(sq_map_, params.sq_off.ring_mask);
+    sq_entries_ = *at_offset<unsigned>(sq_map_, params.sq_off.ring_entries);
+    cq_head_ = at_offset<unsigned>(cq_map_, params.cq_off.head);
+    cq_tail_ = at_offset<unsigned>(cq_map_, params.cq_off.tail);
+    cqes_ = at_offset<io_uring_cqe>(cq_map_, params.cq_off.cqes);
+    cq_mask_ = *at_offset<unsigned>(cq_map_, params.cq_off.ring_mask);
+
+    // 提交项按顺序使用，索引数组固定为恒等映射
+    for (unsigned i = 0; i < sq_entries_; ++i) {
+        sq_array_[i] = i;
+    }
+    sqe_tail_ = *sq_tail_;
+}
+
+io_uring_queue::~io_uring_queue() {
+    ::munmap(sqes_, sqes_size_);
+    if (cq_map_ != sq_map_) {
+        ::munmap(cq_map_, cq_map_size_);
+    }
+    ::munmap(sq_map_, sq_map_size_);
+    ::close(ring_fd_);
+}
+
+bool io_uring_queue::supported(const uint8_t* opcodes, size_t count) {
+    try {
+        io_uring_queue queue(2);
+        constexpr unsigned max_ops = 256;
+        std::vector<uint8_t> buffer(sizeof(io_uring_probe) + max_ops * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (sys_register(queue.ring_fd_, IORING_REGISTER_PROBE, probe, max_ops) < 0) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (opcodes[i] > probe->last_op || !(probe->ops[opcodes[i]].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    } catch (const std::system_error&) {
+        // 内核太旧、被 io_uring_disabled 禁用或被 seccomp 拦截
+        return false;
+    }
+}
+
+io_uring_queue* thread_io_uring(uint32_t entries) {
+    thread_local std::unique_ptr<io_uring_queue> ring;
+    thread_local bool failed = false;
+    if (!ring && !failed) {
+        try {
+            ring = std::make_unique<io_uring_queue>(entries);
+        } catch (const std::system_error&) {
+            failed = true;
+        }
+    }
+    return ring.get();
+}
+
+io_uring_sqe* io_uring_queue::get_sqe() {
+    if (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+        submit(0);
+        if (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+            return nullptr;
+        }
+    }
+    io_uring_sqe* sqe = &sqes_[sqe_tail_ & sq_mask_];
+    ++sqe_tail_;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+unsigned io_uring_queue::submit(unsigned wait_nr) {
+    // 发布尾指针之前提交项的内容必须对内核可见
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    const unsigned to_submit = sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (to_submit == 0 && wait_nr == 0) {
+        return 0;
+    }
+    const int n = sys_enter(ring_fd_, to_submit, wait_nr, wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0);
+    if (n < 0) {
+        // EBUSY/EAGAIN：完成队列积压，调用方处理完已有的完成项后再提交
+        if (errno == EINTR || errno == EBUSY || errno == EAGAIN) {
+            return 0;
+        }
+        throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+    }
+    return static_cast<unsigned>(n);
+}
+
+void io_uring_queue::register_buffers(const iovec* buffers, unsigned count) {
+    if (sys_register(ring_fd_, IORING_REGISTER_BUFFERS, buffers, count) < 0) {
+        throw std::system_error(errno, std::generic_category(), "io_uring register buffers");
+    }
+}
+
+void io_uring_queue::register_buffer_ring(io_uring_buf_ring* ring, uint32_t entries, uint16_t group) {
+    io_uring_buf_reg reg = {};
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = entries;
+    reg.bgid = group;
+    if (sys_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        throw std::system_error(errno, std::generic_category(), "io_uring register buffer ring");
+    }
+}
+
+void io_uring_queue::unregister_buffer_ring(uint16_t group) {
+    io_uring_buf_reg reg = {};
+    reg.bgid = group;
+    sys_register(ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+}
+
+io_uring_provided_buffers::io_uring_provided_buffers(io_uring_queue& queue, uint16_t group, uint32_t count,
+                                                     uint8_t* base, uint32_t buffer_size, uint64_t tag)
+    : queue_(queue), group_(group), mask_(count - 1), base_(base), buffer_size_(buffer_size), tag_(tag) {
+    if (count == 0 || count > 32768 || (count & (count - 1)) != 0) {
+        throw std::system_error(EINVAL, std::generic_category(), "io_uring provided buffer count");
+    }
+    if (map_ring(count)) {
+        for (uint32_t i = 0; i < count; ++i) {
+            recycle(static_cast<uint16_t>(i));
+        }
+        publish();
+        if (self_test()) {
+            return;
+        }
+        // 注册成功但选择缓冲区时看不到环中的缓冲区（在一些内核上观察到），退回旧接口
+        unmap_ring();
+        tail_ = 0;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        recycle(static_cast<uint16_t>(i));
+    }
+    publish();
+}
+
+io_uring_provided_buffers::~io_uring_provided_buffers() {
+    unmap_ring();
+}
+
+bool io_uring_provided_buffers::map_ring(uint32_t count) {
+    // 环的内存必须按页对齐，直接映射匿名页
+    ring_bytes_ = count * sizeof(io_uring_buf);
+    void* ring = ::mmap(nullptr, ring_bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        return false;
+    }
+    // 注册前先写入，让内核固定的是已经分配的页而不是共享的零页
+    std::memset(ring, 0, ring_bytes_);
+    try {
+        queue_.register_buffer_ring(static_cast<io_uring_buf_ring*>(ring), count, group_);
+    } catch (const std::system_error&) {
+        // 5.19 之前的内核没有缓冲区环
+        ::munmap(ring, ring_bytes_);
+        return false;
+    }
+    ring_ = static_cast<io_uring_buf_ring*>(ring);
+    return true;
+}
+
+void io_uring_provided_buffers::unmap_ring() {
+    if (ring_ != nullptr) {
+        queue_.unregister_buffer_ring(group_);
+        ::munmap(ring_, ring_bytes_);
+        ring_ = nullptr;
+    }
+}
+
+bool io_uring_provided_buffers::self_test() {
+    int fds[2];
+    if (::pipe2(fds, O_CLOEXEC) != 0) {
+        return true;
+    }
+    const uint8_t byte = 0;
+    bool done = false;
+    bool ok = false;
+    io_uring_sqe* sqe = ::write(fds[1], &byte, 1) == 1 ? queue_.get_sqe() : nullptr;
+    if (sqe != nullptr) {
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fds[0];
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = group_;
+        sqe->off = ~uint64_t(0);
+        sqe->user_data = tag_;
+        while (!done) {
+            queue_.submit(1);
+            queue_.for_each_cqe([&](const io_uring_cqe& cqe) {
+                if (cqe.user_data != tag_) {
+                    return;
+                }
+                done = true;
+                ok = cqe.res == 1;
+                if (cqe.flags & IORING_CQE_F_BUFFER) {
+                    recycle(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+                    publish();
+                }
+            });
+        }
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return ok || sqe == nullptr;
+}
+
+void io_uring_provided_buffers::recycle(uint16_t id) {
+    if (ring_ == nullptr) {
+        pending_.push_back(id);
+        return;
+    }
+    io_uring_buf& buf = ring_->bufs[tail_ & mask_];
+    buf.addr = reinterpret_cast<uint64_t>(buffer(id));
+    buf.len = buffer_size_;
+    buf.bid = id;
+    ++tail_;
+}
+
+void io_uring_provided_buffers::publish() {
+    if (ring_ != nullptr) {
+        // 尾指针与第一个描述的保留字段重叠，用 release 存储让之前写入的描述先可见
+        __atomic_store_n(&ring_->tail, tail_, __ATOMIC_RELEASE);
+        return;
+    }
+    // 连续的编号合并成一个提交项
+    std::sort(pending_.begin(), pending_.end());
+    size_t i = 0;
+    while (i < pending_.size()) {
+        size_t j = i + 1;
+        while (j < pending_.size() && pending_[j] == pending_[j - 1] + 1) {
+            ++j;
+        }
+        io_uring_sqe* sqe = queue_.get_sqe();
+        if (sqe == nullptr) {
+            break;
+        }
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = static_cast<int>(j - i);
+        sqe->addr = reinterpret_cast<uint64_t>(buffer(pending_[i]));
+        sqe->len = buffer_size_;
+        sqe->off = pending_[i];
+        sqe->buf_group = group_;
+        sqe->user_data = tag_;
+        i = j;
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(i));
+}
+
+#endif
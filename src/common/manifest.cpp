@@ -0,0 +1,515 @@
+#include "common/manifest.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t manifest_magic = 0x31464D53;  // "SMF1"
+constexpr uint32_t manifest_version = 1;
+constexpr size_t header_size = 64;
+constexpr size_t checksum_size = 8;
+constexpr size_t meta_size = 24;
+constexpr size_t entry_fixed_size = meta_size + hash_digest_size;
+
+// 头部各字段的偏移
+constexpr size_t header_magic = 0;
+constexpr size_t header_version = 4;
+constexpr size_t header_entry_count = 8;
+constexpr size_t header_restart_interval = 16;
+constexpr size_t header_flags = 20;
+constexpr size_t header_restarts_offset = 24;
+constexpr size_t header_paths_offset = 32;
+constexpr size_t header_paths_size = 40;
+constexpr size_t header_checksum = 48;
+static_assert(header_checksum + checksum_size <= header_size, "manifest header must fit in 64 bytes");
+
+void store_u32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+void store_u64(uint8_t* out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t load_u32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t load_u64(const uint8_t* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+void put_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t get_varint(const uint8_t* data, uint64_t size, uint64_t& offset) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (offset >= size) {
+            throw std::runtime_error("malformed manifest: truncated path table");
+        }
+        const uint8_t byte = data[offset++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("malformed manifest: varint too long");
+}
+
+void checksum_of(const uint8_t* header, const uint8_t* body, size_t body_size, uint8_t out[checksum_size]) {
+    // 校验和覆盖校验和字段清零后的头部和之后的全部内容
+    uint8_t copy[header_size];
+    std::memcpy(copy, header, header_size);
+    std::memset(copy + header_checksum, 0, checksum_size);
+    blake3_hasher hasher;
+    hasher.update(copy, header_size);
+    hasher.update(body, body_size);
+    const hash_digest digest = hasher.finalize();
+    std::memcpy(out, digest.data(), checksum_size);
+}
+
+void write_all(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "write manifest");
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+void fsync_directory_of(const std::string& path) {
+    const size_t slash = path.find_last_of('/');
+    const std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+// 路径表中一条记录：与前一条共享的前缀长度和后缀
+struct path_record {
+    uint64_t shared;
+    const uint8_t* suffix;
+    uint64_t suffix_size;
+};
+
+path_record read_record(const uint8_t* paths, uint64_t paths_size, uint64_t& offset) {
+    path_record record;
+    record.shared = get_varint(paths, paths_size, offset);
+    record.suffix_size = get_varint(paths, paths_size, offset);
+    if (record.suffix_size > paths_size - offset) {
+        throw std::runtime_error("malformed manifest: path exceeds path table");
+    }
+    record.suffix = paths + offset;
+    offset += record.suffix_size;
+    return record;
+}
+
+// 按字节（无符号）比较，与 std::string 的比较一致
+int compare_bytes(const uint8_t* data, size_t size, const std::string& path) {
+    const size_t common = std::min(size, path.size());
+    const int result = common == 0 ? 0 : std::memcmp(data, path.data(), common);
+    if (result != 0) {
+        return result;
+    }
+    return size < path.size() ? -1 : (size > path.size() ? 1 : 0);
+}
+
+}  // namespace
+
+manifest_builder::manifest_builder(uint32_t restart_interval) : restart_interval_(restart_interval) {
+    if (restart_interval == 0) {
+        throw std::invalid_argument("manifest restart interval must be positive");
+    }
+}
+
+void manifest_builder::add(const manifest_entry& entry) {
+    add(entry.path, entry.meta, entry.hash);
+}
+
+void manifest_builder::add(const std::string& path, const manifest_meta& meta, const hash_digest& hash) {
+    if (count_ > 0 && !(last_path_ < path)) {
+        throw std::invalid_argument("manifest paths must be strictly ascending: " + path);
+    }
+
+    uint8_t fixed[meta_size];
+    store_u64(fixed, meta.size);
+    store_u64(fixed + 8, static_cast<uint64_t>(meta.mtime_ns));
+    store_u32(fixed + 16, meta.mode);
+    store_u32(fixed + 20, 0);
+    meta_.insert(meta_.end(), fixed, fixed + meta_size);
+    hashes_.insert(hashes_.end(), hash.begin(), hash.end());
+
+    size_t shared = 0;
+    if (count_ % restart_interval_ == 0) {
+        restarts_.push_back(paths_.size());
+    } else {
+        const size_t limit = std::min(last_path_.size(), path.size());
+        while (shared < limit && last_path_[shared] == path[shared]) {
+            ++shared;
+        }
+    }
+    put_varint(paths_, shared);
+    put_varint(paths_, path.size() - shared);
+    paths_.insert(paths_.end(), path.begin() + static_cast<std::ptrdiff_t>(shared), path.end());
+
+    last_path_ = path;
+    ++count_;
+}
+
+std::vector<uint8_t> manifest_builder::finish() {
+    const uint64_t restarts_offset = header_size + count_ * entry_fixed_size;
+    const uint64_t paths_offset = restarts_offset + restarts_.size() * sizeof(uint64_t);
+
+    std::vector<uint8_t> out(paths_offset + paths_.size());
+    uint8_t* header = out.data();
+    store_u32(header + header_magic, manifest_magic);
+    store_u32(header + header_version, manifest_version);
+    store_u64(header + header_entry_count, count_);
+    store_u32(header + header_restart_interval, restart_interval_);
+    store_u32(header + header_flags, 0);
+    store_u64(header + header_restarts_offset, restarts_offset);
+    store_u64(header + header_paths_offset, paths_offset);
+    store_u64(header + header_paths_size, paths_.size());
+
+    uint8_t* cursor = out.data() + header_size;
+    std::copy(meta_.begin(), meta_.end(), cursor);
+    cursor += meta_.size();
+    std::copy(hashes_.begin(), hashes_.end(), cursor);
+    cursor += hashes_.size();
+    for (uint64_t restart : restarts_) {
+        store_u64(cursor, restart);
+        cursor += sizeof(uint64_t);
+    }
+    std::copy(paths_.begin(), paths_.end(), cursor);
+
+    checksum_of(header, out.data() + header_size, out.size() - header_size, header + header_checksum);
+
+    count_ = 0;
+    last_path_.clear();
+    meta_.clear();
+    hashes_.clear();
+    restarts_.clear();
+    paths_.clear();
+    return out;
+}
+
+void manifest_builder::write(const std::string& path) {
+    const std::vector<uint8_t> data = finish();
+
+    // 写临时文件并 fsync 后再 rename：崩溃时要么是旧清单，要么是完整的新清单
+    const std::string temp = path + ".tmp";
+    const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + temp);
+    }
+    try {
+        write_all(fd, data.data(), data.size());
+        if (::fsync(fd) != 0) {
+            throw std::system_error(errno, std::generic_category(), "fsync " + temp);
+        }
+        if (::rename(temp.c_str(), path.c_str()) != 0) {
+            throw std::system_error(errno, std::generic_category(), "rename " + temp);
+        }
+    } catch (...) {
+        ::close(fd);
+        ::unlink(temp.c_str());
+        throw;
+    }
+    ::close(fd);
+    fsync_directory_of(path);
+}
+
+void sort_manifest_entries(std::vector<manifest_entry>& entries) {
+    std::sort(entries.begin(), entries.end(),
+              [](const manifest_entry& a, const manifest_entry& b) { return a.path < b.path; });
+}
+
+manifest::manifest(file_view data, bool verify) : data_(std::move(data)) {
+    const uint8_t* base = data_.data();
+    const uint64_t size = data_.size();
+    if (size < header_size) {
+        throw std::runtime_error("malformed manifest: truncated header");
+    }
+    if (load_u32(base + header_magic) != manifest_magic) {
+        throw std::runtime_error("malformed manifest: bad magic");
+    }
+    if (load_u32(base + header_version) != manifest_version) {
+        throw std::runtime_error("malformed manifest: unsupported version");
+    }
+
+    const uint64_t count = load_u64(base + header_entry_count);
+    restart_interval_ = load_u32(base + header_restart_interval);
+    const uint64_t restarts_offset = load_u64(base + header_restarts_offset);
+    const uint64_t paths_offset = load_u64(base + header_paths_offset);
+    paths_size_ = load_u64(base + header_paths_size);
+    if (restart_interval_ == 0) {
+        throw std::runtime_error("malformed manifest: zero restart interval");
+    }
+    if (count > (size - header_size) / entry_fixed_size) {
+        throw std::runtime_error("malformed manifest: entry count exceeds size");
+    }
+    count_ = static_cast<size_t>(count);
+    restart_count_ = (count_ + restart_interval_ - 1) / restart_interval_;
+    if (restarts_offset != header_size + count * entry_fixed_size ||
+        paths_offset != restarts_offset + restart_count_ * sizeof(uint64_t) || paths_offset > size ||
+        paths_size_ != size - paths_offset) {
+        throw std::runtime_error("malformed manifest: inconsistent section offsets");
+    }
+
+    if (verify) {
+        uint8_t checksum[checksum_size];
+        checksum_of(base, base + header_size, static_cast<size_t>(size - header_size), checksum);
+        if (std::memcmp(checksum, base + header_checksum, checksum_size) != 0) {
+            throw std::runtime_error("malformed manifest: checksum mismatch");
+        }
+    }
+
+    meta_ = base + header_size;
+    hashes_ = meta_ + count_ * meta_size;
+    restarts_ = base + restarts_offset;
+    paths_ = base + paths_offset;
+}
+
+manifest manifest::open(const std::string& path, bool verify) {
+    file_reader_options options;
+    options.sequential = false;  // 查找是随机访问
+    file_reader reader(path, options);
+    return manifest(reader.read(0, static_cast<size_t>(reader.size())), verify);
+}
+
+manifest_meta manifest::meta(size_t index) const {
+    const uint8_t* fixed = meta_ + index * meta_size;
+    manifest_meta meta;
+    meta.size = load_u64(fixed);
+    meta.mtime_ns = static_cast<int64_t>(load_u64(fixed + 8));
+    meta.mode = load_u32(fixed + 16);
+    return meta;
+}
+
+hash_digest manifest::hash(size_t index) const {
+    hash_digest digest;
+    std::memcpy(digest.data(), hashes_ + index * hash_digest_size, hash_digest_size);
+    return digest;
+}
+
+std::string manifest::path(size_t index) const {
+    return cursor(*this, index).path();
+}
+
+manifest_entry manifest::entry(size_t index) const {
+    manifest_entry entry;
+    entry.path = path(index);
+    entry.meta = meta(index);
+    entry.hash = hash(index);
+    return entry;
+}
+
+size_t manifest::restart_floor(const std::string& path) const {
+    // 最后一个完整路径不大于 path 的重启点；都大于 path 时返回 restart_count_
+    size_t low = 0;
+    size_t high = restart_count_;
+    size_t found = restart_count_;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        uint64_t offset = load_u64(restarts_ + mid * sizeof(uint64_t));
+        if (offset >= paths_size_) {
+            throw std::runtime_error("malformed manifest: restart point exceeds path table");
+        }
+        const path_record record = read_record(paths_, paths_size_, offset);
+        if (record.shared != 0) {
+            throw std::runtime_error("malformed manifest: restart point is prefix-compressed");
+        }
+        if (compare_bytes(record.suffix, static_cast<size_t>(record.suffix_size), path) <= 0) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return found;
+}
+
+size_t manifest::lower_bound(const std::string& path) const {
+    const size_t restart = restart_floor(path);
+    if (restart == restart_count_) {
+        return 0;
+    }
+    const size_t end = std::min(count_, (restart + 1) * static_cast<size_t>(restart_interval_));
+    for (cursor it(*this, restart * restart_interval_); it.index() < end; it.next()) {
+        if (!(it.path() < path)) {
+            return it.index();
+        }
+    }
+    return end;
+}
+
+size_t manifest::find(const std::string& path) const {
+    const size_t restart = restart_floor(path);
+    if (restart == restart_count_) {
+        return npos;
+    }
+    const size_t end = std::min(count_, (restart + 1) * static_cast<size_t>(restart_interval_));
+    for (cursor it(*this, restart * restart_interval_); it.index() < end; it.next()) {
+        if (it.path() == path) {
+            return it.index();
+        }
+        if (path < it.path()) {
+            break;
+        }
+    }
+    return npos;
+}
+
+std::vector<uint8_t> manifest::slice(size_t begin, size_t end, uint32_t restart_interval) const {
+    if (begin > end || end > count_) {
+        throw std::out_of_range("manifest slice out of range");
+    }
+    manifest_builder builder(restart_interval);
+    for (cursor it(*this, begin); it.index() < end; it.next()) {
+        builder.add(it.path(), it.meta(), it.hash());
+    }
+    return builder.finish();
+}
+
+manifest::cursor::cursor(const manifest& m, size_t index) : m_(&m), index_(std::min(index, m.count_)) {
+    if (!valid()) {
+        return;
+    }
+    // 从所在区间的重启点开始解码，重启点保存完整路径
+    const size_t restart = index_ / m.restart_interval_;
+    offset_ = load_u64(m.restarts_ + restart * sizeof(uint64_t));
+    if (offset_ >= m.paths_size_) {
+        throw std::runtime_error("malformed manifest: restart point exceeds path table");
+    }
+    const size_t target = index_;
+    index_ = restart * m.restart_interval_;
+    decode();
+    while (index_ < target) {
+        next();
+    }
+}
+
+void manifest::cursor::next() {
+    ++index_;
+    if (valid()) {
+        decode();
+    }
+}
+
+void manifest::cursor::decode() {
+    const path_record record = read_record(m_->paths_, m_->paths_size_, offset_);
+    const bool restart = index_ % m_->restart_interval_ == 0;
+    if (record.shared > path_.size() || (restart && record.shared != 0)) {
+        throw std::runtime_error("malformed manifest: bad shared prefix length");
+    }
+    path_.resize(static_cast<size_t>(record.shared));
+    path_.append(reinterpret_cast<const char*>(record.suffix), static_cast<size_t>(record.suffix_size));
+}
+
+manifest_diff::manifest_diff(const manifest& local, callback on_change)
+    : on_change_(std::move(on_change)), cursor_(local) {}
+
+void manifest_diff::add(const manifest& remote) {
+    if (finished_) {
+        throw std::logic_error("manifest_diff::add after finish");
+    }
+    manifest::cursor it(remote);
+    // 先检查与前一段的衔接，不合法的段不产生任何差异
+    if (it.valid() && has_remote_ && !(last_remote_ < it.path())) {
+        throw std::invalid_argument("manifest segment overlaps previous segment: " + it.path());
+    }
+
+    manifest_change change;
+    for (; it.valid(); it.next()) {
+        const std::string& path = it.path();
+        if (has_remote_ && !(last_remote_ < path)) {
+            throw std::invalid_argument("manifest segment is not ascending: " + path);
+        }
+        while (cursor_.valid() && cursor_.path() < path) {
+            emit_local();
+        }
+
+        change.path = path;
+        change.remote_meta = it.meta();
+        change.remote_hash = it.hash();
+        if (cursor_.valid() && cursor_.path() == path) {
+            change.local_meta = cursor_.meta();
+            change.local_hash = cursor_.hash();
+            cursor_.next();
+            if (change.local_meta.size != change.remote_meta.size || change.local_hash != change.remote_hash) {
+                change.type = manifest_change::kind::modified;
+            } else if (change.local_meta != change.remote_meta) {
+                change.type = manifest_change::kind::metadata;
+            } else {
+                last_remote_ = path;
+                has_remote_ = true;
+                continue;
+            }
+        } else {
+            change.type = manifest_change::kind::added;
+            change.local_meta = manifest_meta();
+            change.local_hash = hash_digest{};
+        }
+        last_remote_ = path;
+        has_remote_ = true;
+        on_change_(change);
+    }
+}
+
+void manifest_diff::finish() {
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+    while (cursor_.valid()) {
+        emit_local();
+    }
+}
+
+void manifest_diff::emit_local() {
+    manifest_change change;
+    change.type = manifest_change::kind::removed;
+    change.path = cursor_.path();
+    change.local_meta = cursor_.meta();
+    change.local_hash = cursor_.hash();
+    cursor_.next();
+    on_change_(change);
+}
+
+void diff_manifests(const manifest& local, const manifest& remote, const manifest_diff::callback& on_change) {
+    manifest_diff diff(local, on_change);
+    diff.add(remote);
+    diff.finish();
+}
@@ -0,0 +1,574 @@
+#include "common/write_back.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "common/io_uring.h"
+#include "metrics/trace.h"
+
+namespace {
+
+std::system_error errno_error(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+std::string parent_of(const std::string& path) {
+    const size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+}
+
+// 预分配只是优化，文件系统不支持时忽略
+void preallocate(int fd, uint64_t size) {
+#if defined(__linux__)
+    (void)::fallocate(fd, 0, 0, static_cast<off_t>(size));
+#elif defined(__APPLE__)
+    fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, static_cast<off_t>(size), 0};
+    if (::fcntl(fd, F_PREALLOCATE, &store) == -1) {
+        store.fst_flags = F_ALLOCATEALL;
+        (void)::fcntl(fd, F_PREALLOCATE, &store);
+    }
+#else
+    (void)fd;
+    (void)size;
+#endif
+}
+
+// 打开 path 并 fsync（目录也可以）
+void fsync_path(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw errno_error("open " + path);
+    }
+    const int rc = ::fsync(fd);
+    const int err = errno;
+    ::close(fd);
+    if (rc != 0) {
+        throw std::system_error(err, std::generic_category(), "fsync " + path);
+    }
+}
+
+#if defined(__linux__)
+// 对 path 所在的文件系统做一次 syncfs
+void syncfs_path(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw errno_error("open " + path);
+    }
+    const int rc = ::syncfs(fd);
+    const int err = errno;
+    ::close(fd);
+    if (rc != 0) {
+        throw std::system_error(err, std::generic_category(), "syncfs " + path);
+    }
+}
+#endif
+
+// 一段偏移连续的缓冲区，对应 iov 中 [first, first + count)
+struct write_run {
+    uint64_t offset;
+    size_t first;
+    size_t count;
+    uint64_t bytes;
+};
+
+// 跳过开头已经写出的 skip 字节，把剩下的部分用 pwritev 写完；返回调用次数
+uint64_t pwritev_all(int fd, struct iovec* iov, size_t count, uint64_t offset, uint64_t skip,
+                     const std::string& path) {
+    uint64_t calls = 0;
+    size_t first = 0;
+    offset += skip;
+    for (;;) {
+        // 跳过已经完整写出的缓冲区，部分写出的调整起点
+        while (first < count && skip >= iov[first].iov_len) {
+            skip -= iov[first].iov_len;
+            ++first;
+        }
+        if (first == count) {
+            return calls;
+        }
+        iov[first].iov_base = static_cast<uint8_t*>(iov[first].iov_base) + skip;
+        iov[first].iov_len -= static_cast<size_t>(skip);
+        const ssize_t n = ::pwritev(fd, iov + first, static_cast<int>(count - first), static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                skip = 0;
+                continue;
+            }
+            throw errno_error("write " + path);
+        }
+        ++calls;
+        offset += static_cast<uint64_t>(n);
+        skip = static_cast<uint64_t>(n);
+    }
+}
+
+#if defined(SYNC_HAVE_IO_URING)
+bool writev_supported() {
+    static const bool available = [] {
+        const uint8_t opcodes[] = {IORING_OP_WRITEV};
+        return io_uring_queue::supported(opcodes, 1);
+    }();
+    return available;
+}
+#endif
+
+}  // namespace
+
+write_back_file::write_back_file(write_back_stage& stage, const std::string& path, uint64_t size, uint32_t mode,
+                                 uint64_t trace_key)
+    : stage_(stage),
+      path_(path),
+      temp_path_(path + stage.options_.temp_suffix),
+      size_(size),
+      trace_key_(trace_key != 0 || !trace_enabled() ? trace_key : trace_file_key(path)) {
+    fd_ = ::open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, static_cast<mode_t>(mode));
+    if (fd_ < 0) {
+        throw errno_error("open " + temp_path_);
+    }
+    if (size_ >= stage_.options_.preallocate_min_size && size_ > 0) {
+        preallocate(fd_, size_);
+    }
+}
+
+write_back_file::~write_back_file() {
+    abort();
+}
+
+void write_back_file::write(uint64_t offset, const uint8_t* data, size_t size) {
+    SYNC_TRACE_SPAN("write", "chunk", trace_chunk_id(trace_key_, offset));
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_) {
+        throw std::logic_error("write_back_file is already committed");
+    }
+    if (offset > size_ || size > size_ - offset) {
+        throw std::out_of_range("write past the end of " + path_);
+    }
+    if (size == 0) {
+        return;
+    }
+    // 首尾相接的小分块直接接在上一个缓冲区后面，减少 iovec 数量
+    if (!pending_.empty()) {
+        pending_chunk& last = pending_.back();
+        if (last.offset + last.data.size() == offset && last.data.size() + size <= stage_.options_.coalesce_bytes) {
+            last.data.insert(last.data.end(), data, data + size);
+            pending_bytes_ += size;
+            cover_locked(offset, size);
+            if (pending_bytes_ >= stage_.options_.write_batch_bytes) {
+                flush_locked();
+            }
+            return;
+        }
+    }
+    pending_chunk chunk;
+    chunk.offset = offset;
+    if (size < stage_.options_.coalesce_bytes) {
+        chunk.data.reserve(stage_.options_.coalesce_bytes);
+    }
+    chunk.data.assign(data, data + size);
+    pending_.push_back(std::move(chunk));
+    pending_bytes_ += size;
+    cover_locked(offset, size);
+    if (pending_bytes_ >= stage_.options_.write_batch_bytes || pending_.size() >= stage_.options_.max_iov) {
+        flush_locked();
+    }
+}
+
+void write_back_file::cover_locked(uint64_t offset, uint64_t size) {
+    uint64_t begin = offset;
+    uint64_t end = offset + size;
+    // 与新范围相交或相接的已有范围合并进来，它们的字节先从 written_ 里减掉
+    auto it = covered_.upper_bound(begin);
+    if (it != covered_.begin() && std::prev(it)->second >= begin) {
+        --it;
+    }
+    while (it != covered_.end() && it->first <= end) {
+        begin = std::min(begin, it->first);
+        end = std::max(end, it->second);
+        written_ -= it->second - it->first;
+        it = covered_.erase(it);
+    }
+    covered_.emplace(begin, end);
+    written_ += end - begin;
+}
+
+void write_back_file::flush_locked() {
+    if (pending_.empty()) {
+        return;
+    }
+    std::sort(pending_.begin(), pending_.end(),
+              [](const pending_chunk& a, const pending_chunk& b) { return a.offset < b.offset; });
+
+    // 偏移连续的一段缓冲区合成一次写入，先把所有段的 iovec 排好
+    const size_t max_iov = std::min<size_t>(stage_.options_.max_iov, IOV_MAX);
+    std::vector<struct iovec> iov;
+    iov.reserve(pending_.size());
+    std::vector<write_run> runs;
+    for (size_t i = 0; i < pending_.size();) {
+        write_run run{pending_[i].offset, iov.size(), 0, 0};
+        while (i < pending_.size() && run.count < max_iov && pending_[i].offset == run.offset + run.bytes) {
+            iov.push_back(iovec{pending_[i].data.data(), pending_[i].data.size()});
+            run.bytes += pending_[i].data.size();
+            ++run.count;
+            ++i;
+        }
+        runs.push_back(run);
+    }
+
+    // 每段已经写出的字节数；io_uring 没有写完的段（短写或被打断）由下面的 pwritev 补齐
+    std::vector<uint64_t> written(runs.size(), 0);
+#if defined(SYNC_HAVE_IO_URING)
+    io_uring_queue* ring = runs.size() > 1 && stage_.use_io_uring_ ? thread_io_uring(64) : nullptr;
+    if (ring != nullptr) {
+        // 所有完成项都取回之后才能抛出错误，内核在此之前还会读 iov 和缓冲区
+        int error = 0;
+        size_t next = 0;
+        size_t inflight = 0;
+        while (next < runs.size() || inflight > 0) {
+            bool queued = false;
+            while (next < runs.size() && ring->sq_space() > 0) {
+                io_uring_sqe* sqe = ring->get_sqe();
+                sqe->opcode = IORING_OP_WRITEV;
+                sqe->fd = fd_;
+                sqe->addr = reinterpret_cast<uint64_t>(iov.data() + runs[next].first);
+                sqe->len = static_cast<uint32_t>(runs[next].count);
+                sqe->off = runs[next].offset;
+                sqe->user_data = next;
+                ++next;
+                ++inflight;
+                queued = true;
+            }
+            ring->submit(1);
+            if (queued) {
+                stage_.submissions_.fetch_add(1, std::memory_order_relaxed);
+            }
+            inflight -= ring->for_each_cqe([&](const io_uring_cqe& cqe) {
+                const size_t index = static_cast<size_t>(cqe.user_data);
+                if (cqe.res >= 0) {
+                    written[index] = static_cast<uint64_t>(cqe.res);
+                    stage_.writes_.fetch_add(1, std::memory_order_relaxed);
+                } else if (cqe.res != -EINTR && cqe.res != -EAGAIN && error == 0) {
+                    error = -cqe.res;
+                }
+            });
+        }
+        if (error != 0) {
+            throw std::system_error(error, std::generic_category(), "write " + temp_path_);
+        }
+    }
+#endif
+
+    for (size_t k = 0; k < runs.size(); ++k) {
+        const write_run& run = runs[k];
+        if (written[k] < run.bytes) {
+            stage_.writes_.fetch_add(
+                pwritev_all(fd_, iov.data() + run.first, run.count, run.offset, written[k], temp_path_),
+                std::memory_order_relaxed);
+        }
+        stage_.bytes_.fetch_add(run.bytes, std::memory_order_relaxed);
+    }
+    pending_.clear();
+    pending_bytes_ = 0;
+}
+
+void write_back_file::discard_locked() {
+    pending_.clear();
+    pending_bytes_ = 0;
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    ::unlink(temp_path_.c_str());
+}
+
+std::future<void> write_back_file::commit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_) {
+        throw std::logic_error("write_back_file is already committed");
+    }
+    finished_ = true;
+
+    std::promise<void> done;
+    std::future<void> result = done.get_future();
+    try {
+        flush_locked();
+        // 重复写入只计一次，所以覆盖的字节数等于大小就说明 [0, size_) 没有空洞
+        if (written_ != size_) {
+            throw std::runtime_error("short write: " + std::to_string(written_) + " of " + std::to_string(size_) +
+                                     " bytes covered for " + path_);
+        }
+        // 描述符先交给 finish_inline，由它关闭且只关闭一次：close 失败时描述符也已释放，
+        // 这个编号随时可能被其他线程打开的文件占用
+        const int fd = fd_;
+        fd_ = -1;
+        stage_.finish_inline(*this, fd);
+        if (stage_.options_.durability == durability_level::batch) {
+            write_back_stage::queued_commit commit;
+            commit.temp_path = temp_path_;
+            commit.path = path_;
+            commit.done = std::move(done);
+            stage_.enqueue(std::move(commit));
+            return result;
+        }
+    } catch (...) {
+        discard_locked();
+        stage_.failures_.fetch_add(1, std::memory_order_relaxed);
+        done.set_exception(std::current_exception());
+        return result;
+    }
+
+    // 已经 rename 到目标路径：之后的目录 fsync 失败只是没有达到持久化级别，
+    // 文件不能删除，也不算放弃
+    stage_.files_.fetch_add(1, std::memory_order_relaxed);
+    if (stage_.options_.durability == durability_level::file) {
+        try {
+            fsync_path(parent_of(path_));
+            stage_.syncs_.fetch_add(1, std::memory_order_relaxed);
+        } catch (...) {
+            done.set_exception(std::current_exception());
+            return result;
+        }
+    }
+    done.set_value();
+    return result;
+}
+
+void write_back_file::abort() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+    discard_locked();
+    stage_.failures_.fetch_add(1, std::memory_order_relaxed);
+}
+
+write_back_stage::write_back_stage(thread_pool& pool, const write_back_options& options)
+    : pool_(pool), options_(options) {
+    if (options_.max_iov == 0 || options_.sync_batch_files == 0) {
+        throw std::invalid_argument("write_back max_iov and sync_batch_files must be positive");
+    }
+#if defined(SYNC_HAVE_IO_URING)
+    use_io_uring_ = options_.use_io_uring && writev_supported();
+#endif
+}
+
+write_back_stage::~write_back_stage() {
+    flush();
+}
+
+std::unique_ptr<write_back_file> write_back_stage::open(const std::string& path, uint64_t size, uint32_t mode,
+                                                        uint64_t trace_key) {
+    return std::unique_ptr<write_back_file>(new write_back_file(*this, path, size, mode, trace_key));
+}
+
+void write_back_stage::finish_inline(write_back_file& file, int fd) {
+    // none 和 file 级别在这里 rename，目录的 fsync 由调用方在 rename 之后完成；
+    // batch 级别只关闭描述符，其余交给屏障任务。fd 在任何情况下都在这里关闭
+    if (options_.durability == durability_level::file) {
+        if (::fsync(fd) != 0) {
+            const int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(), "fsync " + file.temp_path_);
+        }
+        syncs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (::close(fd) != 0) {
+        throw errno_error("close " + file.temp_path_);
+    }
+    if (options_.durability == durability_level::batch) {
+        return;
+    }
+    if (::rename(file.temp_path_.c_str(), file.path_.c_str()) != 0) {
+        throw errno_error("rename " + file.path_);
+    }
+}
+
+void write_back_stage::enqueue(queued_commit commit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.push_back(std::move(commit));
+        if (syncing_) {
+            return;  // 正在进行的屏障结束后会接着处理
+        }
+        syncing_ = true;
+    }
+    try {
+        pool_.submit_to(options_.lane, [this] { sync_loop(); });
+    } catch (...) {
+        // 线程池正在关闭：在当前线程完成
+        sync_loop();
+    }
+}
+
+void write_back_stage::sync_loop() {
+    for (;;) {
+        std::vector<queued_commit> group;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queued_.empty()) {
+                // 通知在锁内完成，之后等待者才可能销毁本对象
+                syncing_ = false;
+                idle_.notify_all();
+                return;
+            }
+            const size_t n = std::min(queued_.size(), options_.sync_batch_files);
+            group.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                group.push_back(std::move(queued_[i]));
+            }
+            queued_.erase(queued_.begin(), queued_.begin() + static_cast<std::ptrdiff_t>(n));
+        }
+        run_group(group);
+    }
+}
+
+void write_back_stage::run_group(std::vector<queued_commit>& group) {
+    std::vector<std::exception_ptr> errors(group.size());
+    std::vector<bool> renamed(group.size(), false);
+    barriers_.fetch_add(1, std::memory_order_relaxed);
+
+    // 屏障作用于一组路径：syncfs 时每个文件系统一次，否则每个路径一次
+    auto barrier = [&](const std::vector<std::string>& paths, const std::vector<size_t>& owners) {
+#if defined(__linux__)
+        if (options_.use_syncfs) {
+            std::map<dev_t, std::vector<size_t>> devices;
+            std::map<dev_t, std::string> representative;
+            for (size_t k = 0; k < paths.size(); ++k) {
+                struct stat st;
+                if (::stat(paths[k].c_str(), &st) != 0) {
+                    errors[owners[k]] = std::make_exception_ptr(errno_error("stat " + paths[k]));
+                    continue;
+                }
+                devices[st.st_dev].push_back(owners[k]);
+                representative.emplace(st.st_dev, paths[k]);
+            }
+            for (const auto& item : devices) {
+                try {
+                    syncfs_path(representative[item.first]);
+                    syncs_.fetch_add(1, std::memory_order_relaxed);
+                } catch (...) {
+                    for (size_t owner : item.second) {
+                        errors[owner] = std::current_exception();
+                    }
+                }
+            }
+            return;
+        }
+#endif
+        for (size_t k = 0; k < paths.size(); ++k) {
+            try {
+                fsync_path(paths[k]);
+                syncs_.fetch_add(1, std::memory_order_relaxed);
+            } catch (...) {
+                errors[owners[k]] = std::current_exception();
+            }
+        }
+    };
+
+    // 1. 临时文件的数据落盘
+    std::vector<std::string> paths;
+    std::vector<size_t> owners;
+    for (size_t i = 0; i < group.size(); ++i) {
+        paths.push_back(group[i].temp_path);
+        owners.push_back(i);
+    }
+    barrier(paths, owners);
+
+    // 2. rename；数据没有落盘的文件不 rename，保留旧内容
+    for (size_t i = 0; i < group.size(); ++i) {
+        if (errors[i]) {
+            ::unlink(group[i].temp_path.c_str());
+        } else if (::rename(group[i].temp_path.c_str(), group[i].path.c_str()) != 0) {
+            errors[i] = std::make_exception_ptr(errno_error("rename " + group[i].path));
+            ::unlink(group[i].temp_path.c_str());
+        } else {
+            renamed[i] = true;
+        }
+    }
+
+    // 3. 目录项落盘，每个目录（或文件系统）一次
+    paths.clear();
+    owners.clear();
+    std::map<std::string, std::vector<size_t>> directories;
+    for (size_t i = 0; i < group.size(); ++i) {
+        if (!errors[i]) {
+            directories[parent_of(group[i].path)].push_back(i);
+        }
+    }
+    std::vector<std::string> dir_paths;
+    std::vector<size_t> dir_owners;
+    for (const auto& item : directories) {
+        dir_paths.push_back(item.first);
+        dir_owners.push_back(item.second.front());
+    }
+    std::vector<std::exception_ptr> before = errors;
+    barrier(dir_paths, dir_owners);
+    // 屏障的错误记在每个目录的第一个文件上，同一目录的其他文件一并失败
+    for (size_t k = 0; k < dir_owners.size(); ++k) {
+        const size_t owner = dir_owners[k];
+        if (errors[owner] && !before[owner]) {
+            for (size_t i : directories[dir_paths[k]]) {
+                errors[i] = errors[owner];
+            }
+        }
+    }
+
+    // 目录屏障失败的文件已经在目标路径上，与 file 级别一样只报告错误，不算放弃
+    for (size_t i = 0; i < group.size(); ++i) {
+        if (renamed[i]) {
+            files_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            failures_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (errors[i]) {
+            group[i].done.set_exception(errors[i]);
+        } else {
+            group[i].done.set_value();
+        }
+    }
+}
+
+void write_back_stage::flush() {
+    for (;;) {
+        const uint32_t key = idle_.prepare_wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!syncing_ && queued_.empty()) {
+                idle_.cancel_wait();
+                return;
+            }
+        }
+        if (pool_.in_worker()) {
+            // 工作线程不能阻塞：屏障任务可能正排在它自己的队列里
+            idle_.cancel_wait();
+            if (!pool_.run_pending_task()) {
+                std::this_thread::yield();
+            }
+            continue;
+        }
+        idle_.wait(key);
+    }
+}
+
+write_back_stats write_back_stage::stats() const {
+    write_back_stats s;
+    s.files = files_.load(std::memory_order_relaxed);
+    s.bytes = bytes_.load(std::memory_order_relaxed);
+    s.writes = writes_.load(std::memory_order_relaxed);
+    s.submissions = submissions_.load(std::memory_order_relaxed);
+    s.syncs = syncs_.load(std::memory_order_relaxed);
+    s.barriers = barriers_.load(std::memory_order_relaxed);
+    s.failures = failures_.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,313 @@
+#include "connection/connection.h"
+
+#include <cerrno>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "io_loop.h"
+
+namespace {
+
+// 一个交付任务最多连续回调的帧数，之后重新提交，让其他连接的任务有机会执行
+constexpr size_t max_delivery_batch = 64;
+
+void set_nonblocking(int fd) {
+    const int flags = ::fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        throw std::system_error(errno, std::generic_category(), "fcntl O_NONBLOCK");
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#if defined(SO_NOSIGPIPE)
+    // macOS 没有 MSG_NOSIGNAL，在套接字上关闭 SIGPIPE
+    const int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+void set_nodelay(int fd) {
+    // 帧已经在用户态合并成一次写出，不需要 Nagle 再等待；不是 TCP 套接字时忽略失败
+    const int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+struct addrinfo_deleter {
+    void operator()(addrinfo* info) const { ::freeaddrinfo(info); }
+};
+
+std::unique_ptr<addrinfo, addrinfo_deleter> resolve(const std::string& host, uint16_t port, bool passive) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    const std::string service = std::to_string(port);
+    const int rc = ::getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, &result);
+    if (rc != 0) {
+        throw std::system_error(EHOSTUNREACH, std::generic_category(), "getaddrinfo " + host + ": " + gai_strerror(rc));
+    }
+    return std::unique_ptr<addrinfo, addrinfo_deleter>(result);
+}
+
+}  // namespace
+
+// 函数 try 块：reader_ 构造失败时析构函数不会运行，在这里关闭接管的描述符
+shared_file::shared_file(int fd) try : fd_(fd), reader_(fd) {
+} catch (...) {
+    ::close(fd);
+}
+
+shared_file::~shared_file() {
+    ::close(fd_);
+}
+
+std::shared_ptr<const shared_file> shared_file::open(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    return std::make_shared<const shared_file>(fd);
+}
+
+connection::connection(uint64_t id, int fd, std::shared_ptr<io_loop> loop,
+                       std::shared_ptr<const connection_handler> handler, thread_pool& pool,
+                       std::shared_ptr<buffer_pool> buffers, const reactor_options& options)
+    : id_(id),
+      fd_(fd),
+      loop_(std::move(loop)),
+      handler_(std::move(handler)),
+      pool_(pool),
+      buffers_(std::move(buffers)),
+      quota_(options.pool_buffers_per_connection),
+      send_queue_(options.send_queue_frames),
+      recv_queue_(options.recv_queue_frames),
+      max_frame_size_(options.max_frame_size),
+      read_buffer_size_(options.read_buffer_size) {
+#if defined(SYNC_METRICS)
+    // 导出时读取计数，速率由 Prometheus 的 rate() 计算；id 只在 reactor 内唯一，
+    // 加上描述符区分不同 reactor 中同时存在的连接
+    const metric_labels labels = {{"connection", std::to_string(id_)}, {"fd", std::to_string(fd_)}};
+    metrics_ = metrics_registry::global().add_collector([this, labels](metric_writer& writer) {
+        writer.counter("sync_connection_sent_bytes_total", "Bytes written to the socket", labels,
+                       static_cast<double>(bytes_sent()));
+        writer.counter("sync_connection_received_bytes_total", "Bytes read from the socket", labels,
+                       static_cast<double>(bytes_received()));
+        writer.gauge("sync_connection_send_queue_frames", "Frames waiting in the send queue", labels,
+                     static_cast<double>(send_queue_.size_approx()));
+        writer.gauge("sync_connection_recv_queue_frames", "Received frames waiting for delivery", labels,
+                     static_cast<double>(recv_queue_.size_approx()));
+    });
+#endif
+}
+
+connection::~connection() {}
+
+bool connection::send(frame f) {
+    if (closed()) {
+        return false;
+    }
+    if (!send_queue_.push_wait(std::move(f))) {
+        return false;
+    }
+    request_write();
+    return !finished_.load(std::memory_order_acquire);
+}
+
+bool connection::try_send(frame& f) {
+    if (closed()) {
+        return false;
+    }
+    if (send_queue_.push_n(std::make_move_iterator(&f), std::make_move_iterator(&f + 1)) != 1) {
+        return false;
+    }
+    request_write();
+    return true;
+}
+
+void connection::close() {
+    if (closed_.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    loop_->post(io_loop::command(io_loop::command_kind::close, shared_from_this()));
+}
+
+void connection::request_write() {
+    if (!write_requested_.exchange(true, std::memory_order_seq_cst)) {
+        loop_->post(io_loop::command(io_loop::command_kind::write, shared_from_this()));
+    }
+}
+
+void connection::schedule_delivery() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!delivering_.exchange(true, std::memory_order_seq_cst)) {
+        connection_ptr self = shared_from_this();
+        pool_.submit([self] { self->deliver(); });
+    }
+}
+
+void connection::deliver() {
+    connection_ptr self = shared_from_this();
+    for (;;) {
+        size_t delivered = 0;
+        frame f;
+        while (delivered < max_delivery_batch && recv_queue_.get(f)) {
+            if (handler_->on_frame) {
+                handler_->on_frame(self, std::move(f));
+            }
+            ++delivered;
+        }
+
+        // 接收队列腾出了空间，让 I/O 线程继续读取
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (read_paused_.load(std::memory_order_seq_cst) && recv_queue_.size_approx() < recv_queue_.capacity() &&
+            read_paused_.exchange(false)) {
+            loop_->post(io_loop::command(io_loop::command_kind::resume, self));
+        }
+
+        if (delivered == max_delivery_batch) {
+            // 还可能有帧，重新排队而不是一直占着工作线程
+            pool_.submit([self] { self->deliver(); });
+            return;
+        }
+
+        if (finished_.load(std::memory_order_acquire) && recv_queue_.size_approx() == 0 &&
+            !close_notified_.exchange(true)) {
+            if (handler_->on_close) {
+                handler_->on_close(self, close_error_);
+            }
+        }
+
+        delivering_.store(false, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const bool more = recv_queue_.size_approx() != 0 ||
+                          (finished_.load(std::memory_order_acquire) && !close_notified_.load());
+        if (!more || delivering_.exchange(true, std::memory_order_seq_cst)) {
+            return;
+        }
+    }
+}
+
+reactor::reactor(thread_pool& pool, const reactor_options& options) : pool_(pool), options_(options) {
+    if (options.io_threads == 0) {
+        throw std::invalid_argument("reactor needs at least one I/O thread");
+    }
+    if (!ring_buffer_detail::is_valid_capacity(options.send_queue_frames) ||
+        !ring_buffer_detail::is_valid_capacity(options.recv_queue_frames)) {
+        throw std::invalid_argument("connection queue sizes must be powers of 2");
+    }
+    if (options.file_block_size == 0 || options.file_blocks == 0 || options.read_buffer_size == 0) {
+        throw std::invalid_argument("reactor buffer sizes must be positive");
+    }
+    if (options.pool_buffer_size > 0) {
+        buffer_pool_options pool_options;
+        pool_options.buffer_size = options.pool_buffer_size;
+        pool_options.buffers = options.pool_buffers;
+        buffers_ = std::make_shared<buffer_pool>(pool_options);
+    }
+    for (size_t i = 0; i < options.io_threads; ++i) {
+        loops_.push_back(make_io_loop(options.backend, *this, pool_, options));
+    }
+    for (auto& loop : loops_) {
+        loop->start();
+    }
+}
+
+reactor::~reactor() {
+    stop();
+}
+
+void reactor::stop() {
+    if (stopped_.exchange(true)) {
+        return;
+    }
+    for (auto& loop : loops_) {
+        loop->stop_and_join();
+    }
+}
+
+const char* reactor::backend_name() const {
+    return loops_.front()->name();
+}
+
+std::shared_ptr<io_loop> reactor::next_loop() {
+    return loops_[next_loop_.fetch_add(1, std::memory_order_relaxed) % loops_.size()];
+}
+
+connection_ptr reactor::adopt(int fd, const connection_handler& handler) {
+    if (stopped_.load(std::memory_order_acquire)) {
+        ::close(fd);
+        throw std::runtime_error("reactor is stopped");
+    }
+    try {
+        set_nonblocking(fd);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    set_nodelay(fd);
+    const uint64_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+    std::shared_ptr<io_loop> loop = next_loop();
+    connection_ptr conn(new connection(id, fd, loop, std::make_shared<const connection_handler>(handler), pool_,
+                                       buffers_, options_));
+    if (!loop->post(io_loop::command(io_loop::command_kind::add, conn))) {
+        io_loop::abandon(conn);
+    }
+    return conn;
+}
+
+connection_ptr reactor::connect(const std::string& host, uint16_t port, const connection_handler& handler) {
+    auto addresses = resolve(host, port, false);
+    int last_error = ECONNREFUSED;
+    for (addrinfo* address = addresses.get(); address != nullptr; address = address->ai_next) {
+        const int fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) {
+            last_error = errno;
+            continue;
+        }
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            return adopt(fd, handler);
+        }
+        last_error = errno;
+        ::close(fd);
+    }
+    throw std::system_error(last_error, std::generic_category(), "connect " + host + ":" + std::to_string(port));
+}
+
+uint16_t reactor::listen(const std::string& host, uint16_t port, const connection_handler& handler) {
+    auto addresses = resolve(host, port, true);
+    int last_error = EADDRNOTAVAIL;
+    for (addrinfo* address = addresses.get(); address != nullptr; address = address->ai_next) {
+        const int fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) {
+            last_error = errno;
+            continue;
+        }
+        const int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (::bind(fd, address->ai_addr, address->ai_addrlen) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+            last_error = errno;
+            ::close(fd);
+            continue;
+        }
+        sockaddr_storage bound = {};
+        socklen_t length = sizeof(bound);
+        ::getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &length);
+        const uint16_t bound_port = ntohs(bound.ss_family == AF_INET6
+                                              ? reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port
+                                              : reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+        set_nonblocking(fd);
+        if (!next_loop()->post(io_loop::command(fd, std::make_shared<const connection_handler>(handler)))) {
+            ::close(fd);
+            throw std::runtime_error("reactor is stopped");
+        }
+        return bound_port;
+    }
+    throw std::system_error(last_error, std::generic_category(), "listen " + host + ":" + std::to_string(port));
+}
@@ -0,0 +1,258 @@
+#include "io_loop.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+io_loop::io_loop(reactor& owner, thread_pool& pool) : owner_(owner), pool_(pool), commands_(4096) {}
+
+io_loop::~io_loop() {}
+
+void io_loop::start() {
+    thread_ = std::thread([this] {
+        thread_id_.store(std::this_thread::get_id(), std::memory_order_release);
+        run();
+        thread_id_.store(std::thread::id(), std::memory_order_release);
+    });
+}
+
+bool io_loop::post(command cmd) {
+    if (std::this_thread::get_id() == thread_id_.load(std::memory_order_acquire)) {
+        execute(cmd);
+        return true;
+    }
+    if (stopped_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    commands_.push_wait(std::move(cmd));
+    wake();
+    // 与 join 之后的清理竞争时自己清掉残留命令，命令持有的连接与本对象互相引用
+    if (stopped_.load(std::memory_order_acquire)) {
+        discard_commands();
+    }
+    return true;
+}
+
+void io_loop::abandon(const connection_ptr& conn) {
+    if (conn->finished_.exchange(true)) {
+        return;
+    }
+    ::close(conn->fd_);
+    conn->closed_.store(true, std::memory_order_release);
+    conn->close_error_ = std::make_error_code(std::errc::operation_canceled);
+    conn->send_queue_.close();
+    try {
+        conn->schedule_delivery();
+    } catch (const std::exception&) {
+        // 线程池已经在关闭，不再回调
+    }
+}
+
+void io_loop::stop_and_join() {
+    if (thread_.joinable()) {
+        post(command(command_kind::stop, nullptr));
+        thread_.join();
+    }
+    stopped_.store(true, std::memory_order_release);
+    discard_commands();
+}
+
+void io_loop::discard_commands() {
+    command cmd;
+    while (commands_.get(cmd)) {
+        if (cmd.kind == command_kind::add) {
+            abandon(cmd.conn);
+        } else if (cmd.kind == command_kind::listen) {
+            ::close(cmd.fd);
+        }
+    }
+}
+
+void io_loop::run_commands() {
+    command cmd;
+    while (commands_.get(cmd)) {
+        execute(cmd);
+    }
+}
+
+void io_loop::accept_all(listener& l) {
+    for (;;) {
+        const int fd = ::accept(l.fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            // EAGAIN：已经取完；EMFILE 等资源错误：等下一次可读再试
+            return;
+        }
+        try {
+            owner_.adopt(fd, *l.handler);
+        } catch (const std::exception&) {
+            ::close(fd);
+        }
+    }
+}
+
+size_t io_loop::extract_frames(connection& conn, const uint8_t* data, size_t size, bool& stalled) {
+    size_t consumed = 0;
+    bool produced = false;
+    while (size - consumed >= frame_header_size) {
+        const uint8_t* header = data + consumed;
+        const uint32_t length = load_le32(header);
+        if (length > conn.max_frame_size_) {
+            finish(conn.shared_from_this(), std::make_error_code(std::errc::message_size));
+            stalled = true;
+            return consumed;
+        }
+        if (size - consumed < frame_header_size + length) {
+            break;
+        }
+        frame f;
+        f.type = load_le16(header + 4);
+        f.flags = load_le16(header + 6);
+        if (conn.buffers_ && length > 0 && length <= conn.buffers_->buffer_size()) {
+            f.buffer = conn.buffers_->try_acquire(conn.quota_);
+        }
+        if (f.buffer) {
+            std::memcpy(f.buffer.data(), header + frame_header_size, length);
+            f.buffer_length = length;
+        } else {
+            f.payload.assign(header + frame_header_size, header + frame_header_size + length);
+        }
+        if (!push_frame(conn, f)) {
+            stalled = true;
+            break;
+        }
+        consumed += frame_header_size + length;
+        produced = true;
+    }
+    if (produced) {
+        conn.schedule_delivery();
+    }
+    return consumed;
+}
+
+bool io_loop::drain_input(connection& conn) {
+    bool stalled = false;
+    const size_t consumed =
+        extract_frames(conn, conn.in_.data() + conn.in_begin_, conn.in_end_ - conn.in_begin_, stalled);
+    if (conn.finished_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    conn.in_begin_ += consumed;
+    return !stalled;
+}
+
+void io_loop::append_input(connection& conn, const uint8_t* data, size_t size) {
+    const size_t pending = conn.in_end_ - conn.in_begin_;
+    if (conn.in_begin_ > 0) {
+        std::memmove(conn.in_.data(), conn.in_.data() + conn.in_begin_, pending);
+        conn.in_begin_ = 0;
+        conn.in_end_ = pending;
+    }
+    if (conn.in_.size() < pending + size) {
+        conn.in_.resize(pending + size);
+    }
+    std::memcpy(conn.in_.data() + conn.in_end_, data, size);
+    conn.in_end_ += size;
+}
+
+bool io_loop::push_frame(connection& conn, frame& f) {
+    auto try_push = [&] {
+        return conn.recv_queue_.push_n(std::make_move_iterator(&f), std::make_move_iterator(&f + 1)) == 1;
+    };
+    if (try_push()) {
+        return true;
+    }
+    // 先标记暂停再重试一次：交付任务取空队列后会检查这个标记，两者之一一定能看到对方
+    conn.read_paused_.store(true, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (try_push()) {
+        conn.read_paused_.store(false, std::memory_order_relaxed);
+        return true;
+    }
+    conn.schedule_delivery();
+    return false;
+}
+
+bool io_loop::fill_output(connection& conn, bool materialize_files) {
+    while (conn.out_.size() < max_write_frames) {
+        connection::outgoing_frame out;
+        if (!conn.send_queue_.get(out.f)) {
+            break;
+        }
+        if (materialize_files && out.f.file) {
+            // 帧头还没有发出：文件比声明的短（被截断）时直接以错误结束连接
+            try {
+                out.body = out.f.file->reader().read(out.f.file_offset, out.f.file_length);
+            } catch (const std::system_error& error) {
+                finish(conn.shared_from_this(), error.code());
+                return false;
+            } catch (const std::runtime_error&) {
+                finish(conn.shared_from_this(), std::make_error_code(std::errc::io_error));
+                return false;
+            }
+        }
+        store_le32(out.header, static_cast<uint32_t>(out.f.payload_size()));
+        store_le16(out.header + 4, out.f.type);
+        store_le16(out.header + 6, out.f.flags);
+        conn.out_.push_back(std::move(out));
+    }
+    return true;
+}
+
+void io_loop::consume_output(connection& conn, size_t n) {
+    conn.bytes_sent_.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+    size_t written = conn.out_offset_ + n;
+    while (!conn.out_.empty() && written >= conn.out_.front().size()) {
+        written -= conn.out_.front().size();
+        conn.out_.pop_front();
+    }
+    conn.out_offset_ = written;
+}
+
+void io_loop::finish(connection_ptr conn, const std::error_code& error) {
+    if (conn->finished_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    conn->closed_.store(true, std::memory_order_release);
+    conn->close_error_ = error;
+    conn->finished_.store(true, std::memory_order_seq_cst);
+    conn->send_queue_.close();
+    conn->in_.clear();
+    conn->in_.shrink_to_fit();
+    conn->schedule_delivery();
+    connections_.erase(conn->id_);
+    release(conn);
+}
+
+std::shared_ptr<io_loop> make_io_loop(reactor_backend backend, reactor& owner, thread_pool& pool,
+                                      const reactor_options& options) {
+    switch (backend) {
+    case reactor_backend::readiness:
+        return make_readiness_loop(owner, pool, options);
+    case reactor_backend::io_uring:
+#if defined(SYNC_HAVE_IO_URING)
+        return make_uring_loop(owner, pool, options);
+#else
+        throw std::system_error(std::make_error_code(std::errc::function_not_supported), "io_uring");
+#endif
+    case reactor_backend::automatic:
+        break;
+    }
+#if defined(SYNC_HAVE_IO_URING)
+    if (uring_loop_supported()) {
+        try {
+            return make_uring_loop(owner, pool, options);
+        } catch (const std::system_error&) {
+            // 例如锁定内存的限额不够注册缓冲区，退回就绪通知
+        }
+    }
+#endif
+    return make_readiness_loop(owner, pool, options);
+}
@@ -0,0 +1,159 @@
+#pragma once
+// I/O 线程的事件循环，只在 connection 库内部使用
+
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "common/io_uring.h"
+#include "connection/connection.h"
+#include "wire.h"
+
+/**
+ * 一个 I/O 线程及其事件循环
+ *
+ * 其他线程通过命令队列（ring_buffer）把注册、写出、恢复读取和关闭请求交给它，
+ * 连接的套接字只在这个线程上读写。命令队列、切帧和关闭流程由各个后端共用，
+ * 后端只负责等待事件和发起读写。
+ */
+class io_loop {
+public:
+    enum class command_kind : uint8_t {
+        add,     // 注册新连接
+        write,   // 连接的发送队列中有新帧
+        resume,  // 接收队列腾出了空间，继续读取
+        close,   // 写完后关闭连接
+        listen,  // 注册监听套接字
+        stop,
+    };
+
+    struct command {
+        command() = default;
+        command(command_kind k, connection_ptr c) : kind(k), conn(std::move(c)) {}
+
+        // 注册监听套接字
+        command(int listen_fd, std::shared_ptr<const connection_handler> h)
+            : kind(command_kind::listen), fd(listen_fd), handler(std::move(h)) {}
+
+        command_kind kind = command_kind::stop;
+        connection_ptr conn;
+        int fd = -1;
+        std::shared_ptr<const connection_handler> handler;
+    };
+
+    io_loop(reactor& owner, thread_pool& pool);
+    virtual ~io_loop();
+
+    io_loop(const io_loop&) = delete;
+    io_loop& operator=(const io_loop&) = delete;
+
+    void start();
+
+    /**
+     * 提交命令；在本线程上调用时直接执行，避免命令队列满时自己等自己
+     *
+     * @return 事件循环已经停止时返回 false，命令被丢弃
+     */
+    bool post(command cmd);
+
+    /**
+     * 结束一个没有注册到任何事件循环的连接
+     */
+    static void abandon(const connection_ptr& conn);
+
+    void stop_and_join();
+
+    virtual const char* name() const = 0;
+
+protected:
+    struct listener {
+        int fd;
+        std::shared_ptr<const connection_handler> handler;
+    };
+
+    // 事件循环主体，在 I/O 线程上运行到 stopping_
+    virtual void run() = 0;
+
+    // 让正在等待的 run 返回处理命令，可以在任意线程调用
+    virtual void wake() = 0;
+
+    virtual void execute(command& cmd) = 0;
+
+    // 连接已经结束：后端关闭套接字并释放输出缓冲区（可以推迟到进行中的操作完成之后）
+    virtual void release(const connection_ptr& conn) = 0;
+
+    // 执行队列中的所有命令
+    void run_commands();
+
+    void accept_all(listener& l);
+
+    /**
+     * 从 data 切出完整的帧放入接收队列
+     *
+     * 接收队列满或遇到超长帧时停止并设置 stalled（超长帧会结束连接）
+     *
+     * @return 已经切走的字节数
+     */
+    size_t extract_frames(connection& conn, const uint8_t* data, size_t size, bool& stalled);
+
+    // 切出 in_ 中缓存的帧；返回 false 表示接收队列满或连接已经结束
+    bool drain_input(connection& conn);
+
+    // 把新收到的数据追加到 in_ 末尾
+    void append_input(connection& conn, const uint8_t* data, size_t size);
+
+    /**
+     * 从发送队列取帧补足 out_，最多 max_write_frames 帧
+     *
+     * @param materialize_files 为 true 时通过文件的 file_reader 取得文件帧负载的映射（body）
+     * @return 文件读取失败、连接已经结束时返回 false
+     */
+    bool fill_output(connection& conn, bool materialize_files);
+
+    // 已写出 n 字节：弹出写完的帧并更新 out_offset_
+    static void consume_output(connection& conn, size_t n);
+
+    // 按值持有：调用方传入的可能就是 connections_ 中的元素
+    void finish(connection_ptr conn, const std::error_code& error);
+
+    // 每次写出最多合并的帧数
+    static constexpr size_t max_write_frames = 32;
+
+    reactor& owner_;
+    thread_pool& pool_;
+    std::thread thread_;
+    std::atomic<std::thread::id> thread_id_{std::thread::id()};
+    bool stopping_ = false;
+
+    std::unordered_map<uint64_t, connection_ptr> connections_;
+    std::unordered_map<uint64_t, listener> listeners_;
+    uint64_t next_listener_ = 0;
+
+private:
+    bool push_frame(connection& conn, frame& f);
+    void discard_commands();
+
+    blocking_ring_buffer<ring_buffer<command, dynamic_capacity>> commands_;
+    std::atomic<bool> stopped_{false};
+};
+
+/**
+ * 创建 backend 对应的事件循环；automatic 在 io_uring 不可用时退回 readiness
+ *
+ * 明确要求的后端不可用时抛出 std::system_error
+ */
+std::shared_ptr<io_loop> make_io_loop(reactor_backend backend, reactor& owner, thread_pool& pool,
+                                      const reactor_options& options);
+
+std::shared_ptr<io_loop> make_readiness_loop(reactor& owner, thread_pool& pool, const reactor_options& options);
+
+#if defined(SYNC_HAVE_IO_URING)
+std::shared_ptr<io_loop> make_uring_loop(reactor& owner, thread_pool& pool, const reactor_options& options);
+
+/**
+ * 当前内核能否使用 io_uring 后端：所需的操作都支持，并且没有被禁用
+ */
+bool uring_loop_supported();
+#endif
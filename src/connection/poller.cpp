@@ -0,0 +1,188 @@
+#include "poller.h"
+
+#include <cerrno>
+#include <system_error>
+
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#elif defined(__APPLE__)
+#include <sys/event.h>
+#include <sys/time.h>
+#include <vector>
+#else
+#error "poller requires epoll or kqueue"
+#endif
+
+namespace {
+
+// 唤醒事件使用的保留 token
+constexpr uint64_t wake_token = ~uint64_t(0);
+
+}  // namespace
+
+#if defined(__linux__)
+
+poller::poller() {
+    fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "epoll_create1");
+    }
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        const int error = errno;
+        ::close(fd_);
+        throw std::system_error(error, std::generic_category(), "eventfd");
+    }
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = wake_token;
+    if (::epoll_ctl(fd_, EPOLL_CTL_ADD, wake_fd_, &event) != 0) {
+        const int error = errno;
+        ::close(wake_fd_);
+        ::close(fd_);
+        throw std::system_error(error, std::generic_category(), "epoll_ctl");
+    }
+}
+
+poller::~poller() {
+    ::close(wake_fd_);
+    ::close(fd_);
+}
+
+void poller::add(int fd, uint64_t token) {
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.u64 = token;
+    if (::epoll_ctl(fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+        throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+    }
+}
+
+void poller::remove(int fd) {
+    ::epoll_ctl(fd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+size_t poller::wait(poll_event* events, size_t max, int timeout_ms) {
+    epoll_event raw[128];
+    const int limit = static_cast<int>(max < 128 ? max : 128);
+    const int n = ::epoll_wait(fd_, raw, limit, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        throw std::system_error(errno, std::generic_category(), "epoll_wait");
+    }
+    size_t count = 0;
+    for (int i = 0; i < n; ++i) {
+        if (raw[i].data.u64 == wake_token) {
+            uint64_t value;
+            (void)::read(wake_fd_, &value, sizeof(value));
+            continue;
+        }
+        poll_event& event = events[count++];
+        event.token = raw[i].data.u64;
+        event.readable = (raw[i].events & (EPOLLIN | EPOLLRDHUP)) != 0;
+        event.writable = (raw[i].events & EPOLLOUT) != 0;
+        event.error = (raw[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+    }
+    return count;
+}
+
+void poller::wake() {
+    const uint64_t one = 1;
+    (void)::write(wake_fd_, &one, sizeof(one));
+}
+
+#else
+
+poller::poller() {
+    fd_ = ::kqueue();
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "kqueue");
+    }
+    struct kevent change;
+    EV_SET(&change, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, reinterpret_cast<void*>(wake_token));
+    if (::kevent(fd_, &change, 1, nullptr, 0, nullptr) != 0) {
+        const int error = errno;
+        ::close(fd_);
+        throw std::system_error(error, std::generic_category(), "kevent");
+    }
+}
+
+poller::~poller() {
+    ::close(fd_);
+}
+
+void poller::add(int fd, uint64_t token) {
+    struct kevent changes[2];
+    void* udata = reinterpret_cast<void*>(static_cast<uintptr_t>(token));
+    EV_SET(&changes[0], fd, EVFILT_READ, EV_ADD | EV_CLEAR, 0, 0, udata);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, udata);
+    if (::kevent(fd_, changes, 2, nullptr, 0, nullptr) != 0) {
+        throw std::system_error(errno, std::generic_category(), "kevent");
+    }
+}
+
+void poller::remove(int fd) {
+    // 关闭描述符时 kqueue 会自动移除，这里显式移除以便描述符还要继续使用的情况
+    struct kevent changes[2];
+    EV_SET(&changes[0], fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+    ::kevent(fd_, changes, 2, nullptr, 0, nullptr);
+}
+
+size_t poller::wait(poll_event* events, size_t max, int timeout_ms) {
+    struct kevent raw[128];
+    const int limit = static_cast<int>(max < 128 ? max : 128);
+    timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    const int n = ::kevent(fd_, nullptr, 0, raw, limit, timeout_ms < 0 ? nullptr : &timeout);
+    if (n < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        throw std::system_error(errno, std::generic_category(), "kevent");
+    }
+    // kqueue 对读和写分别报告，合并同一描述符的事件
+    size_t count = 0;
+    for (int i = 0; i < n; ++i) {
+        const uint64_t token = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(raw[i].udata));
+        if (raw[i].filter == EVFILT_USER) {
+            continue;
+        }
+        poll_event* event = nullptr;
+        for (size_t j = 0; j < count; ++j) {
+            if (events[j].token == token) {
+                event = &events[j];
+                break;
+            }
+        }
+        if (event == nullptr) {
+            event = &events[count++];
+            *event = poll_event();
+            event->token = token;
+        }
+        if (raw[i].filter == EVFILT_READ) {
+            event->readable = true;
+        } else if (raw[i].filter == EVFILT_WRITE) {
+            event->writable = true;
+        }
+        if (raw[i].flags & (EV_EOF | EV_ERROR)) {
+            event->error = true;
+            event->readable = true;
+        }
+    }
+    return count;
+}
+
+void poller::wake() {
+    struct kevent change;
+    EV_SET(&change, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    ::kevent(fd_, &change, 1, nullptr, 0, nullptr);
+}
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+// I/O 线程使用的边沿触发就绪通知，只在 connection 库内部使用
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 一条就绪事件
+ */
+struct poll_event {
+    uint64_t token = 0;
+    bool readable = false;
+    bool writable = false;
+    bool error = false;  // 出错或对端挂断；仍应尝试读取以取得错误码或剩余数据
+};
+
+/**
+ * 边沿触发的就绪通知：Linux 为 epoll（EPOLLET），macOS 为 kqueue（EV_CLEAR）
+ *
+ * 套接字注册一次同时关注可读和可写，只有状态由"不可用"变为"可用"时才会再次通知，
+ * 所以调用方每次都必须读写到 EAGAIN。wake 可以在任意线程调用，使正在进行的 wait 返回。
+ * 创建失败时抛出 std::system_error。
+ */
+class poller {
+public:
+    poller();
+    ~poller();
+
+    poller(const poller&) = delete;
+    poller& operator=(const poller&) = delete;
+
+    void add(int fd, uint64_t token);
+    void remove(int fd);
+
+    /**
+     * 等待最多 timeout_ms 毫秒（-1 为一直等待）
+     *
+     * @return 写入 events 的事件数量；只被 wake 唤醒时返回 0
+     */
+    size_t wait(poll_event* events, size_t max, int timeout_ms);
+
+    void wake();
+
+private:
+    int fd_ = -1;
+#if defined(__linux__)
+    int wake_fd_ = -1;
+#endif
+};
@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <csignal>
+#include <pthread.h>
+#include <sys/sendfile.h>
+#elif defined(__APPLE__)
+#include <sys/types.h>
+#endif
+
+#include "io_loop.h"
+#include "poller.h"
+
+namespace {
+
+// 监听套接字的 token 带上最高位，与连接编号区分
+constexpr uint64_t listener_token_bit = uint64_t(1) << 63;
+
+// more 表示后面紧跟着文件负载，让内核把帧头与负载合并成满的报文段
+ssize_t write_vectors(int fd, const iovec* iov, int count, bool more) {
+#if defined(MSG_NOSIGNAL)
+    msghdr message = {};
+    message.msg_iov = const_cast<iovec*>(iov);
+    message.msg_iovlen = static_cast<decltype(message.msg_iovlen)>(count);
+    int flags = MSG_NOSIGNAL;
+#if defined(MSG_MORE)
+    if (more) {
+        flags |= MSG_MORE;
+    }
+#endif
+    const ssize_t n = ::sendmsg(fd, &message, flags);
+    // 不是套接字（例如测试中使用的管道）时退回 writev
+    if (n < 0 && errno == ENOTSOCK) {
+        return ::writev(fd, iov, count);
+    }
+    return n;
+#else
+    (void)more;
+    return ::writev(fd, iov, count);
+#endif
+}
+
+#if defined(__linux__) || defined(__APPLE__)
+constexpr bool have_sendfile = true;
+#else
+constexpr bool have_sendfile = false;
+#endif
+
+}  // namespace
+
+/**
+ * 边沿触发的事件循环：epoll 或 kqueue
+ *
+ * 可读时一直读到 EAGAIN，可写时一直写到 EAGAIN。文件帧的帧头与内存帧一起 writev，
+ * 负载用 sendfile 或 splice 直接从页缓存发出，不经过用户空间；平台不支持时从文件的
+ * 映射窗口 writev。
+ */
+class readiness_loop : public io_loop {
+public:
+    readiness_loop(reactor& owner, thread_pool& pool, const reactor_options& options)
+        : io_loop(owner, pool), mode_(resolve_mode(options.file_mode)) {}
+
+    const char* name() const override {
+#if defined(__linux__)
+        return "epoll";
+#else
+        return "kqueue";
+#endif
+    }
+
+protected:
+    void run() override {
+#if defined(__linux__)
+        // sendfile 和 splice 没有 MSG_NOSIGNAL：在本线程屏蔽 SIGPIPE，对端关闭时只返回 EPIPE
+        sigset_t pipe_signal;
+        sigemptyset(&pipe_signal);
+        sigaddset(&pipe_signal, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipe_signal, nullptr);
+#endif
+        poll_event events[128];
+        while (!stopping_) {
+            run_commands();
+            if (stopping_) {
+                break;
+            }
+            const size_t n = poller_.wait(events, 128, -1);
+            for (size_t i = 0; i < n; ++i) {
+                dispatch(events[i]);
+            }
+        }
+
+        // 关闭所有连接和监听套接字
+        const auto canceled = std::make_error_code(std::errc::operation_canceled);
+        while (!connections_.empty()) {
+            finish(connections_.begin()->second, canceled);
+        }
+        for (auto& entry : listeners_) {
+            poller_.remove(entry.second.fd);
+            ::close(entry.second.fd);
+        }
+        listeners_.clear();
+    }
+
+    void wake() override {
+        poller_.wake();
+    }
+
+    void execute(command& cmd) override {
+        switch (cmd.kind) {
+        case command_kind::add:
+            connections_[cmd.conn->id_] = cmd.conn;
+            try {
+                poller_.add(cmd.conn->fd_, cmd.conn->id_);
+            } catch (const std::system_error& error) {
+                finish(cmd.conn, error.code());
+            }
+            // 注册之前可能已经有帧在发送队列中
+            handle_write(*cmd.conn);
+            break;
+        case command_kind::write:
+            if (connections_.count(cmd.conn->id_) != 0) {
+                handle_write(*cmd.conn);
+            }
+            break;
+        case command_kind::resume:
+            if (connections_.count(cmd.conn->id_) != 0) {
+                handle_read(*cmd.conn);
+            }
+            break;
+        case command_kind::close:
+            if (connections_.count(cmd.conn->id_) != 0) {
+                cmd.conn->closing_ = true;
+                handle_write(*cmd.conn);
+            }
+            break;
+        case command_kind::listen: {
+            const uint64_t token = listener_token_bit | next_listener_++;
+            try {
+                poller_.add(cmd.fd, token);
+            } catch (const std::system_error&) {
+                ::close(cmd.fd);
+                break;
+            }
+            listeners_[token] = listener{cmd.fd, cmd.handler};
+            accept_all(listeners_[token]);
+            break;
+        }
+        case command_kind::stop:
+            stopping_ = true;
+            break;
+        }
+    }
+
+    void release(const connection_ptr& conn) override {
+        poller_.remove(conn->fd_);
+        ::close(conn->fd_);
+        conn->out_.clear();
+        auto it = pipes_.find(conn->id_);
+        if (it != pipes_.end()) {
+            it->second.close();
+            pipes_.erase(it);
+        }
+    }
+
+private:
+    /**
+     * splice 使用的管道，负载先从文件移入管道再移到套接字
+     *
+     * 套接字写满时已经移入管道的数据留在管道中，下次可写时先发出它们。
+     */
+    struct splice_pipe {
+        int read_fd = -1;
+        int write_fd = -1;
+        size_t buffered = 0;  // 管道中尚未发出的字节数
+
+        void close() {
+            if (read_fd >= 0) {
+                ::close(read_fd);
+                ::close(write_fd);
+            }
+        }
+    };
+
+    static file_transfer resolve_mode(file_transfer mode) {
+#if !defined(__linux__)
+        if (mode == file_transfer::splice) {
+            mode = file_transfer::automatic;
+        }
+#endif
+        if (mode == file_transfer::automatic && !have_sendfile) {
+            mode = file_transfer::copy;
+        }
+        return mode;
+    }
+
+    void dispatch(const poll_event& event) {
+        if (event.token & listener_token_bit) {
+            auto it = listeners_.find(event.token);
+            if (it != listeners_.end()) {
+                accept_all(it->second);
+            }
+            return;
+        }
+        auto it = connections_.find(event.token);
+        if (it == connections_.end()) {
+            return;
+        }
+        // 回调中可能结束连接，先持有一份引用
+        connection_ptr conn = it->second;
+        if (event.readable || event.error) {
+            handle_read(*conn);
+        }
+        if (event.writable && !conn->finished_.load(std::memory_order_relaxed)) {
+            handle_write(*conn);
+        }
+    }
+
+    void handle_read(connection& conn) {
+        if (conn.finished_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        for (;;) {
+            if (!drain_input(conn)) {
+                return;
+            }
+
+            // 把未处理的数据移到缓冲区开头，保证能放下一个完整的帧和一次读取
+            const size_t pending = conn.in_end_ - conn.in_begin_;
+            if (conn.in_begin_ > 0) {
+                std::memmove(conn.in_.data(), conn.in_.data() + conn.in_begin_, pending);
+                conn.in_begin_ = 0;
+                conn.in_end_ = pending;
+            }
+            size_t want = conn.read_buffer_size_;
+            if (pending >= frame_header_size) {
+                want = std::max(want, frame_header_size + load_le32(conn.in_.data()));
+            }
+            if (conn.in_.size() < pending + want) {
+                conn.in_.resize(pending + want);
+            }
+
+            const ssize_t n = ::read(conn.fd_, conn.in_.data() + conn.in_end_, conn.in_.size() - conn.in_end_);
+            if (n > 0) {
+                conn.in_end_ += static_cast<size_t>(n);
+                conn.bytes_received_.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+                continue;
+            }
+            if (n == 0) {
+                // 对端关闭；没有切完的半帧说明连接被截断
+                const bool truncated = conn.in_end_ != conn.in_begin_;
+                finish(conn.shared_from_this(),
+                       truncated ? std::make_error_code(std::errc::connection_reset) : std::error_code());
+                return;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                finish(conn.shared_from_this(), std::error_code(errno, std::generic_category()));
+            }
+            return;
+        }
+    }
+
+    void handle_write(connection& conn) {
+        if (conn.finished_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        // 先清除标记再取帧：之后新入队的帧会重新发出 write 命令
+        conn.write_requested_.store(false, std::memory_order_seq_cst);
+        for (;;) {
+            if (!fill_output(conn, mode_ == file_transfer::copy)) {
+                return;
+            }
+            if (conn.out_.empty()) {
+                if (conn.closing_) {
+                    finish(conn.shared_from_this(), std::error_code());
+                }
+                return;
+            }
+
+            ssize_t n;
+            const connection::outgoing_frame& front = conn.out_.front();
+            if (front.f.file && front.body.data() == nullptr && conn.out_offset_ >= frame_header_size) {
+                // 第一帧的帧头已经写出，接着发文件负载
+                n = send_file_body(conn, front);
+                if (n == 0) {
+                    // 文件被截断，帧头中的长度已经不能兑现
+                    finish(conn.shared_from_this(), std::make_error_code(std::errc::io_error));
+                    return;
+                }
+            } else {
+                // 合并到下一个文件帧的帧头为止，文件负载另外发送
+                iovec iov[max_write_frames * 2];
+                int count = 0;
+                bool more = false;
+                size_t skip = conn.out_offset_;
+                for (auto& out : conn.out_) {
+                    const size_t header_skip = std::min(skip, frame_header_size);
+                    iov[count].iov_base = out.header + header_skip;
+                    iov[count].iov_len = frame_header_size - header_skip;
+                    ++count;
+                    skip -= header_skip;
+                    if (out.f.file && out.body.data() == nullptr) {
+                        more = out.f.file_length > 0;
+                        break;
+                    }
+                    // copy 方式下文件负载直接从映射的页写出
+                    const uint8_t* payload = out.f.file ? out.body.data() : out.f.payload_data();
+                    if (out.f.payload_size() > skip) {
+                        iov[count].iov_base = const_cast<uint8_t*>(payload) + skip;
+                        iov[count].iov_len = out.f.payload_size() - skip;
+                        ++count;
+                    }
+                    skip = 0;
+                }
+                n = write_vectors(conn.fd_, iov, count, more);
+            }
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    finish(conn.shared_from_this(), std::error_code(errno, std::generic_category()));
+                }
+                // 套接字写满，等待可写事件
+                return;
+            }
+            consume_output(conn, static_cast<size_t>(n));
+        }
+    }
+
+    /**
+     * 发送第一帧剩余的文件负载
+     *
+     * @return 发出的字节数；0 表示文件已经读到末尾；-1 表示出错，错误在 errno 中
+     */
+    ssize_t send_file_body(connection& conn, const connection::outgoing_frame& out) {
+        const size_t sent = conn.out_offset_ - frame_header_size;
+        const uint64_t offset = out.f.file_offset + sent;
+        const size_t remaining = out.f.file_length - sent;
+#if defined(__linux__)
+        if (mode_ == file_transfer::automatic && pipes_.count(conn.id_) == 0) {
+            off_t position = static_cast<off_t>(offset);
+            const ssize_t n = ::sendfile(conn.fd_, out.f.file->fd(), &position, remaining);
+            // 文件系统或目标不支持 sendfile 时这个连接改用 splice
+            if (n >= 0 || (errno != EINVAL && errno != ENOSYS)) {
+                return n;
+            }
+        }
+        return splice_body(conn, out.f.file->fd(), offset, remaining);
+#elif defined(__APPLE__)
+        off_t length = static_cast<off_t>(remaining);
+        if (::sendfile(out.f.file->fd(), conn.fd_, static_cast<off_t>(offset), &length, nullptr, 0) == 0) {
+            return static_cast<ssize_t>(length);
+        }
+        // 写满或被信号打断时 length 是已经发出的部分
+        if ((errno == EAGAIN || errno == EINTR) && length > 0) {
+            return static_cast<ssize_t>(length);
+        }
+        return -1;
+#else
+        (void)conn;
+        (void)offset;
+        (void)remaining;
+        errno = ENOTSUP;
+        return -1;
+#endif
+    }
+
+#if defined(__linux__)
+    ssize_t splice_body(connection& conn, int file_fd, uint64_t offset, size_t remaining) {
+        splice_pipe& pipe = pipes_[conn.id_];
+        if (pipe.read_fd < 0) {
+            int fds[2];
+            if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+                pipes_.erase(conn.id_);
+                return -1;
+            }
+            pipe.read_fd = fds[0];
+            pipe.write_fd = fds[1];
+        }
+        // 先补满管道（从已经在管道中的数据之后开始），再尽量移到套接字
+        if (pipe.buffered < remaining) {
+            loff_t position = static_cast<loff_t>(offset + pipe.buffered);
+            const ssize_t n = ::splice(file_fd, &position, pipe.write_fd, nullptr, remaining - pipe.buffered,
+                                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                pipe.buffered += static_cast<size_t>(n);
+            } else if (pipe.buffered == 0) {
+                // 文件到末尾（0）或出错；管道满（EAGAIN）时不会走到这里
+                return n;
+            }
+        }
+        const ssize_t n = ::splice(pipe.read_fd, nullptr, conn.fd_, nullptr, pipe.buffered,
+                                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK | (pipe.buffered < remaining ? SPLICE_F_MORE : 0));
+        if (n > 0) {
+            pipe.buffered -= static_cast<size_t>(n);
+        }
+        return n;
+    }
+#endif
+
+    poller poller_;
+    const file_transfer mode_;
+    std::unordered_map<uint64_t, splice_pipe> pipes_;
+};
+
+std::shared_ptr<io_loop> make_readiness_loop(reactor& owner, thread_pool& pool, const reactor_options& options) {
+    return std::make_shared<readiness_loop>(owner, pool, options);
+}
@@ -0,0 +1,547 @@
+#include "connection/striped.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "wire.h"
+
+namespace {
+
+frame control_frame(striped_frame type, size_t size) {
+    frame f;
+    f.type = static_cast<uint16_t>(type);
+    f.payload.resize(size);
+    return f;
+}
+
+std::error_code protocol_error() {
+    return std::error_code(EPROTO, std::generic_category());
+}
+
+void check_options(const striped_options& options) {
+    if (options.streams == 0 || options.streams > 65535 ||
+        !ring_buffer_detail::is_valid_capacity(options.send_queue_frames) || options.run_frames == 0 ||
+        options.reorder_window < options.run_frames) {
+        throw std::invalid_argument(
+            "striped connection needs 1-65535 streams, a power-of-2 send queue and reorder_window >= run_frames");
+    }
+}
+
+// 组标识只用来在接受方把流归组，随机数加计数器避免同一进程内重复
+uint64_t new_group_id() {
+    static std::atomic<uint64_t> counter{0};
+    static const uint64_t seed = [] {
+        std::random_device rd;
+        return (uint64_t(rd()) << 32) ^ rd();
+    }();
+    return seed ^ (counter.fetch_add(1, std::memory_order_relaxed) * 0x9e3779b97f4a7c15ull);
+}
+
+}  // namespace
+
+/**
+ * 组中的一条流
+ */
+struct striped_connection::stream {
+    connection_ptr conn;                 // 在 streams_mutex_ 下设置一次，之后不变
+    bool finished = false;               // 收到了 on_close，在 streams_mutex_ 下访问
+    std::atomic<uint64_t> assigned{0};   // 交给 conn->send 的字节数，减去 bytes_sent 是未写出的积压
+    std::atomic<uint64_t> frames_sent{0};
+
+    // 接收方的当前段，只在这条流的 on_frame 中访问
+    uint64_t run_seq = 0;
+    uint32_t run_left = 0;
+};
+
+striped_connection::striped_connection(uint64_t group, uint32_t streams, std::shared_ptr<const striped_handler> handler,
+                                       const striped_options& options)
+    : group_(group), options_(options), handler_(std::move(handler)), send_queue_(options.send_queue_frames) {
+    for (uint32_t i = 0; i < streams; ++i) {
+        streams_.push_back(std::make_shared<stream>());
+    }
+}
+
+striped_connection::~striped_connection() {
+    close_streams();
+}
+
+connection_handler striped_connection::stream_handler(const std::weak_ptr<striped_connection>& self, uint32_t index) {
+    connection_handler h;
+    h.on_frame = [self, index](const connection_ptr&, frame&& f) {
+        if (striped_ptr group = self.lock()) {
+            group->on_stream_frame(index, std::move(f));
+        }
+    };
+    h.on_close = [self, index](const connection_ptr&, const std::error_code& error) {
+        if (striped_ptr group = self.lock()) {
+            group->on_stream_close(index, error);
+        }
+    };
+    return h;
+}
+
+striped_ptr striped_connection::connect(reactor& r, const std::string& host, uint16_t port,
+                                        const striped_handler& handler, const striped_options& options) {
+    check_options(options);
+    const uint64_t group = new_group_id();
+    striped_ptr result(
+        new striped_connection(group, options.streams, std::make_shared<const striped_handler>(handler), options));
+    try {
+        for (uint32_t i = 0; i < options.streams; ++i) {
+            result->attach(i, r.connect(host, port, stream_handler(result, i)));
+            frame hello = control_frame(striped_frame::hello, 12);
+            store_le64(hello.payload.data(), group);
+            store_le16(hello.payload.data() + 8, static_cast<uint16_t>(i));
+            store_le16(hello.payload.data() + 10, static_cast<uint16_t>(options.streams));
+            result->transmit(*result->streams_[i], std::move(hello));
+        }
+    } catch (...) {
+        result->close_streams();
+        throw;
+    }
+    return result;
+}
+
+bool striped_connection::attach(uint32_t index, const connection_ptr& conn) {
+    std::lock_guard<std::mutex> lock(streams_mutex_);
+    stream& s = *streams_[index];
+    if (s.conn || streams_closed_.load(std::memory_order_acquire)) {
+        // 重复的流或者组已经关闭
+        conn->close();
+        return false;
+    }
+    s.conn = conn;
+    return true;
+}
+
+bool striped_connection::send(frame f) {
+    if (f.type >= striped_reserved_type) {
+        throw std::invalid_argument("frame types from 0xff00 are reserved for striped connections");
+    }
+    if (closed()) {
+        return false;
+    }
+    if (!send_queue_.push_wait(std::move(f))) {
+        return false;
+    }
+    pump();
+    return !streams_closed_.load(std::memory_order_acquire);
+}
+
+void striped_connection::close() {
+    closed_.store(true, std::memory_order_release);
+    closing_.store(true, std::memory_order_seq_cst);
+    pump();
+}
+
+bool striped_connection::transmit(stream& s, frame f) {
+    s.assigned.fetch_add(frame_header_size + f.payload_size(), std::memory_order_relaxed);
+    return s.conn->send(std::move(f));
+}
+
+std::shared_ptr<striped_connection::stream> striped_connection::pick_stream() const {
+    // 积压最少的流写得最快（或者最空闲），下一段交给它
+    // 积压相同（例如都已写完）时从轮转的位置开始找，空闲的流轮流分到
+    std::lock_guard<std::mutex> lock(streams_mutex_);
+    std::shared_ptr<stream> best;
+    uint64_t best_backlog = 0;
+    const size_t start = next_pick_++;
+    for (size_t i = 0; i < streams_.size(); ++i) {
+        const std::shared_ptr<stream>& s = streams_[(start + i) % streams_.size()];
+        if (!s->conn || s->finished || s->conn->closed()) {
+            continue;
+        }
+        const uint64_t assigned = s->assigned.load(std::memory_order_relaxed);
+        const uint64_t sent = s->conn->bytes_sent();
+        const uint64_t backlog = assigned > sent ? assigned - sent : 0;
+        if (!best || backlog < best_backlog) {
+            best = s;
+            best_backlog = backlog;
+        }
+    }
+    return best;
+}
+
+void striped_connection::pump() {
+    for (;;) {
+        if (pumping_.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        drain();
+        pumping_.store(false, std::memory_order_seq_cst);
+
+        // 与 send 和 ack 的交错：放下 pumping_ 之后重新检查，避免新帧或新窗口无人处理
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (streams_closed_.load(std::memory_order_acquire)) {
+            return;
+        }
+        const bool queued = send_queue_.size_approx() != 0;
+        const bool window_open =
+            next_seq_.load(std::memory_order_relaxed) - acked_.load(std::memory_order_acquire) < options_.reorder_window;
+        const bool shutdown = closing_.load(std::memory_order_seq_cst) && !queued;
+        if (!(queued && window_open) && !shutdown) {
+            return;
+        }
+    }
+}
+
+void striped_connection::drain() {
+    std::vector<frame> run;
+    run.reserve(options_.run_frames);
+    for (;;) {
+        if (streams_closed_.load(std::memory_order_acquire)) {
+            // 组已经关闭：丢弃还在共享队列中的帧，唤醒等待空位的 send
+            frame dropped;
+            while (send_queue_.get(dropped)) {
+            }
+            return;
+        }
+        const uint64_t seq = next_seq_.load(std::memory_order_relaxed);
+        const uint64_t in_flight = seq - acked_.load(std::memory_order_acquire);
+        if (in_flight >= options_.reorder_window) {
+            if (send_queue_.size_approx() != 0) {
+                window_stalls_.fetch_add(1, std::memory_order_relaxed);
+            }
+            return;
+        }
+        run.clear();
+        const size_t room = std::min<uint64_t>(options_.run_frames, options_.reorder_window - in_flight);
+        if (send_queue_.get_n(std::back_inserter(run), room) == 0) {
+            break;
+        }
+
+        std::shared_ptr<stream> target = pick_stream();
+        if (!target) {
+            fail(std::error_code(ENOTCONN, std::generic_category()));
+            continue;
+        }
+        // 先占用序号：对端可能在 transmit 返回之前就交付并确认了这一段
+        next_seq_.store(seq + run.size(), std::memory_order_relaxed);
+        target->frames_sent.fetch_add(run.size(), std::memory_order_relaxed);
+        frame marker = control_frame(striped_frame::run, 12);
+        store_le64(marker.payload.data(), seq);
+        store_le32(marker.payload.data() + 8, static_cast<uint32_t>(run.size()));
+        bool ok = transmit(*target, std::move(marker));
+        for (size_t i = 0; ok && i < run.size(); ++i) {
+            ok = transmit(*target, std::move(run[i]));
+        }
+        if (!ok) {
+            // 流在发送途中关闭，这一段的帧对端收不全，整组无法继续保持顺序
+            fail(std::error_code(ECONNRESET, std::generic_category()));
+            continue;
+        }
+    }
+
+    if (closing_.load(std::memory_order_seq_cst) && send_queue_.size_approx() == 0) {
+        close_streams();
+    }
+}
+
+void striped_connection::on_stream_frame(uint32_t index, frame&& f) {
+    stream& s = *streams_[index];
+    const uint8_t* data = f.payload_data();
+    const size_t size = f.payload_size();
+    switch (static_cast<striped_frame>(f.type)) {
+    case striped_frame::run:
+        if (f.file || size < 12 || s.run_left != 0) {
+            fail(protocol_error());
+            return;
+        }
+        s.run_seq = load_le64(data);
+        s.run_left = load_le32(data + 8);
+        return;
+    case striped_frame::ack: {
+        if (f.file || size < 8) {
+            fail(protocol_error());
+            return;
+        }
+        // 确认可能从不同的流乱序到达，只前进不后退
+        const uint64_t delivered = load_le64(data);
+        uint64_t current = acked_.load(std::memory_order_relaxed);
+        while (delivered > current && !acked_.compare_exchange_weak(current, delivered, std::memory_order_acq_rel)) {
+        }
+        if (delivered > next_seq_.load(std::memory_order_relaxed)) {
+            fail(protocol_error());
+            return;
+        }
+        pump();
+        return;
+    }
+    default:
+        break;
+    }
+    if (f.type >= striped_reserved_type || s.run_left == 0) {
+        fail(protocol_error());
+        return;
+    }
+    const uint64_t seq = s.run_seq++;
+    --s.run_left;
+    accept(seq, std::move(f), s.run_left == 0);
+}
+
+void striped_connection::accept(uint64_t seq, frame&& f, bool run_end) {
+    std::unique_lock<std::mutex> lock(recv_mutex_);
+    if (seq < next_deliver_ || !reorder_.emplace(seq, pending_frame{std::move(f), run_end}).second) {
+        lock.unlock();
+        fail(protocol_error());
+        return;
+    }
+    reorder_peak_ = std::max(reorder_peak_, reorder_.size());
+    if (delivering_) {
+        // 正在交付的线程会接着取走这一帧
+        return;
+    }
+    delivering_ = true;
+
+    striped_ptr self = shared_from_this();
+    std::vector<frame> batch;
+    for (;;) {
+        batch.clear();
+        bool ack = false;
+        for (auto it = reorder_.begin(); it != reorder_.end() && it->first == next_deliver_; it = reorder_.erase(it)) {
+            batch.push_back(std::move(it->second.f));
+            ack = ack || it->second.run_end;
+            ++next_deliver_;
+        }
+        if (batch.empty()) {
+            delivering_ = false;
+            return;
+        }
+        const uint64_t delivered = next_deliver_;
+
+        // on_frame 在锁外调用，其他流可以继续把帧放进重排缓冲区
+        lock.unlock();
+        for (auto& item : batch) {
+            delivered_.fetch_add(1, std::memory_order_relaxed);
+            if (handler_->on_frame) {
+                handler_->on_frame(self, std::move(item));
+            }
+        }
+        if (ack) {
+            send_ack(delivered);
+        }
+        lock.lock();
+    }
+}
+
+void striped_connection::send_ack(uint64_t delivered) {
+    std::shared_ptr<stream> target = pick_stream();
+    if (!target) {
+        return;
+    }
+    frame ack = control_frame(striped_frame::ack, 8);
+    store_le64(ack.payload.data(), delivered);
+    transmit(*target, std::move(ack));
+}
+
+void striped_connection::fail(const std::error_code& error) {
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        if (!close_error_) {
+            close_error_ = error;
+        }
+    }
+    closed_.store(true, std::memory_order_release);
+    close_streams();
+}
+
+void striped_connection::close_streams() {
+    if (streams_closed_.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    send_queue_.close();
+    std::lock_guard<std::mutex> lock(streams_mutex_);
+    for (const auto& s : streams_) {
+        if (s->conn) {
+            s->conn->close();
+        }
+    }
+}
+
+void striped_connection::on_stream_close(uint32_t index, const std::error_code& error) {
+    bool done = false;
+    std::error_code result;
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        stream& s = *streams_[index];
+        if (s.finished) {
+            return;
+        }
+        s.finished = true;
+        ++finished_streams_;
+        if (error && !close_error_) {
+            close_error_ = error;
+        }
+        const uint32_t attached = static_cast<uint32_t>(
+            std::count_if(streams_.begin(), streams_.end(), [](const std::shared_ptr<stream>& p) { return !!p->conn; }));
+        done = finished_streams_ == attached;
+        result = close_error_;
+    }
+    closed_.store(true, std::memory_order_release);
+    if (error) {
+        // 一条流出错后后续的序号可能永远收不到，关闭整组
+        close_streams();
+    }
+    if (!done) {
+        // 对端正常关闭时其余的流上还可能有数据在路上，等它们各自结束
+        return;
+    }
+
+    close_streams();
+    if (close_notified_.exchange(true)) {
+        return;
+    }
+    {
+        // 所有流的帧都已交付，缺了前面序号的帧不会再到达
+        std::lock_guard<std::mutex> lock(recv_mutex_);
+        if (!result && !reorder_.empty()) {
+            result = std::error_code(ECONNRESET, std::generic_category());
+        }
+        reorder_.clear();
+    }
+    if (handler_->on_close) {
+        handler_->on_close(shared_from_this(), result);
+    }
+}
+
+striped_stats striped_connection::stats() const {
+    striped_stats stats;
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        for (const auto& s : streams_) {
+            striped_stream_stats entry;
+            if (s->conn) {
+                entry.frames_sent = s->frames_sent.load(std::memory_order_relaxed);
+                entry.bytes_sent = s->conn->bytes_sent();
+                entry.bytes_received = s->conn->bytes_received();
+                const uint64_t assigned = s->assigned.load(std::memory_order_relaxed);
+                entry.send_backlog = assigned > entry.bytes_sent ? assigned - entry.bytes_sent : 0;
+                entry.open = !s->finished && !s->conn->closed();
+            }
+            stats.streams.push_back(entry);
+        }
+    }
+    stats.frames_sent = next_seq_.load(std::memory_order_relaxed);
+    stats.frames_delivered = delivered_.load(std::memory_order_relaxed);
+    const uint64_t acked = acked_.load(std::memory_order_relaxed);
+    stats.in_flight = stats.frames_sent > acked ? stats.frames_sent - acked : 0;
+    stats.window_stalls = window_stalls_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(recv_mutex_);
+    stats.reorder_peak = reorder_peak_;
+    return stats;
+}
+
+/**
+ * 接受方的状态，由所有连接的回调共享
+ */
+struct striped_listener::state {
+    struct member {
+        striped_ptr group;
+        uint32_t index;
+    };
+
+    std::shared_ptr<const striped_handler> handler;
+    striped_options options;
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::weak_ptr<striped_connection>> groups;  // 组标识 -> 组
+    std::unordered_map<uint64_t, member> members;                           // 连接编号 -> 所在的组
+
+    void on_frame(const connection_ptr& conn, frame&& f);
+    void on_close(const connection_ptr& conn, const std::error_code& error);
+};
+
+void striped_listener::state::on_frame(const connection_ptr& conn, frame&& f) {
+    striped_ptr group;
+    uint32_t index = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = members.find(conn->id());
+        if (it != members.end()) {
+            group = it->second.group;
+            index = it->second.index;
+        }
+    }
+    if (group) {
+        group->on_stream_frame(index, std::move(f));
+        return;
+    }
+
+    // 还没有归组的连接，第一帧必须是 hello
+    if (static_cast<striped_frame>(f.type) != striped_frame::hello || f.file || f.payload_size() < 12) {
+        conn->close();
+        return;
+    }
+    const uint8_t* data = f.payload_data();
+    const uint64_t id = load_le64(data);
+    index = load_le16(data + 8);
+    const uint32_t streams = load_le16(data + 10);
+    if (streams == 0 || index >= streams) {
+        conn->close();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = groups.find(id);
+        if (found != groups.end()) {
+            group = found->second.lock();
+        }
+        if (!group || group->streams() != streams) {
+            if (group) {
+                conn->close();
+                return;
+            }
+            group = striped_ptr(new striped_connection(id, streams, handler, options));
+            groups[id] = group;
+        }
+        members[conn->id()] = member{group, index};
+    }
+    if (!group->attach(index, conn)) {
+        // 没有加入组的连接关闭时不能算作组中的流
+        std::lock_guard<std::mutex> lock(mutex);
+        members.erase(conn->id());
+    }
+}
+
+void striped_listener::state::on_close(const connection_ptr& conn, const std::error_code& error) {
+    striped_ptr group;
+    uint32_t index = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = members.find(conn->id());
+        if (it == members.end()) {
+            return;
+        }
+        group = std::move(it->second.group);
+        index = it->second.index;
+        members.erase(it);
+    }
+    group->on_stream_close(index, error);
+    if (group->close_notified_.load()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = groups.find(group->group_);
+        if (found != groups.end() && found->second.lock() == group) {
+            groups.erase(found);
+        }
+    }
+}
+
+striped_listener::striped_listener(const striped_handler& handler, const striped_options& options)
+    : state_(std::make_shared<state>()) {
+    check_options(options);
+    state_->handler = std::make_shared<const striped_handler>(handler);
+    state_->options = options;
+}
+
+connection_handler striped_listener::handler() const {
+    std::shared_ptr<state> s = state_;
+    connection_handler h;
+    h.on_frame = [s](const connection_ptr& conn, frame&& f) { s->on_frame(conn, std::move(f)); };
+    h.on_close = [s](const connection_ptr& conn, const std::error_code& error) { s->on_close(conn, error); };
+    return h;
+}
@@ -0,0 +1,480 @@
+#include "connection/transfer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "metrics/trace.h"
+#include "wire.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+frame make_message(transfer_frame type, uint16_t flags, size_t size) {
+    frame f;
+    f.type = static_cast<uint16_t>(type);
+    f.flags = flags;
+    f.payload.resize(size);
+    return f;
+}
+
+frame stream_message(transfer_frame type, uint32_t stream, const std::string& text) {
+    frame f = make_message(type, 0, 4 + text.size());
+    store_le32(f.payload.data(), stream);
+    std::copy(text.begin(), text.end(), f.payload.begin() + 4);
+    return f;
+}
+
+}  // namespace
+
+uint32_t bdp_window(double bandwidth, std::chrono::microseconds rtt, uint32_t chunk_size, uint32_t max_window) {
+    const double chunks = std::ceil(bandwidth * (static_cast<double>(rtt.count()) / 1e6) / chunk_size);
+    if (!(chunks >= 1)) {
+        return 1;
+    }
+    return chunks >= max_window ? max_window : static_cast<uint32_t>(chunks);
+}
+
+/**
+ * 数据方的状态，由所有连接的回调共享
+ */
+struct transfer_server::state {
+    struct open_stream {
+        std::shared_ptr<const shared_file> file;
+        uint64_t trace_key = 0;  // 文件名的跟踪键，发送区间的编号与拉取方按同一个名字算出
+    };
+
+    open_file open;
+
+    // 每个连接上打开的流
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::unordered_map<uint32_t, open_stream>> files;
+
+    void on_frame(const connection_ptr& conn, frame&& f);
+};
+
+void transfer_server::state::on_frame(const connection_ptr& conn, frame&& f) {
+    const uint8_t* data = f.payload_data();
+    const size_t size = f.payload_size();
+    if (size < 4) {
+        conn->close();
+        return;
+    }
+    const uint32_t stream = load_le32(data);
+
+    switch (static_cast<transfer_frame>(f.type)) {
+    case transfer_frame::open: {
+        const std::string name(reinterpret_cast<const char*>(data) + 4, size - 4);
+        std::shared_ptr<const shared_file> file;
+        try {
+            file = open(name);
+        } catch (const std::exception& error) {
+            conn->send(stream_message(transfer_frame::error, stream, error.what()));
+            return;
+        }
+        if (!file) {
+            conn->send(stream_message(transfer_frame::error, stream, "cannot open " + name));
+            return;
+        }
+        const uint64_t file_size = file->reader().size();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            open_stream& opened = files[conn->id()][stream];
+            opened.file = std::move(file);
+            opened.trace_key = trace_enabled() ? trace_file_key(name) : 0;
+        }
+        frame reply = make_message(transfer_frame::opened, 0, 12);
+        store_le32(reply.payload.data(), stream);
+        store_le64(reply.payload.data() + 4, file_size);
+        conn->send(std::move(reply));
+        return;
+    }
+    case transfer_frame::request: {
+        if (size < 16) {
+            conn->close();
+            return;
+        }
+        const uint64_t offset = load_le64(data + 4);
+        const uint32_t length = load_le32(data + 12);
+        std::shared_ptr<const shared_file> file;
+        uint64_t trace_key = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = files.find(conn->id());
+            if (it != files.end()) {
+                auto found = it->second.find(stream);
+                if (found != it->second.end()) {
+                    file = found->second.file;
+                    trace_key = found->second.trace_key;
+                }
+            }
+        }
+        if (!file || offset > file->reader().size() || length > file->reader().size() - offset) {
+            conn->send(stream_message(transfer_frame::error, stream, "bad chunk request"));
+            return;
+        }
+        // 分块数据直接从文件发出，槽位原样带回；区间只覆盖放进发送队列，实际的发送在事件循环中
+        SYNC_TRACE_SPAN("send", "chunk", trace_chunk_id(trace_key, offset));
+        frame reply = make_message(transfer_frame::data, f.flags, 0);
+        reply.file = std::move(file);
+        reply.file_offset = offset;
+        reply.file_length = length;
+        conn->send(std::move(reply));
+        return;
+    }
+    case transfer_frame::close: {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = files.find(conn->id());
+        if (it != files.end()) {
+            it->second.erase(stream);
+        }
+        return;
+    }
+    default:
+        conn->close();
+        return;
+    }
+}
+
+transfer_server::transfer_server(open_file open) : state_(std::make_shared<state>()) {
+    state_->open = std::move(open);
+}
+
+connection_handler transfer_server::handler() const {
+    std::shared_ptr<state> s = state_;
+    connection_handler h;
+    h.on_frame = [s](const connection_ptr& conn, frame&& f) { s->on_frame(conn, std::move(f)); };
+    h.on_close = [s](const connection_ptr& conn, const std::error_code&) {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        s->files.erase(conn->id());
+    };
+    return h;
+}
+
+/**
+ * 拉取方的状态，由连接的回调和 transfer_client 共享
+ *
+ * 除 sink 调用外都在 mutex 下进行；请求也在锁内发出，保证同一个流的请求按偏移顺序进入发送队列。
+ */
+struct transfer_client::state {
+    struct stream {
+        chunk_sink sink;
+        std::promise<uint64_t> done;
+        uint64_t trace_key = 0;    // 文件名的跟踪键，接收区间的编号
+        uint64_t size = 0;
+        uint64_t next_offset = 0;  // 下一个要请求的偏移
+        uint64_t received = 0;
+        bool failed = false;       // 已经以异常结束，之后到达的分块丢弃
+    };
+
+    // 在途请求所在的窗口槽位
+    struct slot {
+        uint32_t stream = 0;
+        uint64_t offset = 0;
+        uint32_t length = 0;
+        clock_type::time_point sent;
+        bool busy = false;
+    };
+
+    explicit state(const transfer_options& o);
+
+    void pump(connection& conn);
+    void on_frame(const connection_ptr& conn, frame&& f);
+    void on_data(const connection_ptr& conn, uint16_t slot_index, const frame& f);
+    void on_close(const std::error_code& error);
+    void sample(const slot& s, clock_type::time_point now);
+    void fail(uint32_t id, std::exception_ptr error);
+    void release(uint32_t id);
+    void finish(connection& conn, uint32_t id);
+
+    const transfer_options options;
+    mutable std::mutex mutex;
+    std::unordered_map<uint32_t, std::unique_ptr<stream>> streams;
+    uint32_t next_stream = 1;
+    std::deque<uint32_t> ready;  // 还有分块要请求的流，轮流发出请求
+    std::vector<slot> slots;
+    std::vector<uint16_t> free_slots;
+    bool closed = false;
+
+    uint32_t window;
+    uint32_t outstanding = 0;
+    uint64_t requests = 0;
+    uint64_t bytes_received = 0;
+    uint64_t credit_stalls = 0;
+    clock_type::duration min_rtt = clock_type::duration::max();
+    double delivery_rate = 0;
+    clock_type::time_point interval_start;
+    uint64_t interval_bytes = 0;
+};
+
+transfer_client::state::state(const transfer_options& o) : options(o), slots(o.max_window) {
+    if (options.chunk_size == 0 || options.max_window == 0 || options.max_window > 65536 || options.min_window == 0 ||
+        options.min_window > options.max_window) {
+        throw std::invalid_argument("transfer window and chunk size must be positive, at most 65536 slots");
+    }
+    for (uint32_t i = options.max_window; i > 0; --i) {
+        free_slots.push_back(static_cast<uint16_t>(i - 1));
+    }
+    if (options.link_bandwidth > 0 && options.link_rtt.count() > 0) {
+        window = bdp_window(options.link_bandwidth, options.link_rtt, options.chunk_size, options.max_window);
+    } else {
+        window = std::min(std::max<uint32_t>(options.initial_window, 1), options.max_window);
+    }
+}
+
+void transfer_client::state::pump(connection& conn) {
+    // 信用：在途的响应都会占用接收队列的槽位，只有剩余的空位可以再发请求
+    const size_t free_recv = conn.recv_free_slots();
+    size_t credit = free_recv > outstanding ? free_recv - outstanding : 0;
+    while (!ready.empty() && outstanding < window) {
+        if (credit == 0) {
+            ++credit_stalls;
+            return;
+        }
+        const uint32_t id = ready.front();
+        ready.pop_front();
+        auto it = streams.find(id);
+        if (it == streams.end() || it->second->failed) {
+            continue;
+        }
+        stream& s = *it->second;
+        const uint32_t length = static_cast<uint32_t>(std::min<uint64_t>(options.chunk_size, s.size - s.next_offset));
+        const uint16_t index = free_slots.back();
+        free_slots.pop_back();
+        slots[index] = slot{id, s.next_offset, length, clock_type::now(), true};
+
+        frame request = make_message(transfer_frame::request, index, 16);
+        store_le32(request.payload.data(), id);
+        store_le64(request.payload.data() + 4, s.next_offset);
+        store_le32(request.payload.data() + 12, length);
+        if (!conn.send(std::move(request))) {
+            // 连接已经关闭，on_close 会结束所有流
+            slots[index].busy = false;
+            free_slots.push_back(index);
+            return;
+        }
+        s.next_offset += length;
+        ++outstanding;
+        ++requests;
+        --credit;
+        if (s.next_offset < s.size) {
+            ready.push_back(id);
+        }
+    }
+}
+
+void transfer_client::state::sample(const slot& s, clock_type::time_point now) {
+    min_rtt = std::min(min_rtt, now - s.sent);
+    if (interval_bytes == 0) {
+        interval_start = s.sent;
+    }
+    interval_bytes += s.length;
+
+    // 每隔几个往返时间更新一次交付速率，窗口取两倍带宽时延积
+    const clock_type::duration elapsed = now - interval_start;
+    if (elapsed < std::max<clock_type::duration>(min_rtt * 4, std::chrono::milliseconds(20))) {
+        return;
+    }
+    delivery_rate = static_cast<double>(interval_bytes) / std::chrono::duration<double>(elapsed).count();
+    interval_bytes = 0;
+    if (options.adaptive_window) {
+        const auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(min_rtt);
+        window = std::max(options.min_window,
+                          bdp_window(2 * delivery_rate, rtt, options.chunk_size, options.max_window));
+    }
+}
+
+void transfer_client::state::fail(uint32_t id, std::exception_ptr error) {
+    auto it = streams.find(id);
+    if (it == streams.end() || it->second->failed) {
+        return;
+    }
+    it->second->failed = true;
+    it->second->done.set_exception(error);
+}
+
+void transfer_client::state::release(uint32_t id) {
+    // 还有在途请求的流要等它们的分块到达后才能删除，槽位中记录的是流编号
+    const bool pending = std::any_of(slots.begin(), slots.end(), [id](const slot& s) { return s.busy && s.stream == id; });
+    if (!pending) {
+        streams.erase(id);
+    }
+}
+
+void transfer_client::state::finish(connection& conn, uint32_t id) {
+    release(id);
+    conn.send(stream_message(transfer_frame::close, id, std::string()));
+}
+
+void transfer_client::state::on_frame(const connection_ptr& conn, frame&& f) {
+    const uint8_t* data = f.payload_data();
+    const size_t size = f.payload_size();
+    if (static_cast<transfer_frame>(f.type) == transfer_frame::data) {
+        on_data(conn, f.flags, f);
+        return;
+    }
+    if (size < 4) {
+        conn->close();
+        return;
+    }
+    const uint32_t id = load_le32(data);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    switch (static_cast<transfer_frame>(f.type)) {
+    case transfer_frame::opened: {
+        auto it = streams.find(id);
+        if (size < 12 || it == streams.end()) {
+            conn->close();
+            return;
+        }
+        stream& s = *it->second;
+        s.size = load_le64(data + 4);
+        if (s.size == 0) {
+            s.done.set_value(0);
+            finish(*conn, id);
+            return;
+        }
+        ready.push_back(id);
+        pump(*conn);
+        return;
+    }
+    case transfer_frame::error: {
+        const std::string message(reinterpret_cast<const char*>(data) + 4, size - 4);
+        fail(id, std::make_exception_ptr(std::runtime_error(message)));
+        // 数据方已经丢弃了这个流，不需要再发 close
+        release(id);
+        return;
+    }
+    default:
+        conn->close();
+        return;
+    }
+}
+
+void transfer_client::state::on_data(const connection_ptr& conn, uint16_t index, const frame& f) {
+    stream* target = nullptr;
+    slot request;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index >= slots.size() || !slots[index].busy || slots[index].length != f.payload_size()) {
+            conn->close();
+            return;
+        }
+        request = slots[index];
+        slots[index].busy = false;
+        free_slots.push_back(index);
+        --outstanding;
+        bytes_received += request.length;
+        sample(request, clock_type::now());
+
+        auto it = streams.find(request.stream);
+        if (it != streams.end() && !it->second->failed) {
+            target = it->second.get();
+        } else if (it != streams.end()) {
+            release(request.stream);
+        }
+    }
+
+    // sink 可能很慢（写盘），在锁外调用；同一连接的回调不会并发，流不会在此期间被删除
+    if (target != nullptr) {
+        bool ok = true;
+        try {
+            SYNC_TRACE_SPAN("receive", "chunk", trace_chunk_id(target->trace_key, request.offset));
+            target->sink(request.offset, f.payload_data(), f.payload_size());
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            fail(request.stream, std::current_exception());
+            finish(*conn, request.stream);
+            ok = false;
+        }
+        if (ok) {
+            std::lock_guard<std::mutex> lock(mutex);
+            target->received += request.length;
+            if (target->received == target->size) {
+                target->done.set_value(target->size);
+                finish(*conn, request.stream);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pump(*conn);
+}
+
+void transfer_client::state::on_close(const std::error_code& error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    for (auto& entry : streams) {
+        if (!entry.second->failed) {
+            entry.second->failed = true;
+            entry.second->done.set_exception(
+                error ? std::make_exception_ptr(std::system_error(error, "transfer connection closed"))
+                      : std::make_exception_ptr(std::runtime_error("transfer connection closed")));
+        }
+    }
+    streams.clear();
+    ready.clear();
+}
+
+connection_handler transfer_client::make_handler(const std::shared_ptr<state>& s) {
+    connection_handler h;
+    h.on_frame = [s](const connection_ptr& conn, frame&& f) { s->on_frame(conn, std::move(f)); };
+    h.on_close = [s](const connection_ptr&, const std::error_code& error) { s->on_close(error); };
+    return h;
+}
+
+transfer_client::transfer_client(reactor& r, const std::string& host, uint16_t port, const transfer_options& options)
+    : state_(std::make_shared<state>(options)) {
+    conn_ = r.connect(host, port, make_handler(state_));
+}
+
+transfer_client::transfer_client(reactor& r, int fd, const transfer_options& options)
+    : state_(std::make_shared<state>(options)) {
+    conn_ = r.adopt(fd, make_handler(state_));
+}
+
+transfer_client::~transfer_client() {
+    // 未完成的拉取在 on_close 中以异常结束
+    conn_->close();
+}
+
+std::future<uint64_t> transfer_client::fetch(const std::string& name, chunk_sink sink) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    std::unique_ptr<state::stream> s(new state::stream);
+    s->sink = std::move(sink);
+    s->trace_key = trace_enabled() ? trace_file_key(name) : 0;
+    std::future<uint64_t> result = s->done.get_future();
+    if (state_->closed) {
+        s->done.set_exception(std::make_exception_ptr(std::runtime_error("transfer connection closed")));
+        return result;
+    }
+    const uint32_t id = state_->next_stream++;
+    if (!conn_->send(stream_message(transfer_frame::open, id, name))) {
+        s->done.set_exception(std::make_exception_ptr(std::runtime_error("transfer connection closed")));
+        return result;
+    }
+    state_->streams[id] = std::move(s);
+    return result;
+}
+
+transfer_stats transfer_client::stats() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    transfer_stats stats;
+    stats.window = state_->window;
+    stats.outstanding = state_->outstanding;
+    stats.requests = state_->requests;
+    stats.bytes_received = state_->bytes_received;
+    stats.credit_stalls = state_->credit_stalls;
+    if (state_->min_rtt != clock_type::duration::max()) {
+        stats.min_rtt = std::chrono::duration_cast<std::chrono::microseconds>(state_->min_rtt);
+    }
+    stats.delivery_rate = state_->delivery_rate;
+    return stats;
+}
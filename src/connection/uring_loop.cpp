@@ -0,0 +1,707 @@
+#include "io_loop.h"
+
+#if defined(SYNC_HAVE_IO_URING)
+
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// user_data 的低 8 位是操作种类，其余是连接编号或监听套接字编号
+enum op_kind : uint8_t {
+    op_wake = 1,    // 命令队列的 eventfd
+    op_recv,        // 多次触发的接收（不是套接字时为带缓冲区选择的单次 READ）
+    op_send,        // 内存帧的 SENDMSG/WRITEV
+    op_file_read,   // 文件块读入注册缓冲区，链接到下面的发送
+    op_file_send,   // 从注册缓冲区发送文件块
+    op_accept,      // 监听套接字可读
+    op_cancel,      // 取消请求本身，结果忽略
+    op_provide,     // 归还接收缓冲区（PROVIDE_BUFFERS），结果忽略
+};
+
+uint64_t pack(uint64_t id, op_kind op) {
+    return id << 8 | op;
+}
+
+constexpr unsigned queue_entries = 256;
+
+// 每个 I/O 线程与内核共享的接收缓冲区数量
+constexpr uint32_t recv_buffers = 64;
+constexpr uint16_t recv_group = 0;
+
+constexpr uint32_t no_block = ~uint32_t(0);
+
+constexpr uint8_t required_ops[] = {
+    IORING_OP_READ,      IORING_OP_RECV,        IORING_OP_SENDMSG,       IORING_OP_SEND,
+    IORING_OP_WRITEV,    IORING_OP_WRITE,       IORING_OP_READ_FIXED,    IORING_OP_WRITE_FIXED,
+    IORING_OP_POLL_ADD,  IORING_OP_ASYNC_CANCEL, IORING_OP_PROVIDE_BUFFERS,
+};
+
+// 析构时释放的 ring_buffer_detail 内存区域
+struct owned_region {
+    ring_buffer_detail::memory_region region;
+
+    owned_region() = default;
+    owned_region(const owned_region&) = delete;
+    owned_region& operator=(const owned_region&) = delete;
+
+    ~owned_region() {
+        ring_buffer_detail::deallocate(region);
+    }
+
+    uint8_t* data() const {
+        return static_cast<uint8_t*>(region.base);
+    }
+};
+
+uint32_t round_up_pow2(uint32_t value) {
+    uint32_t result = 2;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+}  // namespace
+
+/**
+ * io_uring 事件循环
+ *
+ * 每个连接挂一个多次触发的接收，数据落在本线程提供给内核的接收缓冲区中，切帧后立即归还；
+ * 接收队列满时取消接收，恢复时重新挂上。发送时每个连接同时只有一个操作在进行以保证顺序：
+ * 内存帧合并成一次 SENDMSG，文件帧先随前面的帧发出帧头，再逐块用 READ_FIXED 读入注册缓冲区，
+ * 并用 IOSQE_IO_LINK 链接一个从同一缓冲区发出的 SEND，文件数据不经过用户态复制。
+ * 一轮循环中产生的所有提交项由一次 io_uring_enter 提交，同时等待下一批完成项。
+ *
+ * 连接结束后进行中的操作仍引用着套接字和输出缓冲区，所以先取消它们，
+ * 等最后一个完成项到达后才关闭套接字。
+ */
+class uring_loop : public io_loop {
+public:
+    uring_loop(reactor& owner, thread_pool& pool, const reactor_options& options)
+        : io_loop(owner, pool),
+          recv_buffer_size_(static_cast<uint32_t>(std::min<size_t>(options.read_buffer_size, 1u << 20))),
+          block_size_(options.file_block_size),
+          block_count_(options.file_blocks),
+          free_blocks_(round_up_pow2(options.file_blocks)),
+          ring_(queue_entries) {
+        ring_buffer_options memory_options;
+        memory_options.huge_pages = true;
+        recv_memory_.region = ring_buffer_detail::allocate(size_t(recv_buffers) * recv_buffer_size_,
+                                                           ring_buffer_detail::small_page_size, memory_options);
+        recv_buffers_.reset(new io_uring_provided_buffers(ring_, recv_group, recv_buffers, recv_memory_.data(),
+                                                          recv_buffer_size_, pack(0, op_provide)));
+        wake_fd_ = ::eventfd(0, EFD_CLOEXEC);
+        if (wake_fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "eventfd");
+        }
+    }
+
+    ~uring_loop() override {
+        recv_buffers_.reset();
+        if (wake_fd_ >= 0) {
+            ::close(wake_fd_);
+        }
+    }
+
+    const char* name() const override {
+        return "io_uring";
+    }
+
+protected:
+    void run() override {
+        arm_wake();
+        while (!stopping_) {
+            run_commands();
+            reap();
+            if (stopping_) {
+                break;
+            }
+            ring_.submit(1);
+            ring_.for_each_cqe([this](const io_uring_cqe& cqe) { handle(cqe); });
+            reap();
+        }
+
+        // 关闭所有连接和监听套接字，等所有进行中的操作结束
+        const auto canceled = std::make_error_code(std::errc::operation_canceled);
+        while (!connections_.empty()) {
+            finish(connections_.begin()->second, canceled);
+        }
+        for (auto& entry : listeners_) {
+            cancel(pack(entry.first, op_accept));
+        }
+        cancel(pack(0, op_wake));
+        while (inflight_ > 0) {
+            ring_.submit(1);
+            ring_.for_each_cqe([this](const io_uring_cqe& cqe) { handle(cqe); });
+            reap();
+        }
+        reap();
+        for (auto& entry : listeners_) {
+            ::close(entry.second.fd);
+        }
+        listeners_.clear();
+    }
+
+    void wake() override {
+        const uint64_t one = 1;
+        (void)::write(wake_fd_, &one, sizeof(one));
+    }
+
+    void execute(command& cmd) override {
+        switch (cmd.kind) {
+        case command_kind::add: {
+            connection& conn = *cmd.conn;
+            connections_[conn.id_] = cmd.conn;
+            std::unique_ptr<conn_state> st(new conn_state);
+            st->conn = cmd.conn;
+            int type = 0;
+            socklen_t length = sizeof(type);
+            st->socket = ::getsockopt(conn.fd_, SOL_SOCKET, SO_TYPE, &type, &length) == 0;
+            // 阻塞的描述符由 io_uring 在就绪时重试；非阻塞的普通文件描述符会把 EAGAIN 直接返回
+            const int flags = ::fcntl(conn.fd_, F_GETFL, 0);
+            if (flags >= 0) {
+                ::fcntl(conn.fd_, F_SETFL, flags & ~O_NONBLOCK);
+            }
+            conn_state& state = *st;
+            states_[conn.id_] = std::move(st);
+            arm_recv(state);
+            // 注册之前可能已经有帧在发送队列中
+            start_send(state);
+            break;
+        }
+        case command_kind::write:
+            if (connections_.count(cmd.conn->id_) != 0) {
+                start_send(*states_[cmd.conn->id_]);
+            }
+            break;
+        case command_kind::resume:
+            if (connections_.count(cmd.conn->id_) != 0) {
+                conn_state& st = *states_[cmd.conn->id_];
+                st.stalled = !drain_input(*cmd.conn);
+                arm_recv(st);
+            }
+            break;
+        case command_kind::close:
+            if (connections_.count(cmd.conn->id_) != 0) {
+                cmd.conn->closing_ = true;
+                start_send(*states_[cmd.conn->id_]);
+            }
+            break;
+        case command_kind::listen: {
+            const uint64_t token = next_listener_++;
+            listeners_[token] = listener{cmd.fd, cmd.handler};
+            accept_all(listeners_[token]);
+            arm_accept(token);
+            break;
+        }
+        case command_kind::stop:
+            stopping_ = true;
+            break;
+        }
+    }
+
+    void release(const connection_ptr& conn) override {
+        auto it = states_.find(conn->id_);
+        if (it == states_.end()) {
+            ::close(conn->fd_);
+            conn->out_.clear();
+            return;
+        }
+        conn_state& st = *it->second;
+        if (st.inflight == 0) {
+            mark_reap(st);
+            return;
+        }
+        // shutdown 让阻塞在对端窗口上的发送也尽快结束
+        if (st.socket) {
+            ::shutdown(conn->fd_, SHUT_RDWR);
+        }
+        if (st.recv_armed) {
+            cancel(pack(conn->id_, op_recv));
+        }
+        if (st.send_busy) {
+            cancel(pack(conn->id_, op_send));
+            cancel(pack(conn->id_, op_file_send));
+        }
+    }
+
+private:
+    // 连接在本线程上的 io_uring 状态
+    struct conn_state {
+        connection_ptr conn;
+        bool socket = true;
+        bool recv_armed = false;       // 接收操作还会产生完成项
+        bool recv_cancelling = false;
+        bool stalled = false;          // 接收队列满，暂不挂接收
+        bool send_busy = false;        // 有发送或文件块在进行
+        bool waiting_block = false;    // 在等空闲的注册缓冲区
+        bool reaped = false;
+        unsigned inflight = 0;
+
+        // 进行中的 SENDMSG 引用的向量，必须保持到完成
+        iovec iov[max_write_frames * 2];
+        msghdr message;
+
+        // 进行中的文件块
+        uint32_t block = no_block;
+        uint32_t block_len = 0;
+        uint32_t block_sent = 0;
+        bool block_failed = false;
+    };
+
+    io_uring_sqe* sqe() {
+        io_uring_sqe* entry = ring_.get_sqe();
+        if (entry == nullptr) {
+            throw std::system_error(EBUSY, std::generic_category(), "io_uring submission queue full");
+        }
+        return entry;
+    }
+
+    void cancel(uint64_t target) {
+        io_uring_sqe* entry = sqe();
+        entry->opcode = IORING_OP_ASYNC_CANCEL;
+        entry->fd = -1;
+        entry->addr = target;
+        entry->user_data = pack(0, op_cancel);
+    }
+
+    void arm_wake() {
+        io_uring_sqe* entry = sqe();
+        entry->opcode = IORING_OP_READ;
+        entry->fd = wake_fd_;
+        entry->addr = reinterpret_cast<uint64_t>(&wake_value_);
+        entry->len = sizeof(wake_value_);
+        entry->user_data = pack(0, op_wake);
+        ++inflight_;
+    }
+
+    void arm_accept(uint64_t token) {
+        io_uring_sqe* entry = sqe();
+        entry->opcode = IORING_OP_POLL_ADD;
+        entry->fd = listeners_[token].fd;
+        entry->poll32_events = POLLIN;
+        entry->user_data = pack(token, op_accept);
+        ++inflight_;
+    }
+
+    void arm_recv(conn_state& st) {
+        connection& conn = *st.conn;
+        if (st.recv_armed || st.stalled || conn.finished_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        io_uring_sqe* entry = sqe();
+        entry->opcode = st.socket ? IORING_OP_RECV : IORING_OP_READ;
+        entry->fd = conn.fd_;
+        entry->flags = IOSQE_BUFFER_SELECT;
+        entry->buf_group = recv_group;
+        if (st.socket && multishot_) {
+            entry->ioprio = IORING_RECV_MULTISHOT;
+        }
+        if (!st.socket) {
+            entry->off = ~uint64_t(0);
+        }
+        entry->user_data = pack(conn.id_, op_recv);
+        st.recv_armed = true;
+        ++st.inflight;
+        ++inflight_;
+    }
+
+    void start_send(conn_state& st) {
+        connection& conn = *st.conn;
+        if (st.send_busy || conn.finished_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        // 先清除标记再取帧：之后新入队的帧会重新发出 write 命令
+        conn.write_requested_.store(false, std::memory_order_seq_cst);
+        if (!fill_output(conn, false)) {
+            return;
+        }
+        if (conn.out_.empty()) {
+            if (conn.closing_) {
+                finish(st.conn, std::error_code());
+            }
+            return;
+        }
+        if (conn.out_.front().f.file && conn.out_offset_ >= frame_header_size) {
+            send_file_block(st);
+            return;
+        }
+
+        int count = 0;
+        size_t skip = conn.out_offset_;
+        for (auto& out : conn.out_) {
+            const size_t header_skip = std::min(skip, frame_header_size);
+            if (header_skip < frame_header_size) {
+                st.iov[count].iov_base = out.header + header_skip;
+                st.iov[count].iov_len = frame_header_size - header_skip;
+                ++count;
+            }
+            skip -= header_skip;
+            if (out.f.file) {
+                // 文件负载从注册缓冲区单独发送
+                break;
+            }
+            if (out.f.payload_size() > skip) {
+                st.iov[count].iov_base = const_cast<uint8_t*>(out.f.payload_data()) + skip;
+                st.iov[count].iov_len = out.f.payload_size() - skip;
+                ++count;
+            }
+            skip = 0;
+        }
+
+        io_uring_sqe* entry = sqe();
+        entry->fd = conn.fd_;
+        if (st.socket) {
+            st.message = msghdr();
+            st.message.msg_iov = st.iov;
+            st.message.msg_iovlen = static_cast<decltype(st.message.msg_iovlen)>(count);
+            entry->opcode = IORING_OP_SENDMSG;
+            entry->addr = reinterpret_cast<uint64_t>(&st.message);
+            entry->len = 1;
+            entry->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        } else {
+            entry->opcode = IORING_OP_WRITEV;
+            entry->addr = reinterpret_cast<uint64_t>(st.iov);
+            entry->len = static_cast<uint32_t>(count);
+            entry->off = ~uint64_t(0);
+        }
+        entry->user_data = pack(conn.id_, op_send);
+        st.send_busy = true;
+        ++st.inflight;
+        ++inflight_;
+    }
+
+    void send_file_block(conn_state& st) {
+        connection& conn = *st.conn;
+        const frame& f = conn.out_.front().f;
+        if (!ensure_blocks()) {
+            finish(st.conn, std::make_error_code(std::errc::not_enough_memory));
+            return;
+        }
+        uint32_t block;
+        if (!free_blocks_.get(block)) {
+            if (!st.waiting_block) {
+                st.waiting_block = true;
+                block_waiters_.push_back(conn.id_);
+            }
+            return;
+        }
+        const uint64_t done = conn.out_offset_ - frame_header_size;
+        st.block = block;
+        st.block_len = static_cast<uint32_t>(std::min<uint64_t>(f.file_length - done, block_size_));
+        st.block_sent = 0;
+        st.block_failed = false;
+        st.send_busy = true;
+
+        // 读和发送必须在同一批提交中相邻，链接才会生效
+        if (ring_.sq_space() < 2) {
+            ring_.submit(0);
+        }
+        io_uring_sqe* read = sqe();
+        read->opcode = fixed_blocks_ ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        read->fd = f.file->fd();
+        read->addr = reinterpret_cast<uint64_t>(block_data(block));
+        read->len = st.block_len;
+        read->off = f.file_offset + done;
+        read->buf_index = 0;
+        read->flags = IOSQE_IO_LINK;
+        read->user_data = pack(conn.id_, op_file_read);
+        ++st.inflight;
+        ++inflight_;
+        queue_file_send(st);
+    }
+
+    void queue_file_send(conn_state& st) {
+        connection& conn = *st.conn;
+        io_uring_sqe* entry = sqe();
+        entry->fd = conn.fd_;
+        entry->addr = reinterpret_cast<uint64_t>(block_data(st.block) + st.block_sent);
+        entry->len = st.block_len - st.block_sent;
+        if (st.socket) {
+            entry->opcode = IORING_OP_SEND;
+            entry->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        } else {
+            entry->opcode = fixed_blocks_ ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+            entry->buf_index = 0;
+            entry->off = ~uint64_t(0);
+        }
+        entry->user_data = pack(conn.id_, op_file_send);
+        ++st.inflight;
+        ++inflight_;
+    }
+
+    // 第一次发送文件帧时分配并注册文件块缓冲区
+    bool ensure_blocks() {
+        if (block_memory_.region.base != nullptr) {
+            return true;
+        }
+        ring_buffer_options memory_options;
+        memory_options.huge_pages = true;
+        try {
+            block_memory_.region = ring_buffer_detail::allocate(size_t(block_count_) * block_size_,
+                                                                ring_buffer_detail::small_page_size, memory_options);
+        } catch (const std::bad_alloc&) {
+            return false;
+        }
+        for (uint32_t i = 0; i < block_count_; ++i) {
+            free_blocks_.push(i);
+        }
+        iovec region = {block_memory_.data(), size_t(block_count_) * block_size_};
+        try {
+            ring_.register_buffers(&region, 1);
+            fixed_blocks_ = true;
+        } catch (const std::system_error&) {
+            // 超过锁定内存的限额（RLIMIT_MEMLOCK）时退回普通的 READ，仍然没有用户态复制
+            fixed_blocks_ = false;
+        }
+        return true;
+    }
+
+    uint8_t* block_data(uint32_t block) const {
+        return block_memory_.data() + size_t(block) * block_size_;
+    }
+
+    void release_block(conn_state& st) {
+        if (st.block == no_block) {
+            return;
+        }
+        free_blocks_.push(st.block);
+        st.block = no_block;
+        while (!block_waiters_.empty()) {
+            auto it = states_.find(block_waiters_.front());
+            block_waiters_.pop_front();
+            if (it == states_.end() || it->second->conn->finished_.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            it->second->waiting_block = false;
+            start_send(*it->second);
+            break;
+        }
+    }
+
+    void handle(const io_uring_cqe& cqe) {
+        const op_kind op = static_cast<op_kind>(cqe.user_data & 0xff);
+        const uint64_t id = cqe.user_data >> 8;
+        switch (op) {
+        case op_cancel:
+        case op_provide:
+            return;
+        case op_wake:
+            --inflight_;
+            if (!stopping_) {
+                arm_wake();
+            }
+            return;
+        case op_accept: {
+            --inflight_;
+            auto it = listeners_.find(id);
+            if (it != listeners_.end() && cqe.res >= 0 && !stopping_) {
+                accept_all(it->second);
+                arm_accept(id);
+            }
+            return;
+        }
+        default:
+            break;
+        }
+
+        auto it = states_.find(id);
+        if (it == states_.end()) {
+            return;
+        }
+        conn_state& st = *it->second;
+        if (op != op_recv || !(cqe.flags & IORING_CQE_F_MORE)) {
+            --st.inflight;
+            --inflight_;
+        }
+        switch (op) {
+        case op_recv:
+            on_recv(st, cqe);
+            break;
+        case op_send:
+            on_send(st, cqe);
+            break;
+        case op_file_read:
+            on_file_read(st, cqe);
+            break;
+        case op_file_send:
+            on_file_send(st, cqe);
+            break;
+        default:
+            break;
+        }
+        if (st.conn->finished_.load(std::memory_order_relaxed) && st.inflight == 0) {
+            mark_reap(st);
+        }
+    }
+
+    void on_recv(conn_state& st, const io_uring_cqe& cqe) {
+        connection& conn = *st.conn;
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            st.recv_armed = false;
+            st.recv_cancelling = false;
+        }
+        const bool has_buffer = (cqe.flags & IORING_CQE_F_BUFFER) != 0;
+        const uint16_t id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        if (!conn.finished_.load(std::memory_order_relaxed)) {
+            if (cqe.res > 0 && has_buffer) {
+                conn.bytes_received_.fetch_add(static_cast<uint64_t>(cqe.res), std::memory_order_relaxed);
+                on_data(st, recv_buffers_->buffer(id), static_cast<size_t>(cqe.res));
+            } else if (cqe.res == 0) {
+                // 对端关闭；没有切完的半帧说明连接被截断
+                const bool truncated = conn.in_end_ != conn.in_begin_;
+                finish(st.conn, truncated ? std::make_error_code(std::errc::connection_reset) : std::error_code());
+            } else if (cqe.res == -EINVAL && st.socket && multishot_) {
+                // 内核不支持多次触发的接收，之后每次完成都重新提交
+                multishot_ = false;
+            } else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED && cqe.res != -EINTR) {
+                finish(st.conn, std::error_code(-cqe.res, std::generic_category()));
+            }
+        }
+        if (has_buffer) {
+            recv_buffers_->recycle(id);
+            recv_buffers_->publish();
+        }
+        if (conn.finished_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        if (!st.recv_armed) {
+            arm_recv(st);
+        } else if (st.stalled && !st.recv_cancelling) {
+            // 接收队列满：停止接收，由 TCP 流量控制反压对端
+            st.recv_cancelling = true;
+            cancel(pack(conn.id_, op_recv));
+        }
+    }
+
+    void on_data(conn_state& st, const uint8_t* data, size_t size) {
+        connection& conn = *st.conn;
+        if (conn.in_begin_ != conn.in_end_) {
+            append_input(conn, data, size);
+            st.stalled = !drain_input(conn);
+            return;
+        }
+        // 没有缓存的半帧时直接从共享缓冲区切帧，只把剩下的部分复制到 in_
+        bool stalled = false;
+        const size_t used = extract_frames(conn, data, size, stalled);
+        if (conn.finished_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        if (used < size) {
+            append_input(conn, data + used, size - used);
+        }
+        st.stalled = stalled;
+    }
+
+    void on_send(conn_state& st, const io_uring_cqe& cqe) {
+        st.send_busy = false;
+        if (st.conn->finished_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        if (cqe.res < 0) {
+            finish(st.conn, std::error_code(-cqe.res, std::generic_category()));
+            return;
+        }
+        consume_output(*st.conn, static_cast<size_t>(cqe.res));
+        start_send(st);
+    }
+
+    void on_file_read(conn_state& st, const io_uring_cqe& cqe) {
+        if (cqe.res == static_cast<int>(st.block_len)) {
+            return;
+        }
+        // 读取失败或文件被截断：链接的发送会以 ECANCELED 结束，帧头中的长度已经不能兑现
+        st.block_failed = true;
+        if (!st.conn->finished_.load(std::memory_order_relaxed)) {
+            finish(st.conn, cqe.res < 0 ? std::error_code(-cqe.res, std::generic_category())
+                                        : std::make_error_code(std::errc::io_error));
+        }
+    }
+
+    void on_file_send(conn_state& st, const io_uring_cqe& cqe) {
+        connection& conn = *st.conn;
+        if (st.block_failed || conn.finished_.load(std::memory_order_relaxed) || cqe.res < 0) {
+            if (cqe.res < 0 && !st.block_failed && !conn.finished_.load(std::memory_order_relaxed)) {
+                finish(st.conn, std::error_code(-cqe.res, std::generic_category()));
+            }
+            st.send_busy = false;
+            release_block(st);
+            return;
+        }
+        st.block_sent += static_cast<uint32_t>(cqe.res);
+        if (st.block_sent < st.block_len) {
+            queue_file_send(st);
+            return;
+        }
+        consume_output(conn, st.block_len);
+        st.send_busy = false;
+        release_block(st);
+        start_send(st);
+    }
+
+    void mark_reap(conn_state& st) {
+        if (!st.reaped) {
+            st.reaped = true;
+            reap_.push_back(st.conn->id_);
+        }
+    }
+
+    // 关闭所有操作都已结束的连接
+    void reap() {
+        for (const uint64_t id : reap_) {
+            auto it = states_.find(id);
+            if (it == states_.end()) {
+                continue;
+            }
+            connection& conn = *it->second->conn;
+            ::close(conn.fd_);
+            conn.out_.clear();
+            states_.erase(it);
+        }
+        reap_.clear();
+    }
+
+    const uint32_t recv_buffer_size_;
+    const uint32_t block_size_;
+    const uint32_t block_count_;
+
+    // 内核引用的内存必须比 ring_ 后释放
+    owned_region recv_memory_;
+    owned_region block_memory_;
+    ring_buffer<uint32_t, dynamic_capacity> free_blocks_;
+
+    io_uring_queue ring_;
+    std::unique_ptr<io_uring_provided_buffers> recv_buffers_;
+    int wake_fd_ = -1;
+    uint64_t wake_value_ = 0;
+    bool multishot_ = true;
+    bool fixed_blocks_ = false;
+    size_t inflight_ = 0;  // 会产生完成项的操作数量，不含取消请求
+
+    std::unordered_map<uint64_t, std::unique_ptr<conn_state>> states_;
+    std::deque<uint64_t> block_waiters_;
+    std::vector<uint64_t> reap_;
+};
+
+bool uring_loop_supported() {
+    static const bool supported = io_uring_queue::supported(required_ops, sizeof(required_ops));
+    return supported;
+}
+
+std::shared_ptr<io_loop> make_uring_loop(reactor& owner, thread_pool& pool, const reactor_options& options) {
+    if (!uring_loop_supported()) {
+        throw std::system_error(std::make_error_code(std::errc::function_not_supported), "io_uring");
+    }
+    return std::make_shared<uring_loop>(owner, pool, options);
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+// 连接上的整数编码，只在 connection 库内部使用
+
+#include <cstdint>
+
+/**
+ * 帧头和协议消息中整数的编解码，小端序
+ */
+inline void store_le32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+inline void store_le16(uint8_t* out, uint16_t value) {
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+inline uint32_t load_le32(const uint8_t* in) {
+    return uint32_t(in[0]) | uint32_t(in[1]) << 8 | uint32_t(in[2]) << 16 | uint32_t(in[3]) << 24;
+}
+
+inline uint16_t load_le16(const uint8_t* in) {
+    return static_cast<uint16_t>(in[0] | in[1] << 8);
+}
+
+inline void store_le64(uint8_t* out, uint64_t value) {
+    store_le32(out, static_cast<uint32_t>(value));
+    store_le32(out + 4, static_cast<uint32_t>(value >> 32));
+}
+
+inline uint64_t load_le64(const uint8_t* in) {
+    return uint64_t(load_le32(in)) | uint64_t(load_le32(in + 4)) << 32;
+}
@@ -0,0 +1,335 @@
+#include "metrics/metrics.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <system_error>
+
+namespace {
+
+// 直方图导出的桶边界：2^0 到 2^40（纳秒到约 18 分钟，字节到 1 TiB），每次导出的边界相同
+constexpr unsigned export_max_exponent = 40;
+
+std::string format_value(double value) {
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    char buf[32];
+    if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        std::snprintf(buf, sizeof(buf), "%.0f", value);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%.9g", value);
+    }
+    return buf;
+}
+
+void append_escaped(std::string& out, const std::string& value, bool help) {
+    for (char c : value) {
+        if (c == '\\') {
+            out += "\\\\";
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '"' && !help) {
+            out += "\\\"";
+        } else {
+            out += c;
+        }
+    }
+}
+
+// name{k="v",...} 加上额外的一个标签（直方图的 le）
+std::string series(const std::string& name, const metric_labels& labels, const char* extra_key = nullptr,
+                   const std::string& extra_value = std::string()) {
+    std::string out = name;
+    if (labels.empty() && extra_key == nullptr) {
+        return out;
+    }
+    out += '{';
+    bool first = true;
+    for (const auto& label : labels) {
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+        out += label.first;
+        out += "=\"";
+        append_escaped(out, label.second, false);
+        out += '"';
+    }
+    if (extra_key != nullptr) {
+        if (!first) {
+            out += ',';
+        }
+        out += extra_key;
+        out += "=\"";
+        out += extra_value;
+        out += '"';
+    }
+    out += '}';
+    return out;
+}
+
+#if defined(SYNC_RING_BUFFER_METRICS)
+// ring_buffer 的计数器通过收集函数导出，所有实例在同一个序列中累加
+metric_registration register_ring_buffer_metrics() {
+    return metrics_registry::global().add_collector([](metric_writer& writer) {
+        writer.counter("sync_ring_buffer_push_full_total", "Pushes rejected because the ring buffer was full", {},
+                       static_cast<double>(ring_buffer_counters.push_full.value()));
+        writer.counter("sync_ring_buffer_get_empty_total", "Gets that found the ring buffer empty", {},
+                       static_cast<double>(ring_buffer_counters.get_empty.value()));
+        writer.counter("sync_ring_buffer_cas_retries_total", "Position claims retried after losing a race", {},
+                       static_cast<double>(ring_buffer_counters.cas_retries.value()));
+    });
+}
+#endif
+
+}  // namespace
+
+ring_buffer_metrics ring_buffer_counters;
+
+#if defined(SYNC_RING_BUFFER_METRICS)
+static metric_registration ring_buffer_registration = register_ring_buffer_metrics();
+#endif
+
+size_t next_metric_shard() {
+    static std::atomic<size_t> next{0};
+    return next.fetch_add(1, std::memory_order_relaxed) % metric_shards;
+}
+
+uint64_t metric_counter::value() const {
+    uint64_t total = 0;
+    for (const shard& s : shards_) {
+        total += s.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+metric_histogram::metric_histogram() : shards_(new shard[histogram_shards]) {
+    for (size_t i = 0; i < histogram_shards; ++i) {
+        for (auto& bucket : shards_[i].buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        shards_[i].sum.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t metric_histogram::bucket_upper(size_t index) {
+    if (index < sub_buckets) {
+        return index;
+    }
+    const unsigned msb = static_cast<unsigned>(index / sub_buckets) + sub_bucket_bits - 1;
+    const uint64_t sub = index % sub_buckets;
+    const uint64_t lower = (sub_buckets + sub) << (msb - sub_bucket_bits);
+    return lower + ((uint64_t(1) << (msb - sub_bucket_bits)) - 1);
+}
+
+metric_histogram::snapshot metric_histogram::read() const {
+    snapshot out;
+    out.buckets.assign(bucket_count, 0);
+    for (size_t i = 0; i < histogram_shards; ++i) {
+        for (size_t b = 0; b < bucket_count; ++b) {
+            out.buckets[b] += shards_[i].buckets[b].load(std::memory_order_relaxed);
+        }
+        out.sum += shards_[i].sum.load(std::memory_order_relaxed);
+    }
+    for (uint64_t n : out.buckets) {
+        out.count += n;
+    }
+    return out;
+}
+
+uint64_t metric_histogram::snapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    q = q < 0 ? 0 : (q > 1 ? 1 : q);
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(count)));
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            return bucket_upper(b);
+        }
+    }
+    return bucket_upper(buckets.size() - 1);
+}
+
+uint64_t metric_histogram::snapshot::count_at_most(uint64_t bound) const {
+    uint64_t total = 0;
+    for (size_t b = 0; b < buckets.size() && bucket_upper(b) <= bound; ++b) {
+        total += buckets[b];
+    }
+    return total;
+}
+
+metric_writer::family& metric_writer::family_of(const std::string& name, const char* type, const std::string& help) {
+    family& f = families_[name];
+    if (f.type.empty()) {
+        f.type = type;
+        f.help = help;
+    }
+    return f;
+}
+
+void metric_writer::counter(const std::string& name, const std::string& help, const metric_labels& labels,
+                            double value) {
+    family_of(name, "counter", help).samples.push_back(series(name, labels) + ' ' + format_value(value));
+}
+
+void metric_writer::gauge(const std::string& name, const std::string& help, const metric_labels& labels,
+                          double value) {
+    family_of(name, "gauge", help).samples.push_back(series(name, labels) + ' ' + format_value(value));
+}
+
+void metric_writer::histogram(const std::string& name, const std::string& help, const metric_labels& labels,
+                              const metric_histogram::snapshot& snapshot, double scale) {
+    family& f = family_of(name, "histogram", help);
+    // Prometheus 的 le 是闭区间，导出的边界取 2^k - 1：它总是某个桶的上界，
+    // 恰好等于 2^k 的值落在下一个边界里，不会被错算进 le 以下
+    for (unsigned k = 1; k <= export_max_exponent + 1; ++k) {
+        const uint64_t bound = (uint64_t(1) << k) - 1;
+        f.samples.push_back(series(name + "_bucket", labels, "le", format_value(static_cast<double>(bound) * scale)) +
+                            ' ' + format_value(static_cast<double>(snapshot.count_at_most(bound))));
+    }
+    f.samples.push_back(series(name + "_bucket", labels, "le", "+Inf") + ' ' +
+                        format_value(static_cast<double>(snapshot.count)));
+    f.samples.push_back(series(name + "_sum", labels) + ' ' + format_value(static_cast<double>(snapshot.sum) * scale));
+    f.samples.push_back(series(name + "_count", labels) + ' ' + format_value(static_cast<double>(snapshot.count)));
+}
+
+std::string metric_writer::prometheus() const {
+    std::string out;
+    for (const auto& item : families_) {
+        out += "# HELP ";
+        out += item.first;
+        out += ' ';
+        append_escaped(out, item.second.help, true);
+        out += "\n# TYPE ";
+        out += item.first;
+        out += ' ';
+        out += item.second.type;
+        out += '\n';
+        for (const std::string& sample : item.second.samples) {
+            out += sample;
+            out += '\n';
+        }
+    }
+    return out;
+}
+
+metric_registration::~metric_registration() {
+    reset();
+}
+
+metric_registration::metric_registration(metric_registration&& other) noexcept
+    : registry_(other.registry_), id_(other.id_) {
+    other.registry_ = nullptr;
+}
+
+metric_registration& metric_registration::operator=(metric_registration&& other) noexcept {
+    if (this != &other) {
+        reset();
+        registry_ = other.registry_;
+        id_ = other.id_;
+        other.registry_ = nullptr;
+    }
+    return *this;
+}
+
+void metric_registration::reset() {
+    if (registry_ != nullptr) {
+        registry_->remove_collector(id_);
+        registry_ = nullptr;
+    }
+}
+
+metrics_registry& metrics_registry::global() {
+    // 不析构：其他静态对象（例如各个线程池）析构时可能仍在注销收集函数
+    static metrics_registry* registry = new metrics_registry();
+    return *registry;
+}
+
+metric_counter& metrics_registry::counter(const std::string& name, const std::string& help,
+                                          const metric_labels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const counter_entry& entry : counters_) {
+        if (entry.name == name && entry.labels == labels) {
+            return *entry.counter;
+        }
+    }
+    counters_.push_back(counter_entry{name, help, labels, std::unique_ptr<metric_counter>(new metric_counter())});
+    return *counters_.back().counter;
+}
+
+metric_histogram& metrics_registry::histogram(const std::string& name, const std::string& help,
+                                              const metric_labels& labels, double scale) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const histogram_entry& entry : histograms_) {
+        if (entry.name == name && entry.labels == labels) {
+            return *entry.histogram;
+        }
+    }
+    histograms_.push_back(
+        histogram_entry{name, help, labels, scale, std::unique_ptr<metric_histogram>(new metric_histogram())});
+    return *histograms_.back().histogram;
+}
+
+metric_registration metrics_registry::add_collector(metric_collector collector) {
+    std::lock_guard<std::mutex> lock(collectors_mutex_);
+    const uint64_t id = next_collector_++;
+    collectors_.emplace(id, std::move(collector));
+    return metric_registration(this, id);
+}
+
+void metrics_registry::remove_collector(uint64_t id) {
+    std::lock_guard<std::mutex> lock(collectors_mutex_);
+    collectors_.erase(id);
+}
+
+std::string metrics_registry::prometheus() const {
+    metric_writer writer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const counter_entry& entry : counters_) {
+            writer.counter(entry.name, entry.help, entry.labels, static_cast<double>(entry.counter->value()));
+        }
+        for (const histogram_entry& entry : histograms_) {
+            writer.histogram(entry.name, entry.help, entry.labels, entry.histogram->read(), entry.scale);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(collectors_mutex_);
+        for (const auto& item : collectors_) {
+            item.second(writer);
+        }
+    }
+    return writer.prometheus();
+}
+
+void metrics_registry::write_prometheus(const std::string& path) const {
+    const std::string text = prometheus();
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::system_error(errno, std::generic_category(), "open " + tmp);
+        }
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        out.flush();
+        if (!out) {
+            throw std::system_error(errno, std::generic_category(), "write " + tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        const int err = errno;
+        std::remove(tmp.c_str());
+        throw std::system_error(err, std::generic_category(), "rename " + path);
+    }
+}
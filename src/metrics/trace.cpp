@@ -0,0 +1,238 @@
+#include "metrics/trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+struct trace_event {
+    const char* name;
+    const char* category;
+    uint64_t id;
+    int64_t begin_ns;
+    int64_t end_ns;
+};
+
+// 每个线程的事件缓冲区；锁只在导出和清空时才有竞争
+struct thread_events {
+    std::mutex mutex;
+    std::vector<trace_event> events;
+    uint64_t dropped = 0;
+    uint32_t tid = 0;
+};
+
+struct trace_state {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<thread_events>> threads;  // 线程退出后仍保留，直到导出
+    std::atomic<size_t> max_events{0};
+    std::atomic<int64_t> start_ns{0};
+    uint32_t next_tid = 1;
+};
+
+trace_state& state() {
+    // 不析构：线程局部缓冲区可能在静态对象析构之后才释放
+    static trace_state* s = new trace_state();
+    return *s;
+}
+
+thread_events& local_events() {
+    thread_local std::shared_ptr<thread_events> local;
+    if (!local) {
+        local = std::make_shared<thread_events>();
+        trace_state& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        local->tid = s.next_tid++;
+        s.threads.push_back(local);
+    }
+    return *local;
+}
+
+void append_json_string(std::string& out, const char* value) {
+    out += '"';
+    for (const char* p = value; *p != '\0'; ++p) {
+        const char c = *p;
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// 微秒，保留纳秒精度
+std::string micros(int64_t ns) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%lld.%03lld", static_cast<long long>(ns / 1000),
+                  static_cast<long long>(ns % 1000));
+    return buf;
+}
+
+int64_t monotonic_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+struct flow_point {
+    uint64_t id;
+    int64_t ts_ns;
+    uint32_t tid;
+    const char* category;
+};
+
+}  // namespace
+
+namespace trace_detail {
+std::atomic<bool> enabled{false};
+}
+
+uint64_t trace_file_key(const std::string& name) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (const char c : name) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001b3ull;
+    }
+    return h == 0 ? 1 : h;
+}
+
+int64_t trace_span::now() {
+    return monotonic_ns();
+}
+
+void trace_span::record(const char* name, const char* category, uint64_t id, int64_t begin_ns, int64_t end_ns) {
+    thread_events& local = local_events();
+    const size_t max = state().max_events.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(local.mutex);
+    if (local.events.size() >= max) {
+        ++local.dropped;
+        return;
+    }
+    local.events.push_back(trace_event{name, category, id, begin_ns, end_ns});
+}
+
+void trace_start(size_t max_events_per_thread) {
+    trace_state& s = state();
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (const auto& t : s.threads) {
+            std::lock_guard<std::mutex> events_lock(t->mutex);
+            t->events.clear();
+            t->dropped = 0;
+        }
+    }
+    s.max_events.store(max_events_per_thread, std::memory_order_relaxed);
+    s.start_ns.store(monotonic_ns(), std::memory_order_relaxed);
+    trace_detail::enabled.store(true, std::memory_order_release);
+}
+
+void trace_stop() {
+    trace_detail::enabled.store(false, std::memory_order_release);
+}
+
+uint64_t trace_dropped() {
+    trace_state& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    uint64_t total = 0;
+    for (const auto& t : s.threads) {
+        std::lock_guard<std::mutex> events_lock(t->mutex);
+        total += t->dropped;
+    }
+    return total;
+}
+
+void trace_write(std::ostream& out) {
+    trace_state& s = state();
+    const int64_t start = s.start_ns.load(std::memory_order_relaxed);
+    std::vector<flow_point> flows;
+    std::string text = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&]() {
+        if (!first) {
+            text += ",\n";
+        } else {
+            text += '\n';
+        }
+        first = false;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (const auto& t : s.threads) {
+            std::lock_guard<std::mutex> events_lock(t->mutex);
+            for (const trace_event& e : t->events) {
+                if (e.begin_ns < start) {
+                    continue;  // 上一次跟踪中开始的区间
+                }
+                separator();
+                text += "{\"name\":";
+                append_json_string(text, e.name);
+                text += ",\"cat\":";
+                append_json_string(text, e.category);
+                text += ",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(t->tid);
+                text += ",\"ts\":" + micros(e.begin_ns - start);
+                text += ",\"dur\":" + micros(e.end_ns - e.begin_ns);
+                if (e.id != 0) {
+                    text += ",\"args\":{\"id\":" + std::to_string(e.id) + "}";
+                    // flow 事件落在区间中间，查看器按时间找到它所属的区间
+                    flows.push_back(flow_point{e.id, (e.begin_ns + e.end_ns) / 2 - start, t->tid, e.category});
+                }
+                text += '}';
+            }
+        }
+    }
+
+    // 编号相同的区间按时间顺序连成一条 flow：s 开始，t 经过，f 结束
+    std::sort(flows.begin(), flows.end(), [](const flow_point& a, const flow_point& b) {
+        return a.id != b.id ? a.id < b.id : a.ts_ns < b.ts_ns;
+    });
+    for (size_t i = 0; i < flows.size();) {
+        size_t end = i;
+        while (end < flows.size() && flows[end].id == flows[i].id) {
+            ++end;
+        }
+        if (end - i >= 2) {
+            for (size_t k = i; k < end; ++k) {
+                const char* phase = k == i ? "s" : (k + 1 == end ? "f" : "t");
+                separator();
+                text += "{\"name\":\"flow\",\"cat\":";
+                append_json_string(text, flows[i].category);
+                text += ",\"ph\":\"";
+                text += phase;
+                text += "\",\"id\":" + std::to_string(flows[k].id);
+                text += ",\"pid\":1,\"tid\":" + std::to_string(flows[k].tid);
+                text += ",\"ts\":" + micros(flows[k].ts_ns);
+                if (k + 1 == end) {
+                    text += ",\"bp\":\"e\"";
+                }
+                text += '}';
+            }
+        }
+        i = end;
+    }
+    text += "\n]}\n";
+    out << text;
+}
+
+void trace_write(const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    trace_write(out);
+    out.flush();
+    if (!out) {
+        throw std::system_error(errno, std::generic_category(), "write " + path);
+    }
+}
@@ -0,0 +1,192 @@
+#include "thread_pool/cpu_topology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <pthread.h>
+#endif
+
+std::vector<int> cpu_topology::parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(',', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        const std::string item = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        char* rest = nullptr;
+        const long first = std::strtol(item.c_str(), &rest, 10);
+        if (rest == item.c_str() || first < 0) {
+            continue;
+        }
+        long last = first;
+        if (*rest == '-') {
+            const char* range = rest + 1;
+            last = std::strtol(range, &rest, 10);
+            if (rest == range || last < first) {
+                continue;
+            }
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+cpu_topology cpu_topology::single_node(size_t cpus) {
+    cpu_topology topology;
+    numa_node_info node;
+    for (size_t i = 0; i < cpus; ++i) {
+        node.cpus.push_back(static_cast<int>(i));
+    }
+    topology.nodes.push_back(node);
+    return topology;
+}
+
+cpu_topology cpu_topology::detect() {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    const bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    cpu_topology topology;
+    if (DIR* dir = opendir("/sys/devices/system/node")) {
+        while (struct dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+                name.find_first_not_of("0123456789", 4) != std::string::npos) {
+                continue;
+            }
+            std::ifstream file("/sys/devices/system/node/" + name + "/cpulist");
+            std::string list;
+            if (!std::getline(file, list)) {
+                continue;
+            }
+            numa_node_info node;
+            node.id = std::atoi(name.c_str() + 4);
+            for (int cpu : parse_cpu_list(list)) {
+                if (!have_mask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))) {
+                    node.cpus.push_back(cpu);
+                }
+            }
+            // 没有可用 CPU 的节点（纯内存节点或被排除的节点）不参与调度
+            if (!node.cpus.empty()) {
+                topology.nodes.push_back(node);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(topology.nodes.begin(), topology.nodes.end(),
+              [](const numa_node_info& a, const numa_node_info& b) { return a.id < b.id; });
+    if (!topology.nodes.empty()) {
+        return topology;
+    }
+
+    // 没有 NUMA 信息时退化为单节点，仍然只包含允许使用的 CPU
+    if (have_mask) {
+        numa_node_info node;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        if (!node.cpus.empty()) {
+            topology.nodes.push_back(node);
+            return topology;
+        }
+    }
+#endif
+    const unsigned hw = std::thread::hardware_concurrency();
+    return single_node(hw == 0 ? 1 : hw);
+}
+
+size_t cpu_topology::cpu_count() const {
+    size_t count = 0;
+    for (const auto& node : nodes) {
+        count += node.cpus.size();
+    }
+    return count;
+}
+
+int cpu_topology::node_index_of_cpu(int cpu) const {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (std::binary_search(nodes[i].cpus.begin(), nodes[i].cpus.end(), cpu)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int cpu_topology::node_index_of_id(int id) const {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].id == id) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int numa_node_of(const void* address) {
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+    // MPOL_F_NODE | MPOL_F_ADDR：返回 address 所在页实际分配的节点
+    constexpr unsigned long mpol_f_node = 1UL << 0;
+    constexpr unsigned long mpol_f_addr = 1UL << 1;
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, nullptr, 0, address, mpol_f_node | mpol_f_addr) == 0) {
+        return node;
+    }
+#else
+    (void)address;
+#endif
+    return -1;
+}
+
+int current_cpu() {
+#if defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+bool set_current_thread_affinity(const std::vector<int>& cpus, int affinity_tag) {
+#if defined(__linux__)
+    (void)affinity_tag;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    bool any = false;
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+            any = true;
+        }
+    }
+    return any && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(__APPLE__)
+    (void)cpus;
+    thread_affinity_policy_data_t policy = {affinity_tag};
+    return thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_AFFINITY_POLICY,
+                             reinterpret_cast<thread_policy_t>(&policy), THREAD_AFFINITY_POLICY_COUNT) == KERN_SUCCESS;
+#else
+    (void)cpus;
+    (void)affinity_tag;
+    return false;
+#endif
+}
@@ -0,0 +1,432 @@
+#include "thread_pool/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+#if defined(__APPLE__)
+#include <pthread.h>
+#include <sys/qos.h>
+#endif
+
+namespace {
+
+// 当前线程所属的线程池及其工作线程编号，外部线程为 nullptr
+thread_local const thread_pool* current_pool = nullptr;
+thread_local size_t current_index = 0;
+
+uint64_t next_random(uint64_t& state) {
+    // xorshift64*
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+#if defined(SYNC_METRICS)
+const char* const lane_names[task_lane_count] = {"transfer", "hash"};
+
+int64_t monotonic_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// 所有线程池共用的每通道直方图
+struct lane_metrics {
+    metric_histogram* wait;  // 从提交到开始执行
+    metric_histogram* run;   // 执行时间
+};
+
+const lane_metrics& metrics_of(task_lane lane) {
+    static const auto all = [] {
+        std::array<lane_metrics, task_lane_count> out{};
+        metrics_registry& registry = metrics_registry::global();
+        for (size_t i = 0; i < task_lane_count; ++i) {
+            const metric_labels labels = {{"lane", lane_names[i]}};
+            out[i].wait = &registry.histogram("sync_thread_pool_task_wait_seconds",
+                                              "Time tasks spent queued before a worker started them", labels, 1e-9);
+            out[i].run = &registry.histogram("sync_thread_pool_task_run_seconds", "Time spent running tasks", labels,
+                                             1e-9);
+        }
+        return out;
+    }();
+    return all[static_cast<size_t>(lane)];
+}
+#endif
+
+}  // namespace
+
+thread_pool::thread_pool(size_t threads, uint32_t queue_capacity) {
+    thread_pool_options options;
+    options.threads = threads;
+    options.queue_capacity = queue_capacity;
+    start(options);
+}
+
+thread_pool::thread_pool(const thread_pool_options& options) {
+    start(options);
+}
+
+void thread_pool::start(const thread_pool_options& options) {
+    topology_ = options.topology.nodes.empty() ? cpu_topology::detect() : options.topology;
+    numa_aware_ = options.numa_aware;
+    if (!numa_aware_) {
+        // 不按节点划分时把所有 CPU 合并为一个节点
+        numa_node_info all;
+        all.id = -1;
+        for (const auto& node : topology_.nodes) {
+            all.cpus.insert(all.cpus.end(), node.cpus.begin(), node.cpus.end());
+        }
+        std::sort(all.cpus.begin(), all.cpus.end());
+        topology_.nodes.assign(1, all);
+    }
+
+    size_t threads = options.threads;
+    if (threads == 0) {
+        threads = std::max<size_t>(topology_.cpu_count(), 1);
+    }
+    for (uint32_t weight : options.lane_weights) {
+        if (weight == 0) {
+            throw std::invalid_argument("thread_pool lane weights must be positive");
+        }
+    }
+
+    // 线程比节点少时只使用前面的节点，每个节点至少有一个工作线程
+    const size_t node_total = std::min(topology_.nodes.size(), threads);
+    std::vector<size_t> node_threads(node_total);
+    std::vector<size_t> node_dedicated(node_total);
+    for (size_t n = 0; n < node_total; ++n) {
+        node_threads[n] = threads / node_total + (n < threads % node_total ? 1 : 0);
+        node_dedicated[n] =
+            options.dedicated_hash_workers / node_total + (n < options.dedicated_hash_workers % node_total ? 1 : 0);
+        if (node_dedicated[n] >= node_threads[n]) {
+            throw std::invalid_argument("thread_pool needs at least one worker that is not dedicated to hashing");
+        }
+    }
+
+    const uint32_t all_lanes = (1u << task_lane_count) - 1;
+    const size_t hash_lane = static_cast<size_t>(task_lane::hash);
+
+    for (size_t n = 0; n < node_total; ++n) {
+        auto node = std::make_unique<node_state>();
+        node->id = topology_.nodes[n].id;
+        node->cpus = topology_.nodes[n].cpus;
+
+        // 注入队列由本节点的工作线程消费，分配在本节点的内存上
+        ring_buffer_options buffer_options;
+        buffer_options.numa_node = numa_aware_ ? node->id : -1;
+        for (size_t lane = 0; lane < task_lane_count; ++lane) {
+            node->lanes[lane] = std::make_unique<lane_state>(options.queue_capacity, buffer_options,
+                                                             options.lane_weights[lane]);
+        }
+
+        // 没有专用哈希线程时本节点所有线程服务所有通道；否则分成通用组和哈希组
+        const size_t general_group = groups_.size();
+        groups_.push_back(std::make_unique<worker_group>());
+        groups_[general_group]->lane_mask = all_lanes;
+        for (auto& lane : node->lanes) {
+            lane->group = general_group;
+        }
+        size_t hash_group = general_group;
+        if (node_dedicated[n] > 0) {
+            hash_group = groups_.size();
+            groups_[general_group]->lane_mask = all_lanes & ~(1u << hash_lane);
+            groups_.push_back(std::make_unique<worker_group>());
+            groups_[hash_group]->lane_mask = 1u << hash_lane;
+            node->lanes[hash_lane]->group = hash_group;
+        }
+
+        const size_t general_workers = node_threads[n] - node_dedicated[n];
+        for (size_t k = 0; k < node_threads[n]; ++k) {
+            auto w = std::make_unique<worker>();
+            w->rng_state = 0x9E3779B97F4A7C15ULL * (workers_.size() + 1);
+            w->group = k < general_workers ? general_group : hash_group;
+            w->node = n;
+            if (options.pin_threads && !node->cpus.empty()) {
+                w->affinity.push_back(node->cpus[k % node->cpus.size()]);
+            } else if (numa_aware_) {
+                w->affinity = node->cpus;
+            }
+            workers_.push_back(std::move(w));
+        }
+        nodes_.push_back(std::move(node));
+    }
+
+#if defined(SYNC_METRICS)
+    // 导出时才读取注入队列的深度；工作线程本地双端队列中的任务不计入
+    static std::atomic<uint64_t> next_pool{0};
+    const std::string pool = std::to_string(next_pool.fetch_add(1, std::memory_order_relaxed));
+    metrics_ = metrics_registry::global().add_collector([this, pool](metric_writer& writer) {
+        for (size_t lane = 0; lane < task_lane_count; ++lane) {
+            size_t depth = 0;
+            for (const auto& node : nodes_) {
+                depth += node->lanes[lane]->queue.size_approx();
+            }
+            writer.gauge("sync_thread_pool_queued_tasks", "Tasks waiting in the injection queues",
+                         {{"pool", pool}, {"lane", lane_names[lane]}}, static_cast<double>(depth));
+        }
+    });
+#endif
+
+    // 所有工作线程的结构就绪后再启动，窃取时可以安全地访问任意受害者
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->thread = std::thread([this, i] { worker_loop(i); });
+    }
+}
+
+thread_pool::~thread_pool() {
+    stopping_.store(true, std::memory_order_seq_cst);
+    for (auto& group : groups_) {
+        group->idle.notify_all();
+    }
+    for (auto& w : workers_) {
+        if (w->thread.joinable()) {
+            w->thread.join();
+        }
+    }
+    drain_remaining();
+}
+
+void thread_pool::drain_remaining() {
+    // 一个工作组退出后，另一组的任务仍可能向它的通道提交子任务，
+    // 这些任务在所有线程退出后由析构线程执行。工作线程已经 join，
+    // 这里可以安全地以所有者身份弹出它们的双端队列
+    bool found = true;
+    while (found) {
+        found = false;
+        task* t = nullptr;
+        for (size_t lane = 0; lane < task_lane_count; ++lane) {
+            for (auto& w : workers_) {
+                while (w->deques[lane].pop(t)) {
+                    run_task(t);
+                    found = true;
+                }
+            }
+            for (auto& node : nodes_) {
+                while (node->lanes[lane]->queue.get(t)) {
+                    run_task(t);
+                    found = true;
+                }
+            }
+        }
+    }
+}
+
+bool thread_pool::in_worker() const {
+    return current_pool == this;
+}
+
+bool thread_pool::run_pending_task() {
+    if (!in_worker()) {
+        return false;
+    }
+    task* t = nullptr;
+    if (!find_task(current_index, t)) {
+        return false;
+    }
+    run_task(t);
+    return true;
+}
+
+int thread_pool::current_node() const {
+    if (!in_worker() || !numa_aware_) {
+        return -1;
+    }
+    return nodes_[workers_[current_index]->node]->id;
+}
+
+size_t thread_pool::home_node() const {
+    if (in_worker()) {
+        return workers_[current_index]->node;
+    }
+    if (nodes_.size() > 1) {
+        const int index = topology_.node_index_of_cpu(current_cpu());
+        if (index >= 0 && static_cast<size_t>(index) < nodes_.size()) {
+            return static_cast<size_t>(index);
+        }
+    }
+    return 0;
+}
+
+void thread_pool::enqueue(int node_id, task_lane lane, task* t) {
+    const size_t index = static_cast<size_t>(lane);
+    SYNC_METRICS_ONLY(t->enqueued_ns = monotonic_ns(); t->lane = lane;)
+    size_t node = home_node();
+    if (node_id >= 0 && nodes_.size() > 1) {
+        const int target = topology_.node_index_of_id(node_id);
+        if (target >= 0 && static_cast<size_t>(target) < nodes_.size()) {
+            node = static_cast<size_t>(target);
+        }
+    }
+
+    if (in_worker()) {
+        worker& self = *workers_[current_index];
+        // 工作线程内部提交到本节点：压入自己对应通道的双端队列，不经过共享结构。
+        // 提交到其他节点时不能阻塞等待（对方也可能正在等我们），队列满就留在本地
+        if (self.node != node && !nodes_[node]->lanes[index]->queue.push(t)) {
+            node = self.node;
+        }
+        if (self.node == node) {
+            self.deques[index].push(t);
+        }
+    } else {
+        if (stopping_.load(std::memory_order_acquire)) {
+            delete t;
+            throw std::runtime_error("thread_pool is shutting down");
+        }
+        // 注入队列满时阻塞等待工作线程取走任务
+        nodes_[node]->lanes[index]->queue.push_wait(t);
+    }
+    notify_lane(node, index);
+}
+
+void thread_pool::notify_lane(size_t node, size_t lane) {
+    if (groups_[nodes_[node]->lanes[lane]->group]->idle.notify_one()) {
+        return;
+    }
+    // 本节点负责该通道的线程都在忙：唤醒其他节点上空闲的线程跨节点来取
+    for (size_t k = 1; k < nodes_.size(); ++k) {
+        const size_t other = (node + k) % nodes_.size();
+        if (groups_[nodes_[other]->lanes[lane]->group]->idle.notify_one()) {
+            return;
+        }
+    }
+}
+
+bool thread_pool::node_has_idle(size_t node, size_t lane) const {
+    return groups_[nodes_[node]->lanes[lane]->group]->idle.has_waiters();
+}
+
+void thread_pool::run_task(task* t) {
+#if defined(SYNC_METRICS)
+    const lane_metrics& metrics = metrics_of(t->lane);
+    const int64_t start = monotonic_ns();
+    metrics.wait->record(static_cast<uint64_t>(start - t->enqueued_ns));
+    t->run();
+    metrics.run->record(static_cast<uint64_t>(monotonic_ns() - start));
+#else
+    t->run();
+#endif
+    delete t;
+}
+
+bool thread_pool::steal_task(size_t index, size_t lane, bool same_node, task*& t) {
+    const size_t count = workers_.size();
+    if (count < 2) {
+        return false;
+    }
+    const size_t node = workers_[index]->node;
+    // 从随机受害者开始依次尝试其他工作线程，包括其他工作组的线程
+    const size_t start = static_cast<size_t>(next_random(workers_[index]->rng_state) % count);
+    for (size_t k = 0; k < count; ++k) {
+        const size_t victim = (start + k) % count;
+        if (victim == index || (workers_[victim]->node == node) != same_node) {
+            continue;
+        }
+        // 远端节点还有空闲线程时让它们自己处理，保持数据局部性
+        if (!same_node && node_has_idle(workers_[victim]->node, lane)) {
+            continue;
+        }
+        if (workers_[victim]->deques[lane].steal(t)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool thread_pool::find_task(size_t index, task*& t) {
+    worker& w = *workers_[index];
+    const uint32_t mask = groups_[w.group]->lane_mask;
+    node_state& home = *nodes_[w.node];
+
+    // 平滑加权轮询：每个服务的通道先加上自己的权重，按当前值从大到小尝试
+    size_t order[task_lane_count];
+    size_t count = 0;
+    int64_t remaining = 0;
+    for (size_t lane = 0; lane < task_lane_count; ++lane) {
+        if (mask & (1u << lane)) {
+            w.current_weight[lane] += home.lanes[lane]->weight;
+            remaining += home.lanes[lane]->weight;
+            order[count++] = lane;
+        }
+    }
+    // 当前值相同时编号小的通道优先
+    std::stable_sort(order, order + count,
+                     [&w](size_t a, size_t b) { return w.current_weight[a] > w.current_weight[b]; });
+
+    for (size_t k = 0; k < count; ++k) {
+        const size_t lane = order[k];
+        if (w.deques[lane].pop(t) || home.lanes[lane]->queue.get(t)) {
+            // 只从仍可能有任务的通道中扣除总权重，空通道不参与分配
+            w.current_weight[lane] -= remaining;
+            return true;
+        }
+        // 空通道放弃已累积的额度，避免空闲一段时间后独占工作线程
+        w.current_weight[lane] = 0;
+        remaining -= home.lanes[lane]->weight;
+    }
+
+    for (size_t k = 0; k < count; ++k) {
+        if (steal_task(index, order[k], true, t)) {
+            return true;
+        }
+    }
+
+    // 本节点没有任何任务时才跨节点，并且只帮助没有空闲线程的节点：
+    // 先取其他节点的注入队列，再窃取远端线程
+    for (size_t k = 0; k < count && nodes_.size() > 1; ++k) {
+        const size_t lane = order[k];
+        for (size_t n = 1; n < nodes_.size(); ++n) {
+            const size_t other = (w.node + n) % nodes_.size();
+            if (!node_has_idle(other, lane) && nodes_[other]->lanes[lane]->queue.get(t)) {
+                return true;
+            }
+        }
+        if (steal_task(index, lane, false, t)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void thread_pool::worker_loop(size_t index) {
+    current_pool = this;
+    current_index = index;
+    worker& self = *workers_[index];
+    event_count& idle = groups_[self.group]->idle;
+
+    if (!self.affinity.empty()) {
+        // 设置失败（例如被 cgroup 限制）时继续运行，只是失去亲和性
+        set_current_thread_affinity(self.affinity, static_cast<int>(self.node) + 1);
+    }
+#if defined(__APPLE__)
+    const uint32_t hash_only = 1u << static_cast<size_t>(task_lane::hash);
+    pthread_set_qos_class_self_np(groups_[self.group]->lane_mask == hash_only ? QOS_CLASS_UTILITY
+                                                                              : QOS_CLASS_USER_INITIATED,
+                                  0);
+#endif
+
+    task* t = nullptr;
+    for (;;) {
+        if (find_task(index, t)) {
+            run_task(t);
+            continue;
+        }
+
+        // 登记为等待者后再检查一次，避免错过登记前刚提交的任务
+        uint32_t key = idle.prepare_wait();
+        if (find_task(index, t)) {
+            idle.cancel_wait();
+            run_task(t);
+            continue;
+        }
+        if (stopping_.load(std::memory_order_acquire)) {
+            idle.cancel_wait();
+            break;
+        }
+        idle.wait(key);
+    }
+
+    current_pool = nullptr;
+}
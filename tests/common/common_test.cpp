@@ -0,0 +1,2227 @@
+#include "../../include/common/blake3.h"
+#include "../../include/common/buffer_pool.h"
+#include "../../include/common/change_watcher.h"
+#include "../../include/common/chunker.h"
+#include "../../include/common/compression.h"
+#include "../../include/common/delta.h"
+#include "../../include/common/directory_scanner.h"
+#include "../../include/common/directory_tree.h"
+#include "../../include/common/file_hasher.h"
+#include "../../include/common/file_reader.h"
+#include "../../include/common/hash_index.h"
+#include "../../include/common/io_uring.h"
+#include "../../include/common/manifest.h"
+#include "../../include/common/write_back.h"
+#include "../../include/metrics/trace.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// BLAKE3 官方测试向量的输入：第 i 个字节为 i % 251
+std::vector<uint8_t> test_input(size_t size) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<uint8_t>(i % 251);
+    }
+    return data;
+}
+
+struct hash_vector {
+    size_t length;
+    const char* hex;
+};
+
+// 官方 test_vectors.json 中默认哈希模式的前 32 字节
+const hash_vector official_vectors[] = {
+        {0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"},
+        {1, "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213"},
+        {63, "e9bc37a594daad83be9470df7f7b3798297c3d834ce80ba85d6e207627b7db7b"},
+        {64, "4eed7141ea4a5cd4b788606bd23f46e212af9cacebacdc7d1f4c6dc7f2511b98"},
+        {65, "de1e5fa0be70df6d2be8fffd0e99ceaa8eb6e8c93a63f2d8d1c30ecb6b263dee"},
+        {1023, "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11"},
+        {1024, "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7"},
+        {1025, "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444"},
+        {2048, "e776b6028c7cd22a4d0ba182a8bf62205d2ef576467e838ed6f2529b85fba24a"},
+        {2049, "5f4d72f40d7a5f82b15ca2b2e44b1de3c2ef86c426c95c1af0b6879522563030"},
+        {3072, "b98cb0ff3623be03326b373de6b9095218513e64f1ee2edd2525c7ad1e5cffd2"},
+        {3073, "7124b49501012f81cc7f11ca069ec9226cecb8a2c850cfe644e327d22d3e1cd3"},
+        {4096, "015094013f57a5277b59d8475c0501042c0b642e531b0a1c8f58d2163229e969"},
+        {4097, "9b4052b38f1c5fc8b1f9ff7ac7b27cd242487b3d890d15c96a1c25b8aa0fb995"},
+        {5120, "9cadc15fed8b5d854562b26a9536d9707cadeda9b143978f319ab34230535833"},
+        {5121, "628bd2cb2004694adaab7bbd778a25df25c47b9d4155a55f8fbd79f2fe154cff"},
+        {6144, "3e2e5b74e048f3add6d21faab3f83aa44d3b2278afb83b80b3c35164ebeca205"},
+        {6145, "f1323a8631446cc50536a9f705ee5cb619424d46887f3c376c695b70e0f0507f"},
+        {7168, "61da957ec2499a95d6b8023e2b0e604ec7f6b50e80a9678b89d2628e99ada77a"},
+        {7169, "a003fc7a51754a9b3c7fae0367ab3d782dccf28855a03d435f8cfe74605e7817"},
+        {8192, "aae792484c8efe4f19e2ca7d371d8c467ffb10748d8a5a1ae579948f718a2a63"},
+        {8193, "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b"},
+        {16384, "f875d6646de28985646f34ee13be9a576fd515f76b5b0a26bb324735041ddde4"},
+        {31744, "62b6960e1a44bcc1eb1a611a8d6235b6b4b78f32e7abc4fb4c6cdcce94895c47"},
+        {102400, "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085"},
+};
+
+std::vector<hash_isa> supported_isas() {
+    std::vector<hash_isa> isas;
+    for (hash_isa isa : {hash_isa::portable, hash_isa::sse2, hash_isa::avx2, hash_isa::avx512, hash_isa::neon}) {
+        if (hash_isa_supported(isa)) {
+            isas.push_back(isa);
+        }
+    }
+    return isas;
+}
+
+// 测试结束后恢复自动选择的指令集
+class scoped_hash_isa {
+public:
+    explicit scoped_hash_isa(hash_isa isa) : previous_(active_hash_isa()) { set_hash_isa(isa); }
+    ~scoped_hash_isa() { set_hash_isa(previous_); }
+
+private:
+    hash_isa previous_;
+};
+
+std::string temp_path(const char* name) {
+    return std::string("/tmp/sync_common_test_") + std::to_string(::getpid()) + "_" + name;
+}
+
+// 测试用的临时目录：构造时新建（先删除同名的残留），析构时连同其中的内容一起删除
+class temp_dir {
+public:
+    explicit temp_dir(const char* name) : path_(temp_path(name)) {
+        std::filesystem::remove_all(path_);
+        std::filesystem::create_directories(path_);
+    }
+    ~temp_dir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path_, ec);
+    }
+
+    temp_dir(const temp_dir&) = delete;
+    temp_dir& operator=(const temp_dir&) = delete;
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+}  // namespace
+
+TEST(Blake3Test, OfficialVectorsAllKernels) {
+    for (hash_isa isa : supported_isas()) {
+        scoped_hash_isa scope(isa);
+        for (const auto& vector : official_vectors) {
+            std::vector<uint8_t> data = test_input(vector.length);
+            EXPECT_EQ(to_hex(blake3_hasher::hash(data.data(), data.size())), vector.hex)
+                << hash_isa_name(isa) << " length " << vector.length;
+        }
+    }
+    EXPECT_EQ(to_hex(blake3_hasher::hash("abc", 3)), "6437b3ac38465133ffb63b75273a8db548c558465d79db03fd359c6cd5bd9d85");
+}
+
+// 以随机大小分多次 update 与一次性计算结果相同，finalize 之后还可以继续输入
+TEST(Blake3Test, IncrementalUpdateMatchesOneShot) {
+    std::vector<uint8_t> data = test_input(300000);
+    const hash_digest expected = blake3_hasher::hash(data.data(), data.size());
+
+    std::mt19937 rng(12345);
+    for (int round = 0; round < 20; round++) {
+        blake3_hasher hasher;
+        size_t offset = 0;
+        while (offset < data.size()) {
+            size_t take = std::uniform_int_distribution<size_t>(0, 70000)(rng);
+            take = std::min(take, data.size() - offset);
+            hasher.update(data.data() + offset, take);
+            offset += take;
+        }
+        EXPECT_EQ(hasher.finalize(), expected);
+    }
+
+    blake3_hasher hasher;
+    hasher.update(data.data(), 1000);
+    EXPECT_EQ(hasher.finalize(), blake3_hasher::hash(data.data(), 1000));
+    hasher.update(data.data() + 1000, data.size() - 1000);
+    EXPECT_EQ(hasher.finalize(), expected);
+    hasher.reset();
+    EXPECT_EQ(to_hex(hasher.finalize()), official_vectors[0].hex);
+}
+
+TEST(Blake3Test, UnsupportedIsaThrows) {
+    bool any_unsupported = false;
+    for (hash_isa isa : {hash_isa::sse2, hash_isa::avx2, hash_isa::avx512, hash_isa::neon}) {
+        if (!hash_isa_supported(isa)) {
+            any_unsupported = true;
+            EXPECT_THROW(set_hash_isa(isa), std::invalid_argument);
+        }
+    }
+    EXPECT_TRUE(any_unsupported);
+    RecordProperty("active_hash_isa", hash_isa_name(active_hash_isa()));
+}
+
+TEST(FileHasherTest, FixedSizeChunks) {
+    EXPECT_TRUE(fixed_size_chunks(0, 4096).empty());
+    std::vector<chunk_span> spans = fixed_size_chunks(10000, 4096);
+    ASSERT_EQ(spans.size(), 3u);
+    EXPECT_EQ(spans[2].offset, 8192u);
+    EXPECT_EQ(spans[2].length, 10000u - 8192u);
+    EXPECT_THROW(fixed_size_chunks(10, 0), std::invalid_argument);
+}
+
+// 树哈希的结构：单个分块即为其摘要，多个分块按 BLAKE3 父节点规则左偏合并
+TEST(FileHasherTest, CombineTreeShape) {
+    std::vector<chunk_hash> chunks(3);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        uint8_t byte = static_cast<uint8_t>(i);
+        chunks[i].digest = blake3_hasher::hash(&byte, 1);
+    }
+    EXPECT_EQ(combine_chunk_hashes({chunks[0]}), chunks[0].digest);
+    EXPECT_EQ(combine_chunk_hashes({}), blake3_hasher::hash(nullptr, 0));
+
+    const hash_digest left = hash_parent(chunks[0].digest, chunks[1].digest, false);
+    EXPECT_EQ(combine_chunk_hashes(chunks), hash_parent(left, chunks[2].digest, true));
+    EXPECT_NE(hash_parent(chunks[0].digest, chunks[1].digest, true), left);
+}
+
+TEST(FileHasherTest, ParallelBufferHashMatchesSequential) {
+    thread_pool pool(4);
+    file_hasher_options options;
+    options.chunk_size = 64 * 1024;
+    file_hasher hasher(pool, options);
+
+    std::vector<uint8_t> data = test_input(1000003);
+    file_hash_result result = hasher.hash_buffer(data.data(), data.size());
+    EXPECT_EQ(result.size, data.size());
+    ASSERT_EQ(result.chunks.size(), 16u);
+
+    for (const auto& chunk : result.chunks) {
+        EXPECT_EQ(chunk.digest, blake3_hasher::hash(data.data() + chunk.offset, chunk.length));
+    }
+    EXPECT_EQ(result.root, combine_chunk_hashes(result.chunks));
+
+    // 只修改一个字节，只有对应分块的摘要变化
+    data[200000] ^= 1;
+    file_hash_result changed = hasher.hash_buffer(data.data(), data.size());
+    int different = 0;
+    for (size_t i = 0; i < result.chunks.size(); i++) {
+        different += result.chunks[i].digest != changed.chunks[i].digest ? 1 : 0;
+    }
+    EXPECT_EQ(different, 1);
+    EXPECT_NE(result.root, changed.root);
+}
+
+TEST(FileHasherTest, HashFileMatchesBuffer) {
+    thread_pool pool(3);
+    file_hasher_options options;
+    options.chunk_size = 100000;
+    file_hasher hasher(pool, options);
+
+    std::vector<uint8_t> data = test_input(777777);
+    const std::string path = temp_path("hash_file");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    }
+
+    file_hash_result from_file = hasher.hash_file(path);
+    file_hash_result from_buffer = hasher.hash_buffer(data.data(), data.size());
+    EXPECT_EQ(from_file.size, data.size());
+    EXPECT_EQ(from_file.root, from_buffer.root);
+    ASSERT_EQ(from_file.chunks.size(), from_buffer.chunks.size());
+
+    // 自定义分块：分块必须连续覆盖整个文件
+    std::vector<chunk_span> spans = {{0, 1}, {1, 500000}, {500001, 277776}};
+    file_hash_result custom = hasher.hash_file(path, spans);
+    EXPECT_EQ(custom.chunks[1].digest, blake3_hasher::hash(data.data() + 1, 500000));
+    std::vector<chunk_span> gap = {{0, 1}, {2, 777775}};
+    EXPECT_THROW(hasher.hash_file(path, gap), std::invalid_argument);
+    // 只覆盖前缀的分块（例如文件变长之前的旧分块）不能当作整个文件的哈希
+    std::vector<chunk_span> prefix = {{0, 1}, {1, 500000}};
+    EXPECT_THROW(hasher.hash_file(path, prefix), std::invalid_argument);
+
+    // 空文件
+    const std::string empty = temp_path("empty");
+    { std::ofstream out(empty, std::ios::binary); }
+    file_hash_result empty_result = hasher.hash_file(empty);
+    EXPECT_TRUE(empty_result.chunks.empty());
+    EXPECT_EQ(to_hex(empty_result.root), official_vectors[0].hex);
+
+    std::remove(path.c_str());
+    std::remove(empty.c_str());
+    EXPECT_THROW(hasher.hash_file(path), std::system_error);
+}
+
+// 小文件一次读入，大文件按窗口映射；跨越窗口的读取、视图比读取器活得久都要得到正确内容
+TEST(FileReaderTest, WindowsAndSmallFiles) {
+    std::vector<uint8_t> data = test_input(300000);
+    const std::string path = temp_path("file_reader");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    }
+
+    {
+        file_reader small(path);
+        EXPECT_FALSE(small.mapped());
+        EXPECT_EQ(small.size(), data.size());
+        file_view view = small.read(1000, 5000);
+        ASSERT_EQ(view.size(), 5000u);
+        EXPECT_EQ(std::memcmp(view.data(), data.data() + 1000, 5000), 0);
+        // 同一份内容，不再重新读取
+        EXPECT_EQ(small.read(0, 10).data() + 1000, view.data());
+    }
+
+    file_reader_options options;
+    options.mmap_threshold = 0;
+    options.window_size = 65536;
+    std::vector<file_view> views;
+    {
+        file_reader reader(path, options);
+        EXPECT_TRUE(reader.mapped());
+        const std::vector<std::pair<uint64_t, size_t>> ranges = {
+            {0, 65536}, {65536, 1}, {65000, 2000}, {4097, 250000}, {299999, 1}, {0, 300000}, {123, 0}};
+        for (const auto& range : ranges) {
+            file_view view = reader.read(range.first, range.second);
+            ASSERT_EQ(view.size(), range.second);
+            if (range.second > 0) {
+                EXPECT_EQ(std::memcmp(view.data(), data.data() + range.first, range.second), 0) << range.first;
+            }
+            views.push_back(view);
+        }
+        // 同一窗口内的读取共用映射
+        EXPECT_EQ(reader.read(65536 + 10, 10).data(), views[1].data() + 10);
+        EXPECT_THROW(reader.read(299999, 2), std::runtime_error);
+        EXPECT_THROW(reader.read(300001, 0), std::runtime_error);
+    }
+    EXPECT_EQ(std::memcmp(views[3].data(), data.data() + 4097, 250000), 0);
+    views.clear();
+
+    // 打开之后文件变短：映射新窗口之前发现并报错，而不是访问时收到 SIGBUS
+    {
+        file_reader reader(path, options);
+        EXPECT_EQ(reader.read(0, 100).size(), 100u);
+        ASSERT_EQ(::truncate(path.c_str(), 100000), 0);
+        EXPECT_THROW(reader.read(200000, 100), std::runtime_error);
+    }
+    std::remove(path.c_str());
+    EXPECT_THROW(file_reader reader(path), std::system_error);
+}
+
+// 哈希时强制走映射路径，分块跨越映射窗口，结果与内存中的数据一致
+TEST(FileHasherTest, MappedHashMatchesBuffer) {
+    thread_pool pool(3);
+    file_hasher_options options;
+    options.chunk_size = 50000;
+    options.reader.mmap_threshold = 0;
+    options.reader.window_size = 128 * 1024;
+    file_hasher hasher(pool, options);
+
+    std::vector<uint8_t> data = test_input(1000003);
+    const std::string path = temp_path("hash_mapped");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    }
+    EXPECT_EQ(hasher.hash_file(path).root, hasher.hash_buffer(data.data(), data.size()).root);
+
+    options.chunking = chunking_mode::content_defined;
+    file_hasher cdc(pool, options);
+    const file_hash_result mapped = cdc.hash_file(path);
+    const file_hash_result buffered = cdc.hash_buffer(data.data(), data.size());
+    EXPECT_EQ(mapped.root, buffered.root);
+    EXPECT_EQ(mapped.chunks.size(), buffered.chunks.size());
+    std::remove(path.c_str());
+}
+
+// 容量固定：用完后申请失败，归还后可以再次申请；配额限制单个使用者的占用
+TEST(BufferPoolTest, FixedCapacityAndQuota) {
+    for (uint32_t magazine : {0u, 4u}) {
+        buffer_pool_options options;
+        options.buffer_size = 1000;
+        options.buffers = 8;
+        options.magazine_size = magazine;
+        buffer_pool pool(options);
+        EXPECT_EQ(pool.capacity(), 8u);
+        EXPECT_GE(pool.stats().reserved_bytes, 8u * 1000);
+
+        std::vector<pooled_buffer> held;
+        std::set<uint32_t> indices;
+        for (int i = 0; i < 8; i++) {
+            pooled_buffer b = pool.try_acquire();
+            ASSERT_TRUE(b);
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(b.data()) % 64, 0u);
+            std::memset(b.data(), i, 1000);
+            indices.insert(b.index());
+            held.push_back(std::move(b));
+        }
+        EXPECT_EQ(indices.size(), 8u);
+        EXPECT_FALSE(pool.try_acquire());
+        EXPECT_EQ(pool.stats().exhausted, 1u);
+        for (int i = 0; i < 8; i++) {
+            EXPECT_EQ(held[i].data()[999], i);
+        }
+
+        held.pop_back();
+        pooled_buffer again = pool.try_acquire();
+        EXPECT_TRUE(again);
+        again.reset();
+        EXPECT_FALSE(again);
+        held.clear();
+
+        buffer_quota quota(3);
+        std::vector<pooled_buffer> limited;
+        for (int i = 0; i < 3; i++) {
+            limited.push_back(pool.try_acquire(quota));
+            EXPECT_TRUE(limited.back());
+        }
+        EXPECT_EQ(quota.used(), 3u);
+        EXPECT_FALSE(pool.try_acquire(quota));
+        EXPECT_TRUE(pool.try_acquire());
+        // 移动后由新的句柄负责归还和配额
+        pooled_buffer moved = std::move(limited[0]);
+        limited.clear();
+        EXPECT_EQ(quota.used(), 1u);
+        moved.reset();
+        EXPECT_EQ(quota.used(), 0u);
+    }
+    buffer_pool_options invalid;
+    invalid.buffers = 0;
+    EXPECT_THROW(buffer_pool pool(invalid), std::invalid_argument);
+}
+
+// 一个线程申请、经过 ring_buffer 交给其他线程归还；线程退出后缓存的缓冲区回到全局列表
+TEST(BufferPoolTest, CrossThreadReturnThroughRingBuffer) {
+    buffer_pool_options options;
+    options.buffer_size = 256;
+    options.buffers = 64;
+    options.magazine_size = 8;
+    buffer_pool pool(options);
+    ring_buffer<pooled_buffer, dynamic_capacity> handoff(16);
+
+    const size_t total = 20000;
+    std::atomic<size_t> consumed{0};
+    std::atomic<bool> corrupted{false};
+    std::thread producer([&] {
+        for (size_t i = 0; i < total;) {
+            pooled_buffer b = pool.try_acquire();
+            if (!b) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::memset(b.data(), static_cast<int>(i & 0xff), 256);
+            while (!handoff.emplace(std::move(b))) {
+                std::this_thread::yield();
+            }
+            ++i;
+        }
+    });
+    std::vector<std::thread> consumers;
+    for (int t = 0; t < 3; t++) {
+        consumers.emplace_back([&] {
+            pooled_buffer b;
+            while (consumed.load() < total) {
+                if (!handoff.get(b)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (b.data()[0] != b.data()[255]) {
+                    corrupted = true;
+                }
+                b.reset();
+                consumed.fetch_add(1);
+            }
+        });
+    }
+    producer.join();
+    for (auto& t : consumers) {
+        t.join();
+    }
+    EXPECT_FALSE(corrupted);
+
+    // 所有线程都已退出，它们缓存的缓冲区都已归还，本线程可以再次申请全部缓冲区
+    std::vector<pooled_buffer> all;
+    for (uint32_t i = 0; i < options.buffers; i++) {
+        all.push_back(pool.try_acquire());
+        ASSERT_TRUE(all.back()) << i;
+    }
+    EXPECT_FALSE(pool.try_acquire());
+}
+
+namespace {
+
+// 类似源代码和日志的可压缩文本
+std::vector<uint8_t> text_chunk(size_t size, uint32_t seed) {
+    static const char* words[] = {"int ", "return ", "const ", "size_t ", "buffer", "->", "(", ");\n", "    ",
+                                  "if ", "for ", "offset", " = ", "0", "1", "chunk", "// ", "error"};
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data;
+    while (data.size() < size) {
+        const char* w = words[rng() % (sizeof(words) / sizeof(words[0]))];
+        data.insert(data.end(), w, w + std::strlen(w));
+    }
+    data.resize(size);
+    return data;
+}
+
+// 类似已经压缩过的媒体文件
+std::vector<uint8_t> random_chunk(size_t size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(size);
+    for (auto& b : data) {
+        b = static_cast<uint8_t>(rng());
+    }
+    return data;
+}
+
+std::vector<compression_codec> available_codecs() {
+    std::vector<compression_codec> codecs;
+    for (compression_codec c : {compression_codec::lz4, compression_codec::zstd, compression_codec::deflate}) {
+        if (codec_available(c)) {
+            codecs.push_back(c);
+        }
+    }
+    return codecs;
+}
+
+}  // namespace
+
+TEST(CompressionTest, EntropyEstimate) {
+    std::vector<uint8_t> zeros(100000, 0);
+    EXPECT_EQ(sample_entropy(zeros.data(), zeros.size(), 4096), 0);
+    const auto random = random_chunk(100000, 1);
+    EXPECT_GT(sample_entropy(random.data(), random.size(), 4096), 7.5);
+    EXPECT_GT(sample_entropy(random.data(), random.size(), 1u << 20), 7.9);
+    const auto text = text_chunk(100000, 2);
+    EXPECT_LT(sample_entropy(text.data(), text.size(), 4096), 6.0);
+    EXPECT_EQ(sample_entropy(nullptr, 0, 4096), 0);
+}
+
+TEST(CompressionTest, RoundTripAllCodecs) {
+    thread_pool pool(2);
+    if (available_codecs().empty()) {
+        GTEST_SKIP() << "no compression library";
+    }
+    for (compression_codec codec : available_codecs()) {
+        for (int level : {0, 1, 5}) {
+            compression_options options;
+            options.codec = codec;
+            options.level = level;
+            compression_stage stage(pool, options);
+            const auto text = text_chunk(300000, level);
+            compressed_chunk c = stage.compress(file_view(text.data(), text.size()));
+            EXPECT_EQ(c.codec, codec) << codec_name(codec);
+            EXPECT_EQ(c.original_size, text.size());
+            EXPECT_LT(c.size() * 3, text.size()) << codec_name(codec) << " level " << level;
+
+            file_view back = stage.decompress(c.codec, file_view(c.bytes(), c.size()), c.original_size);
+            ASSERT_EQ(back.size(), text.size());
+            EXPECT_EQ(std::memcmp(back.data(), text.data(), text.size()), 0);
+
+            // 截断或改写的数据不能悄悄解出错误的内容
+            EXPECT_THROW(stage.decompress(c.codec, file_view(c.bytes(), c.size() / 2), c.original_size),
+                         std::runtime_error);
+            EXPECT_THROW(stage.decompress(c.codec, file_view(c.bytes(), c.size()), c.original_size + 1),
+                         std::runtime_error);
+        }
+    }
+}
+
+// 不值得压缩的分块原样放行：太小、熵太高，或者前面的分块刚刚压缩失败
+TEST(CompressionTest, SkipHeuristics) {
+    thread_pool pool(2);
+    if (available_codecs().empty()) {
+        GTEST_SKIP() << "no compression library";
+    }
+    compression_options options;
+    options.codec = available_codecs().front();
+    compression_stage stage(pool, options);
+
+    const auto small = text_chunk(100, 3);
+    compressed_chunk c = stage.compress(file_view(small.data(), small.size()));
+    EXPECT_EQ(c.codec, compression_codec::none);
+    EXPECT_EQ(c.bytes(), small.data());
+
+    const auto media = random_chunk(200000, 4);
+    c = stage.compress(file_view(media.data(), media.size()));
+    EXPECT_EQ(c.codec, compression_codec::none);
+    EXPECT_EQ(c.bytes(), media.data());
+    EXPECT_EQ(stage.stats().skipped_small, 1u);
+    EXPECT_EQ(stage.stats().skipped_entropy, 1u);
+
+    // 关掉熵检查：随机数据真的去压缩，失败后退避 1、2、4 个分块
+    options.max_entropy = 8;
+    options.max_backoff = 4;
+    compression_stage probing(pool, options);
+    const auto text = text_chunk(200000, 5);
+    std::vector<compression_codec> used;
+    for (int i = 0; i < 12; i++) {
+        const auto& input = i < 10 ? media : text;
+        used.push_back(probing.compress(file_view(input.data(), input.size())).codec);
+    }
+    const compression_stats stats = probing.stats();
+    // 尝试：0、2、5、10（退避 1、2、4，之后保持 4），第 10 个文本分块压缩成功后退避清零
+    EXPECT_EQ(stats.incompressible, 3u);
+    EXPECT_EQ(stats.skipped_backoff, 7u);
+    EXPECT_EQ(used[10], options.codec);
+    EXPECT_EQ(used[11], options.codec);
+    EXPECT_EQ(stats.compressed, 2u);
+    EXPECT_EQ(stats.chunks, 12u);
+    EXPECT_EQ(stats.bytes_in, 10 * media.size() + 2 * text.size());
+    EXPECT_LT(stats.bytes_out, stats.bytes_in);
+}
+
+// 一个文件的分块在线程池上并行压缩、并行解压，按提交顺序取结果
+TEST(CompressionTest, ParallelStreamRoundTrip) {
+    thread_pool pool(3);
+    if (available_codecs().empty()) {
+        GTEST_SKIP() << "no compression library";
+    }
+    compression_options options;
+    options.codec = available_codecs().front();
+    compression_stage sender(pool, options);
+    compression_stage receiver(pool, options);
+
+    std::vector<std::vector<uint8_t>> chunks;
+    for (uint32_t i = 0; i < 48; i++) {
+        chunks.push_back(i % 3 == 0 ? random_chunk(65536, i) : text_chunk(65536 + i, i));
+    }
+    std::vector<std::future<compressed_chunk>> compressed;
+    for (const auto& chunk : chunks) {
+        compressed.push_back(sender.compress_async(file_view(chunk.data(), chunk.size())));
+    }
+    std::vector<compressed_chunk> results;
+    for (auto& f : compressed) {
+        results.push_back(f.get());
+    }
+    std::vector<std::future<file_view>> restored;
+    for (const auto& c : results) {
+        restored.push_back(receiver.decompress_async(c.codec, file_view(c.bytes(), c.size()), c.original_size));
+    }
+    for (size_t i = 0; i < chunks.size(); i++) {
+        file_view view = restored[i].get();
+        ASSERT_EQ(view.size(), chunks[i].size()) << i;
+        EXPECT_EQ(std::memcmp(view.data(), chunks[i].data(), view.size()), 0) << i;
+        EXPECT_EQ(results[i].codec == compression_codec::none, i % 3 == 0) << i;
+    }
+    EXPECT_EQ(sender.stats().skipped_entropy, 16u);
+}
+
+TEST(CompressionTest, UnavailableCodecThrows) {
+    thread_pool pool(1);
+    for (compression_codec c : {compression_codec::lz4, compression_codec::zstd, compression_codec::deflate}) {
+        compression_options options;
+        options.codec = c;
+        if (!codec_available(c)) {
+            EXPECT_THROW(compression_stage(pool, options), std::invalid_argument) << codec_name(c);
+        }
+    }
+    compression_options options;
+    options.codec = compression_codec::none;
+    options.min_saving = 1;
+    EXPECT_THROW(compression_stage(pool, options), std::invalid_argument);
+    options.min_saving = 0.1;
+    compression_stage stage(pool, options);
+    const auto text = text_chunk(10000, 6);
+    EXPECT_EQ(stage.compress(file_view(text.data(), text.size())).codec, compression_codec::none);
+}
+
+// 在工作线程内部哈希（例如每个文件一个任务），等待分块任务时不会占死线程
+TEST(FileHasherTest, HashFromInsideWorker) {
+    thread_pool pool(2);
+    file_hasher_options options;
+    options.chunk_size = 4096;
+    file_hasher hasher(pool, options);
+    std::vector<uint8_t> data = test_input(200000);
+
+    std::vector<std::future<hash_digest>> roots;
+    for (int i = 0; i < 8; i++) {
+        roots.push_back(pool.submit_to(task_lane::hash, [&] { return hasher.hash_buffer(data.data(), data.size()).root; }));
+    }
+    const hash_digest expected = hasher.hash_buffer(data.data(), data.size()).root;
+    for (auto& root : roots) {
+        EXPECT_EQ(root.get(), expected);
+    }
+}
+
+namespace {
+
+std::vector<uint8_t> random_bytes(size_t size, uint32_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<uint8_t> data(size);
+    for (auto& byte : data) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    return data;
+}
+
+std::set<std::string> digest_set(const file_hash_result& result) {
+    std::set<std::string> digests;
+    for (const auto& chunk : result.chunks) {
+        digests.insert(to_hex(chunk.digest));
+    }
+    return digests;
+}
+
+}  // namespace
+
+TEST(FastCdcTest, ChunkSizesWithinBounds) {
+    fastcdc_options options;
+    options.min_size = 2048;
+    options.avg_size = 8192;
+    options.max_size = 32768;
+    fastcdc_chunker chunker(options);
+
+    std::vector<uint8_t> data = random_bytes(4 << 20, 1);
+    std::vector<chunk_span> spans = chunker.split(data.data(), data.size());
+    uint64_t offset = 0;
+    for (size_t i = 0; i < spans.size(); i++) {
+        EXPECT_EQ(spans[i].offset, offset);
+        EXPECT_LE(spans[i].length, options.max_size);
+        if (i + 1 < spans.size()) {
+            EXPECT_GE(spans[i].length, options.min_size);
+        }
+        offset += spans[i].length;
+    }
+    EXPECT_EQ(offset, data.size());
+
+    // 归一化分块让平均大小接近配置值
+    const double average = static_cast<double>(data.size()) / spans.size();
+    EXPECT_GT(average, options.avg_size * 0.6);
+    EXPECT_LT(average, options.avg_size * 1.6);
+
+    // 全零数据没有内容边界，按最大长度切分
+    std::vector<uint8_t> zeros(100000, 0);
+    std::vector<chunk_span> zero_spans = chunker.split(zeros.data(), zeros.size());
+    ASSERT_EQ(zero_spans.size(), 4u);
+    EXPECT_EQ(zero_spans[0].length, options.max_size);
+
+    EXPECT_THROW(fastcdc_chunker(fastcdc_options{4096, 1024, 8192}), std::invalid_argument);
+    EXPECT_TRUE(chunker.split(data.data(), 0).empty());
+}
+
+// 在中间插入字节后，除插入点附近外的分块都保持不变
+TEST(FastCdcTest, BoundariesStableUnderInsertion) {
+    thread_pool pool(2);
+    file_hasher_options options;
+    options.chunking = chunking_mode::content_defined;
+    options.cdc = fastcdc_options{2048, 8192, 32768};
+    file_hasher hasher(pool, options);
+
+    std::vector<uint8_t> original = random_bytes(2 << 20, 2);
+    std::vector<uint8_t> edited = original;
+    std::vector<uint8_t> inserted = random_bytes(100, 3);
+    edited.insert(edited.begin() + 1000000, inserted.begin(), inserted.end());
+
+    file_hash_result before = hasher.hash_buffer(original.data(), original.size());
+    file_hash_result after = hasher.hash_buffer(edited.data(), edited.size());
+    std::set<std::string> old_digests = digest_set(before);
+    size_t changed = 0;
+    for (const auto& chunk : after.chunks) {
+        changed += old_digests.count(to_hex(chunk.digest)) ? 0 : 1;
+    }
+    EXPECT_LE(changed, 3u);
+    EXPECT_GT(after.chunks.size(), 100u);
+
+    // 固定分块在插入点之后全部错位
+    file_hasher_options small_fixed;
+    small_fixed.chunk_size = 8192;
+    file_hasher fixed_small(pool, small_fixed);
+    std::set<std::string> fixed_old = digest_set(fixed_small.hash_buffer(original.data(), original.size()));
+    size_t fixed_changed = 0;
+    for (const auto& chunk : fixed_small.hash_buffer(edited.data(), edited.size()).chunks) {
+        fixed_changed += fixed_old.count(to_hex(chunk.digest)) ? 0 : 1;
+    }
+    EXPECT_GT(fixed_changed, 100u);
+}
+
+// 按文件窗口切分与一次性切分结果相同
+TEST(FastCdcTest, SplitFileMatchesBuffer) {
+    fastcdc_chunker chunker(fastcdc_options{4096, 16384, 65536});
+    std::vector<uint8_t> data = random_bytes((9 << 20) + 12345, 4);
+    const std::string path = temp_path("cdc");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    }
+    std::vector<chunk_span> from_file = chunker.split_file(path);
+    std::vector<chunk_span> from_buffer = chunker.split(data.data(), data.size());
+    ASSERT_EQ(from_file.size(), from_buffer.size());
+    for (size_t i = 0; i < from_file.size(); i++) {
+        EXPECT_EQ(from_file[i].offset, from_buffer[i].offset);
+        EXPECT_EQ(from_file[i].length, from_buffer[i].length);
+    }
+
+    thread_pool pool(2);
+    file_hasher_options options;
+    options.chunking = chunking_mode::content_defined;
+    options.cdc = chunker.options();
+    file_hasher hasher(pool, options);
+    EXPECT_EQ(hasher.hash_file(path).root, hasher.hash_buffer(data.data(), data.size()).root);
+    std::remove(path.c_str());
+}
+
+TEST(DeltaTest, ChunkListRoundTrip) {
+    thread_pool pool(2);
+    file_hasher_options options;
+    options.chunking = chunking_mode::content_defined;
+    options.cdc = fastcdc_options{1024, 4096, 16384};
+    file_hasher hasher(pool, options);
+    std::vector<uint8_t> data = random_bytes(300000, 5);
+    file_hash_result result = hasher.hash_buffer(data.data(), data.size());
+
+    std::vector<uint8_t> encoded = encode_chunk_list(result.chunks);
+    std::vector<chunk_hash> decoded = decode_chunk_list(encoded.data(), encoded.size());
+    ASSERT_EQ(decoded.size(), result.chunks.size());
+    for (size_t i = 0; i < decoded.size(); i++) {
+        EXPECT_EQ(decoded[i].offset, result.chunks[i].offset);
+        EXPECT_EQ(decoded[i].length, result.chunks[i].length);
+        EXPECT_EQ(decoded[i].digest, result.chunks[i].digest);
+    }
+
+    EXPECT_THROW(decode_chunk_list(encoded.data(), encoded.size() - 1), std::runtime_error);
+    encoded[0] ^= 1;
+    EXPECT_THROW(decode_chunk_list(encoded.data(), encoded.size()), std::runtime_error);
+}
+
+// 发送方只发送接收方缺失的分块，接收方重建出与新文件完全相同的数据
+TEST(DeltaTest, EndToEndTransfersOnlyMissingChunks) {
+    thread_pool pool(4);
+    file_hasher_options options;
+    options.chunking = chunking_mode::content_defined;
+    options.cdc = fastcdc_options{2048, 8192, 32768};
+    file_hasher hasher(pool, options);
+
+    std::vector<uint8_t> basis = random_bytes(4 << 20, 6);
+    std::vector<uint8_t> target = basis;
+    // 一处插入、一处覆盖、一处删除
+    std::vector<uint8_t> patch = random_bytes(5000, 7);
+    target.insert(target.begin() + 100000, patch.begin(), patch.end());
+    std::copy(patch.begin(), patch.begin() + 3000, target.begin() + 2000000);
+    target.erase(target.begin() + 3000000, target.begin() + 3010000);
+
+    // 1. 接收方发送基准的分块列表
+    std::vector<uint8_t> list_message = encode_chunk_list(hasher.hash_buffer(basis.data(), basis.size()).chunks);
+
+    // 2. 发送方生成并编码计划，随后附上 literal 数据
+    file_hash_result target_hash = hasher.hash_buffer(target.data(), target.size());
+    delta_plan plan = make_delta_plan(target_hash, decode_chunk_list(list_message.data(), list_message.size()));
+    std::vector<uint8_t> plan_message = encode_delta_plan(plan);
+    std::vector<uint8_t> literal_stream;
+    for (const auto& op : plan.ops) {
+        if (op.literal) {
+            literal_stream.insert(literal_stream.end(), target.begin() + static_cast<std::ptrdiff_t>(op.target_offset),
+                                  target.begin() + static_cast<std::ptrdiff_t>(op.target_offset + op.length));
+        }
+    }
+    EXPECT_EQ(literal_stream.size(), plan.literal_bytes());
+    EXPECT_LT(plan.literal_bytes(), 200000u);
+    EXPECT_EQ(plan.copied_bytes() + plan.literal_bytes(), target.size());
+
+    // 3. 接收方按计划重建
+    delta_plan received = decode_delta_plan(plan_message.data(), plan_message.size());
+    std::vector<uint8_t> rebuilt;
+    size_t literal_pos = 0;
+    apply_delta(
+        received,
+        [&](uint64_t offset, uint8_t* out, uint32_t length) { std::memcpy(out, basis.data() + offset, length); },
+        [&](uint8_t* out, uint32_t length) {
+            std::memcpy(out, literal_stream.data() + literal_pos, length);
+            literal_pos += length;
+        },
+        [&](const uint8_t* data, uint32_t length) { rebuilt.insert(rebuilt.end(), data, data + length); });
+    EXPECT_EQ(literal_pos, literal_stream.size());
+    EXPECT_TRUE(rebuilt == target);
+
+    // 基准文件在计划生成后被修改：校验失败
+    basis[plan.ops[0].basis_offset] ^= 1;
+    literal_pos = 0;
+    auto apply_again = [&] {
+        apply_delta(
+            received,
+            [&](uint64_t offset, uint8_t* out, uint32_t length) { std::memcpy(out, basis.data() + offset, length); },
+            [&](uint8_t* out, uint32_t length) {
+                std::memcpy(out, literal_stream.data() + literal_pos, length);
+                literal_pos += length;
+            },
+            [](const uint8_t*, uint32_t) {});
+    };
+    if (plan.ops[0].literal) {
+        literal_stream[0] ^= 1;
+    }
+    EXPECT_THROW(apply_again(), std::runtime_error);
+
+    EXPECT_THROW(decode_delta_plan(plan_message.data(), plan_message.size() - 3), std::runtime_error);
+}
+
+namespace {
+
+file_hash_result fake_hash(uint64_t seed, size_t chunks) {
+    file_hash_result result;
+    uint64_t offset = 0;
+    for (size_t i = 0; i < chunks; i++) {
+        chunk_hash chunk;
+        chunk.offset = offset;
+        chunk.length = static_cast<uint32_t>(1000 + i);
+        const uint64_t value = seed * 1000 + i;
+        chunk.digest = blake3_hasher::hash(&value, sizeof(value));
+        offset += chunk.length;
+        result.chunks.push_back(chunk);
+    }
+    result.size = offset;
+    result.root = combine_chunk_hashes(result.chunks);
+    return result;
+}
+
+file_identity fake_identity(uint64_t inode, const file_hash_result& hash) {
+    file_identity id;
+    id.device = 7;
+    id.inode = inode;
+    id.mtime_ns = static_cast<int64_t>(inode) * 1000;
+    id.size = hash.size;
+    return id;
+}
+
+void expect_same_hash(const file_hash_result& a, const file_hash_result& b) {
+    EXPECT_EQ(a.size, b.size);
+    EXPECT_EQ(a.root, b.root);
+    ASSERT_EQ(a.chunks.size(), b.chunks.size());
+    for (size_t i = 0; i < a.chunks.size(); i++) {
+        EXPECT_EQ(a.chunks[i].offset, b.chunks[i].offset);
+        EXPECT_EQ(a.chunks[i].length, b.chunks[i].length);
+        EXPECT_EQ(a.chunks[i].digest, b.chunks[i].digest);
+    }
+}
+
+}  // namespace
+
+TEST(HashIndexTest, PutLookupAndIdentityMismatch) {
+    const std::string path = temp_path("index_basic");
+    std::remove(path.c_str());
+    hash_index index(path);
+
+    file_hash_result hash = fake_hash(1, 5);
+    file_identity id = fake_identity(42, hash);
+    index.put(id, hash);
+    EXPECT_EQ(index.size(), 1u);
+
+    file_hash_result found;
+    ASSERT_TRUE(index.lookup(id, found));
+    expect_same_hash(found, hash);
+
+    // mtime 或大小变化时视为文件已修改
+    file_identity touched = id;
+    touched.mtime_ns += 1;
+    EXPECT_FALSE(index.lookup(touched, found));
+    file_identity resized = id;
+    resized.size += 1;
+    EXPECT_FALSE(index.lookup(resized, found));
+
+    index.remove(id.device, id.inode);
+    EXPECT_FALSE(index.lookup(id, found));
+    EXPECT_EQ(index.size(), 0u);
+
+    // 空文件也能记录
+    file_hash_result empty = fake_hash(2, 0);
+    index.put(fake_identity(43, empty), empty);
+    ASSERT_TRUE(index.lookup(fake_identity(43, empty), found));
+    EXPECT_TRUE(found.chunks.empty());
+
+    struct stat st;
+    ASSERT_EQ(::stat(path.c_str(), &st), 0);
+    file_identity from_stat = file_identity::from_stat(st);
+    EXPECT_EQ(from_stat.inode, static_cast<uint64_t>(st.st_ino));
+    EXPECT_EQ(from_stat.size, static_cast<uint64_t>(st.st_size));
+    std::remove(path.c_str());
+}
+
+TEST(HashIndexTest, PersistsAcrossReopenAndCompact) {
+    const std::string path = temp_path("index_persist");
+    std::remove(path.c_str());
+    const size_t count = 3000;  // 超过开放寻址表的初始容量
+    {
+        hash_index index(path);
+        for (size_t i = 0; i < count; i++) {
+            file_hash_result hash = fake_hash(i, i % 4);
+            index.put(fake_identity(i, hash), hash);
+        }
+        // 覆盖和删除
+        file_hash_result updated = fake_hash(100000, 3);
+        index.put(fake_identity(5, updated), updated);
+        index.remove(7, 6);
+        index.flush();
+    }
+    auto verify = [&](hash_index& index) {
+        EXPECT_EQ(index.size(), count - 1);
+        file_hash_result found;
+        for (size_t i = 0; i < count; i += 37) {
+            if (i == 5 || i == 6) {
+                continue;
+            }
+            file_hash_result hash = fake_hash(i, i % 4);
+            ASSERT_TRUE(index.lookup(fake_identity(i, hash), found)) << i;
+            expect_same_hash(found, hash);
+        }
+        file_hash_result updated = fake_hash(100000, 3);
+        ASSERT_TRUE(index.lookup(fake_identity(5, updated), found));
+        expect_same_hash(found, updated);
+        EXPECT_FALSE(index.lookup(fake_identity(6, fake_hash(6, 2)), found));
+    };
+    {
+        hash_index index(path);
+        verify(index);
+        EXPECT_GT(index.log_bytes(), 0u);
+        index.compact();
+        EXPECT_EQ(index.log_bytes(), 0u);
+        verify(index);
+
+        // 合并后继续追加
+        file_hash_result added = fake_hash(200000, 2);
+        index.put(fake_identity(count, added), added);
+        index.remove(7, 8);
+    }
+    {
+        hash_index index(path);
+        EXPECT_EQ(index.size(), count - 1);
+        file_hash_result found;
+        file_hash_result added = fake_hash(200000, 2);
+        ASSERT_TRUE(index.lookup(fake_identity(count, added), found));
+        expect_same_hash(found, added);
+        EXPECT_FALSE(index.lookup(fake_identity(8, fake_hash(8, 0)), found));
+    }
+    std::remove(path.c_str());
+}
+
+TEST(HashIndexTest, RecoversFromTornTailAndCorruption) {
+    const std::string path = temp_path("index_torn");
+    std::remove(path.c_str());
+    file_hash_result first = fake_hash(1, 3);
+    file_hash_result second = fake_hash(2, 3);
+    uint64_t first_end;
+    {
+        hash_index index(path);
+        index.put(fake_identity(1, first), first);
+        first_end = index.log_bytes();
+        index.put(fake_identity(2, second), second);
+    }
+
+    // 模拟崩溃：最后一条记录只写了一半
+    struct stat st;
+    ASSERT_EQ(::stat(path.c_str(), &st), 0);
+    ASSERT_EQ(::truncate(path.c_str(), st.st_size - 10), 0);
+    {
+        hash_index index(path);
+        EXPECT_EQ(index.size(), 1u);
+        EXPECT_EQ(index.log_bytes(), first_end);
+        file_hash_result found;
+        EXPECT_TRUE(index.lookup(fake_identity(1, first), found));
+        EXPECT_FALSE(index.lookup(fake_identity(2, second), found));
+
+        // 截掉坏尾部之后追加的记录可以正常读回
+        index.put(fake_identity(2, second), second);
+    }
+    {
+        hash_index index(path);
+        EXPECT_EQ(index.size(), 2u);
+    }
+
+    // 基础段损坏：丢弃内容重新开始
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(0);
+        file.write("XXXX", 4);
+    }
+    {
+        hash_index index(path);
+        EXPECT_EQ(index.size(), 0u);
+        file_hash_result found;
+        EXPECT_FALSE(index.lookup(fake_identity(1, first), found));
+    }
+    std::remove(path.c_str());
+    EXPECT_THROW(hash_index("/nonexistent_dir/index"), std::system_error);
+}
+
+TEST(HashIndexTest, ConcurrentLookupAndPut) {
+    const std::string path = temp_path("index_concurrent");
+    std::remove(path.c_str());
+    hash_index index(path);
+    for (uint64_t i = 0; i < 200; i++) {
+        file_hash_result hash = fake_hash(i, 2);
+        index.put(fake_identity(i, hash), hash);
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&index, t] {
+            file_hash_result found;
+            for (uint64_t i = 0; i < 200; i++) {
+                if (t == 0) {
+                    file_hash_result hash = fake_hash(1000 + i, 2);
+                    index.put(fake_identity(1000 + i, hash), hash);
+                } else {
+                    file_hash_result hash = fake_hash(i, 2);
+                    EXPECT_TRUE(index.lookup(fake_identity(i, hash), found));
+                    EXPECT_EQ(found.root, hash.root);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(index.size(), 400u);
+    std::remove(path.c_str());
+}
+
+namespace {
+
+manifest_entry fake_manifest_entry(const std::string& path, uint64_t seed) {
+    manifest_entry entry;
+    entry.path = path;
+    entry.meta.size = seed * 100;
+    entry.meta.mtime_ns = static_cast<int64_t>(seed) * 1000000007;
+    entry.meta.mode = 0100644;
+    entry.hash = blake3_hasher::hash(&seed, sizeof(seed));
+    return entry;
+}
+
+// 类似源码树的路径：共享很长的目录前缀
+std::vector<manifest_entry> fake_tree(size_t count) {
+    std::vector<manifest_entry> entries;
+    for (size_t i = 0; i < count; i++) {
+        const std::string path = "src/module" + std::to_string(i % 17) + "/sub" + std::to_string(i % 5) + "/file" +
+                                 std::to_string(i) + ".cpp";
+        entries.push_back(fake_manifest_entry(path, i));
+    }
+    sort_manifest_entries(entries);
+    return entries;
+}
+
+manifest manifest_of(const std::vector<manifest_entry>& entries, uint32_t restart_interval = 16) {
+    manifest_builder builder(restart_interval);
+    for (const auto& entry : entries) {
+        builder.add(entry);
+    }
+    auto data = std::make_shared<std::vector<uint8_t>>(builder.finish());
+    return manifest(file_view(data->data(), data->size(), data));
+}
+
+std::vector<std::string> describe_changes(const std::function<void(const manifest_diff::callback&)>& run) {
+    std::vector<std::string> out;
+    run([&](const manifest_change& change) {
+        static const char* kinds[] = {"added", "removed", "modified", "metadata"};
+        out.push_back(std::string(kinds[static_cast<int>(change.type)]) + " " + change.path);
+    });
+    return out;
+}
+
+}  // namespace
+
+TEST(ManifestTest, RoundTripAndLookup) {
+    const std::vector<manifest_entry> entries = fake_tree(1000);
+    const std::string path = temp_path("manifest_basic");
+    {
+        manifest_builder builder;
+        for (const auto& entry : entries) {
+            builder.add(entry);
+        }
+        EXPECT_EQ(builder.size(), entries.size());
+        builder.write(path);
+    }
+    const manifest m = manifest::open(path);
+    ASSERT_EQ(m.size(), entries.size());
+
+    // 顺序遍历和按下标访问都还原出原来的条目
+    size_t path_bytes = 0;
+    size_t i = 0;
+    for (manifest::cursor it(m); it.valid(); it.next(), i++) {
+        EXPECT_EQ(it.path(), entries[i].path);
+        EXPECT_EQ(it.meta(), entries[i].meta);
+        EXPECT_EQ(it.hash(), entries[i].hash);
+        path_bytes += entries[i].path.size();
+    }
+    EXPECT_EQ(i, entries.size());
+    for (size_t index : {size_t(0), size_t(15), size_t(16), size_t(17), size_t(500), entries.size() - 1}) {
+        EXPECT_EQ(m.path(index), entries[index].path);
+        EXPECT_EQ(m.entry(index).meta.size, entries[index].meta.size);
+    }
+
+    // 前缀压缩后路径表远小于原始路径
+    EXPECT_LT(m.data().size(), entries.size() * 56 + 64 + path_bytes / 2);
+
+    for (size_t index = 0; index < entries.size(); index += 7) {
+        EXPECT_EQ(m.find(entries[index].path), index);
+        EXPECT_EQ(m.lower_bound(entries[index].path), index);
+        // 紧挨着的不存在的路径
+        EXPECT_EQ(m.find(entries[index].path + "~"), manifest::npos);
+        EXPECT_EQ(m.lower_bound(entries[index].path + "\x01"), index + 1);
+    }
+    EXPECT_EQ(m.find(""), manifest::npos);
+    EXPECT_EQ(m.lower_bound(""), 0u);
+    EXPECT_EQ(m.lower_bound("zzz"), m.size());
+    EXPECT_EQ(m.find("zzz"), manifest::npos);
+
+    // 空清单
+    const manifest empty = manifest_of({});
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(empty.find("a"), manifest::npos);
+    EXPECT_FALSE(manifest::cursor(empty).valid());
+
+    // 路径必须严格递增
+    manifest_builder builder;
+    builder.add(entries[1]);
+    EXPECT_THROW(builder.add(entries[0]), std::invalid_argument);
+    EXPECT_THROW(builder.add(entries[1]), std::invalid_argument);
+    EXPECT_THROW(manifest_builder(0), std::invalid_argument);
+    EXPECT_THROW(manifest::open("/nonexistent_dir/manifest"), std::system_error);
+    std::remove(path.c_str());
+}
+
+TEST(ManifestTest, DiffReportsEachKind) {
+    std::vector<manifest_entry> local = {fake_manifest_entry("a", 1), fake_manifest_entry("b", 2),
+                                         fake_manifest_entry("c/d", 3), fake_manifest_entry("c/e", 4),
+                                         fake_manifest_entry("f", 5)};
+    std::vector<manifest_entry> remote = local;
+    remote.erase(remote.begin());                                        // a 只在本地
+    remote[0].hash = fake_manifest_entry("b", 9).hash;                   // b 内容不同
+    remote[1].meta.mtime_ns += 1;                                        // c/d 只改了时间
+    remote.insert(remote.begin() + 3, fake_manifest_entry("c/f", 6));   // c/f 只在对端
+    remote.back().meta.size += 1;                                        // f 大小不同
+    remote.push_back(fake_manifest_entry("g", 7));
+
+    const manifest l = manifest_of(local);
+    const manifest r = manifest_of(remote);
+    std::vector<manifest_change> changes;
+    diff_manifests(l, r, [&](const manifest_change& change) { changes.push_back(change); });
+    const std::vector<std::string> expected = {"removed a", "modified b", "metadata c/d", "added c/f",
+                                               "modified f", "added g"};
+    ASSERT_EQ(changes.size(), expected.size());
+    EXPECT_EQ(changes[0].type, manifest_change::kind::removed);
+    EXPECT_EQ(changes[0].local_hash, local[0].hash);
+    EXPECT_EQ(changes[1].remote_hash, remote[0].hash);
+    EXPECT_EQ(changes[1].local_hash, local[1].hash);
+    EXPECT_EQ(changes[2].remote_meta.mtime_ns, local[2].meta.mtime_ns + 1);
+    EXPECT_EQ(changes[3].type, manifest_change::kind::added);
+    EXPECT_EQ(changes[3].local_meta, manifest_meta());
+
+    static const char* kinds[] = {"added", "removed", "modified", "metadata"};
+    for (size_t i = 0; i < changes.size(); i++) {
+        EXPECT_EQ(std::string(kinds[static_cast<int>(changes[i].type)]) + " " + changes[i].path, expected[i]);
+    }
+
+    // 与自己比较没有差异
+    size_t count = 0;
+    diff_manifests(l, l, [&](const manifest_change&) { count++; });
+    EXPECT_EQ(count, 0u);
+}
+
+TEST(ManifestTest, SegmentedDiffMatchesWhole) {
+    const std::vector<manifest_entry> all = fake_tree(2000);
+    std::vector<manifest_entry> local;
+    std::vector<manifest_entry> remote;
+    std::mt19937 rng(5);
+    for (const auto& entry : all) {
+        switch (rng() % 6) {
+        case 0:
+            local.push_back(entry);
+            break;
+        case 1:
+            remote.push_back(entry);
+            break;
+        case 2: {
+            local.push_back(entry);
+            manifest_entry changed = entry;
+            changed.hash[0] ^= 1;
+            remote.push_back(changed);
+            break;
+        }
+        default:
+            local.push_back(entry);
+            remote.push_back(entry);
+        }
+    }
+    const manifest l = manifest_of(local);
+    const manifest r = manifest_of(remote, 8);
+
+    const auto whole = describe_changes([&](const manifest_diff::callback& cb) { diff_manifests(l, r, cb); });
+    EXPECT_GT(whole.size(), all.size() / 3);
+
+    // 对端按任意大小分段发送，每段独立校验和解析
+    std::vector<std::vector<uint8_t>> segments;
+    for (size_t begin = 0; begin < r.size(); begin += 37) {
+        segments.push_back(r.slice(begin, std::min(r.size(), begin + 37)));
+    }
+    const auto segmented = describe_changes([&](const manifest_diff::callback& cb) {
+        manifest_diff diff(l, cb);
+        for (const auto& segment : segments) {
+            diff.add(manifest(file_view(segment.data(), segment.size())));
+        }
+        diff.finish();
+    });
+    EXPECT_EQ(segmented, whole);
+
+    // 重复或倒退的段被拒绝
+    manifest_diff diff(l, [](const manifest_change&) {});
+    diff.add(manifest(file_view(segments[1].data(), segments[1].size())));
+    EXPECT_THROW(diff.add(manifest(file_view(segments[1].data(), segments[1].size()))), std::invalid_argument);
+    EXPECT_THROW(diff.add(manifest(file_view(segments[0].data(), segments[0].size()))), std::invalid_argument);
+    EXPECT_THROW(r.slice(10, r.size() + 1), std::out_of_range);
+}
+
+TEST(ManifestTest, RejectsMalformedData) {
+    std::vector<manifest_entry> entries = fake_tree(100);
+    manifest_builder builder;
+    for (const auto& entry : entries) {
+        builder.add(entry);
+    }
+    const std::vector<uint8_t> good = builder.finish();
+    EXPECT_NO_THROW(manifest(file_view(good.data(), good.size())));
+
+    auto expect_malformed = [](std::vector<uint8_t> data, bool verify) {
+        EXPECT_THROW(
+            {
+                manifest m(file_view(data.data(), data.size()), verify);
+                for (manifest::cursor it(m); it.valid(); it.next()) {
+                }
+                m.find("src/module3");
+            },
+            std::runtime_error);
+    };
+
+    // 截断、魔数错误
+    expect_malformed(std::vector<uint8_t>(good.begin(), good.begin() + 40), false);
+    expect_malformed(std::vector<uint8_t>(good.begin(), good.end() - 1), false);
+    std::vector<uint8_t> bad = good;
+    bad[0] ^= 1;
+    expect_malformed(bad, false);
+
+    // 内容被修改时校验和不符
+    bad = good;
+    bad[good.size() / 2] ^= 0x40;
+    expect_malformed(bad, true);
+
+    // 不校验时，越界的重启点和路径长度在访问时被发现
+    bad = good;
+    const size_t restarts_offset = 64 + entries.size() * 56;
+    bad[restarts_offset + 3 * 8 + 7] = 0x7f;  // 二分查找第一个访问的重启点
+    expect_malformed(bad, false);
+    bad = good;
+    const size_t paths_offset = restarts_offset + 7 * 8;
+    bad[paths_offset + 2 + entries[0].path.size()] = 0x7f;  // 第二条路径的共享前缀长度超过前一条路径
+    expect_malformed(bad, false);
+}
+
+namespace {
+
+// 三层目录，每个叶子目录若干文件
+std::vector<manifest_entry> nested_tree(size_t top, size_t middle, size_t files) {
+    std::vector<manifest_entry> entries;
+    uint64_t seed = 0;
+    for (size_t a = 0; a < top; a++) {
+        for (size_t b = 0; b < middle; b++) {
+            for (size_t c = 0; c < files; c++) {
+                entries.push_back(fake_manifest_entry(
+                    "d" + std::to_string(a) + "/s" + std::to_string(b) + "/f" + std::to_string(c), ++seed));
+            }
+        }
+    }
+    return entries;
+}
+
+void load_entries(directory_tree& tree, const std::vector<manifest_entry>& entries) {
+    for (const auto& entry : entries) {
+        tree.update(entry.path, entry.meta, entry.hash);
+    }
+}
+
+}  // namespace
+
+TEST(DirectoryTreeTest, IncrementalUpdateMatchesRebuild) {
+    std::vector<manifest_entry> entries = nested_tree(8, 8, 20);
+    directory_tree tree(100);
+    load_entries(tree, entries);
+    EXPECT_TRUE(tree.dirty());
+    EXPECT_THROW(tree.root_hash(), std::logic_error);
+    thread_pool pool(3);
+    tree.refresh(pool);
+    EXPECT_EQ(tree.file_count(), entries.size());
+
+    // 顺序计算与并行计算结果相同，与加入顺序无关
+    directory_tree sequential;
+    std::vector<manifest_entry> shuffled = entries;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(3));
+    load_entries(sequential, shuffled);
+    sequential.refresh();
+    EXPECT_EQ(tree.root_hash(), sequential.root_hash());
+    const hash_digest original = tree.root_hash();
+
+    // 修改、删除、新增文件后增量刷新，结果与从头构造的树一致
+    entries[100].hash = fake_manifest_entry("x", 999).hash;
+    tree.update(entries[100].path, entries[100].meta, entries[100].hash);
+    EXPECT_TRUE(tree.remove(entries[200].path));
+    EXPECT_FALSE(tree.remove(entries[200].path));
+    EXPECT_FALSE(tree.remove("d0/missing/f0"));
+    const manifest_entry added = fake_manifest_entry("d9/new/file", 1000);
+    tree.update(added.path, added.meta, added.hash);
+    tree.refresh(pool);
+    EXPECT_NE(tree.root_hash(), original);
+
+    std::vector<manifest_entry> expected = entries;
+    expected.erase(expected.begin() + 200);
+    expected.push_back(added);
+    directory_tree rebuilt;
+    load_entries(rebuilt, expected);
+    rebuilt.refresh();
+    EXPECT_EQ(tree.root_hash(), rebuilt.root_hash());
+    EXPECT_EQ(tree.file_count(), expected.size());
+
+    // 修改时间不参与哈希；mode 参与
+    manifest_entry touched = entries[5];
+    touched.meta.mtime_ns += 1;
+    tree.update(touched.path, touched.meta, touched.hash);
+    tree.refresh();
+    EXPECT_EQ(tree.root_hash(), rebuilt.root_hash());
+    touched.meta.mode = 0100755;
+    tree.update(touched.path, touched.meta, touched.hash);
+    tree.refresh();
+    EXPECT_NE(tree.root_hash(), rebuilt.root_hash());
+
+    // 删除整个目录，文件替换目录
+    const size_t before = tree.file_count();
+    EXPECT_TRUE(tree.remove("d4"));
+    EXPECT_EQ(tree.file_count(), before - 8 * 20);
+    tree.update("d2", entries[0].meta, entries[0].hash);
+    EXPECT_EQ(tree.file_count(), before - 16 * 20 + 1);
+    EXPECT_THROW(tree.update("d2/x", entries[0].meta, entries[0].hash), std::invalid_argument);
+    EXPECT_THROW(tree.update("/", entries[0].meta, entries[0].hash), std::invalid_argument);
+    tree.refresh();
+
+    directory_listing listing;
+    EXPECT_TRUE(tree.listing("", listing));
+    EXPECT_TRUE(tree.listing("d3/s1", listing));
+    ASSERT_EQ(listing.children.size(), 20u);
+    EXPECT_EQ(listing.children[0].name, "f0");
+    EXPECT_EQ(listing.children[1].name, "f1");  // 按名字字节序
+    EXPECT_FALSE(tree.listing("d2", listing));  // 现在是文件
+    EXPECT_FALSE(tree.listing("nope", listing));
+
+    // 从清单构造
+    manifest_builder builder;
+    std::vector<manifest_entry> sorted = expected;
+    sort_manifest_entries(sorted);
+    for (const auto& entry : sorted) {
+        builder.add(entry);
+    }
+    auto data = std::make_shared<std::vector<uint8_t>>(builder.finish());
+    directory_tree from_manifest;
+    from_manifest.load(manifest(file_view(data->data(), data->size(), data)));
+    from_manifest.refresh();
+    EXPECT_EQ(from_manifest.root_hash(), rebuilt.root_hash());
+}
+
+TEST(DirectoryTreeTest, RemoteDiffDescendsOnlyIntoChangedSubtrees) {
+    const std::vector<manifest_entry> entries = nested_tree(10, 10, 50);  // 5000 个文件
+    directory_tree local;
+    directory_tree remote;
+    load_entries(local, entries);
+    load_entries(remote, entries);
+    local.refresh();
+    remote.refresh();
+
+    // 对端的摘要经过编码和解码，模拟网络请求
+    size_t bytes = 0;
+    const directory_listing_fetcher fetch = [&](const std::string& path, directory_listing& out) {
+        directory_listing listing;
+        if (!remote.listing(path, listing)) {
+            return false;
+        }
+        const std::vector<uint8_t> encoded = encode_directory_listing(listing);
+        bytes += encoded.size();
+        out = decode_directory_listing(encoded.data(), encoded.size());
+        return true;
+    };
+    std::vector<directory_difference> diffs;
+    const auto on_difference = [&](const directory_difference& d) { diffs.push_back(d); };
+
+    // 完全相同：只比较根
+    directory_diff_stats stats = diff_directory_trees(local, fetch, on_difference);
+    EXPECT_EQ(stats.listings_fetched, 1u);
+    EXPECT_TRUE(diffs.empty());
+
+    // 改一个文件：每层只请求一个目录
+    manifest_entry changed = entries[1234];
+    changed.hash[0] ^= 1;
+    remote.update(changed.path, changed.meta, changed.hash);
+    remote.update("d3/s3/extra", entries[0].meta, entries[0].hash);
+    remote.remove("d7/s2");
+    remote.remove("d8/s8/f8");
+    remote.update("d8/s8/f8/deeper", entries[0].meta, entries[0].hash);  // 文件变成目录
+    remote.refresh();
+    bytes = 0;
+    stats = diff_directory_trees(local, fetch, on_difference);
+    ASSERT_EQ(diffs.size(), 4u);
+    std::map<std::string, directory_difference> by_path;
+    for (const auto& d : diffs) {
+        by_path[d.path] = d;
+    }
+    EXPECT_EQ(by_path.at(changed.path).type, directory_difference::kind::modified);
+    EXPECT_EQ(by_path.at("d3/s3/extra").type, directory_difference::kind::added);
+    EXPECT_EQ(by_path.at("d7/s2").type, directory_difference::kind::removed);
+    EXPECT_TRUE(by_path.at("d7/s2").directory);
+    EXPECT_EQ(by_path.at("d8/s8/f8").type, directory_difference::kind::modified);
+    // 根、4 个顶层目录和 3 个（d7/s2 已在 d7 的摘要中发现）二级目录
+    EXPECT_EQ(stats.listings_fetched, 1u + 4u + 3u);
+    EXPECT_EQ(stats.subtrees_skipped, 6u + 4u * 9u);
+    EXPECT_LT(bytes, entries.size() * 8);
+
+    // 摘要编码往返和损坏检测
+    directory_listing listing;
+    ASSERT_TRUE(local.listing("d0/s0", listing));
+    std::vector<uint8_t> encoded = encode_directory_listing(listing);
+    const directory_listing decoded = decode_directory_listing(encoded.data(), encoded.size());
+    EXPECT_EQ(decoded.path, "d0/s0");
+    EXPECT_EQ(decoded.hash, listing.hash);
+    ASSERT_EQ(decoded.children.size(), listing.children.size());
+    EXPECT_EQ(decoded.children[3].meta, listing.children[3].meta);
+    EXPECT_THROW(decode_directory_listing(encoded.data(), encoded.size() - 1), std::runtime_error);
+    encoded[0] ^= 1;
+    EXPECT_THROW(decode_directory_listing(encoded.data(), encoded.size()), std::runtime_error);
+}
+
+namespace {
+
+// 取出 timeout 内到达的所有事件，路径 -> 最后一种变化
+std::map<std::string, change_kind> collect_changes(change_watcher& watcher, std::chrono::milliseconds timeout,
+                                                   size_t* total = nullptr) {
+    std::map<std::string, change_kind> changes;
+    change_event event;
+    while (watcher.events().get_wait_for(event, timeout)) {
+        changes[event.path] = event.kind;
+        if (total != nullptr) {
+            ++*total;
+        }
+    }
+    return changes;
+}
+
+void write_file(const std::string& path, const std::string& content) {
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    out << content;
+}
+
+void check_coalesced_changes(watch_backend backend) {
+    const temp_dir dir("watch_basic");
+    const std::string& root = dir.path();
+    ::mkdir((root + "/sub").c_str(), 0755);
+    change_watcher_options options;
+    options.debounce = std::chrono::milliseconds(30);
+    options.backend = backend;
+    change_watcher watcher(root, options);
+
+    // 连续多次写入同一个文件只输出一次
+    const std::string file = watcher.root() + "/sub/a.txt";
+    for (int i = 0; i < 20; i++) {
+        write_file(file, "x");
+    }
+    size_t total = 0;
+    auto changes = collect_changes(watcher, std::chrono::milliseconds(300), &total);
+    ASSERT_EQ(changes.count(file), 1u);
+    EXPECT_EQ(changes[file], change_kind::modified);
+    EXPECT_EQ(total, changes.size());
+
+    // 新建目录及其中的文件、删除文件
+    ::mkdir((watcher.root() + "/new").c_str(), 0755);
+    write_file(watcher.root() + "/new/b.txt", "y");
+    std::remove(file.c_str());
+    changes = collect_changes(watcher, std::chrono::milliseconds(300));
+    EXPECT_EQ(changes[watcher.root() + "/new/b.txt"], change_kind::modified);
+    EXPECT_EQ(changes[file], change_kind::removed);
+
+    // 移入子树的目录：其中已有的文件也要报告
+    const temp_dir outside_dir("watch_outside");
+    const std::string& outside = outside_dir.path();
+    write_file(outside + "/c.txt", "z");
+    ASSERT_EQ(std::rename(outside.c_str(), (watcher.root() + "/moved").c_str()), 0);
+    changes = collect_changes(watcher, std::chrono::milliseconds(300));
+    EXPECT_EQ(changes[watcher.root() + "/moved/c.txt"], change_kind::modified);
+    write_file(watcher.root() + "/moved/c.txt", "w");
+    changes = collect_changes(watcher, std::chrono::milliseconds(300));
+    EXPECT_EQ(changes.count(watcher.root() + "/moved/c.txt"), 1u);
+    EXPECT_EQ(watcher.overflows(), 0u);
+
+    watcher.stop();
+    change_event event;
+    EXPECT_FALSE(watcher.events().get_wait(event));
+}
+
+}  // namespace
+
+TEST(ChangeWatcherTest, CoalescesEventsInotify) {
+    check_coalesced_changes(watch_backend::inotify);
+}
+
+TEST(ChangeWatcherTest, CoalescesEventsFanotify) {
+    try {
+        change_watcher probe("/tmp", [] {
+            change_watcher_options options;
+            options.backend = watch_backend::fanotify;
+            return options;
+        }());
+    } catch (const std::exception&) {
+        GTEST_SKIP() << "fanotify is not available (needs CAP_SYS_ADMIN and Linux 5.9)";
+    }
+    check_coalesced_changes(watch_backend::fanotify);
+}
+
+// 合并表超过上限时丢弃已合并的路径，只输出一条完整扫描事件
+TEST(ChangeWatcherTest, OverflowRequestsRescan) {
+    const temp_dir dir("watch_overflow");
+    const std::string& root = dir.path();
+    change_watcher_options options;
+    options.debounce = std::chrono::milliseconds(200);
+    options.max_pending = 8;
+    options.backend = watch_backend::inotify;
+    change_watcher watcher(root, options);
+    EXPECT_STREQ(watcher.backend_name(), "inotify");
+
+    for (int i = 0; i < 50; i++) {
+        write_file(watcher.root() + "/f" + std::to_string(i), "x");
+    }
+    change_event first;
+    ASSERT_TRUE(watcher.events().get_wait_for(first, std::chrono::seconds(2)));
+    EXPECT_EQ(first.kind, change_kind::rescan);
+    EXPECT_EQ(first.path, watcher.root());
+    EXPECT_GE(watcher.overflows(), 1u);
+
+    // 溢出之后的事件照常输出
+    collect_changes(watcher, std::chrono::milliseconds(400));
+    write_file(watcher.root() + "/after", "x");
+    auto changes = collect_changes(watcher, std::chrono::milliseconds(500));
+    EXPECT_EQ(changes.count(watcher.root() + "/after"), 1u);
+
+    EXPECT_THROW(change_watcher(root + "/missing"), std::system_error);
+}
+
+namespace {
+
+// 在 root 下建立嵌套目录、一个需要拆分批次的大目录、空目录和符号链接
+void fill_scan_tree(const std::string& root) {
+    for (int a = 0; a < 4; a++) {
+        const std::string dir = root + "/d" + std::to_string(a);
+        ::mkdir(dir.c_str(), 0755);
+        for (int b = 0; b < 3; b++) {
+            const std::string sub = dir + "/s" + std::to_string(b);
+            ::mkdir(sub.c_str(), 0755);
+            for (int c = 0; c < 5; c++) {
+                write_file(sub + "/f" + std::to_string(c), std::string(static_cast<size_t>(a * 100 + c), 'x'));
+            }
+        }
+    }
+    ::mkdir((root + "/big").c_str(), 0755);
+    for (int i = 0; i < 300; i++) {
+        write_file(root + "/big/file" + std::to_string(i), "content");
+    }
+    ::mkdir((root + "/empty").c_str(), 0755);
+    EXPECT_EQ(::symlink("d0", (root + "/link").c_str()), 0);
+}
+
+// 用 lstat 逐个得到期望的结果，与哈希索引使用的 file_identity::from_stat 一致
+std::map<std::string, scan_entry> expected_scan(const std::string& root, const std::string& path) {
+    std::map<std::string, scan_entry> out;
+    const std::string full = path.empty() ? root : root + "/" + path;
+    DIR* dir = ::opendir(full.c_str());
+    while (const struct dirent* entry = ::readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        const std::string child = path.empty() ? name : path + "/" + name;
+        struct stat st;
+        EXPECT_EQ(::lstat((root + "/" + child).c_str(), &st), 0);
+        scan_entry e;
+        e.path = child;
+        e.id = file_identity::from_stat(st);
+        e.mode = static_cast<uint32_t>(st.st_mode);
+        out[child] = e;
+        if (S_ISDIR(st.st_mode)) {
+            auto nested = expected_scan(root, child);
+            out.insert(nested.begin(), nested.end());
+        }
+    }
+    ::closedir(dir);
+    return out;
+}
+
+}  // namespace
+
+TEST(DirectoryScannerTest, AllMethodsMatchLstat) {
+    const temp_dir dir("scan_methods");
+    const std::string& root = dir.path();
+    fill_scan_tree(root);
+    const auto expected = expected_scan(root, "");
+    ASSERT_EQ(expected.size(), 4u + 12u + 60u + 1u + 300u + 1u + 1u);
+
+    thread_pool pool(3);
+    for (scan_method method : {scan_method::posix, scan_method::statx, scan_method::io_uring, scan_method::bulk,
+                               scan_method::automatic}) {
+        if (!directory_scanner::method_available(method)) {
+            EXPECT_THROW(
+                {
+                    directory_scanner_options options;
+                    options.method = method;
+                    directory_scanner scanner(pool, root, options);
+                },
+                std::invalid_argument);
+            continue;
+        }
+        directory_scanner_options options;
+        options.method = method;
+        options.stat_batch = 64;  // big 目录拆成 5 个任务
+        options.queue_capacity = 32;  // 扫描任务会在队列上等待消费者
+        directory_scanner scanner(pool, root + "/", options);
+        SCOPED_TRACE(scanner.method_name());
+
+        std::map<std::string, scan_entry> found;
+        scan_entry entry;
+        while (scanner.entries().get_wait(entry)) {
+            EXPECT_TRUE(found.emplace(entry.path, entry).second) << entry.path;
+        }
+        scanner.wait();
+        EXPECT_TRUE(scanner.done());
+
+        ASSERT_EQ(found.size(), expected.size());
+        for (const auto& item : expected) {
+            auto it = found.find(item.first);
+            ASSERT_NE(it, found.end()) << item.first;
+            EXPECT_EQ(it->second.mode, item.second.mode) << item.first;
+            EXPECT_EQ(it->second.id.device, item.second.id.device) << item.first;
+            EXPECT_EQ(it->second.id.inode, item.second.id.inode) << item.first;
+            EXPECT_EQ(it->second.id.mtime_ns, item.second.id.mtime_ns) << item.first;
+            EXPECT_EQ(it->second.id.size, item.second.id.size) << item.first;
+        }
+        EXPECT_TRUE(S_ISLNK(found.at("link").mode));  // 不跟随符号链接
+        EXPECT_EQ(found.count("link/s0"), 0u);
+
+        const scan_stats stats = scanner.stats();
+        EXPECT_EQ(stats.directories, 1u + 4u + 12u + 2u);
+        EXPECT_EQ(stats.entries, expected.size());
+        EXPECT_EQ(stats.errors, 0u);
+        if (method == scan_method::io_uring) {
+            EXPECT_GE(stats.batches, 5u);
+        }
+    }
+}
+
+TEST(DirectoryScannerTest, StopsWithoutConsumer) {
+    const temp_dir dir("scan_stop");
+    const std::string& root = dir.path();
+    fill_scan_tree(root);
+    thread_pool pool(2);
+    {
+        directory_scanner_options options;
+        options.queue_capacity = 8;
+        directory_scanner scanner(pool, root, options);
+        scan_entry entry;
+        ASSERT_TRUE(scanner.entries().get_wait(entry));
+        // 析构时扫描任务还在等待队列空位，不能卡住
+    }
+    EXPECT_THROW(directory_scanner(pool, root + "/missing"), std::system_error);
+    EXPECT_THROW(directory_scanner(pool, root + "/big/file0"), std::system_error);
+}
+
+#if defined(SYNC_HAVE_IO_URING)
+
+namespace {
+
+bool io_uring_available() {
+    const uint8_t ops[] = {IORING_OP_READ_FIXED, IORING_OP_WRITE, IORING_OP_RECV};
+    return io_uring_queue::supported(ops, sizeof(ops));
+}
+
+}  // namespace
+
+// 文件读入注册缓冲区并链接写出：一次提交两个操作，写出只在读取完成后开始
+TEST(IoUringTest, LinkedReadFixedThenWrite) {
+    if (!io_uring_available()) {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    const std::string path = ::testing::TempDir() + "io_uring_linked.bin";
+    std::string content(100000, '\0');
+    for (size_t i = 0; i < content.size(); i++) {
+        content[i] = static_cast<char>(i * 7);
+    }
+    std::ofstream(path, std::ios::binary) << content;
+    const int file = ::open(path.c_str(), O_RDONLY);
+    ASSERT_GE(file, 0);
+    int pipe_fds[2];
+    ASSERT_EQ(::pipe(pipe_fds), 0);
+
+    io_uring_queue queue(8);
+    std::vector<uint8_t> block(4096);
+    const iovec region = {block.data(), block.size()};
+    queue.register_buffers(&region, 1);
+    ASSERT_EQ(queue.sq_space(), 8u);
+
+    io_uring_sqe* read = queue.get_sqe();
+    read->opcode = IORING_OP_READ_FIXED;
+    read->fd = file;
+    read->addr = reinterpret_cast<uint64_t>(block.data());
+    read->len = 4096;
+    read->off = 50000;
+    read->buf_index = 0;
+    read->flags = IOSQE_IO_LINK;
+    read->user_data = 1;
+    io_uring_sqe* write = queue.get_sqe();
+    write->opcode = IORING_OP_WRITE;
+    write->fd = pipe_fds[1];
+    write->addr = reinterpret_cast<uint64_t>(block.data());
+    write->len = 4096;
+    write->off = ~uint64_t(0);
+    write->user_data = 2;
+    EXPECT_EQ(queue.submit(2), 2u);
+
+    std::map<uint64_t, int> results;
+    while (results.size() < 2) {
+        queue.for_each_cqe([&](const io_uring_cqe& cqe) { results[cqe.user_data] = cqe.res; });
+        if (results.size() < 2) {
+            queue.submit(1);
+        }
+    }
+    EXPECT_EQ(results[1], 4096);
+    EXPECT_EQ(results[2], 4096);
+    std::string piped(4096, '\0');
+    ASSERT_EQ(::read(pipe_fds[0], &piped[0], piped.size()), 4096);
+    EXPECT_EQ(piped, content.substr(50000, 4096));
+
+    // 读取越过文件末尾时读到的字节数少于请求，链接的写出被取消
+    read = queue.get_sqe();
+    read->opcode = IORING_OP_READ_FIXED;
+    read->fd = file;
+    read->addr = reinterpret_cast<uint64_t>(block.data());
+    read->len = 4096;
+    read->off = content.size() - 10;
+    read->flags = IOSQE_IO_LINK;
+    read->user_data = 3;
+    write = queue.get_sqe();
+    write->opcode = IORING_OP_WRITE;
+    write->fd = pipe_fds[1];
+    write->addr = reinterpret_cast<uint64_t>(block.data());
+    write->len = 4096;
+    write->off = ~uint64_t(0);
+    write->user_data = 4;
+    queue.submit(2);
+    results.clear();
+    while (results.size() < 2) {
+        queue.for_each_cqe([&](const io_uring_cqe& cqe) { results[cqe.user_data] = cqe.res; });
+        if (results.size() < 2) {
+            queue.submit(1);
+        }
+    }
+    EXPECT_EQ(results[3], 10);
+    EXPECT_EQ(results[4], -ECANCELED);
+
+    ::close(pipe_fds[0]);
+    ::close(pipe_fds[1]);
+    ::close(file);
+    std::remove(path.c_str());
+}
+
+// 多次触发的接收：每次完成带回一个提供的缓冲区，归还后可以继续接收
+TEST(IoUringTest, MultishotRecvWithProvidedBuffers) {
+    if (!io_uring_available()) {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    io_uring_queue queue(8);
+    std::vector<uint8_t> memory(4 * 256);
+    io_uring_provided_buffers buffers(queue, 7, 4, memory.data(), 256, 99);
+
+    io_uring_sqe* recv = queue.get_sqe();
+    recv->opcode = IORING_OP_RECV;
+    recv->fd = fds[0];
+    recv->flags = IOSQE_BUFFER_SELECT;
+    recv->buf_group = buffers.group();
+    recv->ioprio = IORING_RECV_MULTISHOT;
+    recv->user_data = 1;
+    queue.submit(0);
+
+    std::string received;
+    bool more = true;
+    for (int round = 0; round < 10 && more; round++) {
+        const std::string message = "message " + std::to_string(round);
+        ASSERT_EQ(::write(fds[1], message.data(), message.size()), static_cast<ssize_t>(message.size()));
+        size_t got = 0;
+        while (got < message.size() && more) {
+            queue.submit(1);
+            queue.for_each_cqe([&](const io_uring_cqe& cqe) {
+                if (cqe.user_data != 1) {
+                    return;
+                }
+                more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+                if (cqe.res > 0) {
+                    ASSERT_TRUE(cqe.flags & IORING_CQE_F_BUFFER);
+                    const uint16_t id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                    received.append(reinterpret_cast<const char*>(buffers.buffer(id)), cqe.res);
+                    got += static_cast<size_t>(cqe.res);
+                    buffers.recycle(id);
+                    buffers.publish();
+                }
+            });
+        }
+        EXPECT_EQ(received.substr(received.size() - message.size()), message);
+    }
+    // 内核不支持多次触发时第一次完成就不再带 MORE
+    if (more) {
+        ::close(fds[1]);
+        while (more) {
+            queue.submit(1);
+            queue.for_each_cqe([&](const io_uring_cqe& cqe) {
+                if (cqe.user_data == 1) {
+                    more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+                }
+            });
+        }
+    } else {
+        ::close(fds[1]);
+    }
+    ::close(fds[0]);
+}
+
+#endif
+
+namespace {
+
+std::string read_back(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+bool path_exists(const std::string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0;
+}
+
+}  // namespace
+
+// 乱序的小分块合并成少量 pwritev，rename 之后内容完整且没有残留的临时文件
+TEST(WriteBackTest, OutOfOrderChunksCoalesce) {
+    const temp_dir dir("write_back_order");
+    const std::string& root = dir.path();
+    thread_pool pool(2);
+    write_back_options options;
+    options.durability = durability_level::none;
+    options.preallocate_min_size = 4096;
+    write_back_stage stage(pool, options);
+
+    const std::vector<uint8_t> data = test_input(300000);
+    const size_t chunk = 1000;
+    std::vector<size_t> order;
+    for (size_t offset = 0; offset < data.size(); offset += chunk) {
+        order.push_back(offset);
+    }
+    // 相邻的两块交换位置：一半的分块与上一块首尾相接，一半不是
+    for (size_t i = 0; i + 1 < order.size(); i += 4) {
+        std::swap(order[i], order[i + 1]);
+    }
+
+    const std::string path = root + "/file";
+    std::unique_ptr<write_back_file> file = stage.open(path, data.size());
+    EXPECT_TRUE(path_exists(path + options.temp_suffix));
+    for (size_t offset : order) {
+        file->write(offset, data.data() + offset, std::min(chunk, data.size() - offset));
+    }
+    EXPECT_THROW(file->write(data.size() - 10, data.data(), 20), std::out_of_range);
+    file->commit().get();
+    EXPECT_THROW(file->write(0, data.data(), 1), std::logic_error);
+
+    EXPECT_EQ(read_back(path), std::string(data.begin(), data.end()));
+    EXPECT_FALSE(path_exists(path + options.temp_suffix));
+    const write_back_stats s = stage.stats();
+    EXPECT_EQ(s.files, 1u);
+    EXPECT_EQ(s.bytes, data.size());
+    EXPECT_LT(s.writes, order.size() / 10);
+    EXPECT_EQ(s.syncs, 0u);
+}
+
+// 攒满一批时互不相连的几段：内核支持时用一次 io_uring 提交写出，否则每段一次 pwritev
+TEST(WriteBackTest, SparseFlushUsesOneSubmission) {
+    const temp_dir dir("write_back_sparse");
+    const std::vector<uint8_t> data = test_input(6000);
+#if defined(SYNC_HAVE_IO_URING)
+    const uint8_t opcodes[] = {IORING_OP_WRITEV};
+    const bool uring = io_uring_queue::supported(opcodes, 1);
+#else
+    const bool uring = false;
+#endif
+    for (bool use_io_uring : {true, false}) {
+        thread_pool pool(1);
+        write_back_options options;
+        options.durability = durability_level::none;
+        options.write_batch_bytes = 3000;
+        options.use_io_uring = use_io_uring;
+        write_back_stage stage(pool, options);
+
+        const std::string path = dir.path() + (use_io_uring ? "/uring" : "/pwritev");
+        std::unique_ptr<write_back_file> file = stage.open(path, data.size());
+        // 先写偶数块再写奇数块，每次攒满 3000 字节时都是不相连的三段
+        for (size_t offset : {0, 2000, 4000, 1000, 3000, 5000}) {
+            file->write(offset, data.data() + offset, 1000);
+        }
+        file->commit().get();
+        EXPECT_EQ(read_back(path), std::string(data.begin(), data.end()));
+        const write_back_stats s = stage.stats();
+        EXPECT_EQ(s.writes, 6u);
+        EXPECT_EQ(s.bytes, data.size());
+        EXPECT_EQ(s.submissions, use_io_uring && uring ? 2u : 0u);
+    }
+}
+
+// 三种持久化级别都能并发提交大量文件；batch 级别的屏障被多个文件共用
+TEST(WriteBackTest, DurabilityLevels) {
+    for (durability_level level : {durability_level::none, durability_level::batch, durability_level::file}) {
+        for (bool use_syncfs : {true, false}) {
+            if (level != durability_level::batch && !use_syncfs) {
+                continue;
+            }
+            const temp_dir dir("write_back_levels");
+            const std::string& root = dir.path();
+            ::mkdir((root + "/a").c_str(), 0755);
+            ::mkdir((root + "/b").c_str(), 0755);
+            thread_pool pool(3);
+            write_back_options options;
+            options.durability = level;
+            options.use_syncfs = use_syncfs;
+            const int files = 200;
+            {
+                write_back_stage stage(pool, options);
+                std::vector<std::future<void>> writers;
+                std::mutex mutex;
+                std::vector<std::future<void>> commits;
+                for (int t = 0; t < 4; ++t) {
+                    writers.push_back(pool.submit_to(task_lane::transfer, [&, t] {
+                        for (int i = t; i < files; i += 4) {
+                            const std::string content = "content " + std::to_string(i);
+                            const std::string path = root + (i % 2 ? "/a/f" : "/b/f") + std::to_string(i);
+                            std::unique_ptr<write_back_file> file = stage.open(path, content.size());
+                            file->write(0, reinterpret_cast<const uint8_t*>(content.data()), content.size());
+                            std::future<void> done = file->commit();
+                            std::lock_guard<std::mutex> lock(mutex);
+                            commits.push_back(std::move(done));
+                        }
+                    }));
+                }
+                for (auto& w : writers) {
+                    w.get();
+                }
+                for (auto& c : commits) {
+                    c.get();
+                }
+                stage.flush();
+
+                const write_back_stats s = stage.stats();
+                EXPECT_EQ(s.files, static_cast<uint64_t>(files));
+                EXPECT_EQ(s.failures, 0u);
+                if (level == durability_level::none) {
+                    EXPECT_EQ(s.syncs, 0u);
+                } else if (level == durability_level::file) {
+                    EXPECT_EQ(s.syncs, 2u * files);
+                } else {
+                    EXPECT_GE(s.barriers, 1u);
+                    EXPECT_LT(s.syncs, 2u * files);
+                }
+            }
+            for (int i = 0; i < files; ++i) {
+                const std::string path = root + (i % 2 ? "/a/f" : "/b/f") + std::to_string(i);
+                ASSERT_EQ(read_back(path), "content " + std::to_string(i)) << path;
+            }
+        }
+    }
+}
+
+// 写入不足时 commit 的 future 得到异常；放弃和析构都会删除临时文件
+TEST(WriteBackTest, ShortWriteAndAbort) {
+    const temp_dir dir("write_back_abort");
+    const std::string& root = dir.path();
+    thread_pool pool(1);
+    write_back_stage stage(pool);
+    const std::vector<uint8_t> data = test_input(100);
+
+    std::unique_ptr<write_back_file> shorter = stage.open(root + "/short", data.size());
+    shorter->write(0, data.data(), 50);
+    std::future<void> done = shorter->commit();
+    EXPECT_THROW(done.get(), std::runtime_error);
+    EXPECT_FALSE(path_exists(root + "/short"));
+    EXPECT_FALSE(path_exists(root + "/short.sync-tmp"));
+
+    // 重传的分块与已写的范围重叠，提交的字节数正好等于大小，但 [90, 100) 没有写过
+    std::unique_ptr<write_back_file> holed = stage.open(root + "/holed", data.size());
+    holed->write(0, data.data(), 50);
+    holed->write(40, data.data() + 40, 50);
+    std::future<void> holed_done = holed->commit();
+    EXPECT_THROW(holed_done.get(), std::runtime_error);
+    EXPECT_FALSE(path_exists(root + "/holed"));
+    EXPECT_FALSE(path_exists(root + "/holed.sync-tmp"));
+
+    // 重叠的写入覆盖了整个文件时照常提交
+    std::unique_ptr<write_back_file> resent = stage.open(root + "/resent", data.size());
+    resent->write(50, data.data() + 50, 50);
+    resent->write(0, data.data(), 60);
+    resent->write(30, data.data() + 30, 40);
+    resent->commit().get();
+    EXPECT_EQ(read_back(root + "/resent"), std::string(data.begin(), data.end()));
+
+    std::unique_ptr<write_back_file> aborted = stage.open(root + "/aborted", data.size());
+    aborted->write(0, data.data(), data.size());
+    aborted->abort();
+    EXPECT_FALSE(path_exists(root + "/aborted.sync-tmp"));
+    EXPECT_THROW(aborted->commit(), std::logic_error);
+
+    stage.open(root + "/dropped", data.size())->write(0, data.data(), 10);
+    EXPECT_FALSE(path_exists(root + "/dropped.sync-tmp"));
+    EXPECT_FALSE(path_exists(root + "/dropped"));
+
+    EXPECT_THROW(stage.open(root + "/missing/file", 1), std::system_error);
+    EXPECT_EQ(stage.stats().failures, 4u);
+    EXPECT_THROW(write_back_stage(pool, [] {
+                     write_back_options options;
+                     options.max_iov = 0;
+                     return options;
+                 }()),
+                 std::invalid_argument);
+}
+
+// rename 失败（目标是非空目录）时 commit 得到异常并删除临时文件；临时文件的描述符只关闭一次，
+// 不会关掉其他线程同时打开、恰好复用了这个编号的描述符
+TEST(WriteBackTest, RenameFailureClosesDescriptorOnce) {
+    const temp_dir dir("write_back_rename");
+    const std::string target = dir.path() + "/target";
+    ::mkdir(target.c_str(), 0755);
+    write_file(target + "/keep", "x");
+
+    thread_pool pool(1);
+    write_back_options options;
+    options.durability = durability_level::none;
+    write_back_stage stage(pool, options);
+
+    std::atomic<bool> stop(false);
+    std::atomic<int> closed_elsewhere(0);
+    std::thread other([&] {
+        while (!stop.load(std::memory_order_relaxed)) {
+            const int fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            ASSERT_GE(fd, 0);
+            std::this_thread::yield();
+            if (::fcntl(fd, F_GETFD) == -1) {
+                closed_elsewhere++;  // 被别人关闭了，编号可能已经再次被复用，不能再关闭
+            } else {
+                ::close(fd);
+            }
+        }
+    });
+
+    const std::vector<uint8_t> data = test_input(64);
+    const int rounds = 2000;
+    for (int i = 0; i < rounds; ++i) {
+        std::unique_ptr<write_back_file> file = stage.open(target, data.size());
+        file->write(0, data.data(), data.size());
+        std::future<void> done = file->commit();
+        EXPECT_THROW(done.get(), std::system_error);
+    }
+    stop = true;
+    other.join();
+
+    EXPECT_EQ(closed_elsewhere.load(), 0);
+    EXPECT_FALSE(path_exists(target + options.temp_suffix));
+    EXPECT_EQ(read_back(target + "/keep"), "x");
+    const write_back_stats s = stage.stats();
+    EXPECT_EQ(s.failures, static_cast<uint64_t>(rounds));
+    EXPECT_EQ(s.files, 0u);
+}
+
+#if defined(SYNC_METRICS)
+namespace {
+
+size_t count_of(const std::string& text, const std::string& needle) {
+    size_t n = 0;
+    for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + needle.size())) {
+        ++n;
+    }
+    return n;
+}
+
+}  // namespace
+
+// 同一个分块在读取、哈希、压缩、写回各阶段的区间编号相同，连成一条 flow；内容相同但
+// 文件键不同的分块（映射窗口可能复用同一段地址）不会连进来
+TEST(PipelineTraceTest, OneFlowPerChunkAcrossStages) {
+    const temp_dir dir("pipeline_trace");
+    const std::string& root = dir.path();
+    const std::vector<uint8_t> data = test_input(100000);
+    write_file(root + "/a", std::string(data.begin(), data.end()));
+    write_file(root + "/b", std::string(data.begin(), data.end()));
+
+    thread_pool pool(2);
+    file_hasher_options hopts;
+    hopts.chunk_size = 65536;
+    const file_hasher hasher(pool, hopts);
+    compression_stage compressor(pool);
+    write_back_options wopts;
+    wopts.durability = durability_level::none;
+    write_back_stage writer(pool, wopts);
+    const uint64_t key = trace_file_key("src/a");
+
+    trace_start();
+    const file_hash_result hashed = hasher.hash_file(root + "/a", key);
+    hasher.hash_file(root + "/b");
+    std::unique_ptr<write_back_file> out = writer.open(root + "/copy", data.size(), 0644, key);
+    for (const chunk_hash& chunk : hashed.chunks) {
+        const file_view view(data.data() + chunk.offset, chunk.length);
+        compressor.compress_async(view, trace_chunk_id(key, chunk.offset)).get();
+        out->write(chunk.offset, view.data(), view.size());
+    }
+    out->commit().get();
+    trace_stop();
+
+    std::ostringstream trace;
+    trace_write(trace);
+    const std::string json = trace.str();
+    ASSERT_EQ(hashed.chunks.size(), 2u);
+    for (const chunk_hash& chunk : hashed.chunks) {
+        const std::string id = std::to_string(trace_chunk_id(key, chunk.offset));
+        EXPECT_EQ(count_of(json, "\"args\":{\"id\":" + id + "}"), 4u) << json;
+        EXPECT_EQ(count_of(json, "\"ph\":\"s\",\"id\":" + id + ","), 1u) << json;
+        EXPECT_EQ(count_of(json, "\"ph\":\"t\",\"id\":" + id + ","), 2u) << json;
+        EXPECT_EQ(count_of(json, "\"ph\":\"f\",\"id\":" + id + ","), 1u) << json;
+    }
+    // 另一个文件的读取和哈希自成一条 flow，每个分块一条
+    EXPECT_EQ(count_of(json, "\"ph\":\"s\""), 4u) << json;
+    EXPECT_EQ(count_of(json, "\"ph\":\"t\""), 4u) << json;
+    EXPECT_EQ(count_of(json, "\"ph\":\"f\""), 4u) << json;
+    EXPECT_EQ(read_back(root + "/copy"), std::string(data.begin(), data.end()));
+}
+#endif
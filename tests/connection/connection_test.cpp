@@ -0,0 +1,724 @@
+#include "../../include/connection/connection.h"
+#include "../../include/connection/striped.h"
+#include "../../include/connection/transfer.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+frame make_frame(uint16_t type, size_t size) {
+    frame f;
+    f.type = type;
+    f.flags = static_cast<uint16_t>(size & 0xffff);
+    f.payload.resize(size);
+    for (size_t i = 0; i < size; i++) {
+        f.payload[i] = static_cast<uint8_t>(i * 31 + type);
+    }
+    return f;
+}
+
+// 在线程池回调和测试线程之间收集结果
+struct collector {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<frame> frames;
+    std::vector<std::error_code> closes;
+
+    connection_handler handler() {
+        connection_handler h;
+        h.on_frame = [this](const connection_ptr&, frame&& f) {
+            std::lock_guard<std::mutex> lock(mutex);
+            frames.push_back(std::move(f));
+            changed.notify_all();
+        };
+        h.on_close = [this](const connection_ptr&, const std::error_code& error) {
+            std::lock_guard<std::mutex> lock(mutex);
+            closes.push_back(error);
+            changed.notify_all();
+        };
+        return h;
+    }
+
+    bool wait_frames(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return changed.wait_for(lock, std::chrono::seconds(10), [&] { return frames.size() >= count; });
+    }
+
+    bool wait_closes(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return changed.wait_for(lock, std::chrono::seconds(10), [&] { return closes.size() >= count; });
+    }
+};
+
+connection_handler echo_handler() {
+    connection_handler h;
+    h.on_frame = [](const connection_ptr& conn, frame&& f) { conn->send(std::move(f)); };
+    return h;
+}
+
+// 写入 size 字节的测试文件，内容由 offset 决定
+std::string write_test_file(const std::string& name, size_t size) {
+    const std::string path = ::testing::TempDir() + name;
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<uint8_t>((i * 2654435761u) >> 13);
+    }
+    FILE* out = std::fopen(path.c_str(), "wb");
+    if (out != nullptr) {
+        std::fwrite(data.data(), 1, data.size(), out);
+        std::fclose(out);
+    }
+    return path;
+}
+
+frame make_file_frame(uint16_t type, const std::shared_ptr<const shared_file>& file, uint64_t offset,
+                      uint32_t length) {
+    frame f;
+    f.type = type;
+    f.file = file;
+    f.file_offset = offset;
+    f.file_length = length;
+    return f;
+}
+
+std::vector<uint8_t> file_bytes(const std::string& path, uint64_t offset, uint32_t length) {
+    std::vector<uint8_t> data(length);
+    FILE* in = std::fopen(path.c_str(), "rb");
+    std::fseek(in, static_cast<long>(offset), SEEK_SET);
+    const size_t n = std::fread(data.data(), 1, length, in);
+    std::fclose(in);
+    data.resize(n);
+    return data;
+}
+
+const char* readiness_name() {
+#if defined(__APPLE__)
+    return "kqueue";
+#else
+    return "epoll";
+#endif
+}
+
+}  // namespace
+
+// 每个测试在两种后端上各运行一次；当前系统不支持 io_uring 时跳过
+class ConnectionBackendTest : public ::testing::TestWithParam<reactor_backend> {
+protected:
+    void SetUp() override {
+        if (GetParam() == reactor_backend::io_uring) {
+            thread_pool pool(1);
+            try {
+                reactor probe(pool, options());
+            } catch (const std::system_error&) {
+                GTEST_SKIP() << "io_uring is not available";
+            }
+        }
+    }
+
+    reactor_options options() const {
+        reactor_options result;
+        result.backend = GetParam();
+        return result;
+    }
+};
+
+INSTANTIATE_TEST_SUITE_P(Backends, ConnectionBackendTest,
+                         ::testing::Values(reactor_backend::readiness, reactor_backend::io_uring),
+                         [](const ::testing::TestParamInfo<reactor_backend>& info) {
+                             return info.param == reactor_backend::io_uring ? "IoUring" : "Readiness";
+                         });
+
+TEST_P(ConnectionBackendTest, EchoOverTcpPreservesOrder) {
+    thread_pool pool(3);
+    reactor r(pool, options());
+    EXPECT_STREQ(r.backend_name(), GetParam() == reactor_backend::io_uring ? "io_uring" : readiness_name());
+    const uint16_t port = r.listen("127.0.0.1", 0, echo_handler());
+    ASSERT_NE(port, 0);
+
+    collector client;
+    connection_ptr conn = r.connect("127.0.0.1", port, client.handler());
+    std::vector<size_t> sizes;
+    for (size_t i = 0; i < 500; i++) {
+        sizes.push_back(i % 7 == 0 ? 0 : (i * 977) % 70000);
+    }
+    sizes.push_back(3 << 20);  // 大于读缓冲区的帧
+    for (size_t i = 0; i < sizes.size(); i++) {
+        ASSERT_TRUE(conn->send(make_frame(static_cast<uint16_t>(i), sizes[i])));
+    }
+    ASSERT_TRUE(client.wait_frames(sizes.size()));
+    for (size_t i = 0; i < sizes.size(); i++) {
+        frame expected = make_frame(static_cast<uint16_t>(i), sizes[i]);
+        EXPECT_EQ(client.frames[i].type, expected.type);
+        EXPECT_EQ(client.frames[i].flags, expected.flags);
+        EXPECT_TRUE(client.frames[i].payload == expected.payload) << i;
+    }
+    EXPECT_GT(conn->bytes_sent(), 3u << 20);
+    EXPECT_EQ(conn->bytes_sent(), conn->bytes_received());
+
+    conn->close();
+    ASSERT_TRUE(client.wait_closes(1));
+    EXPECT_FALSE(client.closes[0]);
+    frame late = make_frame(1, 1);
+    EXPECT_FALSE(conn->send(late));
+}
+
+// 接收方处理得慢：接收队列满后暂停读取，恢复后帧不丢失、不乱序
+TEST_P(ConnectionBackendTest, BackpressureWithSmallQueues) {
+    thread_pool pool(2);
+    reactor_options options = this->options();
+    options.io_threads = 1;
+    options.send_queue_frames = 4;
+    options.recv_queue_frames = 2;
+    options.read_buffer_size = 512;
+    reactor r(pool, options);
+
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    collector slow;
+    connection_handler slow_handler = slow.handler();
+    auto record = slow_handler.on_frame;
+    slow_handler.on_frame = [record](const connection_ptr& conn, frame&& f) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        record(conn, std::move(f));
+    };
+    connection_ptr receiver = r.adopt(fds[0], slow_handler);
+    collector unused;
+    connection_ptr sender = r.adopt(fds[1], unused.handler());
+
+    const size_t count = 400;
+    std::thread producer([&] {
+        for (size_t i = 0; i < count; i++) {
+            ASSERT_TRUE(sender->send(make_frame(static_cast<uint16_t>(i), 100 + i * 13)));
+        }
+    });
+    producer.join();
+    ASSERT_TRUE(slow.wait_frames(count));
+    for (size_t i = 0; i < count; i++) {
+        EXPECT_EQ(slow.frames[i].type, static_cast<uint16_t>(i));
+        EXPECT_EQ(slow.frames[i].payload.size(), 100 + i * 13);
+    }
+
+    // 一端关闭后另一端收到正常关闭
+    sender->close();
+    ASSERT_TRUE(slow.wait_closes(1));
+    EXPECT_FALSE(slow.closes[0]);
+}
+
+TEST_P(ConnectionBackendTest, OversizedFrameClosesWithError) {
+    thread_pool pool(2);
+    reactor_options options = this->options();
+    options.max_frame_size = 1024;
+    reactor r(pool, options);
+
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    collector server;
+    r.adopt(fds[0], server.handler());
+    const uint8_t header[frame_header_size] = {0x00, 0x10, 0x00, 0x00, 1, 0, 0, 0};  // 4096 字节
+    ASSERT_EQ(::write(fds[1], header, sizeof(header)), static_cast<ssize_t>(sizeof(header)));
+    ASSERT_TRUE(server.wait_closes(1));
+    EXPECT_EQ(server.closes[0], std::make_error_code(std::errc::message_size));
+    ::close(fds[1]);
+}
+
+// 几个 I/O 线程服务大量连接
+TEST_P(ConnectionBackendTest, ManyConnections) {
+    thread_pool pool(4);
+    reactor_options options = this->options();
+    options.io_threads = 2;
+    reactor r(pool, options);
+    EXPECT_EQ(r.io_threads(), 2u);
+    const uint16_t port = r.listen("127.0.0.1", 0, echo_handler());
+
+    const size_t connections = 100;
+    const size_t frames_per_connection = 20;
+    collector client;
+    std::vector<connection_ptr> conns;
+    for (size_t i = 0; i < connections; i++) {
+        conns.push_back(r.connect("127.0.0.1", port, client.handler()));
+    }
+    for (size_t round = 0; round < frames_per_connection; round++) {
+        for (auto& conn : conns) {
+            ASSERT_TRUE(conn->send(make_frame(static_cast<uint16_t>(round), 64)));
+        }
+    }
+    ASSERT_TRUE(client.wait_frames(connections * frames_per_connection));
+
+    // 停止时所有连接都收到 on_close
+    r.stop();
+    ASSERT_TRUE(client.wait_closes(connections));
+    EXPECT_THROW(r.adopt(::dup(0), client.handler()), std::runtime_error);
+}
+
+// 文件帧与内存帧交错发送：帧头随前面的帧发出，文件数据分块读出，顺序和内容都不变
+TEST_P(ConnectionBackendTest, FileFramesInterleaveWithMemoryFrames) {
+    thread_pool pool(3);
+    reactor_options options = this->options();
+    options.file_block_size = 64 * 1024;
+    options.file_blocks = 2;
+    reactor r(pool, options);
+    const uint16_t port = r.listen("127.0.0.1", 0, echo_handler());
+
+    const size_t file_size = 1300 * 1000 + 7;
+    const std::string path = write_test_file("connection_file_frames.bin", file_size);
+    auto file = shared_file::open(path);
+
+    struct range {
+        uint64_t offset;
+        uint32_t length;
+    };
+    const std::vector<range> ranges = {{0, static_cast<uint32_t>(file_size)}, {5, 0}, {65535, 65537},
+                                       {1000, 1}, {file_size - 3, 3}};
+    collector client;
+    std::vector<connection_ptr> conns;
+    for (int c = 0; c < 3; c++) {
+        conns.push_back(r.connect("127.0.0.1", port, client.handler()));
+    }
+    for (auto& conn : conns) {
+        for (size_t i = 0; i < ranges.size(); i++) {
+            ASSERT_TRUE(conn->send(make_frame(static_cast<uint16_t>(2 * i), i * 100)));
+            ASSERT_TRUE(conn->send(
+                make_file_frame(static_cast<uint16_t>(2 * i + 1), file, ranges[i].offset, ranges[i].length)));
+        }
+    }
+    ASSERT_TRUE(client.wait_frames(conns.size() * ranges.size() * 2));
+
+    // 各连接的帧交错到达，按类型分别检查
+    std::vector<size_t> seen(ranges.size() * 2, 0);
+    for (const frame& f : client.frames) {
+        ASSERT_LT(f.type, seen.size());
+        ++seen[f.type];
+        if (f.type % 2 == 0) {
+            EXPECT_TRUE(f.payload == make_frame(f.type, (f.type / 2) * 100).payload);
+        } else {
+            const range& expected = ranges[f.type / 2];
+            EXPECT_TRUE(f.payload == file_bytes(path, expected.offset, expected.length)) << f.type;
+        }
+    }
+    for (size_t count : seen) {
+        EXPECT_EQ(count, conns.size());
+    }
+    std::remove(path.c_str());
+}
+
+// 文件比帧声明的短：帧头可能已经发出，只能以错误结束连接，对端收不到这一帧
+TEST_P(ConnectionBackendTest, TruncatedFileFrameClosesWithError) {
+    thread_pool pool(2);
+    reactor r(pool, options());
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    collector sender_events;
+    connection_ptr sender = r.adopt(fds[0], sender_events.handler());
+    collector receiver;
+    r.adopt(fds[1], receiver.handler());
+
+    const std::string path = write_test_file("connection_truncated.bin", 1000);
+    // 连接可能在 send 返回之前就已经结束，返回值不确定
+    sender->send(make_file_frame(1, shared_file::open(path), 0, 5000));
+    ASSERT_TRUE(sender_events.wait_closes(1));
+    EXPECT_TRUE(sender_events.closes[0]);
+    ASSERT_TRUE(receiver.wait_closes(1));
+    EXPECT_TRUE(receiver.frames.empty());
+    std::remove(path.c_str());
+}
+
+// readiness 后端的每种文件发送方式：大文件帧会多次写满套接字，负载在管道或页缓存中分段发出
+TEST(ConnectionTest, ReadinessFileTransferModes) {
+    const size_t file_size = 3 * 1000 * 1000 + 11;
+    const std::string path = write_test_file("connection_transfer_modes.bin", file_size);
+    auto file = shared_file::open(path);
+    const std::vector<uint8_t> whole = file_bytes(path, 0, file_size);
+    const std::vector<uint8_t> middle = file_bytes(path, 4095, 700001);
+
+    for (file_transfer mode : {file_transfer::automatic, file_transfer::splice, file_transfer::copy}) {
+        thread_pool pool(2);
+        reactor_options options;
+        options.backend = reactor_backend::readiness;
+        options.file_mode = mode;
+        reactor r(pool, options);
+        const uint16_t port = r.listen("127.0.0.1", 0, echo_handler());
+
+        collector client;
+        connection_ptr conn = r.connect("127.0.0.1", port, client.handler());
+        for (uint16_t i = 0; i < 4; i++) {
+            ASSERT_TRUE(conn->send(make_file_frame(i, file, 0, static_cast<uint32_t>(file_size))));
+            ASSERT_TRUE(conn->send(make_frame(100, 10)));
+            ASSERT_TRUE(conn->send(make_file_frame(200, file, 4095, 700001)));
+        }
+        ASSERT_TRUE(client.wait_frames(12));
+        for (size_t i = 0; i < client.frames.size(); i++) {
+            const frame& f = client.frames[i];
+            if (i % 3 == 0) {
+                EXPECT_EQ(f.type, i / 3);
+                EXPECT_TRUE(f.payload == whole) << static_cast<int>(mode);
+            } else if (i % 3 == 1) {
+                EXPECT_TRUE(f.payload == make_frame(100, 10).payload);
+            } else {
+                EXPECT_TRUE(f.payload == middle) << static_cast<int>(mode);
+            }
+        }
+        const uint64_t expected = 4 * (3 * frame_header_size + file_size + 10 + 700001);
+        EXPECT_EQ(conn->bytes_sent(), expected);
+    }
+    std::remove(path.c_str());
+}
+
+// 启用接收缓冲区池：小帧放进池缓冲区并原样回显，单个连接的占用不超过配额，大帧和超出配额的帧退回 payload
+TEST_P(ConnectionBackendTest, PooledReceiveBuffers) {
+    thread_pool pool(3);
+    reactor_options options = this->options();
+    options.pool_buffer_size = 4096;
+    options.pool_buffers = 64;
+    options.pool_buffers_per_connection = 4;
+    reactor r(pool, options);
+    ASSERT_TRUE(r.buffers());
+    const uint16_t port = r.listen("127.0.0.1", 0, echo_handler());
+
+    collector client;
+    connection_ptr conn = r.connect("127.0.0.1", port, client.handler());
+    const size_t frames = 200;
+    for (size_t i = 0; i < frames; i++) {
+        ASSERT_TRUE(conn->send(make_frame(static_cast<uint16_t>(i), (i % 3 == 0) ? 5000 + i : i * 13)));
+    }
+    ASSERT_TRUE(client.wait_frames(frames));
+    size_t pooled = 0;
+    for (size_t i = 0; i < frames; i++) {
+        const frame& f = client.frames[i];
+        const frame expected = make_frame(static_cast<uint16_t>(i), (i % 3 == 0) ? 5000 + i : i * 13);
+        ASSERT_EQ(f.payload_size(), expected.payload.size());
+        EXPECT_EQ(std::memcmp(f.payload_data(), expected.payload.data(), expected.payload.size()), 0) << i;
+        pooled += f.buffer ? 1 : 0;
+        EXPECT_FALSE(f.buffer && f.payload_size() > 4096);
+    }
+    // 收集器保留着帧，客户端连接的配额用满后其余的帧都在 payload 中
+    EXPECT_EQ(pooled, 4u);
+    EXPECT_EQ(conn->pooled_buffers(), 4u);
+
+    // 复制帧时池缓冲区的内容复制到 payload
+    frame copy = client.frames[1];
+    EXPECT_FALSE(copy.buffer);
+    EXPECT_EQ(copy.payload_size(), client.frames[1].payload_size());
+    {
+        std::lock_guard<std::mutex> lock(client.mutex);
+        client.frames.clear();
+    }
+    EXPECT_EQ(conn->pooled_buffers(), 0u);
+}
+
+TEST(TransferTest, BdpWindow) {
+    using std::chrono::milliseconds;
+    // 1 Gbit/s、80 ms：10 MB 在途，按 1 MiB 分块需要 10 个请求
+    EXPECT_EQ(bdp_window(125e6, milliseconds(80), 1u << 20, 256), 10u);
+    EXPECT_EQ(bdp_window(125e6, milliseconds(80), 64 * 1024, 256), 153u);
+    EXPECT_EQ(bdp_window(125e6, milliseconds(80), 4096, 256), 256u);
+    EXPECT_EQ(bdp_window(0, milliseconds(80), 4096, 256), 1u);
+    EXPECT_EQ(bdp_window(1e6, milliseconds(0), 4096, 256), 1u);
+}
+
+namespace {
+
+// 按名字打开测试目录中的文件
+transfer_server test_server() {
+    return transfer_server([](const std::string& name) { return shared_file::open(::testing::TempDir() + name); });
+}
+
+struct received_file {
+    std::mutex mutex;
+    std::vector<uint8_t> data;
+    bool in_order = true;
+
+    transfer_client::chunk_sink sink() {
+        return [this](uint64_t offset, const uint8_t* bytes, size_t size) {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_order = in_order && offset == data.size();
+            data.insert(data.end(), bytes, bytes + size);
+        };
+    }
+};
+
+}  // namespace
+
+// 一条连接上同时拉取多个文件：各流的分块交错在途，每个文件的数据按顺序完整到达
+TEST_P(ConnectionBackendTest, TransferMultiplexesFiles) {
+    thread_pool pool(3);
+    reactor r(pool, options());
+    const uint16_t port = r.listen("127.0.0.1", 0, test_server().handler());
+
+    const std::vector<size_t> sizes = {3 * 1000 * 1000 + 17, 0, 65536, 200000, 1};
+    std::vector<std::string> names;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        names.push_back("transfer_" + std::to_string(i) + ".bin");
+        write_test_file(names.back(), sizes[i]);
+    }
+
+    transfer_options topts;
+    topts.chunk_size = 64 * 1024;
+    transfer_client client(r, "127.0.0.1", port, topts);
+    std::vector<std::unique_ptr<received_file>> files;
+    std::vector<std::future<uint64_t>> done;
+    for (const auto& name : names) {
+        files.emplace_back(new received_file);
+        done.push_back(client.fetch(name, files.back()->sink()));
+    }
+    auto missing = client.fetch("transfer_missing.bin", [](uint64_t, const uint8_t*, size_t) {});
+
+    for (size_t i = 0; i < sizes.size(); i++) {
+        ASSERT_EQ(done[i].wait_for(std::chrono::seconds(10)), std::future_status::ready);
+        EXPECT_EQ(done[i].get(), sizes[i]);
+        EXPECT_TRUE(files[i]->in_order);
+        EXPECT_TRUE(files[i]->data == file_bytes(::testing::TempDir() + names[i], 0, sizes[i])) << names[i];
+    }
+    EXPECT_THROW(missing.get(), std::runtime_error);
+
+    uint64_t chunks = 0;
+    uint64_t total = 0;
+    for (size_t size : sizes) {
+        chunks += (size + topts.chunk_size - 1) / topts.chunk_size;
+        total += size;
+    }
+    const transfer_stats stats = client.stats();
+    EXPECT_EQ(stats.requests, chunks);
+    EXPECT_EQ(stats.bytes_received, total);
+    EXPECT_EQ(stats.outstanding, 0u);
+    EXPECT_GE(stats.window, topts.min_window);
+    for (const auto& name : names) {
+        std::remove((::testing::TempDir() + name).c_str());
+    }
+}
+
+// 写盘慢时接收队列堆满，在途请求数不超过接收队列的容量，数据方不会被无限制地要数据
+TEST(TransferTest, CreditFollowsReceiveQueue) {
+    thread_pool pool(3);
+    reactor server(pool);
+    const uint16_t port = server.listen("127.0.0.1", 0, test_server().handler());
+    const std::string name = "transfer_credit.bin";
+    const size_t size = 64 * 4096;
+    write_test_file(name, size);
+
+    reactor_options options;
+    options.recv_queue_frames = 4;
+    reactor r(pool, options);
+    transfer_options topts;
+    topts.chunk_size = 4096;
+    topts.initial_window = 32;
+    topts.adaptive_window = false;
+    transfer_client client(r, "127.0.0.1", port, topts);
+
+    std::atomic<uint32_t> max_outstanding{0};
+    std::atomic<uint64_t> received{0};
+    auto done = client.fetch(name, [&](uint64_t, const uint8_t*, size_t n) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        const uint32_t outstanding = client.stats().outstanding;
+        if (outstanding > max_outstanding) {
+            max_outstanding = outstanding;
+        }
+        received += n;
+    });
+    ASSERT_EQ(done.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(done.get(), size);
+    EXPECT_EQ(received.load(), size);
+    EXPECT_LE(max_outstanding.load(), 4u);
+    EXPECT_GT(client.stats().credit_stalls, 0u);
+    std::remove((::testing::TempDir() + name).c_str());
+}
+
+// 连接断开时未完成的拉取以异常结束；不合法的配置直接拒绝
+TEST(TransferTest, ConnectionLossFailsFetches) {
+    thread_pool pool(2);
+    reactor r(pool);
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    transfer_client client(r, fds[0]);
+    auto pending = client.fetch("anything", [](uint64_t, const uint8_t*, size_t) {});
+    ::close(fds[1]);
+    ASSERT_EQ(pending.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_THROW(pending.get(), std::exception);
+    EXPECT_THROW(client.fetch("later", [](uint64_t, const uint8_t*, size_t) {}).get(), std::runtime_error);
+
+    transfer_options invalid;
+    invalid.max_window = 70000;
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    EXPECT_THROW(transfer_client(r, fds[0], invalid), std::invalid_argument);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+namespace {
+
+frame numbered_frame(uint64_t seq, size_t size) {
+    frame f;
+    f.type = 9;
+    f.payload.resize(std::max<size_t>(size, 8));
+    for (int i = 0; i < 8; i++) {
+        f.payload[i] = static_cast<uint8_t>(seq >> (8 * i));
+    }
+    return f;
+}
+
+uint64_t frame_number(const frame& f) {
+    uint64_t seq = 0;
+    for (int i = 0; i < 8; i++) {
+        seq |= uint64_t(f.payload_data()[i]) << (8 * i);
+    }
+    return seq;
+}
+
+// 按顺序收帧，记录第一个乱序的位置
+struct ordered_receiver {
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint64_t next = 0;
+    bool in_order = true;
+    bool closed = false;
+    std::error_code error;
+
+    void on_frame(const frame& f) {
+        std::lock_guard<std::mutex> lock(mutex);
+        in_order = in_order && frame_number(f) == next;
+        ++next;
+        cv.notify_all();
+    }
+
+    void on_close(const std::error_code& e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        error = e;
+        cv.notify_all();
+    }
+
+    template <typename Pred>
+    bool wait(Pred pred) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return cv.wait_for(lock, std::chrono::seconds(10), [&] { return pred(*this); });
+    }
+};
+
+}  // namespace
+
+// 帧被分到多条流上发送，两个方向都按 send 的顺序交付
+TEST_P(ConnectionBackendTest, StripedStreamsKeepOrder) {
+    thread_pool pool(3);
+    reactor r(pool, options());
+    ordered_receiver server_side;
+    striped_handler echo;
+    echo.on_frame = [&](const striped_ptr& conn, frame&& f) {
+        server_side.on_frame(f);
+        conn->send(std::move(f));
+    };
+    echo.on_close = [&](const striped_ptr&, const std::error_code& e) { server_side.on_close(e); };
+    striped_listener listener(echo);
+    const uint16_t port = r.listen("127.0.0.1", 0, listener.handler());
+
+    ordered_receiver client_side;
+    striped_handler h;
+    h.on_frame = [&](const striped_ptr&, frame&& f) { client_side.on_frame(f); };
+    h.on_close = [&](const striped_ptr&, const std::error_code& e) { client_side.on_close(e); };
+    striped_options so;
+    so.streams = 4;
+    so.run_frames = 4;
+    auto conn = striped_connection::connect(r, "127.0.0.1", port, h, so);
+    EXPECT_EQ(conn->streams(), 4u);
+
+    const uint64_t total = 2000;
+    for (uint64_t i = 0; i < total; i++) {
+        ASSERT_TRUE(conn->send(numbered_frame(i, (i * 7919) % 40000)));
+    }
+    ASSERT_TRUE(client_side.wait([&](ordered_receiver& rcv) { return rcv.next == total; }));
+    EXPECT_TRUE(server_side.in_order);
+    EXPECT_TRUE(client_side.in_order);
+
+    const striped_stats stats = conn->stats();
+    ASSERT_EQ(stats.streams.size(), 4u);
+    uint64_t frames = 0;
+    for (const auto& entry : stats.streams) {
+        EXPECT_GT(entry.frames_sent, 0u);
+        EXPECT_GT(entry.bytes_received, 0u);
+        EXPECT_TRUE(entry.open);
+        frames += entry.frames_sent;
+    }
+    EXPECT_EQ(frames, total);
+    EXPECT_EQ(stats.frames_sent, total);
+    EXPECT_EQ(stats.frames_delivered, total);
+    EXPECT_LE(stats.reorder_peak, so.reorder_window);
+
+    conn->close();
+    EXPECT_FALSE(conn->send(numbered_frame(0, 8)));
+    ASSERT_TRUE(client_side.wait([](ordered_receiver& rcv) { return rcv.closed; }));
+    ASSERT_TRUE(server_side.wait([](ordered_receiver& rcv) { return rcv.closed; }));
+    EXPECT_FALSE(client_side.error) << client_side.error.message();
+    EXPECT_FALSE(server_side.error) << server_side.error.message();
+}
+
+// 接收方处理慢时，已发出而未确认的帧不超过 reorder_window，发送方在窗口上等待
+TEST(StripedTest, WindowBoundsReorderBuffer) {
+    thread_pool pool(3);
+    reactor r(pool);
+    ordered_receiver server_side;
+    striped_handler slow;
+    slow.on_frame = [&](const striped_ptr&, frame&& f) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        server_side.on_frame(f);
+    };
+    striped_listener listener(slow);
+    const uint16_t port = r.listen("127.0.0.1", 0, listener.handler());
+
+    striped_options so;
+    so.streams = 3;
+    so.run_frames = 4;
+    so.reorder_window = 16;
+    auto conn = striped_connection::connect(r, "127.0.0.1", port, striped_handler(), so);
+    const uint64_t total = 400;
+    uint64_t max_in_flight = 0;
+    for (uint64_t i = 0; i < total; i++) {
+        ASSERT_TRUE(conn->send(numbered_frame(i, 1000)));
+        max_in_flight = std::max(max_in_flight, conn->stats().in_flight);
+    }
+    ASSERT_TRUE(server_side.wait([&](ordered_receiver& rcv) { return rcv.next == total; }));
+    EXPECT_TRUE(server_side.in_order);
+    EXPECT_LE(max_in_flight, so.reorder_window);
+    EXPECT_GT(conn->stats().window_stalls, 0u);
+}
+
+TEST(StripedTest, InvalidUseThrows) {
+    thread_pool pool(2);
+    reactor r(pool);
+    striped_listener listener{striped_handler()};
+    const uint16_t port = r.listen("127.0.0.1", 0, listener.handler());
+
+    striped_options bad;
+    bad.streams = 0;
+    EXPECT_THROW(striped_connection::connect(r, "127.0.0.1", port, striped_handler(), bad), std::invalid_argument);
+    bad.streams = 2;
+    bad.send_queue_frames = 1000;
+    EXPECT_THROW(striped_listener(striped_handler(), bad), std::invalid_argument);
+
+    auto conn = striped_connection::connect(r, "127.0.0.1", port, striped_handler());
+    frame reserved;
+    reserved.type = static_cast<uint16_t>(striped_frame::ack);
+    EXPECT_THROW(conn->send(reserved), std::invalid_argument);
+}
+
+TEST(ConnectionTest, InvalidOptionsThrow) {
+    thread_pool pool(1);
+    reactor_options options;
+    options.io_threads = 0;
+    EXPECT_THROW(reactor(pool, options), std::invalid_argument);
+    options.io_threads = 1;
+    options.recv_queue_frames = 3;
+    EXPECT_THROW(reactor(pool, options), std::invalid_argument);
+    options.recv_queue_frames = 4;
+    options.file_blocks = 0;
+    EXPECT_THROW(reactor(pool, options), std::invalid_argument);
+    EXPECT_THROW(reactor(pool).connect("127.0.0.1", 1, connection_handler()), std::system_error);
+}
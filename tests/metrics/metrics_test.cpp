@@ -0,0 +1,209 @@
+#include "../../include/metrics/metrics.h"
+#include "../../include/metrics/trace.h"
+#include "../../include/ring_buffer/ring_buffer.h"
+#include "../../include/thread_pool/thread_pool.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+size_t count_of(const std::string& text, const std::string& needle) {
+    size_t n = 0;
+    for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + needle.size())) {
+        ++n;
+    }
+    return n;
+}
+
+}  // namespace
+
+// 多个线程写入不同分片，读数是所有分片之和
+TEST(MetricsTest, CounterSumsShardsAcrossThreads) {
+    metric_counter counter;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&counter] {
+            for (int i = 0; i < 10000; ++i) {
+                counter.add();
+            }
+            counter.add(5);
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(counter.value(), 8u * 10005u);
+}
+
+// 桶的边界连续覆盖整个范围，分位数的相对误差不超过一个子桶
+TEST(MetricsTest, HistogramBucketsAndQuantiles) {
+    for (size_t b = 1; b < metric_histogram::bucket_count; ++b) {
+        ASSERT_EQ(metric_histogram::bucket_of(metric_histogram::bucket_upper(b - 1) + 1), b);
+        ASSERT_EQ(metric_histogram::bucket_of(metric_histogram::bucket_upper(b)), b);
+    }
+    EXPECT_EQ(metric_histogram::bucket_upper(metric_histogram::bucket_count - 1), UINT64_MAX);
+
+    metric_histogram histogram;
+    for (uint64_t v = 1; v <= 1000; ++v) {
+        histogram.record(v * 1000);
+    }
+    const metric_histogram::snapshot s = histogram.read();
+    EXPECT_EQ(s.count, 1000u);
+    EXPECT_EQ(s.sum, 1000u * 1001u / 2 * 1000u);
+    for (double q : {0.5, 0.9, 0.99}) {
+        const double exact = q * 1000 * 1000;
+        const double got = static_cast<double>(s.quantile(q));
+        EXPECT_GE(got, exact);
+        EXPECT_LE(got, exact * 1.125 + 1);
+    }
+    EXPECT_EQ(s.quantile(1.0), metric_histogram::bucket_upper(metric_histogram::bucket_of(1000000)));
+    EXPECT_EQ(s.count_at_most(999), 0u);
+    EXPECT_EQ(s.count_at_most(1023), 1u);
+    EXPECT_EQ(s.count_at_most(UINT64_MAX), 1000u);
+    EXPECT_EQ(metric_histogram().read().quantile(0.5), 0u);
+}
+
+// 同名同标签返回同一个对象，同名的样本归在一个指标族下，收集函数注销后不再出现
+TEST(MetricsTest, PrometheusExport) {
+    metrics_registry registry;
+    metric_counter& a = registry.counter("test_requests_total", "Requests", {{"kind", "a"}});
+    metric_counter& b = registry.counter("test_requests_total", "Requests", {{"kind", "b\"q"}});
+    EXPECT_EQ(&a, &registry.counter("test_requests_total", "Requests", {{"kind", "a"}}));
+    a.add(3);
+    b.add(1);
+
+    metric_histogram& latency = registry.histogram("test_latency_seconds", "Latency", {}, 1e-9);
+    latency.record(1500);
+    latency.record(3000000);
+    // 恰好落在边界上的值：le 是闭区间
+    metric_histogram& edge = registry.histogram("test_edge", "Edge", {});
+    edge.record(1023);
+    edge.record(1024);
+
+    metric_registration registration = registry.add_collector([](metric_writer& writer) {
+        writer.gauge("test_depth", "Depth", {{"queue", "x"}}, 7);
+    });
+
+    std::string text = registry.prometheus();
+    EXPECT_EQ(count_of(text, "# TYPE test_requests_total counter\n"), 1u);
+    EXPECT_NE(text.find("test_requests_total{kind=\"a\"} 3\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_requests_total{kind=\"b\\\"q\"} 1\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("# TYPE test_latency_seconds histogram\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"+Inf\"} 2\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"1.023e-06\"} 0\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"2.047e-06\"} 1\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_edge_bucket{le=\"511\"} 0\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_edge_bucket{le=\"1023\"} 1\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_edge_bucket{le=\"2047\"} 2\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("test_latency_seconds_count 2\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_sum 0.0030015\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("# TYPE test_depth gauge\ntest_depth{queue=\"x\"} 7\n"), std::string::npos) << text;
+
+    registration.reset();
+    text = registry.prometheus();
+    EXPECT_EQ(text.find("test_depth"), std::string::npos);
+
+    const std::string path = testing::TempDir() + "metrics_test.prom";
+    registry.write_prometheus(path);
+    FILE* f = std::fopen(path.c_str(), "rb");
+    ASSERT_NE(f, nullptr);
+    std::string read(text.size() + 1, '\0');
+    read.resize(std::fread(&read[0], 1, read.size(), f));
+    std::fclose(f);
+    std::remove(path.c_str());
+    EXPECT_EQ(read, text);
+}
+
+#if defined(SYNC_RING_BUFFER_METRICS)
+// 满和空的失败都计入全局计数器，并出现在全局注册表的导出中
+TEST(MetricsTest, RingBufferCountsFullAndEmpty) {
+    const uint64_t full = ring_buffer_counters.push_full.value();
+    const uint64_t empty = ring_buffer_counters.get_empty.value();
+
+    ring_buffer<int, 4> buffer;
+    int value = 0;
+    EXPECT_FALSE(buffer.get(value));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(buffer.push(i));
+    }
+    EXPECT_FALSE(buffer.push(4));
+    EXPECT_FALSE(buffer.push(5));
+
+    EXPECT_EQ(ring_buffer_counters.push_full.value() - full, 2u);
+    EXPECT_EQ(ring_buffer_counters.get_empty.value() - empty, 1u);
+    EXPECT_NE(metrics_registry::global().prometheus().find("# TYPE sync_ring_buffer_push_full_total counter"),
+              std::string::npos);
+}
+#endif
+
+#if defined(SYNC_METRICS)
+// 每个执行过的任务都记录一次排队时间和执行时间
+TEST(MetricsTest, ThreadPoolRecordsTaskLatency) {
+    {
+        // 先执行一个任务，让线程池注册直方图
+        thread_pool warm(1);
+        warm.submit_to(task_lane::hash, [] {}).get();
+    }
+    metrics_registry& registry = metrics_registry::global();
+    const metric_labels labels = {{"lane", "hash"}};
+    metric_histogram& run = registry.histogram("sync_thread_pool_task_run_seconds", "", labels, 1e-9);
+    const uint64_t before = run.read().count;
+    {
+        thread_pool pool(2);
+        std::vector<std::future<void>> results;
+        for (int i = 0; i < 50; ++i) {
+            results.push_back(pool.submit_to(task_lane::hash, [] {
+                std::this_thread::sleep_for(std::chrono::microseconds(10));
+            }));
+        }
+        for (auto& r : results) {
+            r.get();
+        }
+        const std::string text = registry.prometheus();
+        EXPECT_NE(text.find("sync_thread_pool_queued_tasks{pool="), std::string::npos);
+    }
+    const metric_histogram::snapshot s = run.read();
+    EXPECT_EQ(s.count - before, 50u);
+    EXPECT_GE(s.quantile(0.5), 10000u);
+    EXPECT_NE(registry.prometheus().find("sync_thread_pool_task_wait_seconds_count{lane=\"hash\"}"),
+              std::string::npos);
+}
+
+// 只有开启期间的区间被记录，编号相同的区间用 flow 连起来
+TEST(MetricsTest, TraceWritesChromeEvents) {
+    { trace_span before("idle", "test", 1); }
+    trace_start(16);
+    {
+        SYNC_TRACE_SPAN("read", "test", 42);
+    }
+    std::thread([] { SYNC_TRACE_SPAN("hash", "test", 42); }).join();
+    {
+        SYNC_TRACE_SPAN("other", "test", 0);
+    }
+    for (int i = 0; i < 20; ++i) {
+        trace_span filler("filler", "test", 0);
+    }
+    trace_stop();
+    { trace_span after("late", "test", 42); }
+
+    std::ostringstream out;
+    trace_write(out);
+    const std::string json = out.str();
+    EXPECT_EQ(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+    EXPECT_EQ(json.find("\"idle\""), std::string::npos);
+    EXPECT_EQ(json.find("\"late\""), std::string::npos);
+    EXPECT_NE(json.find("{\"name\":\"read\",\"cat\":\"test\",\"ph\":\"X\""), std::string::npos) << json;
+    EXPECT_NE(json.find("\"name\":\"hash\""), std::string::npos);
+    EXPECT_NE(json.find("\"args\":{\"id\":42}"), std::string::npos);
+    EXPECT_EQ(count_of(json, "\"ph\":\"s\""), 1u);
+    EXPECT_EQ(count_of(json, "\"ph\":\"f\""), 1u);
+    EXPECT_EQ(count_of(json, "\"ph\":\"X\""), 16u + 1u);
+    EXPECT_EQ(trace_dropped(), 6u);
+}
+#endif
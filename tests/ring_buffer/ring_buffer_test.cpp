@@ -1,4 +1,6 @@
 #include "../../include/ring_buffer/ring_buffer.h"
+#include "../../include/ring_buffer/spsc_ring_buffer.h"
+#include "../../include/ring_buffer/blocking_ring_buffer.h"
 #include <gtest/gtest.h>
 #include <thread>
 #include <vector>
@@ -6,7 +8,10 @@
 #include <chrono>
 #include <random>
 #include <mutex>
-#include <iostream>
+#include <type_traits>
+#include <memory>
+#include <string>
+#include <stdexcept>
 
 
 // 单生产者单消费者测试 - 使用更可靠的验证方法
@@ -555,6 +560,56 @@ TEST(RingBufferTest, StressTest) {
     }
 }
 
+// 保留seq_cst内存序策略的多生产者多消费者测试
+TEST(RingBufferTest, SeqCstOrderPolicy) {
+    ring_buffer<int, 64, seq_cst_order> rb;
+    std::atomic<int> consumed_count(0);
+    std::atomic<long long> consumed_sum(0);
+
+    const int NUM_PRODUCERS = 4;
+    const int NUM_CONSUMERS = 4;
+    const int ITEMS_PER_PRODUCER = 10000;
+    const int TOTAL_ITEMS = NUM_PRODUCERS * ITEMS_PER_PRODUCER;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        producers.emplace_back([&, p]() {
+            for (int i = 1; i <= ITEMS_PER_PRODUCER; i++) {
+                int value = p * ITEMS_PER_PRODUCER + i;
+                while (!rb.push(value)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < NUM_CONSUMERS; c++) {
+        consumers.emplace_back([&]() {
+            int value;
+            while (consumed_count < TOTAL_ITEMS) {
+                if (rb.get(value)) {
+                    consumed_sum.fetch_add(value, std::memory_order_relaxed);
+                    consumed_count.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (auto& p : producers) {
+        p.join();
+    }
+    for (auto& c : consumers) {
+        c.join();
+    }
+
+    const long long expected_sum = static_cast<long long>(TOTAL_ITEMS) * (TOTAL_ITEMS + 1) / 2;
+    EXPECT_EQ(consumed_count.load(), TOTAL_ITEMS);
+    EXPECT_EQ(consumed_sum.load(), expected_sum);
+}
+
 // Custom type test
 struct TestStruct {
     int id;
@@ -621,6 +676,955 @@ TEST(RingBufferTest, CustomTypeTest) {
     EXPECT_FALSE(rb.get(value));
 }
 
+// 批量接口的部分成功语义
+TEST(RingBufferTest, BatchPartialTransfer) {
+    ring_buffer<int, 16> rb;
+    std::vector<int> input(20);
+    for (int i = 0; i < 20; i++) {
+        input[i] = i;
+    }
+
+    // 只能写入容量个元素
+    EXPECT_EQ(rb.push_n(input.begin(), input.end()), 16u);
+    EXPECT_EQ(rb.push_n(input.begin() + 16, input.end()), 0u);
+    EXPECT_FALSE(rb.push(100));
+
+    std::vector<int> output;
+    EXPECT_EQ(rb.get_n(std::back_inserter(output), 10), 10u);
+    EXPECT_EQ(rb.push_n(input.begin() + 16, input.end()), 4u);
+    EXPECT_EQ(rb.get_n(std::back_inserter(output), 100), 10u);
+    EXPECT_EQ(rb.get_n(std::back_inserter(output), 100), 0u);
+
+    ASSERT_EQ(output.size(), 20u);
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ(output[i], i);
+    }
+
+    // 批量接口与单元素接口混用
+    EXPECT_TRUE(rb.push(7));
+    int value;
+    EXPECT_EQ(rb.get_n(&value, 1), 1u);
+    EXPECT_EQ(value, 7);
+}
+
+// 批量接口的多生产者多消费者测试
+TEST(RingBufferTest, BatchMultipleProducersMultipleConsumers) {
+    ring_buffer<int, 64> rb;
+    std::atomic<int> consumed_count(0);
+
+    const int NUM_PRODUCERS = 4;
+    const int NUM_CONSUMERS = 4;
+    const int ITEMS_PER_PRODUCER = 10000;
+    const int BATCH = 8;
+    const int TOTAL_ITEMS = NUM_PRODUCERS * ITEMS_PER_PRODUCER;
+
+    // 0 = 未消费, 1 = 已消费
+    std::vector<std::atomic<int>> item_status(TOTAL_ITEMS + 1);
+    for (int i = 0; i <= TOTAL_ITEMS; i++) {
+        item_status[i].store(0, std::memory_order_relaxed);
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        producers.emplace_back([&, p]() {
+            std::vector<int> batch;
+            for (int i = 1; i <= ITEMS_PER_PRODUCER; i += BATCH) {
+                batch.clear();
+                for (int j = i; j < i + BATCH && j <= ITEMS_PER_PRODUCER; j++) {
+                    batch.push_back(p * ITEMS_PER_PRODUCER + j);
+                }
+                // 部分成功时从未写入的位置继续
+                auto it = batch.begin();
+                while (it != batch.end()) {
+                    size_t pushed = rb.push_n(it, batch.end());
+                    if (pushed == 0) {
+                        std::this_thread::yield();
+                    }
+                    it += pushed;
+                }
+            }
+        });
+    }
+
+    std::atomic<bool> duplicate(false);
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < NUM_CONSUMERS; c++) {
+        consumers.emplace_back([&]() {
+            int values[BATCH];
+            while (consumed_count < TOTAL_ITEMS) {
+                size_t count = rb.get_n(values, BATCH);
+                if (count == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (size_t k = 0; k < count; k++) {
+                    if (values[k] <= 0 || values[k] > TOTAL_ITEMS ||
+                        item_status[values[k]].exchange(1) != 0) {
+                        duplicate = true;
+                    }
+                }
+                consumed_count.fetch_add(static_cast<int>(count), std::memory_order_relaxed);
+            }
+        });
+    }
+
+    for (auto& p : producers) {
+        p.join();
+    }
+    for (auto& c : consumers) {
+        c.join();
+    }
+
+    EXPECT_FALSE(duplicate.load());
+    EXPECT_EQ(consumed_count.load(), TOTAL_ITEMS);
+    for (int i = 1; i <= TOTAL_ITEMS; i++) {
+        EXPECT_EQ(item_status[i].load(), 1) << "Item " << i << " was not consumed";
+    }
+}
+
+// 就地写入/读取的槽位接口
+TEST(RingBufferTest, ReserveCommitPeekRelease) {
+    ring_buffer<TestStruct, 4> rb;
+
+    for (int i = 0; i < 4; i++) {
+        auto slot = rb.try_reserve();
+        ASSERT_TRUE(slot);
+        slot->id = i;
+        slot->data = "slot_" + std::to_string(i);
+        slot.commit();
+        EXPECT_FALSE(slot);
+    }
+    EXPECT_FALSE(rb.try_reserve());
+
+    for (int i = 0; i < 4; i++) {
+        auto slot = rb.try_peek();
+        ASSERT_TRUE(slot);
+        EXPECT_EQ(slot->id, i);
+        EXPECT_EQ((*slot).data, "slot_" + std::to_string(i));
+        slot.release();
+    }
+    EXPECT_FALSE(rb.try_peek());
+
+    // 句柄析构时自动提交/释放，与push/get混用
+    {
+        auto slot = rb.try_reserve();
+        ASSERT_TRUE(slot);
+        slot->id = 42;
+    }
+    TestStruct value;
+    EXPECT_TRUE(rb.get(value));
+    EXPECT_EQ(value.id, 42);
+
+    EXPECT_TRUE(rb.push(TestStruct(7, "seven")));
+    {
+        auto slot = rb.try_peek();
+        ASSERT_TRUE(slot);
+        EXPECT_EQ(slot->id, 7);
+    }
+    EXPECT_FALSE(rb.get(value));
+}
+
+// 槽位接口的多生产者多消费者测试
+TEST(RingBufferTest, ReservePeekMultipleProducersMultipleConsumers) {
+    ring_buffer<int, 32> rb;
+    const int NUM_PRODUCERS = 4;
+    const int NUM_CONSUMERS = 4;
+    const int ITEMS_PER_PRODUCER = 10000;
+    const int TOTAL_ITEMS = NUM_PRODUCERS * ITEMS_PER_PRODUCER;
+
+    std::vector<std::atomic<int>> item_status(TOTAL_ITEMS + 1);
+    for (int i = 0; i <= TOTAL_ITEMS; i++) {
+        item_status[i].store(0, std::memory_order_relaxed);
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        producers.emplace_back([&, p]() {
+            for (int i = 1; i <= ITEMS_PER_PRODUCER; i++) {
+                for (;;) {
+                    auto slot = rb.try_reserve();
+                    if (slot) {
+                        *slot = p * ITEMS_PER_PRODUCER + i;
+                        slot.commit();
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::atomic<int> consumed_count(0);
+    std::atomic<bool> duplicate(false);
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < NUM_CONSUMERS; c++) {
+        consumers.emplace_back([&]() {
+            while (consumed_count < TOTAL_ITEMS) {
+                auto slot = rb.try_peek();
+                if (!slot) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                int value = *slot;
+                slot.release();
+                if (value <= 0 || value > TOTAL_ITEMS || item_status[value].exchange(1) != 0) {
+                    duplicate = true;
+                }
+                consumed_count.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    for (auto& p : producers) {
+        p.join();
+    }
+    for (auto& c : consumers) {
+        c.join();
+    }
+
+    EXPECT_FALSE(duplicate.load());
+    EXPECT_EQ(consumed_count.load(), TOTAL_ITEMS);
+}
+
+// 统计存活实例数量，且没有默认构造函数
+struct LifetimeTracked {
+    static std::atomic<int> alive;
+    int id;
+
+    explicit LifetimeTracked(int i) : id(i) { alive++; }
+    LifetimeTracked(LifetimeTracked&& other) noexcept : id(other.id) { alive++; }
+    LifetimeTracked& operator=(LifetimeTracked&& other) noexcept {
+        id = other.id;
+        return *this;
+    }
+    LifetimeTracked(const LifetimeTracked&) = delete;
+    LifetimeTracked& operator=(const LifetimeTracked&) = delete;
+    ~LifetimeTracked() { alive--; }
+};
+std::atomic<int> LifetimeTracked::alive(0);
+
+// 只能移动的元素类型
+TEST(RingBufferTest, MoveOnlyElements) {
+    ring_buffer<std::unique_ptr<int>, 8> rb;
+
+    EXPECT_TRUE(rb.push(std::make_unique<int>(1)));
+    EXPECT_TRUE(rb.emplace(new int(2)));
+    auto three = std::make_unique<int>(3);
+    EXPECT_TRUE(rb.push(std::move(three)));
+
+    std::unique_ptr<int> value;
+    for (int i = 1; i <= 3; i++) {
+        EXPECT_TRUE(rb.get(value));
+        ASSERT_TRUE(value);
+        EXPECT_EQ(*value, i);
+    }
+    EXPECT_FALSE(rb.get(value));
+}
+
+// 元素只在入队时构造一次，出队时析构，缓冲区析构时清理剩余元素
+TEST(RingBufferTest, ElementLifetime) {
+    LifetimeTracked::alive = 0;
+    {
+        ring_buffer<LifetimeTracked, 8> rb;
+        EXPECT_EQ(LifetimeTracked::alive.load(), 0);
+
+        for (int i = 0; i < 8; i++) {
+            EXPECT_TRUE(rb.emplace(i));
+        }
+        EXPECT_FALSE(rb.emplace(100));
+        EXPECT_EQ(LifetimeTracked::alive.load(), 8);
+
+        LifetimeTracked value(-1);
+        EXPECT_TRUE(rb.get(value));
+        EXPECT_EQ(value.id, 0);
+        EXPECT_EQ(LifetimeTracked::alive.load(), 8);
+
+        {
+            auto slot = rb.try_peek();
+            ASSERT_TRUE(slot);
+            EXPECT_EQ(slot->id, 1);
+        }
+        EXPECT_EQ(LifetimeTracked::alive.load(), 7);
+    }
+    EXPECT_EQ(LifetimeTracked::alive.load(), 0);
+
+    {
+        spsc_ring_buffer<LifetimeTracked, 4> rb;
+        EXPECT_TRUE(rb.emplace(1));
+        EXPECT_TRUE(rb.emplace(2));
+        EXPECT_EQ(LifetimeTracked::alive.load(), 2);
+    }
+    EXPECT_EQ(LifetimeTracked::alive.load(), 0);
+}
+
+// 构造时可能抛出异常的元素：值为负数时抛出
+struct ThrowingElement {
+    int value = 0;
+
+    ThrowingElement() = default;
+    explicit ThrowingElement(int v) : value(v) {
+        if (v < 0) {
+            throw std::runtime_error("negative");
+        }
+    }
+    ThrowingElement(const ThrowingElement& other) : ThrowingElement(other.value) {}
+    ThrowingElement(ThrowingElement&& other) noexcept : value(other.value) {}
+    ThrowingElement& operator=(const ThrowingElement& other) = default;
+    ThrowingElement& operator=(ThrowingElement&& other) noexcept = default;
+};
+
+// 构造抛出异常后缓冲区仍然可用：没有占有后不发布的单元格，已写入的元素都能读出
+template <typename buffer_type>
+static void check_throwing_construction() {
+    buffer_type rb;
+    EXPECT_THROW(rb.emplace(-1), std::runtime_error);
+    EXPECT_TRUE(rb.emplace(1));
+
+    const std::vector<ThrowingElement> batch = {ThrowingElement(2), ThrowingElement(3), ThrowingElement(4)};
+    std::vector<ThrowingElement> with_bad = batch;
+    with_bad[1].value = -1;  // 拷贝时抛出
+    EXPECT_THROW(rb.push_n(with_bad.begin(), with_bad.end()), std::runtime_error);
+    EXPECT_EQ(rb.push_n(batch.begin() + 1, batch.end()), 2u);
+
+    std::vector<int> got;
+    ThrowingElement value;
+    while (rb.get(value)) {
+        got.push_back(value.value);
+    }
+    EXPECT_EQ(got, (std::vector<int>{1, 2, 3, 4}));
+    EXPECT_TRUE(rb.emplace(5));
+    ASSERT_TRUE(rb.get(value));
+    EXPECT_EQ(value.value, 5);
+}
+
+TEST(RingBufferTest, ThrowingConstructorKeepsQueueUsable) {
+    check_throwing_construction<ring_buffer<ThrowingElement, 8>>();
+    check_throwing_construction<spsc_ring_buffer<ThrowingElement, 8>>();
+}
+
+// 剩余次数用完后赋值抛出异常的输出迭代器，模拟 back_inserter 的 push_back 抛出 bad_alloc
+struct throwing_output {
+    std::vector<int>* out;
+    int* remaining;
+
+    throwing_output& operator*() { return *this; }
+    throwing_output& operator++() { return *this; }
+    throwing_output& operator=(int&& value) {
+        if ((*remaining)-- == 0) {
+            throw std::runtime_error("output full");
+        }
+        out->push_back(value);
+        return *this;
+    }
+};
+
+// 出队时抛出异常后缓冲区仍然可用；expected 为之后还能读出的元素
+template <typename buffer_type>
+static void check_throwing_output(const std::vector<int>& expected) {
+    buffer_type rb;
+    for (int i = 1; i <= 6; i++) {
+        ASSERT_TRUE(rb.push(i));
+    }
+    std::vector<int> got;
+    int remaining = 2;
+    EXPECT_THROW(rb.get_n(throwing_output{&got, &remaining}, 4), std::runtime_error);
+    EXPECT_EQ(got, (std::vector<int>{1, 2}));
+
+    ASSERT_TRUE(rb.push(7));
+    got.clear();
+    int value;
+    while (rb.get(value)) {
+        got.push_back(value);
+    }
+    EXPECT_EQ(got, expected);
+    for (int i = 0; i < 8; i++) {
+        ASSERT_TRUE(rb.push(i));
+    }
+    EXPECT_EQ(rb.get_n(std::back_inserter(got), 8), 8u);
+}
+
+// 移动赋值时值为负数就抛出异常的元素
+struct AssignThrows {
+    int value = 0;
+
+    AssignThrows() = default;
+    explicit AssignThrows(int v) noexcept : value(v) {}
+    AssignThrows(AssignThrows&& other) noexcept : value(other.value) {}
+    AssignThrows& operator=(AssignThrows&& other) {
+        if (other.value < 0) {
+            throw std::runtime_error("negative");
+        }
+        value = other.value;
+        return *this;
+    }
+};
+
+TEST(RingBufferTest, ThrowingConsumerKeepsQueueUsable) {
+    // MPMC 已争抢到的单元格必须交还，出错的和同一批之后的元素被丢弃
+    check_throwing_output<ring_buffer<int, 8>>({5, 6, 7});
+    // SPSC 出错的元素和之后的元素留在缓冲区中
+    check_throwing_output<spsc_ring_buffer<int, 8>>({3, 4, 5, 6, 7});
+
+    ring_buffer<AssignThrows, 4> rb;
+    ASSERT_TRUE(rb.emplace(-1));
+    ASSERT_TRUE(rb.emplace(2));
+    AssignThrows value;
+    EXPECT_THROW(rb.get(value), std::runtime_error);
+    ASSERT_TRUE(rb.get(value));
+    EXPECT_EQ(value.value, 2);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(rb.emplace(i));
+    }
+    EXPECT_FALSE(rb.emplace(9));
+}
+
+// 运行时容量的缓冲区
+TEST(RingBufferTest, DynamicCapacity) {
+    EXPECT_THROW((ring_buffer<int, dynamic_capacity>(0)), std::invalid_argument);
+    EXPECT_THROW((ring_buffer<int, dynamic_capacity>(1)), std::invalid_argument);
+    EXPECT_THROW((ring_buffer<int, dynamic_capacity>(100)), std::invalid_argument);
+
+    ring_buffer<TestStruct, dynamic_capacity> rb(8);
+    EXPECT_EQ(rb.capacity(), 8u);
+    for (int i = 0; i < 8; i++) {
+        EXPECT_TRUE(rb.push(TestStruct(i, std::to_string(i))));
+    }
+    EXPECT_FALSE(rb.push(TestStruct()));
+
+    TestStruct value;
+    for (int i = 0; i < 8; i++) {
+        EXPECT_TRUE(rb.get(value));
+        EXPECT_EQ(value.id, i);
+        EXPECT_EQ(value.data, std::to_string(i));
+    }
+    EXPECT_FALSE(rb.get(value));
+}
+
+// 大页存储的大容量缓冲区：大页不可用时退化为普通页，功能不受影响
+TEST(RingBufferTest, DynamicCapacityHugePages) {
+    ring_buffer_options options;
+    options.huge_pages = true;
+    ring_buffer<uint64_t, dynamic_capacity> rb(1u << 16, options);
+    EXPECT_EQ(rb.capacity(), 1u << 16);
+
+    const int NUM_PRODUCERS = 2;
+    const int ITEMS_PER_PRODUCER = 100000;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        producers.emplace_back([&, p]() {
+            for (uint64_t i = 1; i <= ITEMS_PER_PRODUCER; i++) {
+                while (!rb.push(p * ITEMS_PER_PRODUCER + i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    uint64_t sum = 0;
+    uint64_t value;
+    for (int received = 0; received < NUM_PRODUCERS * ITEMS_PER_PRODUCER;) {
+        if (rb.get(value)) {
+            sum += value;
+            received++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    for (auto& p : producers) {
+        p.join();
+    }
+
+    const uint64_t total = NUM_PRODUCERS * ITEMS_PER_PRODUCER;
+    EXPECT_EQ(sum, total * (total + 1) / 2);
+    RecordProperty("huge_pages", rb.huge_pages() ? "yes" : "no");
+}
+
+// 指定 NUMA 节点分配：节点偏好设置失败（单节点机器、容器限制）时功能不受影响
+TEST(RingBufferTest, DynamicCapacityNumaNode) {
+    ring_buffer_options options;
+    options.numa_node = 0;
+    ring_buffer<uint64_t, dynamic_capacity> rb(1024, options);
+    spsc_ring_buffer<uint64_t, dynamic_capacity> spsc(1024, options);
+
+    for (uint64_t i = 0; i < 1024; i++) {
+        ASSERT_TRUE(rb.push(i));
+        ASSERT_TRUE(spsc.push(i));
+    }
+    EXPECT_FALSE(rb.push(0));
+    uint64_t value;
+    for (uint64_t i = 0; i < 1024; i++) {
+        ASSERT_TRUE(rb.get(value));
+        EXPECT_EQ(value, i);
+        ASSERT_TRUE(spsc.get(value));
+        EXPECT_EQ(value, i);
+    }
+
+    // 巨页与节点偏好可以同时请求
+    options.huge_pages = true;
+    ring_buffer<uint64_t, dynamic_capacity> both(1u << 16, options);
+    EXPECT_TRUE(both.push(1));
+    RecordProperty("numa_bound", rb.numa_bound() ? "yes" : "no");
+}
+
+// 验证每个值恰好被消费一次的多生产者多消费者压力测试
+template <typename buffer_type>
+static void run_exactly_once_stress(buffer_type& rb, int num_producers, int num_consumers, int items_per_producer) {
+    const int total_items = num_producers * items_per_producer;
+    std::vector<std::atomic<int>> item_status(total_items + 1);
+    for (int i = 0; i <= total_items; i++) {
+        item_status[i].store(0, std::memory_order_relaxed);
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < num_producers; p++) {
+        producers.emplace_back([&, p]() {
+            for (int i = 1; i <= items_per_producer; i++) {
+                while (!rb.push(p * items_per_producer + i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::atomic<int> consumed_count(0);
+    std::atomic<bool> duplicate(false);
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < num_consumers; c++) {
+        consumers.emplace_back([&]() {
+            int value;
+            while (consumed_count < total_items) {
+                if (rb.get(value)) {
+                    if (value <= 0 || value > total_items || item_status[value].exchange(1) != 0) {
+                        duplicate = true;
+                    }
+                    consumed_count.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (auto& p : producers) {
+        p.join();
+    }
+    for (auto& c : consumers) {
+        c.join();
+    }
+
+    EXPECT_FALSE(duplicate.load());
+    EXPECT_EQ(consumed_count.load(), total_items);
+}
+
+// 单元格布局策略：填充布局按缓存行对齐，打散布局保持FIFO且是双射
+TEST(RingBufferTest, CellLayouts) {
+    ring_buffer<int, 16, acq_rel_order, padded_layout> padded;
+    run_exactly_once_stress(padded, 8, 8, 1000);
+
+    ring_buffer<int, 16, acq_rel_order, scrambled_layout> scrambled;
+    run_exactly_once_stress(scrambled, 8, 8, 1000);
+
+    ring_buffer<int, dynamic_capacity, acq_rel_order, scrambled_layout> scrambled_dynamic(1024);
+    run_exactly_once_stress(scrambled_dynamic, 4, 4, 10000);
+
+    // 各种容量下打散映射都覆盖全部单元格，且顺序与压入顺序一致
+    ring_buffer<int, 2, acq_rel_order, scrambled_layout> tiny;
+    ring_buffer<int, 64, acq_rel_order, scrambled_layout> medium;
+    int value;
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 2; i++) {
+            EXPECT_TRUE(tiny.push(round * 2 + i));
+        }
+        EXPECT_FALSE(tiny.push(-1));
+        for (int i = 0; i < 2; i++) {
+            EXPECT_TRUE(tiny.get(value));
+            EXPECT_EQ(value, round * 2 + i);
+        }
+
+        for (int i = 0; i < 64; i++) {
+            EXPECT_TRUE(medium.push(round * 64 + i));
+        }
+        EXPECT_FALSE(medium.push(-1));
+        for (int i = 0; i < 64; i++) {
+            EXPECT_TRUE(medium.get(value));
+            EXPECT_EQ(value, round * 64 + i);
+        }
+        EXPECT_FALSE(medium.get(value));
+    }
+}
+
+// SPSC缓冲区：与RingBufferTest.SingleProducerSingleConsumer相同的验证方法
+TEST(SpscRingBufferTest, SingleProducerSingleConsumer) {
+    spsc_ring_buffer<int, 128> rb;
+    const int NUM_ITEMS = 1000000;
+    std::atomic<bool> ordered(true);
+
+    std::thread producer([&]() {
+        for (int i = 1; i <= NUM_ITEMS; i++) {
+            while (!rb.push(i)) {
+                std::this_thread::yield(); // 缓冲区满，让出CPU
+            }
+        }
+    });
+
+    // 单生产者单消费者必须保持FIFO顺序
+    std::thread consumer([&]() {
+        int value;
+        int expected = 1;
+        while (expected <= NUM_ITEMS) {
+            if (rb.get(value)) {
+                if (value != expected) {
+                    ordered = false;
+                }
+                expected++;
+            } else {
+                std::this_thread::yield(); // 缓冲区空，让出CPU
+            }
+        }
+    });
+
+    producer.join();
+    consumer.join();
+
+    EXPECT_TRUE(ordered.load());
+    int value;
+    EXPECT_FALSE(rb.get(value));
+}
+
+// 满/空边界与索引回绕
+TEST(SpscRingBufferTest, FullEmptyWraparound) {
+    spsc_ring_buffer<int, 4> rb;
+    int value;
+
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 4; i++) {
+            EXPECT_TRUE(rb.push(round * 4 + i));
+        }
+        EXPECT_FALSE(rb.push(-1));
+
+        for (int i = 0; i < 4; i++) {
+            EXPECT_TRUE(rb.get(value));
+            EXPECT_EQ(value, round * 4 + i);
+        }
+        EXPECT_FALSE(rb.get(value));
+    }
+}
+
+TEST(SpscRingBufferTest, CustomTypeTest) {
+    spsc_ring_buffer<TestStruct, 16> rb;
+
+    for (int i = 0; i < 5; i++) {
+        EXPECT_TRUE(rb.push(TestStruct(i, "rvalue_" + std::to_string(i))));
+    }
+    for (int i = 5; i < 10; i++) {
+        TestStruct obj(i, "lvalue_" + std::to_string(i));
+        EXPECT_TRUE(rb.push(obj));
+    }
+
+    TestStruct value;
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(rb.get(value));
+        EXPECT_EQ(value.id, i);
+        std::string expected_prefix = (i < 5) ? "rvalue_" : "lvalue_";
+        EXPECT_EQ(value.data.substr(0, expected_prefix.length()), expected_prefix);
+    }
+    EXPECT_FALSE(rb.get(value));
+}
+
+// SPSC批量接口：部分成功语义与FIFO顺序
+TEST(SpscRingBufferTest, BatchTransfer) {
+    spsc_ring_buffer<int, 64> rb;
+    const int NUM_ITEMS = 100000;
+    std::atomic<bool> ordered(true);
+
+    std::thread producer([&]() {
+        int batch[16];
+        for (int i = 1; i <= NUM_ITEMS; i += 16) {
+            int n = 0;
+            for (int j = i; j < i + 16 && j <= NUM_ITEMS; j++) {
+                batch[n++] = j;
+            }
+            int* it = batch;
+            while (it != batch + n) {
+                size_t pushed = rb.push_n(it, batch + n);
+                if (pushed == 0) {
+                    std::this_thread::yield();
+                }
+                it += pushed;
+            }
+        }
+    });
+
+    std::thread consumer([&]() {
+        int values[24];
+        int expected = 1;
+        while (expected <= NUM_ITEMS) {
+            size_t count = rb.get_n(values, 24);
+            if (count == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (size_t k = 0; k < count; k++) {
+                if (values[k] != expected++) {
+                    ordered = false;
+                }
+            }
+        }
+    });
+
+    producer.join();
+    consumer.join();
+
+    EXPECT_TRUE(ordered.load());
+    int leftover;
+    EXPECT_EQ(rb.get_n(&leftover, 1), 0u);
+}
+
+// SPSC槽位接口：接收方直接写入缓冲区存储，处理方就地读取
+TEST(SpscRingBufferTest, ReserveCommitPeekRelease) {
+    struct chunk {
+        uint32_t length;
+        unsigned char bytes[4096];
+    };
+    static spsc_ring_buffer<chunk, 8> rb;
+    const int NUM_CHUNKS = 10000;
+
+    std::thread producer([&]() {
+        for (int i = 0; i < NUM_CHUNKS; i++) {
+            for (;;) {
+                auto slot = rb.try_reserve();
+                if (slot) {
+                    slot->length = static_cast<uint32_t>(i % 4096 + 1);
+                    for (uint32_t k = 0; k < slot->length; k++) {
+                        slot->bytes[k] = static_cast<unsigned char>(i + k);
+                    }
+                    slot.commit();
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    bool intact = true;
+    for (int i = 0; i < NUM_CHUNKS;) {
+        auto slot = rb.try_peek();
+        if (!slot) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (slot->length != static_cast<uint32_t>(i % 4096 + 1)) {
+            intact = false;
+        }
+        for (uint32_t k = 0; k < slot->length && intact; k++) {
+            if (slot->bytes[k] != static_cast<unsigned char>(i + k)) {
+                intact = false;
+            }
+        }
+        slot.release();
+        i++;
+    }
+    producer.join();
+
+    EXPECT_TRUE(intact);
+    EXPECT_FALSE(rb.try_peek());
+}
+
+// 运行时容量的SPSC缓冲区，以及其阻塞包装
+TEST(SpscRingBufferTest, DynamicCapacity) {
+    EXPECT_THROW((spsc_ring_buffer<int, dynamic_capacity>(6)), std::invalid_argument);
+
+    blocking_ring_buffer<spsc_ring_buffer<int, dynamic_capacity>> rb(16u);
+    EXPECT_EQ(rb.capacity(), 16u);
+    const int NUM_ITEMS = 100000;
+
+    std::thread producer([&]() {
+        for (int i = 1; i <= NUM_ITEMS; i++) {
+            rb.push_wait(i);
+        }
+        rb.close();
+    });
+
+    int value;
+    int expected = 1;
+    while (rb.get_wait(value)) {
+        EXPECT_EQ(value, expected);
+        expected++;
+    }
+    producer.join();
+    EXPECT_EQ(expected, NUM_ITEMS + 1);
+}
+
+// 通过选择标签得到的类型可以直接替换
+TEST(SpscRingBufferTest, SelectByTag) {
+    static_assert(std::is_same<select_ring_buffer_t<int, 8, spsc_tag>, spsc_ring_buffer<int, 8>>::value,
+                  "spsc_tag must select spsc_ring_buffer");
+    static_assert(std::is_same<select_ring_buffer_t<int, 8, mpmc_tag>, ring_buffer<int, 8>>::value,
+                  "mpmc_tag must select ring_buffer");
+}
+
+// 单生产者单消费者交接：MPMC实现与SPSC实现都按顺序交付每个值（吞吐量对比见 ring_buffer_bench）
+template <typename buffer_type>
+static void check_spsc_handoff(int num_items) {
+    buffer_type rb;
+    long long sum = 0;
+    bool ordered = true;
+
+    std::thread producer([&]() {
+        for (int i = 1; i <= num_items; i++) {
+            while (!rb.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    std::thread consumer([&]() {
+        int value;
+        for (int received = 0; received < num_items;) {
+            if (rb.get(value)) {
+                ordered = ordered && value == received + 1;
+                sum += value;
+                received++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    producer.join();
+    consumer.join();
+
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(sum, static_cast<long long>(num_items) * (num_items + 1) / 2);
+}
+
+TEST(SpscRingBufferTest, HandoffAgainstMpmc) {
+    const int NUM_ITEMS = 1000000;
+    check_spsc_handoff<ring_buffer<int, 128>>(NUM_ITEMS);
+    check_spsc_handoff<spsc_ring_buffer<int, 128>>(NUM_ITEMS);
+}
+
+// 阻塞接口：小缓冲区迫使生产者和消费者都进入休眠
+TEST(BlockingRingBufferTest, ProducersConsumersPark) {
+    blocking_ring_buffer<ring_buffer<int, 4>> rb;
+    const int NUM_PRODUCERS = 3;
+    const int NUM_CONSUMERS = 3;
+    const int ITEMS_PER_PRODUCER = 20000;
+    const int TOTAL_ITEMS = NUM_PRODUCERS * ITEMS_PER_PRODUCER;
+
+    std::vector<std::atomic<int>> item_status(TOTAL_ITEMS + 1);
+    for (int i = 0; i <= TOTAL_ITEMS; i++) {
+        item_status[i].store(0, std::memory_order_relaxed);
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        producers.emplace_back([&, p]() {
+            for (int i = 1; i <= ITEMS_PER_PRODUCER; i++) {
+                EXPECT_TRUE(rb.push_wait(p * ITEMS_PER_PRODUCER + i));
+            }
+        });
+    }
+
+    std::atomic<int> consumed_count(0);
+    std::atomic<bool> duplicate(false);
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < NUM_CONSUMERS; c++) {
+        consumers.emplace_back([&]() {
+            int value;
+            while (rb.get_wait(value)) {
+                if (item_status[value].exchange(1) != 0) {
+                    duplicate = true;
+                }
+                consumed_count.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    for (auto& p : producers) {
+        p.join();
+    }
+    // 生产结束后关闭，消费者取完剩余元素后退出
+    rb.close();
+    for (auto& c : consumers) {
+        c.join();
+    }
+
+    EXPECT_FALSE(duplicate.load());
+    EXPECT_EQ(consumed_count.load(), TOTAL_ITEMS);
+}
+
+// 阻塞接口同样适用于SPSC缓冲区，且保持FIFO顺序
+TEST(BlockingRingBufferTest, SpscInOrder) {
+    blocking_ring_buffer<spsc_ring_buffer<int, 8>> rb;
+    const int NUM_ITEMS = 100000;
+
+    std::thread producer([&]() {
+        for (int i = 1; i <= NUM_ITEMS; i++) {
+            rb.push_wait(i);
+        }
+        rb.close();
+    });
+
+    int value;
+    int expected = 1;
+    while (rb.get_wait(value)) {
+        EXPECT_EQ(value, expected);
+        expected++;
+    }
+    producer.join();
+    EXPECT_EQ(expected, NUM_ITEMS + 1);
+}
+
+// 超时接口在满/空时按时返回
+TEST(BlockingRingBufferTest, TimedWaitTimesOut) {
+    blocking_ring_buffer<ring_buffer<int, 2>> rb;
+    int value;
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(rb.get_wait_for(value, std::chrono::milliseconds(20)));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+
+    EXPECT_TRUE(rb.push_wait_for(1, std::chrono::milliseconds(20)));
+    EXPECT_TRUE(rb.push_wait_for(2, std::chrono::milliseconds(20)));
+    start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(rb.push_wait_for(3, std::chrono::milliseconds(20)));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+
+    EXPECT_TRUE(rb.get_wait_for(value, std::chrono::milliseconds(20)));
+    EXPECT_EQ(value, 1);
+}
+
+// 休眠中的消费者能被之后的写入唤醒，失败的写入不会移走元素
+TEST(BlockingRingBufferTest, WakeupAndMoveOnlyOnSuccess) {
+    blocking_ring_buffer<ring_buffer<std::string, 2>> rb;
+
+    std::string received;
+    std::thread consumer([&]() {
+        EXPECT_TRUE(rb.get_wait(received));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_TRUE(rb.push(std::string("wake")));
+    consumer.join();
+    EXPECT_EQ(received, "wake");
+
+    EXPECT_TRUE(rb.push(std::string("a")));
+    EXPECT_TRUE(rb.push(std::string("b")));
+    EXPECT_FALSE(rb.push_wait_for(std::string("c"), std::chrono::milliseconds(1)));
+
+    // 缓冲区满时等待中的每次失败重试都不能移走元素：腾出空间后写入的仍是完整的值
+    std::thread producer([&]() {
+        EXPECT_TRUE(rb.push_wait_for(std::string("a string long enough to live on the heap"), std::chrono::seconds(5)));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::string value;
+    ASSERT_TRUE(rb.get_wait(value));
+    EXPECT_EQ(value, "a");
+    producer.join();
+    ASSERT_TRUE(rb.get_wait(value));
+    EXPECT_EQ(value, "b");
+    ASSERT_TRUE(rb.get_wait(value));
+    EXPECT_EQ(value, "a string long enough to live on the heap");
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
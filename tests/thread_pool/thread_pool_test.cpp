@@ -0,0 +1,440 @@
+#include "../../include/thread_pool/thread_pool.h"
+#include "../../include/thread_pool/work_steal_deque.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// 所有者视角：底部LIFO，扩容后元素不丢失
+TEST(WorkStealDequeTest, OwnerLifoAndGrow) {
+    work_steal_deque<int*> deque(4);
+    std::vector<int> values(100);
+
+    for (int i = 0; i < 100; i++) {
+        values[i] = i;
+        deque.push(&values[i]);
+    }
+    EXPECT_EQ(deque.size_approx(), 100u);
+
+    int* value;
+    for (int i = 99; i >= 0; i--) {
+        ASSERT_TRUE(deque.pop(value));
+        EXPECT_EQ(*value, i);
+    }
+    EXPECT_FALSE(deque.pop(value));
+    EXPECT_FALSE(deque.steal(value));
+}
+
+// 窃取者视角：顶部FIFO
+TEST(WorkStealDequeTest, StealFifo) {
+    work_steal_deque<int*> deque;
+    std::vector<int> values(10);
+    for (int i = 0; i < 10; i++) {
+        values[i] = i;
+        deque.push(&values[i]);
+    }
+
+    int* value;
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(deque.steal(value));
+        EXPECT_EQ(*value, i);
+    }
+    EXPECT_FALSE(deque.steal(value));
+}
+
+// 所有者与多个窃取者并发：每个元素恰好被取走一次
+TEST(WorkStealDequeTest, ConcurrentOwnerAndThieves) {
+    work_steal_deque<int*> deque(8);
+    const int NUM_ITEMS = 200000;
+    const int NUM_THIEVES = 4;
+    std::vector<int> values(NUM_ITEMS);
+    std::vector<std::atomic<int>> taken(NUM_ITEMS);
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        values[i] = i;
+        taken[i].store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<int> total_taken(0);
+    std::atomic<bool> owner_done(false);
+
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < NUM_THIEVES; t++) {
+        thieves.emplace_back([&]() {
+            int* value;
+            while (!owner_done || total_taken < NUM_ITEMS) {
+                if (deque.steal(value)) {
+                    taken[*value].fetch_add(1);
+                    total_taken.fetch_add(1);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // 所有者交替压入和弹出
+    int* value;
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        deque.push(&values[i]);
+        if (i % 3 == 0 && deque.pop(value)) {
+            taken[*value].fetch_add(1);
+            total_taken.fetch_add(1);
+        }
+    }
+    while (deque.pop(value)) {
+        taken[*value].fetch_add(1);
+        total_taken.fetch_add(1);
+    }
+    owner_done = true;
+    for (auto& t : thieves) {
+        t.join();
+    }
+
+    EXPECT_EQ(total_taken.load(), NUM_ITEMS);
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        EXPECT_EQ(taken[i].load(), 1) << "Item " << i;
+    }
+}
+
+TEST(ThreadPoolTest, SubmitReturnsFuture) {
+    thread_pool pool(4);
+    EXPECT_EQ(pool.size(), 4u);
+
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 1000; i++) {
+        results.push_back(pool.submit([](int x) { return x * x; }, i));
+    }
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ(results[i].get(), i * i);
+    }
+
+    auto done = pool.submit([] {});
+    done.get();
+}
+
+TEST(ThreadPoolTest, ExceptionPropagatesThroughFuture) {
+    thread_pool pool(2);
+    auto result = pool.submit([]() -> int { throw std::runtime_error("hash failed"); });
+    EXPECT_THROW(result.get(), std::runtime_error);
+
+    // 线程池在任务抛出异常后仍然可用
+    EXPECT_EQ(pool.submit([] { return 7; }).get(), 7);
+}
+
+// 工作线程内部提交的子任务进入本地队列并可被其他线程窃取
+TEST(ThreadPoolTest, NestedSubmitFromWorkers) {
+    thread_pool pool(4);
+    std::atomic<int> leaves(0);
+    const int FAN_OUT = 64;
+
+    std::vector<std::future<void>> parents;
+    for (int p = 0; p < 16; p++) {
+        parents.push_back(pool.submit([&]() {
+            EXPECT_TRUE(pool.in_worker());
+            for (int c = 0; c < FAN_OUT; c++) {
+                pool.submit([&]() { leaves.fetch_add(1); });
+            }
+        }));
+    }
+    for (auto& f : parents) {
+        f.get();
+    }
+    EXPECT_FALSE(pool.in_worker());
+
+    // 等待所有子任务完成
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (leaves.load() < 16 * FAN_OUT && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(leaves.load(), 16 * FAN_OUT);
+}
+
+// 多个外部线程同时提交，注入队列容量很小时提交方阻塞等待
+TEST(ThreadPoolTest, ConcurrentExternalSubmitWithBackpressure) {
+    std::atomic<int> executed(0);
+    {
+        thread_pool pool(3, 8);
+        std::vector<std::thread> submitters;
+        for (int s = 0; s < 4; s++) {
+            submitters.emplace_back([&]() {
+                for (int i = 0; i < 5000; i++) {
+                    pool.submit([&]() { executed.fetch_add(1, std::memory_order_relaxed); });
+                }
+            });
+        }
+        for (auto& t : submitters) {
+            t.join();
+        }
+        // 析构时执行完所有已提交的任务
+    }
+    EXPECT_EQ(executed.load(), 4 * 5000);
+}
+
+// 任务执行完后工作线程休眠，之后提交的任务能唤醒它们
+TEST(ThreadPoolTest, IdleWorkersWakeUp) {
+    thread_pool pool(2);
+    EXPECT_EQ(pool.submit([] { return 1; }).get(), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(pool.submit([] { return 2; }).get(), 2);
+}
+
+// 两个通道都有积压时单个工作线程按权重比例交替执行
+TEST(ThreadPoolTest, WeightedFairLanes) {
+    thread_pool_options options;
+    options.threads = 1;
+    options.lane_weights = {{3, 1}};
+    thread_pool pool(options);
+
+    // 先用一个任务占住唯一的工作线程，再在两个通道各积压一批任务
+    std::promise<void> release;
+    std::shared_future<void> gate = release.get_future().share();
+    auto blocker = pool.submit([gate] { gate.wait(); });
+
+    std::mutex order_mutex;
+    std::vector<task_lane> order;
+    std::vector<std::future<void>> results;
+    for (int i = 0; i < 40; i++) {
+        for (task_lane lane : {task_lane::transfer, task_lane::hash}) {
+            results.push_back(pool.submit_to(lane, [&order_mutex, &order, lane] {
+                std::lock_guard<std::mutex> lock(order_mutex);
+                order.push_back(lane);
+            }));
+        }
+    }
+    release.set_value();
+    blocker.get();
+    for (auto& f : results) {
+        f.get();
+    }
+
+    ASSERT_EQ(order.size(), 80u);
+    // 前 40 个任务中传输任务约占 3/4
+    int transfers = 0;
+    for (int i = 0; i < 40; i++) {
+        transfers += order[i] == task_lane::transfer ? 1 : 0;
+    }
+    EXPECT_GE(transfers, 29);
+    EXPECT_LE(transfers, 31);
+}
+
+// 专用哈希线程：哈希通道被长任务占满时传输任务仍能执行，反之亦然
+TEST(ThreadPoolTest, DedicatedHashWorkersIsolateLanes) {
+    thread_pool_options options;
+    options.threads = 3;
+    options.dedicated_hash_workers = 1;
+    thread_pool pool(options);
+
+    std::promise<void> release_hash;
+    std::shared_future<void> hash_gate = release_hash.get_future().share();
+    auto long_hash = pool.submit_to(task_lane::hash, [hash_gate] { hash_gate.wait(); });
+
+    for (int i = 0; i < 100; i++) {
+        auto result = pool.submit([i] { return i + 1; });
+        ASSERT_EQ(result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+        EXPECT_EQ(result.get(), i + 1);
+    }
+
+    // 哈希通道的后续任务只能由专用线程执行，要等长任务结束
+    auto queued_hash = pool.submit_to(task_lane::hash, [] { return 42; });
+    EXPECT_EQ(queued_hash.wait_for(std::chrono::milliseconds(50)), std::future_status::timeout);
+    release_hash.set_value();
+    long_hash.get();
+    EXPECT_EQ(queued_hash.get(), 42);
+
+    // 占住所有通用线程后，哈希任务仍由专用线程执行
+    std::promise<void> release_transfer;
+    std::shared_future<void> transfer_gate = release_transfer.get_future().share();
+    std::vector<std::future<void>> blockers;
+    for (int i = 0; i < 2; i++) {
+        blockers.push_back(pool.submit([transfer_gate] { transfer_gate.wait(); }));
+    }
+    auto hash_result = pool.submit_to(task_lane::hash, [] { return 7; });
+    ASSERT_EQ(hash_result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(hash_result.get(), 7);
+    release_transfer.set_value();
+    for (auto& f : blockers) {
+        f.get();
+    }
+}
+
+// 跨通道的嵌套提交：哈希任务拆分出的子任务在析构前全部执行
+TEST(ThreadPoolTest, CrossLaneNestedSubmitDrainsOnShutdown) {
+    std::atomic<int> executed(0);
+    {
+        thread_pool_options options;
+        options.threads = 4;
+        options.dedicated_hash_workers = 2;
+        thread_pool pool(options);
+        for (int i = 0; i < 32; i++) {
+            pool.submit_to(task_lane::hash, [&pool, &executed] {
+                for (int c = 0; c < 8; c++) {
+                    pool.submit_to(c % 2 ? task_lane::hash : task_lane::transfer,
+                                   [&executed] { executed.fetch_add(1); });
+                }
+            });
+        }
+    }
+    EXPECT_EQ(executed.load(), 32 * 8);
+}
+
+TEST(ThreadPoolTest, InvalidOptionsThrow) {
+    thread_pool_options options;
+    options.threads = 2;
+    options.dedicated_hash_workers = 2;
+    EXPECT_THROW(thread_pool pool(options), std::invalid_argument);
+
+    options.dedicated_hash_workers = 0;
+    options.lane_weights = {{1, 0}};
+    EXPECT_THROW(thread_pool pool(options), std::invalid_argument);
+
+    options.lane_weights = {{1, 1}};
+    options.queue_capacity = 100;
+    EXPECT_THROW(thread_pool pool(options), std::invalid_argument);
+}
+
+TEST(CpuTopologyTest, ParseCpuList) {
+    EXPECT_EQ(cpu_topology::parse_cpu_list("0-3,8,10-11\n"), (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(cpu_topology::parse_cpu_list("5"), (std::vector<int>{5}));
+    EXPECT_EQ(cpu_topology::parse_cpu_list(""), std::vector<int>());
+    EXPECT_EQ(cpu_topology::parse_cpu_list("3-1,x,2,2"), (std::vector<int>{2}));
+}
+
+TEST(CpuTopologyTest, DetectAndLookup) {
+    cpu_topology topology = cpu_topology::detect();
+    ASSERT_FALSE(topology.nodes.empty());
+    EXPECT_GE(topology.cpu_count(), 1u);
+
+    const int cpu = topology.nodes[0].cpus[0];
+    EXPECT_EQ(topology.node_index_of_cpu(cpu), 0);
+    EXPECT_EQ(topology.node_index_of_cpu(-5), -1);
+    EXPECT_EQ(topology.node_index_of_id(topology.nodes[0].id), 0);
+
+    std::vector<char> page(4096, 1);
+    EXPECT_GE(numa_node_of(page.data()), -1);
+}
+
+// 把本机的 CPU 划分成两个假节点，验证按节点路由和跨节点兜底
+static cpu_topology two_node_topology() {
+    cpu_topology detected = cpu_topology::detect();
+    std::vector<int> cpus;
+    for (const auto& node : detected.nodes) {
+        cpus.insert(cpus.end(), node.cpus.begin(), node.cpus.end());
+    }
+    cpu_topology topology;
+    topology.nodes.resize(2);
+    for (size_t i = 0; i < 2; i++) {
+        topology.nodes[i].id = static_cast<int>(i);
+    }
+    for (size_t i = 0; i < cpus.size(); i++) {
+        topology.nodes[cpus.size() == 1 ? i : i % 2].cpus.push_back(cpus[i]);
+    }
+    if (topology.nodes[1].cpus.empty()) {
+        topology.nodes[1].cpus = topology.nodes[0].cpus;
+    }
+    return topology;
+}
+
+TEST(ThreadPoolTest, NumaAwareRoutesToNode) {
+    thread_pool_options options;
+    options.threads = 4;
+    options.numa_aware = true;
+    options.topology = two_node_topology();
+    thread_pool pool(options);
+    EXPECT_EQ(pool.node_count(), 2u);
+    EXPECT_EQ(pool.current_node(), -1);
+
+    // 等所有线程进入休眠，新任务只会唤醒目标节点的线程
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    int on_target = 0;
+    for (int i = 0; i < 200; i++) {
+        const int node = i % 2;
+        int ran_on = pool.submit_on_node(node, task_lane::transfer, [&pool] { return pool.current_node(); }).get();
+        on_target += ran_on == node ? 1 : 0;
+    }
+    EXPECT_GE(on_target, 180);
+
+    // 工作线程内部提交的任务留在本节点
+    int nested = pool.submit_on_node(1, task_lane::hash, [&pool] {
+        return pool.submit_to(task_lane::hash, [&pool] { return pool.current_node(); }).get();
+    }).get();
+    EXPECT_GE(nested, 0);
+}
+
+// 一个节点的线程全部被占住时，提交到该节点的任务由其他节点执行
+TEST(ThreadPoolTest, NumaAwareSpillsWhenNodeBusy) {
+    thread_pool_options options;
+    options.threads = 4;
+    options.numa_aware = true;
+    options.pin_threads = true;
+    options.topology = two_node_topology();
+    thread_pool pool(options);
+
+    std::promise<void> release;
+    std::shared_future<void> gate = release.get_future().share();
+    std::atomic<int> started(0);
+    std::vector<std::future<void>> blockers;
+    for (int i = 0; i < 2; i++) {
+        blockers.push_back(pool.submit_on_node(0, task_lane::transfer, [gate, &started] {
+            started.fetch_add(1);
+            gate.wait();
+        }));
+    }
+    while (started.load() < 2) {
+        std::this_thread::yield();
+    }
+
+    auto spilled = pool.submit_on_node(0, task_lane::transfer, [] { return 9; });
+    ASSERT_EQ(spilled.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(spilled.get(), 9);
+
+    release.set_value();
+    for (auto& f : blockers) {
+        f.get();
+    }
+}
+
+TEST(ThreadPoolTest, NumaAwareDedicatedHashWorkersPerNode) {
+    thread_pool_options options;
+    options.threads = 4;
+    options.numa_aware = true;
+    options.dedicated_hash_workers = 2;
+    options.topology = two_node_topology();
+    thread_pool pool(options);
+
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 100; i++) {
+        results.push_back(pool.submit_on_node(i % 2, i % 3 ? task_lane::hash : task_lane::transfer, [i] { return i; }));
+    }
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(results[i].get(), i);
+    }
+
+    // 每个节点都必须保留通用线程
+    options.dedicated_hash_workers = 3;
+    EXPECT_THROW(thread_pool bad(options), std::invalid_argument);
+}
+
+// 单个工作线程内拆分子任务并等待结果：等待期间执行子任务，不会死锁
+TEST(ThreadPoolTest, WaitRunsPendingTasksInWorker) {
+    thread_pool pool(1);
+    EXPECT_FALSE(pool.run_pending_task());
+
+    auto total = pool.submit_to(task_lane::hash, [&pool] {
+        std::vector<std::future<int>> parts;
+        for (int i = 1; i <= 100; i++) {
+            parts.push_back(pool.submit_to(task_lane::hash, [i] { return i; }));
+        }
+        int sum = 0;
+        for (auto& part : parts) {
+            pool.wait(part);
+            sum += part.get();
+        }
+        return sum;
+    });
+    pool.wait(total);
+    EXPECT_EQ(total.get(), 5050);
+}